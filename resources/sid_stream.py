@@ -0,0 +1,199 @@
+#!/usr/bin/env python3
+#
+# Compress a raw SID register dump (25 bytes per frame) for sidbits::SIDStream.
+# See src/sidbits/sid_stream.h for the format.
+#
+# Usage: sid_stream.py [--keyframe-interval N] <input.dmp> <output.sidz>
+
+import argparse
+import struct
+import sys
+
+MAGIC = b'SIDZ'
+VERSION = 2
+HEADER_SIZE = 16
+NUM_REGISTERS = 25
+GROUP_SIZE = 7
+NUM_GROUPS = (NUM_REGISTERS + GROUP_SIZE - 1) // GROUP_SIZE
+
+TAG_KEYFRAME = 0x10
+TAG_REPEAT = 0x80
+TAG_REPLAY = 0xC0
+MAX_COUNT = 0x40
+MAX_DISTANCE = 0xFFFF
+REPLAY_SIZE = 3
+MAX_CANDIDATES = 256
+
+# 5s at 50Hz; each keyframe costs 30 bytes
+DEFAULT_KEYFRAME_INTERVAL = 250
+
+
+def frames_from_dump(data):
+    n = len(data) // NUM_REGISTERS
+    return [data[i * NUM_REGISTERS:(i + 1) * NUM_REGISTERS] for i in range(n)]
+
+
+def delta_record(previous, frame):
+    tag = 0
+    body = bytearray()
+    for group in range(NUM_GROUPS):
+        mask = 0
+        values = bytearray()
+        for i in range(GROUP_SIZE):
+            reg = group * GROUP_SIZE + i
+            if reg < NUM_REGISTERS and frame[reg] != previous[reg]:
+                mask |= 1 << i
+                values.append(frame[reg])
+        if mask:
+            tag |= 1 << group
+            body.append(mask)
+            body += values
+    return bytes([tag]) + bytes(body)
+
+
+def records_from_frames(frames, keyframe_interval):
+    """Delta records with runs of unchanged frames collapsed into repeats, and a keyframe record
+    every keyframe_interval frames. Returns the records and a keyframe flag for each."""
+    records = []
+    keyframes = []
+    previous = bytes(NUM_REGISTERS)
+    i = 0
+    while i < len(frames):
+        frame = frames[i]
+        if i % keyframe_interval == 0:
+            records.append(bytes([TAG_KEYFRAME]) + frame)
+            keyframes.append(True)
+            previous = frame
+            i += 1
+        elif frame == previous:
+            run = 1
+            while (run < MAX_COUNT and i + run < len(frames) and frames[i + run] == previous
+                   and (i + run) % keyframe_interval):
+                run += 1
+            records.append(bytes([TAG_REPEAT | (run - 1)]))
+            keyframes.append(False)
+            i += run
+        else:
+            records.append(delta_record(previous, frame))
+            keyframes.append(False)
+            previous = frame
+            i += 1
+    return records, keyframes
+
+
+def replay_records(records, keyframes):
+    """Greedily replace sequences of records with replays of earlier literal records.
+
+    Only literal records can be replayed, and a replay covers consecutive literals in the output.
+    Keyframes are never replayed or replaced. Returns the output and the keyframe offsets.
+    """
+    out = bytearray()
+    keyframe_offsets = []
+    literals = []  # (offset, record, run) of emitted literals; run changes after each replay
+    index = {}  # record -> list of literal indices
+    run = 0
+    i = 0
+    while i < len(records):
+        if keyframes[i]:
+            keyframe_offsets.append(len(out))
+            out += records[i]
+            run += 1
+            i += 1
+            continue
+        best_len, best_bytes, best_literal = 0, 0, None
+        for k in reversed(index.get(records[i], [])[-MAX_CANDIDATES:]):
+            distance = len(out) - literals[k][0]
+            if distance > MAX_DISTANCE:
+                break
+            n, size = 0, 0
+            while (n < MAX_COUNT and i + n < len(records) and not keyframes[i + n]
+                   and k + n < len(literals)
+                   and literals[k + n][2] == literals[k][2] and literals[k + n][1] == records[i + n]):
+                size += len(records[i + n])
+                n += 1
+            if size > best_bytes:
+                best_len, best_bytes, best_literal = n, size, k
+        if best_bytes > REPLAY_SIZE:
+            distance = len(out) - literals[best_literal][0]
+            out += struct.pack('<BH', TAG_REPLAY | (best_len - 1), distance)
+            run += 1
+            i += best_len
+        else:
+            index.setdefault(records[i], []).append(len(literals))
+            literals.append((len(out), records[i], run))
+            out += records[i]
+            i += 1
+    return bytes(out), keyframe_offsets
+
+
+def encode(data, keyframe_interval=DEFAULT_KEYFRAME_INTERVAL):
+    frames = frames_from_dump(data)
+    out, keyframe_offsets = replay_records(*records_from_frames(frames, keyframe_interval))
+    data_start = HEADER_SIZE + 4 * len(keyframe_offsets)
+    header = MAGIC + struct.pack('<BBHII', VERSION, NUM_REGISTERS, keyframe_interval, len(frames),
+                                 len(keyframe_offsets))
+    index = b''.join(struct.pack('<I', data_start + offset) for offset in keyframe_offsets)
+    return header + index + out
+
+
+def decode(data):
+    """Reference decoder, mirrors SIDStream::Step"""
+    assert data[:4] == MAGIC
+    keyframe_interval, num_frames, num_keyframes = struct.unpack_from('<HII', data, 6)
+    index = struct.unpack_from(f'<{num_keyframes}I', data, HEADER_SIZE)
+    registers = bytearray(NUM_REGISTERS)
+    frames = []
+
+    def decode_record(pos):
+        tag = data[pos]
+        pos += 1
+        if tag >= TAG_REPEAT:
+            return pos, (tag & (MAX_COUNT - 1)) + 1
+        if tag == TAG_KEYFRAME:
+            assert pos - 1 == index[len(frames) // keyframe_interval]
+            registers[:] = data[pos:pos + NUM_REGISTERS]
+            return pos + NUM_REGISTERS, 1
+        for group in range(NUM_GROUPS):
+            if tag & (1 << group):
+                mask = data[pos]
+                pos += 1
+                for i in range(GROUP_SIZE):
+                    if mask & (1 << i):
+                        registers[group * GROUP_SIZE + i] = data[pos]
+                        pos += 1
+        return pos, 1
+
+    pos = HEADER_SIZE + 4 * num_keyframes
+    while pos < len(data):
+        if data[pos] >= TAG_REPLAY:
+            count = (data[pos] & (MAX_COUNT - 1)) + 1
+            distance = struct.unpack_from('<H', data, pos + 1)[0]
+            replay = pos - distance
+            for _ in range(count):
+                replay, n = decode_record(replay)
+                frames += [bytes(registers)] * n
+            pos += REPLAY_SIZE
+        else:
+            pos, n = decode_record(pos)
+            frames += [bytes(registers)] * n
+    assert len(frames) == num_frames
+    return b''.join(frames)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--keyframe-interval', type=int, default=DEFAULT_KEYFRAME_INTERVAL)
+    parser.add_argument('input')
+    parser.add_argument('output')
+    args = parser.parse_args()
+    if not 0 < args.keyframe_interval <= 0xFFFF:
+        sys.exit('invalid keyframe interval')
+
+    with open(args.input, 'rb') as f:
+        raw = f.read()
+    raw = raw[:len(raw) - len(raw) % NUM_REGISTERS]
+    compressed = encode(raw, args.keyframe_interval)
+    if decode(compressed) != raw:
+        sys.exit(f'{args.input}: round trip failed')
+    with open(args.output, 'wb') as f:
+        f.write(compressed)
@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+#
+# Upload patches, banks or SID files via sysex. See src/midi/sysex_transfer.h for the protocol.
+#
+# Usage: sysex_transfer.py [--port NAME] [--slot N] {patch,bank,sid} <input>
+#        sysex_transfer.py --output <file.syx> ...
+#
+# Sending to a port uses mido and waits for the replies; writing to a file just produces the
+# messages (without any flow control).
+
+import argparse
+import sys
+import time
+import zlib
+
+SYSEX_ID = 0x7D
+CMD_BEGIN = 0x10
+CMD_DATA = 0x11
+CMD_END = 0x12
+CMD_REPLY = 0x13
+
+TYPES = {'patch': 0, 'bank': 1, 'wavetable': 2, 'sid': 3}
+STATUS = ['OK', 'CHECKSUM', 'SEQUENCE', 'UNSUPPORTED', 'INVALID', 'WRITE', 'CRC']
+
+CHUNK_SIZE = 256
+WINDOW_SIZE = 4
+MAX_SIZE = (1 << 21) - 1
+PATCH_VERSION = 1  # synth::PatchBank::kPatchVersion
+
+TIMEOUT = 0.5
+# Erasing a 128K flash sector takes 1-2s
+BEGIN_TIMEOUT = 4.0
+MAX_RETRIES = 8
+
+
+def pack7(data):
+    out = bytearray()
+    for i in range(0, len(data), 7):
+        group = data[i:i + 7]
+        out.append(sum(((b >> 7) & 1) << n for n, b in enumerate(group)))
+        out += bytes(b & 0x7f for b in group)
+    return bytes(out)
+
+
+def unpack7(data):
+    out = bytearray()
+    for i in range(0, len(data), 8):
+        msbs = data[i]
+        out += bytes(b | ((msbs >> n) & 1) << 7 for n, b in enumerate(data[i + 1:i + 8]))
+    return bytes(out)
+
+
+def begin_message(type, slot, version, size):
+    return bytes([SYSEX_ID, CMD_BEGIN, type, slot, version, size >> 14 & 0x7f, size >> 7 & 0x7f,
+                  size & 0x7f])
+
+
+def data_message(seq, chunk):
+    packed = pack7(chunk)
+    checksum = (seq + sum(packed)) & 0x7f
+    return bytes([SYSEX_ID, CMD_DATA, seq]) + packed + bytes([checksum])
+
+
+def end_message(crc):
+    return bytes([SYSEX_ID, CMD_END] + [crc >> shift & 0x7f for shift in (28, 21, 14, 7, 0)])
+
+
+def messages(type, slot, version, data):
+    """All the messages for a transfer, excluding F0/F7"""
+    chunks = [data[i:i + CHUNK_SIZE] for i in range(0, len(data), CHUNK_SIZE)]
+    return ([begin_message(type, slot, version, len(data))] +
+            [data_message(seq & 0x7f, chunk) for seq, chunk in enumerate(chunks)] +
+            [end_message(zlib.crc32(data))])
+
+
+class Connection:
+    def __init__(self, port):
+        import mido
+        self.mido = mido
+        self.output = mido.open_output(port)
+        self.input = mido.open_input(port)
+
+    def send(self, message):
+        self.output.send(self.mido.Message('sysex', data=message))
+
+    def reply(self, timeout):
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            for msg in self.input.iter_pending():
+                if (msg.type == 'sysex' and len(msg.data) == 5 and msg.data[0] == SYSEX_ID
+                        and msg.data[1] == CMD_REPLY):
+                    return msg.data[2], msg.data[3], msg.data[4]
+            time.sleep(0.001)
+        return None
+
+
+def send(connection, msgs):
+    """Send with up to WINDOW_SIZE chunks in flight, and resend from the seq in a NAK"""
+    begin, chunks, end = msgs[0], msgs[1:-1], msgs[-1]
+
+    def command(message, cmd, timeout):
+        for _ in range(MAX_RETRIES):
+            connection.send(message)
+            reply = connection.reply(timeout)
+            if reply and reply[0] == cmd:
+                if reply[2]:
+                    sys.exit(f'failed: {STATUS[reply[2]]}')
+                return
+        sys.exit('no reply')
+
+    command(begin, CMD_BEGIN, BEGIN_TIMEOUT)
+    acked = 0  # index of the first chunk that wasn't acknowledged
+    sent = 0
+    retries = 0
+    while acked < len(chunks):
+        while sent < len(chunks) and sent < acked + WINDOW_SIZE:
+            connection.send(chunks[sent])
+            sent += 1
+        reply = connection.reply(TIMEOUT)
+        if not reply or reply[0] != CMD_DATA:
+            retries += 1
+            if retries > MAX_RETRIES:
+                sys.exit('no reply')
+            sent = acked
+            continue
+        retries = 0
+        _, seq, status = reply
+        # seq is 7 bit, find the chunk in the window it refers to
+        index = acked + ((seq - acked) & 0x7f)
+        if status == 0:
+            if acked <= index < sent:
+                acked = index + 1
+        elif STATUS[status] in ('CHECKSUM', 'SEQUENCE'):
+            sent = acked = index
+        else:
+            sys.exit(f'failed at {index}: {STATUS[status]}')
+        print(f'\r{acked * CHUNK_SIZE * 100 // (len(chunks) * CHUNK_SIZE)}%', end='', flush=True)
+    print()
+    command(end, CMD_END, BEGIN_TIMEOUT)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--port', help='MIDI port (see mido.get_ioport_names())')
+    parser.add_argument('--output', help='write the messages to a .syx file instead')
+    parser.add_argument('--slot', type=int, default=0)
+    parser.add_argument('type', choices=['patch', 'bank', 'sid'])
+    parser.add_argument('input')
+    args = parser.parse_args()
+    if not 0 <= args.slot < 128:
+        sys.exit('invalid slot')
+
+    with open(args.input, 'rb') as f:
+        data = f.read()
+    if not 0 < len(data) <= MAX_SIZE:
+        sys.exit(f'{args.input}: invalid size')
+
+    msgs = messages(TYPES[args.type], args.slot, PATCH_VERSION, data)
+    if args.output:
+        with open(args.output, 'wb') as f:
+            for message in msgs:
+                f.write(bytes([0xF0]) + message + bytes([0xF7]))
+    elif args.port:
+        send(Connection(args.port), msgs)
+    else:
+        sys.exit('either --port or --output is required')
@@ -0,0 +1,84 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "internal_flash.h"
+
+#include <cstring>
+#include <iterator>
+
+#include "stm32x/stm32x_core.h"
+
+namespace pfm2sid {
+
+static constexpr uint16_t kFlashSectors[] = {FLASH_Sector_5, FLASH_Sector_6,  FLASH_Sector_7,
+                                             FLASH_Sector_8, FLASH_Sector_9,  FLASH_Sector_10,
+                                             FLASH_Sector_11};
+static_assert(std::size(kFlashSectors) ==
+              InternalFlash::kLastSector - InternalFlash::kFirstSector + 1);
+
+static constexpr uint32_t kFlashFlags = FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR |
+                                        FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR;
+
+// The ART data cache may still contain the previous contents
+static void ResetDataCache()
+{
+  FLASH_DataCacheCmd(DISABLE);
+  FLASH_DataCacheReset();
+  FLASH_DataCacheCmd(ENABLE);
+}
+
+bool InternalFlash::Erase(size_t index)
+{
+  if (index >= num_sectors_) return false;
+
+  FLASH_Unlock();
+  FLASH_ClearFlag(kFlashFlags);
+  auto status =
+      FLASH_EraseSector(kFlashSectors[first_sector_ - kFirstSector + index], VoltageRange_3);
+  FLASH_Lock();
+  ResetDataCache();
+  return FLASH_COMPLETE == status;
+}
+
+bool InternalFlash::Program(size_t index, size_t offset, const void *data, size_t len)
+{
+  if (index >= num_sectors_ || offset % kProgramAlignment || len % kProgramAlignment ||
+      offset + len > kSectorSize)
+    return false;
+
+  auto address = reinterpret_cast<uintptr_t>(sector(index)) + offset;
+  auto src = static_cast<const uint8_t *>(data);
+
+  FLASH_Unlock();
+  FLASH_ClearFlag(kFlashFlags);
+  auto status = FLASH_COMPLETE;
+  for (size_t i = 0; i < len && FLASH_COMPLETE == status; i += sizeof(uint32_t)) {
+    uint32_t word;
+    memcpy(&word, src + i, sizeof(word));
+    status = FLASH_ProgramWord(static_cast<uint32_t>(address + i), word);
+  }
+  FLASH_Lock();
+  ResetDataCache();
+  return FLASH_COMPLETE == status;
+}
+
+}  // namespace pfm2sid
@@ -0,0 +1,66 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_INTERNAL_FLASH_H_
+#define PFM2SID_INTERNAL_FLASH_H_
+
+#include "misc/flash_storage.h"
+#include "util/util_macros.h"
+
+namespace pfm2sid {
+
+// A range of the 128K sectors (5-11) of the STM32F405 internal flash. The ones used for storage
+// are excluded from FLASH_SIZE in the Makefile.
+class InternalFlash : public util::FlashStorage {
+public:
+  static constexpr size_t kFirstSector = 5;
+  static constexpr size_t kLastSector = 11;
+  static constexpr size_t kSectorSize = 128 * 1024;
+  static constexpr uintptr_t kFirstSectorAddress = 0x08020000;
+
+  constexpr InternalFlash(size_t first_sector, size_t num_sectors)
+      : first_sector_{first_sector}, num_sectors_{num_sectors}
+  {}
+  DELETE_COPY_MOVE(InternalFlash);
+
+  size_t num_sectors() const final { return num_sectors_; }
+  size_t sector_size() const final { return kSectorSize; }
+
+  const uint8_t *sector(size_t index) const final
+  {
+    return reinterpret_cast<const uint8_t *>(kFirstSectorAddress +
+                                             (first_sector_ - kFirstSector + index) * kSectorSize);
+  }
+
+  // This blocks for up to a few seconds, and code executing from flash stalls too
+  bool Erase(size_t index) final;
+
+  bool Program(size_t index, size_t offset, const void *data, size_t len) final;
+
+private:
+  const size_t first_sector_;
+  const size_t num_sectors_;
+};
+
+}  // namespace pfm2sid
+
+#endif  // PFM2SID_INTERNAL_FLASH_H_
@@ -51,6 +51,10 @@ public:
       return std::nullopt;
     }
   }
+
+  // Transmit is also polled, there's very little to send
+  bool tx_ready() const { return PFM2SID_MIDI_USART->SR & USART_FLAG_TXE; }
+  void Transmit(uint8_t byte) const { PFM2SID_MIDI_USART->DR = byte; }
 };
 
 }  // namespace pfm2sid
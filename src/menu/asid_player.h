@@ -23,11 +23,15 @@
 #ifndef PFM2SID_MENU_ASID_PLAYER_H_
 #define PFM2SID_MENU_ASID_PLAYER_H_
 
+#include <algorithm>
 #include <cinttypes>
+#include <cstring>
 
 #include "menu/menu_util.h"
+#include "misc/crc32.h"
 #include "misc/platform.h"
 #include "pfm2sid_stats.h"
+#include "sidbits/asid_jitter_buffer.h"
 #include "sidbits/asid_parser.h"
 #include "sidbits/sidbits.h"
 #include "synth/engine.h"
@@ -40,15 +44,42 @@ extern synth::Engine engine;
 
 class ASIDPlayer : public Menu {
 public:
-  ASIDPlayer() : Menu("\001 ASID \001") {}
+  ASIDPlayer() : Menu("\001 ASID \001")
+  {
+    jitter_buffer_.Init(synth::kDacUpdateRateHz / kNominalFrameRateHz);
+  }
   DELETE_COPY_MOVE(ASIDPlayer);
 
-  void Step() {}
+  // Multi-SID streams may need more time than we have; the governor drops the other chips then.
+  void Step() final
+  {
+    if (hexdump_) {
+      Invalidate();
+      return;
+    }
+    if (chips_.Changed(rendered_chips()) | stream_chips_.Changed(asid_parser_.num_chips()))
+      Invalidate(LINE(0));
+    const auto lcd_data = asid_parser_.lcd_data();
+    if (lcd_data_crc_.Changed(util::Crc32(lcd_data, strlen(lcd_data)))) Invalidate(LINE(1));
+    if (jitter_buffer_enabled()) {
+      if (period_.Changed(static_cast<uint32_t>(jitter_buffer_.period())) |
+          fill_.Changed(jitter_buffer_.fill()))
+        Invalidate(LINE(2));
+      if (late_.Changed(jitter_buffer_.stats().late) |
+          overflow_.Changed(jitter_buffer_.stats().overflow))
+        Invalidate(LINE(3));
+    }
+    if (render_us_.Changed(stats::render_block_cycles.value_in_us())) Invalidate(LINE(3));
+  }
 
   void HandleMenuEvent(MENU_EVENT menu_event) final
   {
     switch (menu_event) {
-      case MENU_EVENT::ENTER: engine.Reset(); break;
+      case MENU_EVENT::ENTER:
+        engine.Reset();
+        asid_parser_.Resync();
+        jitter_buffer_.Reset(asid_parser_.register_maps());
+        break;
       case MENU_EVENT::EXIT: break;
     }
   }
@@ -62,6 +93,7 @@ public:
           case CONTROL::SWITCH1:
             engine.Reset();
             asid_parser_.Reset();
+            jitter_buffer_.Reset(asid_parser_.register_maps());
             break;
           case CONTROL::SWITCH6: set_mode(MODE::SID_SYNTH); break;
           case CONTROL::SWITCH7:
@@ -73,15 +105,17 @@ public:
         break;
       default: break;
     }
+    Invalidate();
   }
 
-  void UpdateDisplay() const final
+  void UpdateDisplay(LineMask lines) const final
   {
     if (hexdump_) {
       menu::HexdumpRegisters(asid_parser_.register_map());
     } else {
-      display.Fmt(0, "%14s", name());
-      display.Fmt(1, "%20s", asid_parser_.lcd_data());
+      if (lines & LINE(0))
+        display.Fmt(0, "%u/%uSID%8s", rendered_chips(), asid_parser_.num_chips(), name());
+      if (lines & LINE(1)) display.Fmt(1, "%20s", asid_parser_.lcd_data());
       /*
       static const char progress[] = "############            ";
       static_assert(sizeof(progress) == 2 * 12 + 1);
@@ -89,29 +123,96 @@ public:
       auto pct = sid_stream_.percent();
       display.Fmt(2, "[%.*s]%5.1f%%", 12, progress + 12 - (int)(pct / 100.f * 12.f), pct);
       */
-      display.Fmt(2, "%20.2f", PRINT_F32(CoreTimer::timer_to_ms(delta_t_)));
-      display.Fmt(3, "%20" PRIu32, stats::render_block_cycles.value_in_us());
+      if (jitter_buffer_enabled()) {
+        const auto &jitter_stats = jitter_buffer_.stats();
+        if (lines & LINE(2)) {
+          display.Fmt(2, "%6.2fms %2u/%-2u %3" PRIu32 "ms",
+                      PRINT_F32(jitter_buffer_.period() * 1000.f / synth::kDacUpdateRateHz),
+                      static_cast<unsigned>(jitter_buffer_.fill()),
+                      static_cast<unsigned>(jitter_buffer_.depth()),
+                      jitter_buffer_.latency() * 1000 / synth::kDacUpdateRateHz);
+        }
+        if (lines & LINE(3)) {
+          display.Fmt(3, "L%-5" PRIu32 "O%-5" PRIu32 "%7" PRIu32, jitter_stats.late,
+                      jitter_stats.overflow, stats::render_block_cycles.value_in_us());
+        }
+      } else {
+        if (lines & LINE(2)) display.Fmt(2, "%20s", "");
+        if (lines & LINE(3)) display.Fmt(3, "%20" PRIu32, stats::render_block_cycles.value_in_us());
+      }
     }
   }
 
-  auto ParseSysex(const uint8_t *data, size_t len)
+  // Sysex messages are decoded incrementally as the chunks arrive
+  void BeginSysex() { asid_parser_.BeginSysex(); }
+  void FeedSysex(const uint8_t *data, size_t len) { asid_parser_.FeedSysex(data, len); }
+
+  // With the jitter buffer enabled, register updates are queued and released at the frame rate.
+  auto EndSysex(uint32_t timestamp)
+  {
+    auto result = asid_parser_.EndSysex();
+    if (result && jitter_buffer_enabled() && !asid_parser_.frame_writes().empty())
+      jitter_buffer_.Push(timestamp, asid_parser_.frame_writes(), asid_parser_.frame_chip());
+    return result;
+  }
+
+  // Latency in ms (0 = off) and depth in frames
+  void set_jitter_buffer(uint32_t latency_ms, size_t depth)
   {
-    auto now = CoreTimer::now();
-    delta_t_ = now - last_;
-    last_ = now;
+    const bool enabled = jitter_buffer_enabled();
+    jitter_buffer_.set_latency(latency_ms * synth::kDacUpdateRateHz / 1000);
+    jitter_buffer_.set_depth(depth);
+    if (enabled != jitter_buffer_enabled()) {
+      // The render paths need to start from a consistent state
+      if (jitter_buffer_enabled())
+        jitter_buffer_.Reset(asid_parser_.register_maps());
+      else
+        asid_parser_.Resync();
+    }
+    Invalidate(LINE(2) | LINE(3));
+  }
 
-    return asid_parser_.ParseSysex(data, len);
+  // Each chip of the stream is rendered by its own instance, up to the available number
+  void RenderBlock(synth::SampleBuffer::MutableBlock block, uint32_t block_start)
+  {
+    const auto chips = num_chips();
+    if (jitter_buffer_enabled()) {
+      jitter_buffer_.Render(block_start, synth::kSampleBlockSize);
+      engine.RenderBlock(block, jitter_buffer_.register_maps(), nullptr,
+                         jitter_buffer_.register_writes(), synth::Engine::first_chips(chips));
+    } else if (chips > 1) {
+      engine.RenderBlock(block, asid_parser_.register_maps(), nullptr, nullptr,
+                         synth::Engine::first_chips(chips));
+    } else {
+      engine.RenderBlock(block, asid_parser_.register_map(), asid_parser_.take_dirty());
+    }
   }
 
   const auto &register_map() const { return asid_parser_.register_map(); }
 
 private:
+  // Most ASID streams are PAL 50Hz frames
+  static constexpr uint32_t kNominalFrameRateHz = 50;
+
   sidbits::ASIDParser asid_parser_;
+  sidbits::ASIDJitterBuffer jitter_buffer_;
 
-  uint32_t last_ = 0;
-  uint32_t delta_t_ = 0;
+  bool jitter_buffer_enabled() const { return jitter_buffer_.latency() > 0; }
+
+  unsigned num_chips() const { return std::min(asid_parser_.num_chips(), synth::kNumSIDs); }
+  unsigned rendered_chips() const { return std::min(num_chips(), engine.max_chips()); }
 
   bool hexdump_ = false;
+
+  // What's on the display
+  WatchedValue<unsigned> chips_;
+  WatchedValue<unsigned> stream_chips_;
+  WatchedValue<uint32_t> lcd_data_crc_;
+  WatchedValue<uint32_t> period_;
+  WatchedValue<size_t> fill_;
+  WatchedValue<uint32_t> late_;
+  WatchedValue<uint32_t> overflow_;
+  WatchedValue<uint32_t> render_us_{2};
 };
 
 }  // namespace pfm2sid
@@ -23,9 +23,13 @@
 #ifndef PFM2SID_MENU_SID_PLAYER_H_
 #define PFM2SID_MENU_SID_PLAYER_H_
 
+#include <algorithm>
 #include <cinttypes>
 
 #include "menu/menu_util.h"
+#include "pfm2sid_stats.h"
+#include "sidbits/frame_scheduler.h"
+#include "sidbits/psid_player.h"
 #include "sidbits/sid_stream.h"
 #include "sidbits/sidbits.h"
 #include "synth/engine.h"
@@ -36,16 +40,64 @@ namespace pfm2sid {
 
 extern synth::Engine engine;
 
-// This isn't super useful (yet) since it can only play an in-memory stream.
-// We could upload things via SYSEX but it'll make more sense once there's a file system.
+// Plays the last file uploaded via sysex (see midi/sysex_transfer.h and
+// resources/sysex_transfer.py), directly from flash.
+//
+// The data can be a PSID tune, which is run on the emulated 6502, or a register stream.
+// For tunes, encoder 1 selects the song. For streams, encoder 1 scrubs, S2/S3 set the loop
+// start/end at the current position and S4 clears the loop. Encoder 2 sets the stream speed and
+// S5 toggles between PAL and NTSC frame rates.
+//
+// Both are clocked by the render loop so the timing doesn't depend on the UI.
 class SIDPlayer : public Menu {
 public:
-  SIDPlayer() : Menu("\001 SID PLAYER \001") {}
+  SIDPlayer() : Menu("\001 SID PLAYER \001")
+  {
+    frame_scheduler_.Init(synth::kDacUpdateRateHz, sidbits::SID_CLOCK::PAL, 1);
+  }
   DELETE_COPY_MOVE(SIDPlayer);
 
-  void Init(const sidbits::SIDStreamData &stream_data) { sid_stream_.Init(stream_data); }
+  void Init(const sidbits::SIDStreamData &data)
+  {
+    psid_ = psid_player_.Load(data.start, static_cast<size_t>(data.end - data.start));
+    if (psid_) {
+      StartSong(0);
+    } else {
+      sid_stream_.Init(data);
+    }
+    Invalidate();
+  }
+
+  void Step() final
+  {
+    if (hexdump_) {
+      Invalidate();
+      return;
+    }
+    if (render_us_.Changed(stats::render_block_cycles.value_in_us())) Invalidate(LINE(3));
+    if (psid_) {
+      if (song_.Changed(psid_player_.song()) | overruns_.Changed(psid_player_.stats().overruns))
+        Invalidate(LINE(2));
+    } else {
+      if (seconds_.Changed(sid_stream_.frame() / frame_scheduler_.frame_rate()))
+        Invalidate(LINE(1));
+      if (permille_.Changed(static_cast<uint32_t>(sid_stream_.percent() * 10.f)))
+        Invalidate(LINE(2));
+    }
+  }
 
-  void Step() { sid_stream_.Step(); }
+  void RenderBlock(synth::SampleBuffer::MutableBlock block)
+  {
+    if (psid_) {
+      psid_player_.Render(synth::kSampleBlockSize);
+      engine.RenderBlock(block, &psid_player_.register_map(), nullptr,
+                         &psid_player_.block_writes(), synth::Engine::first_chips(1));
+    } else {
+      StepStream();
+      engine.RenderBlock(block, &block_map_, nullptr, &block_writes_,
+                         synth::Engine::first_chips(1));
+    }
+  }
 
   void HandleMenuEvent(MENU_EVENT menu_event) final
   {
@@ -58,12 +110,46 @@ public:
   void HandleEvent(const Event &event) final
   {
     switch (event.type) {
-      case EVENT_ENCODER: break;
+      case EVENT_ENCODER:
+        if (CONTROL::ENCODER1 == event.control && psid_) {
+          const auto songs = static_cast<int32_t>(psid_player_.tune().songs);
+          auto song = static_cast<int32_t>(psid_player_.song()) - 1 + event.value;
+          StartSong(static_cast<unsigned>((song % songs + songs) % songs + 1));
+        } else if (CONTROL::ENCODER1 == event.control) {
+          // Scrub by a second
+          auto frame = static_cast<int32_t>(sid_stream_.frame()) +
+                       event.value * static_cast<int32_t>(frame_scheduler_.frame_rate());
+          Seek(static_cast<uint32_t>(std::max<int32_t>(frame, 0)));
+        } else if (CONTROL::ENCODER2 == event.control && !psid_) {
+          auto speed = frame_scheduler_.speed();
+          speed = event.value > 0 ? speed << 1 : speed >> 1;
+          frame_scheduler_.Init(synth::kDacUpdateRateHz, frame_scheduler_.video_standard(),
+                                speed);
+        }
+        break;
       case EVENT_BUTTON_PRESS:
         switch (event.control) {
           case CONTROL::SWITCH1:
-            engine.Reset();
-            sid_stream_.Reset();
+            if (psid_) {
+              StartSong(psid_player_.song());
+            } else {
+              engine.Reset();
+              sid_stream_.Reset();
+            }
+            break;
+          case CONTROL::SWITCH2:
+            sid_stream_.set_loop(sid_stream_.frame(), sid_stream_.loop_end());
+            break;
+          case CONTROL::SWITCH3:
+            sid_stream_.set_loop(sid_stream_.loop_start(), sid_stream_.frame());
+            break;
+          case CONTROL::SWITCH4: sid_stream_.set_loop(0, sid_stream_.num_frames()); break;
+          case CONTROL::SWITCH5:
+            frame_scheduler_.Init(synth::kDacUpdateRateHz,
+                                  sidbits::SID_CLOCK::PAL == frame_scheduler_.video_standard()
+                                      ? sidbits::SID_CLOCK::NTSC
+                                      : sidbits::SID_CLOCK::PAL,
+                                  frame_scheduler_.speed());
             break;
           case CONTROL::SWITCH7:
             hexdump_ = !hexdump_;
@@ -74,29 +160,119 @@ public:
         break;
       default: break;
     }
+    Invalidate();
   }
 
-  void UpdateDisplay() const final
+  void UpdateDisplay(LineMask lines) const final
   {
     if (hexdump_) {
-      menu::HexdumpRegisters(sid_stream_.register_map());
+      menu::HexdumpRegisters(register_map());
+    } else if (psid_) {
+      auto &tune = psid_player_.tune();
+      if (lines & LINE(0)) display.Fmt(0, "%-20.20s", tune.name);
+      if (lines & LINE(1)) display.Fmt(1, "%-20.20s", tune.author);
+      if (lines & LINE(2)) {
+        display.Fmt(2, "Song %2u/%-2u ovr %5" PRIu32, psid_player_.song(), tune.songs,
+                    psid_player_.stats().overruns);
+      }
+      if (lines & LINE(3)) display.Fmt(3, "%20" PRIu32, stats::render_block_cycles.value_in_us());
     } else {
-      display.Fmt(0, "%14s", name());
+      if (lines & LINE(0)) {
+        display.Fmt(0, "%14s%4" PRIu32 "Hz", name(), frame_scheduler_.frame_rate());
+      }
+      if (lines & LINE(1)) {
+        const auto frame = sid_stream_.frame();
+        if (sid_stream_.loop_start() || sid_stream_.loop_end() < sid_stream_.num_frames()) {
+          const auto start = sid_stream_.loop_start();
+          const auto end = sid_stream_.loop_end();
+          display.Fmt(1, "%02u:%02u  [%02u:%02u-%02u:%02u]", minutes(frame), seconds(frame),
+                      minutes(start), seconds(start), minutes(end), seconds(end));
+        } else {
+          const auto end = sid_stream_.num_frames();
+          display.Fmt(1, "%02u:%02u/%02u:%02u%9s", minutes(frame), seconds(frame), minutes(end),
+                      seconds(end), "");
+        }
+      }
 
       static const char progress[] = "############            ";
       static_assert(sizeof(progress) == 2 * 12 + 1);
 
       auto pct = sid_stream_.percent();
-      display.Fmt(2, "[%.*s]%5.1f%%", 12, progress + 12 - (int)(pct / 100.f * 12.f),
-                  PRINT_F32(pct));
-      display.Fmt(3, "%20" PRIu32, stats::render_block_cycles.value_in_us());
+      if (lines & LINE(2)) {
+        display.Fmt(2, "[%.*s]%5.1f%%", 12, progress + 12 - (int)(pct / 100.f * 12.f),
+                    PRINT_F32(pct));
+      }
+      if (lines & LINE(3)) display.Fmt(3, "%20" PRIu32, stats::render_block_cycles.value_in_us());
     }
   }
 
-  auto register_map() const { return sid_stream_.register_map(); }
+  const sidbits::RegisterMap &register_map() const
+  {
+    return psid_ ? psid_player_.register_map() : block_map_;
+  }
 
 private:
+  // There's no frame rate in the stream (yet), so it's up to the user
+  unsigned minutes(uint32_t frames) const { return frames / frame_scheduler_.frame_rate() / 60; }
+  unsigned seconds(uint32_t frames) const { return frames / frame_scheduler_.frame_rate() % 60; }
+
   sidbits::SIDStream sid_stream_;
+  sidbits::FrameScheduler frame_scheduler_;
+  // Stream state at the start of the current block, and the frame changes within it
+  sidbits::RegisterMap block_map_;
+  sidbits::BlockRegisterWrites block_writes_;
+  sidbits::PSIDPlayer psid_player_;
+  bool psid_ = false;
+
+  // What's on the display
+  WatchedValue<uint32_t> render_us_{2};
+  WatchedValue<unsigned> song_;
+  WatchedValue<uint32_t> overruns_;
+  WatchedValue<uint32_t> seconds_;
+  WatchedValue<uint32_t> permille_;
+
+  void StartSong(unsigned song)
+  {
+    engine.Reset();
+    psid_player_.StartSong(song, static_cast<float>(synth::kDacUpdateRateHz));
+  }
+
+  // Step the stream for each frame in the block, writing the changes at the frame's offset
+  void StepStream()
+  {
+    block_map_ = sid_stream_.register_map();
+    block_writes_.clear();
+
+    auto registers = block_map_;
+    bool jumped = false;
+    frame_scheduler_.Advance(synth::kSampleBlockSize, [&](uint16_t offset) {
+      if (sid_stream_.Step()) jumped = true;
+      auto &frame = sid_stream_.register_map();
+      for (uint8_t reg = 0; reg < sidbits::SID_REGISTER_COUNT; ++reg) {
+        if (frame.peek(reg) != registers.peek(reg)) {
+          registers.poke(reg, frame.peek(reg));
+          block_writes_.push_back(offset, reg, frame.peek(reg));
+        }
+      }
+    });
+
+    // Restore from where the stream jumped to instead, even if it's a little early
+    if (jumped) Restore();
+  }
+
+  // Decoding from the keyframe is quick enough, but the emulator has to catch up too
+  void Seek(uint32_t frame)
+  {
+    sid_stream_.Seek(frame);
+    Restore();
+  }
+
+  void Restore()
+  {
+    block_map_ = sid_stream_.register_map();
+    block_writes_.clear();
+    engine.RestoreState(0, block_map_);
+  }
 
   bool hexdump_ = false;
 };
@@ -23,11 +23,14 @@
 #include "synth_editor.h"
 
 #include <cinttypes>
+#include <cstring>
 
 #include "menu_util.h"
+#include "misc/format.h"
 #include "pfm2sid.h"
 #include "pfm2sid_stats.h"
 #include "synth/engine.h"
+#include "synth/governor.h"
 #include "synth/modulation.h"
 #include "synth/parameter_types.h"
 #include "synth/patch.h"
@@ -39,7 +42,9 @@ namespace pfm2sid {
 extern synth::SystemParameters system_parameters;
 extern synth::Patch current_patch;
 extern synth::Engine engine;
+extern synth::Governor governor;
 extern synth::SIDSynth sid_synth_;
+extern synth::ChangeNotifier parameter_changes;
 
 namespace synth {
 
@@ -75,23 +80,26 @@ static constexpr EditorPageDef editor_page_defs[] = {
     {"System",
      PARAMETER_SCOPE::SYSTEM,
      {GLOBAL::VOICE_MODE, SYSTEM::MIDI_CHANNEL, GLOBAL::CHIP_MODEL, GLOBAL::VOLUME}},
+    {"Engine",
+     PARAMETER_SCOPE::SYSTEM,
+     {SYSTEM::MOD_SMOOTHING, SYSTEM::SID_CLOCK, SYSTEM::ASID_LATENCY, SYSTEM::ASID_DEPTH}},
 };
 static_assert(ARRAY_SIZE(editor_page_defs) == util::enum_count<EDITOR_PAGE>());
 
-static constexpr EDITOR_PAGE menu_levels[][5] = {
+static constexpr EDITOR_PAGE menu_levels[][6] = {
     {EDITOR_PAGE::EDIT_VOICE_OSC, EDITOR_PAGE::EDIT_VOICE_TUNE, EDITOR_PAGE::NONE},
     {EDITOR_PAGE::EDIT_VOICE_ENV, EDITOR_PAGE::EDIT_VOICE_WAVETABLE, EDITOR_PAGE::NONE},
     {EDITOR_PAGE::EDIT_FILTER, EDITOR_PAGE::EDIT_FILTER_VOICES, EDITOR_PAGE::NONE},
     {EDITOR_PAGE::EDIT_VOICE_MOD, EDITOR_PAGE::EDIT_FILTER_MOD, EDITOR_PAGE::NONE},
     {EDITOR_PAGE::EDIT_LFO, EDITOR_PAGE::EDIT_LFO_EXT, EDITOR_PAGE::NONE},
     {EDITOR_PAGE::NONE},
-    {EDITOR_PAGE::EDIT_MISC, EDITOR_PAGE::HEXDUMP, EDITOR_PAGE::INFO, EDITOR_PAGE::STATS,
-     EDITOR_PAGE::NONE},
+    {EDITOR_PAGE::EDIT_MISC, EDITOR_PAGE::EDIT_ENGINE, EDITOR_PAGE::HEXDUMP, EDITOR_PAGE::INFO,
+     EDITOR_PAGE::STATS, EDITOR_PAGE::NONE},
 };
 
 void SIDSynthEditor::MenuInit()
 {
-  register_listener(this);
+  parameter_changes.register_listener(this);
   voice_mode_ = current_patch.parameters.get<GLOBAL::VOICE_MODE, VOICE_MODE>();
 }
 
@@ -127,12 +135,13 @@ void SIDSynthEditor::HandleEvent(const Event &event)
       if (util::enum_to_i(editor_page_) >= util::enum_to_i(EDITOR_PAGE::EDIT_VOICE_TUNE)) {
         auto idx = encoder_index(event.control);
         if (values_[idx]) {
-          if (values_[idx]->change_value(event.value)) {
-            auto ref = values_[idx]->ref();
+          if (values_[idx].change_value(event.value)) {
+            Invalidate(LINE(3));
+            auto ref = values_[idx].ref();
             if (ref.is_system()) {
-              for (auto l : listeners_) l->SystemParameterChanged(ref.system_param);
+              parameter_changes.mark(ref.system_param);
             } else if (ref.is_global()) {
-              for (auto l : listeners_) l->GlobalParameterChanged(ref.global_param);
+              parameter_changes.mark(ref.global_param);
             }
           }
         }
@@ -142,9 +151,33 @@ void SIDSynthEditor::HandleEvent(const Event &event)
   }
 }
 
-// There is definitely room for improvement here, we don't need to redraw most of the screen since
-// it's static. And the formatting is horribly ineffecient.
-void SIDSynthEditor::UpdateDisplay() const
+void SIDSynthEditor::Step()
+{
+  switch (editor_page_) {
+    case EDITOR_PAGE::NONE:
+    case EDITOR_PAGE::INFO: break;
+    case EDITOR_PAGE::HEXDUMP: Invalidate(); break;
+    case EDITOR_PAGE::STATS:
+      if (render_us_.Changed(stats::render_block_cycles.value_in_us()) |
+          render_max_us_.Changed(stats::render_block_cycles.max_in_us()))
+        Invalidate(LINE(0) | LINE(1));
+      if (sid_us_.Changed(stats::sid_clock_cycles.value_in_us()) |
+          sid_max_us_.Changed(stats::sid_clock_cycles.max_in_us()))
+        Invalidate(LINE(2));
+      if (governor_level_.Changed(governor.level()) |
+          governor_changes_.Changed(governor.stats().downgrades + governor.stats().upgrades))
+        Invalidate(LINE(3));
+      break;
+    default:
+      if (patch_number_.Changed(current_patch.number())) Invalidate(LINE(0));
+      for (size_t i = 0; i < values_.size(); ++i) {
+        if (values_[i] && shown_values_[i].Changed(values_[i].value())) Invalidate(LINE(3));
+      }
+      break;
+  }
+}
+
+void SIDSynthEditor::UpdateDisplay(LineMask lines) const
 {
   if (editor_page_ == EDITOR_PAGE::HEXDUMP) {
     menu::HexdumpRegisters(engine.register_map());
@@ -156,7 +189,7 @@ void SIDSynthEditor::UpdateDisplay() const
     display.Fmt(1, "Clk: %luMHz", SystemCoreClock / 1000UL / 1000UL);
     display.Fmt(2, "Eng: %4.1fx%" PRIu32 " dt=%u",
                 PRINT_F32(static_cast<float>(kDacUpdateRateHz) / 1000.f), kSampleBlockSize,
-                SIDInstance::clock_delta_t);
+                engine.clock_delta_t());
     display.Fmt(3, "Mod: %4.1f", PRINT_F32(kModulatorUpdateRateHz));
     return;
   }
@@ -168,64 +201,72 @@ void SIDSynthEditor::UpdateDisplay() const
 
     auto load = static_cast<float>(stats::render_block_cycles.value_in_us()) / blk_max_f * 100.f;
 
-    display.Fmt(0, "load %3.0f%%", PRINT_F32(load));
-    display.Fmt(1, "blk  %4" PRIu32 " %4" PRIu32 " %4" PRIu32,
-                stats::render_block_cycles.value_in_us(), stats::render_block_cycles.max_in_us(),
-                blk_max);
-    display.Fmt(2, "sid  %4" PRIu32 " %4" PRIu32, stats::sid_clock_cycles.value_in_us(),
-                stats::sid_clock_cycles.max_in_us());
-    // display.Fmt(3, "%.3f", sid_synth_.bend());
+    if (lines & LINE(0)) display.Fmt(0, "load %3.0f%%", PRINT_F32(load));
+    if (lines & LINE(1)) {
+      display.Fmt(1, "blk  %4" PRIu32 " %4" PRIu32 " %4" PRIu32,
+                  stats::render_block_cycles.value_in_us(),
+                  stats::render_block_cycles.max_in_us(), blk_max);
+    }
+    if (lines & LINE(2)) {
+      display.Fmt(2, "sid  %4" PRIu32 " %4" PRIu32, stats::sid_clock_cycles.value_in_us(),
+                  stats::sid_clock_cycles.max_in_us());
+    }
+    if (lines & LINE(3)) {
+      const auto &governor_stats = governor.stats();
+      display.Fmt(3, "gov  %u/%u max %u %" PRIu32 "/%" PRIu32, governor.level(),
+                  governor.num_levels() - 1, governor_stats.max_level, governor_stats.downgrades,
+                  governor_stats.upgrades);
+    }
     return;
   }
   {
     const auto &page_def = editor_page_defs[util::enum_to_i(editor_page_)];
 
-    display.Fmt(0, "%02d %s", current_patch.number(), current_patch.name());
+    if (lines & LINE(0)) display.Fmt(0, "%02d %s", current_patch.number(), current_patch.name());
 
     char buf[20] = {0};
     switch (page_def.parameter_type) {
       case PARAMETER_SCOPE::NONE:
       case PARAMETER_SCOPE::SYSTEM:
-      case PARAMETER_SCOPE::GLOBAL: snprintf(buf, sizeof(buf), "%s", page_def.title); break;
+      case PARAMETER_SCOPE::GLOBAL:
+        util::FormatString(buf, sizeof(buf), "%s", page_def.title);
+        break;
       case PARAMETER_SCOPE::VOICE:
         if (edit_individual_voices())
-          snprintf(buf, sizeof(buf), "Voice%d %s", voice_index_ + 1, page_def.title);
+          util::FormatString(buf, sizeof(buf), "Voice%d %s", voice_index_ + 1, page_def.title);
         else
-          snprintf(buf, sizeof(buf), "%s", page_def.title);
+          util::FormatString(buf, sizeof(buf), "%s", page_def.title);
         break;
       case PARAMETER_SCOPE::LFO:
-        snprintf(buf, sizeof(buf), "LFO%d/%d %s", lfo_index_ + 1, 3, page_def.title);
+        util::FormatString(buf, sizeof(buf), "LFO%d/%d %s", lfo_index_ + 1, 3, page_def.title);
         break;
     }
 
-    display.Fmt(1, "%c%-18s%c", navigation_[0], buf, navigation_[1]);
+    if (lines & LINE(1)) display.Fmt(1, "%c%-18s%c", navigation_[0], buf, navigation_[1]);
     for (int i = 0; i < 4; ++i) {
-      auto value = values_[i];
+      auto &value = values_[i];
       if (value) {
-        snprintf(name_buf_ + (i * 5), 6, "%5s", value->name());
-        value->Fmt(value_buf_ + (i * 5));
+        util::Format(name_buf_ + (i * 5), 5, "%5s", value.name());
+        value.Fmt(value_buf_ + (i * 5));
       } else {
         memset(name_buf_ + (i * 5), ' ', 5);
         memset(value_buf_ + (i * 5), ' ', 5);
       }
-
-      display.Write(2, name_buf_);
-      display.Write(3, value_buf_);
     }
+    if (lines & LINE(2)) display.Write(2, name_buf_);
+    if (lines & LINE(3)) display.Write(3, value_buf_);
   }
 }
 
-void SIDSynthEditor::GlobalParameterChanged(GLOBAL parameter)
+void SIDSynthEditor::ParametersChanged(const ChangeSet &changes)
 {
-  switch (parameter) {
-    case GLOBAL::VOICE_MODE:
-      voice_mode_ = current_patch.parameters.get<GLOBAL::VOICE_MODE, VOICE_MODE>();
-      switch (voice_mode_) {
-        case VOICE_MODE::UNISON: voice_index_ = sidbits::VOICE1; break;
-        case VOICE_MODE::POLY: break;
-      }
-      break;
-    default: break;
+  if (changes.test(GLOBAL::VOICE_MODE)) {
+    voice_mode_ = current_patch.parameters.get<GLOBAL::VOICE_MODE, VOICE_MODE>();
+    switch (voice_mode_) {
+      case VOICE_MODE::UNISON: voice_index_ = sidbits::VOICE1; break;
+      case VOICE_MODE::POLY: break;
+    }
+    Invalidate();
   }
 }
 void SIDSynthEditor::CycleVoiceOrLfo()
@@ -282,7 +323,7 @@ void SIDSynthEditor::SetPage(EDITOR_PAGE editor_page, bool force)
       case PARAMETER_SCOPE::LFO:
         values_[i] = current_patch.parameters.mutable_value(ref, lfo_index_);
         break;
-      default: values_[i] = nullptr;
+      default: values_[i] = {};
     }
   }
 
@@ -291,6 +332,7 @@ void SIDSynthEditor::SetPage(EDITOR_PAGE editor_page, bool force)
       menu_levels[menu_level_][menu_subpage_ + 1] != EDITOR_PAGE::NONE ? RIGHT_ARROW_CHAR : ' ';
 
   display.Clear();
+  Invalidate();
 }
 
 }  // namespace synth
@@ -49,6 +49,7 @@ enum struct EDITOR_PAGE {
   EDIT_LFO,
   EDIT_LFO_EXT,
   EDIT_MISC,
+  EDIT_ENGINE,
   LAST
 };
 
@@ -66,18 +67,16 @@ public:
   void MenuInit() final;
   void HandleMenuEvent(MENU_EVENT menu_event) final;
   void HandleEvent(const Event &event) final;
-  void UpdateDisplay() const final;
-  void Step() final {}
+  void UpdateDisplay(LineMask lines) const final;
+  void Step() final;
 
-  void register_listener(ParameterListener *listener) { listeners_.push_back(listener); }
-
-  void GlobalParameterChanged(GLOBAL parameter);
+  void ParametersChanged(const ChangeSet &changes) final;
 
 private:
   int menu_level_ = -1;
   int menu_subpage_ = 0;
   EDITOR_PAGE editor_page_ = EDITOR_PAGE::NONE;
-  std::array<ParameterValue *, 4> values_ = {};
+  std::array<ParameterValue, 4> values_ = {};
 
   mutable char name_buf_[21] = {};
   mutable char value_buf_[21] = {};
@@ -89,7 +88,16 @@ private:
 
   char navigation_[3] = "";
 
-  util::StaticStack<ParameterListener *, 8> listeners_;
+  // What's on the display, values may also be changed via MIDI
+  static constexpr uint32_t kStatsThresholdUs = 2;
+  WatchedValue<int> patch_number_;
+  std::array<WatchedValue<parameter_value_type>, 4> shown_values_;
+  WatchedValue<uint32_t> render_us_{kStatsThresholdUs};
+  WatchedValue<uint32_t> render_max_us_;
+  WatchedValue<uint32_t> sid_us_{kStatsThresholdUs};
+  WatchedValue<uint32_t> sid_max_us_;
+  WatchedValue<unsigned> governor_level_;
+  WatchedValue<uint32_t> governor_changes_;
 
   bool edit_individual_voices() const { return VOICE_MODE::POLY != voice_mode_; }
 
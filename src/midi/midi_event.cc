@@ -0,0 +1,111 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "midi_event.h"
+
+#include <bitset>
+
+#include "midi_parser.h"
+
+namespace pfm2sid::midi {
+
+static constexpr bool is_continuous_controller(uint8_t control)
+{
+  switch (control) {
+    case 0:   // Bank select MSB
+    case 6:   // Data entry MSB
+    case 32:  // Bank select LSB
+    case 38:  // Data entry LSB
+      return false;
+    default: break;
+  }
+  // Data increment/decrement, (N)RPN, channel mode
+  return !(control >= 96 && control <= 101) && control < 120;
+}
+
+size_t CoalesceEvents(MidiEvent *events, size_t num_events)
+{
+  // Walk backwards so the last event of each kind is seen first, and mark the earlier ones
+  std::bitset<kNumMidiChannels> bend, pressure;
+  std::bitset<kNumMidiChannels * 128> controllers;
+
+  bool dropped = false;
+  for (size_t i = num_events; i--;) {
+    auto &event = events[i];
+    auto channel = event.channel();
+    bool drop = false;
+    switch (event.type()) {
+      case CH_PITCHBEND:
+        drop = bend[channel];
+        bend[channel] = true;
+        break;
+      case CH_CHAN_AT:
+        drop = pressure[channel];
+        pressure[channel] = true;
+        break;
+      case CH_CTRL_CHG:
+        if (is_continuous_controller(event.data[0])) {
+          auto key = channel * 128U + event.data[0];
+          drop = controllers[key];
+          controllers[key] = true;
+        }
+        break;
+      default: break;
+    }
+    if (drop) {
+      event.status = 0;
+      dropped = true;
+    }
+  }
+  if (!dropped) return num_events;
+
+  size_t n = 0;
+  for (size_t i = 0; i < num_events; ++i) {
+    if (events[i].status) events[n++] = events[i];
+  }
+  return n;
+}
+
+void DispatchEvent(const MidiEvent &event, MidiHandler &handler)
+{
+  auto channel = event.channel();
+  auto data = event.data;
+  switch (event.type()) {
+    case CH_NOTE_OFF: handler.MidiNoteOff(channel, data[0], data[1]); break;
+    case CH_NOTE_ON:
+      if (data[1]) {
+        handler.MidiNoteOn(channel, data[0], data[1]);
+      } else {
+        handler.MidiNoteOff(channel, data[0], 0);
+      }
+      break;
+    case CH_POLY_AT: handler.MidiAftertouch(channel, data[0], data[1]); break;
+    case CH_CTRL_CHG: handler.MidiControlChange(channel, data[0], data[1]); break;
+    case CH_PROG_CHG: handler.MidiProgramChange(channel, data[0]); break;
+    case CH_CHAN_AT: handler.MidiAftertouch(channel, data[0]); break;
+    case CH_PITCHBEND:
+      handler.MidiPitchbend(channel, static_cast<int16_t>(-8192 + (data[1] << 7) + data[0]));
+      break;
+  }
+}
+
+}  // namespace pfm2sid::midi
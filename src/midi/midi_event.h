@@ -0,0 +1,75 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_MIDI_EVENT_H_
+#define PFM2SID_MIDI_EVENT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "midi_types.h"
+#include "misc/spsc_queue.h"
+
+namespace pfm2sid::midi {
+
+class MidiHandler;
+
+// Compact record of a channel message, so the parser can queue them instead of calling the
+// handler directly. The consumer can then process all events for a block at once.
+struct MidiEvent {
+  uint8_t status;  // including channel
+  uint8_t data[2];
+
+  uint8_t type() const { return status & 0xf0; }
+  Channel channel() const { return status & 0x0f; }
+};
+static_assert(sizeof(MidiEvent) == 3);
+
+static constexpr size_t kMidiEventQueueSize = 64;
+using MidiEventQueue = util::SpscQueue<MidiEvent, kMidiEventQueueSize>;
+
+// Remove pitch bend, channel pressure and (continuous) CC events that are superseded by a later one
+// of the same kind on the same channel. Controllers where the sequence matters, e.g. (N)RPN, data
+// entry, bank select and channel mode messages, are kept. Returns the new number of events.
+size_t CoalesceEvents(MidiEvent *events, size_t num_events);
+
+// Call the matching handler function, same as the parser would
+void DispatchEvent(const MidiEvent &event, MidiHandler &handler);
+
+// Drain the queue, coalesce, and dispatch
+template <size_t N>
+void DispatchEvents(util::SpscQueue<MidiEvent, N> &queue, MidiHandler &handler)
+{
+  MidiEvent events[N];
+  size_t num_events = 0;
+  for (auto span = queue.ReadableSpan(); span.size; span = queue.ReadableSpan()) {
+    for (size_t i = 0; i < span.size; ++i) events[num_events++] = span.data[i];
+    queue.Consume(span.size);
+  }
+
+  num_events = CoalesceEvents(events, num_events);
+  for (size_t i = 0; i < num_events; ++i) DispatchEvent(events[i], handler);
+}
+
+}  // namespace pfm2sid::midi
+
+#endif  // PFM2SID_MIDI_EVENT_H_
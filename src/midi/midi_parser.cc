@@ -22,6 +22,8 @@
 //
 #include "midi_parser.h"
 
+#include <algorithm>
+#include <cstring>
 #include <tuple>
 
 #ifdef MIDI_TRACE_FMT
@@ -58,6 +60,7 @@ void MidiParser::Init(const Handlers &handlers)
   midi_handler_ = handlers.midi_handler;
   sys_handler_ = handlers.sys_handler;
   rt_handler_ = handlers.rt_handler;
+  event_queue_ = handlers.event_queue;
 }
 
 void MidiParser::Reset()
@@ -143,21 +146,7 @@ void MidiParser::Parse(uint8_t byte)
     if (state_.msg_len < state_.expected_msg_len) return;
 
     if (SYSEX_STATUS::IDLE != state_.sysex_status) {
-      // This handler can use the 3 bytes to decide whether to continue at all by returning false.
-      // TODO Make this optional
-      if (midi_handler_ &&
-          midi_handler_->MidiSysex(data_.data(), state_.msg_len, state_.sysex_status)) {
-        if (state_.sysex_status == SYSEX_STATUS::DATA) {
-          state_.msg_len = 0;
-        } else {
-          state_.sysex_status = SYSEX_STATUS::DATA;
-        }
-        state_.expected_msg_len = kRxBufferSize;
-      } else {
-        // End transfer, further data will be ignored.
-        state_.sysex_status = SYSEX_STATUS::IDLE;
-        state_.running_status = 0;
-      }
+      DispatchSysex(data_.data(), state_.msg_len);
     } else {
       DispatchMessage(state_.running_status);
       if (!is_channel_message(state_.running_status)) state_.running_status = 0;
@@ -169,6 +158,7 @@ void MidiParser::Parse(uint8_t byte)
     // End or abort current sysex transfer, if any
     if (SYSEX_STATUS::IDLE != state_.sysex_status) {
       bool eox = byte == SYS_EOX;
+      FlushEvents();
       if (midi_handler_)
         (void)midi_handler_->MidiSysex(data_.data(), state_.msg_len,
                                        eox ? SYSEX_STATUS::EOX : SYSEX_STATUS::ABORT);
@@ -199,6 +189,84 @@ void MidiParser::Parse(uint8_t byte)
   }
 }
 
+// Find the first status byte in [data, end), or end. Checks 4 bytes at a time for the high bit.
+static const uint8_t *find_status_byte(const uint8_t *data, const uint8_t *end)
+{
+  while (end - data >= 4) {
+    uint32_t word;
+    memcpy(&word, data, sizeof(word));
+    if (word & 0x80808080U) break;
+    data += 4;
+  }
+  while (data != end && is_data_byte(*data)) ++data;
+  return data;
+}
+
+void MidiParser::Parse(const uint8_t *data, size_t len)
+{
+  const auto end = data + len;
+  while (data != end) {
+    // Runs of data bytes are only interesting for sysex (or get ignored), channel messages are
+    // short enough that the per-byte path is fine.
+    const bool sysex = SYSEX_STATUS::IDLE != state_.sysex_status;
+    if (is_data_byte(*data) && (sysex || !state_.running_status)) {
+      auto run_end = find_status_byte(data + 1, end);
+      if (!state_.running_status) {
+        data = run_end;  // Orphan data or noise
+        continue;
+      }
+      while (data != run_end && state_.running_status) {
+        if (SYSEX_STATUS::DATA == state_.sysex_status) {
+          // Transfer is accepted, so flush anything buffered and then pass the data in-place
+          if (state_.msg_len) {
+            DispatchSysex(data_.data(), state_.msg_len);
+          } else {
+            auto n = std::min<size_t>(run_end - data, kRxBufferSize);
+            DispatchSysex(data, static_cast<unsigned>(n));
+            data += n;
+          }
+          continue;
+        }
+        auto n = std::min<size_t>(run_end - data, state_.expected_msg_len - state_.msg_len);
+        memcpy(data_.data() + state_.msg_len, data, n);
+        state_.msg_len += static_cast<unsigned>(n);
+        data += n;
+        if (state_.msg_len >= state_.expected_msg_len) DispatchSysex(data_.data(), state_.msg_len);
+      }
+      if (!state_.running_status) data = run_end;
+    } else {
+      Parse(*data++);
+    }
+  }
+}
+
+void MidiParser::FlushEvents() const
+{
+  // Channel messages before a sysex (e.g. a program change before a scale) have to be handled
+  // first. There can't be any new ones until the sysex ends.
+  if (event_queue_ && midi_handler_ && event_queue_->readable())
+    DispatchEvents(*event_queue_, *midi_handler_);
+}
+
+void MidiParser::DispatchSysex(const uint8_t *data, unsigned len)
+{
+  FlushEvents();
+  // This handler can use the 3 bytes to decide whether to continue at all by returning false.
+  // TODO Make this optional
+  if (midi_handler_ && midi_handler_->MidiSysex(data, len, state_.sysex_status)) {
+    if (state_.sysex_status == SYSEX_STATUS::DATA) {
+      state_.msg_len = 0;
+    } else {
+      state_.sysex_status = SYSEX_STATUS::DATA;
+    }
+    state_.expected_msg_len = kRxBufferSize;
+  } else {
+    // End transfer, further data will be ignored.
+    state_.sysex_status = SYSEX_STATUS::IDLE;
+    state_.running_status = 0;
+  }
+}
+
 void MidiParser::DispatchMessage(uint8_t running_status) const
 {
   MIDI_TRACE_FMT("Dispatch {:02x}", running_status);
@@ -214,25 +282,13 @@ void MidiParser::DispatchMessage(uint8_t running_status) const
     return;
   }
 
-  if (midi_handler_) {
-    auto [hi, lo] = split_status_byte(running_status);
-    switch (hi) {
-      case STATUS::CH_NOTE_OFF: midi_handler_->MidiNoteOff(lo, data_[0], data_[1]); break;
-      case STATUS::CH_NOTE_ON:
-        if (data_[1]) {
-          midi_handler_->MidiNoteOn(lo, data_[0], data_[1]);
-        } else {
-          midi_handler_->MidiNoteOff(lo, data_[0], 0);
-        }
-        break;
-      case STATUS::CH_POLY_AT: midi_handler_->MidiAftertouch(lo, data_[0], data_[1]); break;
-      case STATUS::CH_CTRL_CHG: midi_handler_->MidiControlChange(lo, data_[0], data_[1]); break;
-      case STATUS::CH_PROG_CHG: midi_handler_->MidiProgramChange(lo, data_[0]); break;
-      case STATUS::CH_CHAN_AT: midi_handler_->MidiAftertouch(lo, data_[0]); break;
-      case STATUS::CH_PITCHBEND:
-        midi_handler_->MidiPitchbend(lo, static_cast<int16_t>(-8192 + (data_[1] << 7) + data_[0]));
-        break;
-    }
+  // Single data byte messages have a stale second byte, but it's ignored
+  const MidiEvent event{running_status, {data_[0], data_[1]}};
+  if (event_queue_) {
+    // Can't fail as long as the caller sticks to max_parse_len()
+    (void)event_queue_->Write(event);
+  } else if (midi_handler_) {
+    DispatchEvent(event, *midi_handler_);
   }
 }
 
@@ -24,7 +24,9 @@
 #define PFM2SID_MIDI_PARSER_H_
 
 #include <array>
+#include <limits>
 
+#include "midi_event.h"
 #include "midi_types.h"
 
 namespace pfm2sid::midi {
@@ -106,10 +108,13 @@ public:
 
   // The sysex handler should receive
   // SYSEX_STATUS::START when the first 3 bytes are received.
-  // SYSEX_STATUS::DATA on-going data when the buffer is full.
-  // SYSEX_STATUS::EOX when transfer complete
+  // SYSEX_STATUS::DATA on-going data when the buffer is full (or a chunk of data in-place).
+  // SYSEX_STATUS::EOX when transfer complete, with any remaining data (len may be 0)
   // SYSEX_STATUS::ABORT when transfer aborted.
   //
+  // The START bytes are only a preview, i.e. they are repeated in the first DATA/EOX chunk so the
+  // concatenated chunks are the complete message.
+  //
   // Returning false for START or DATA will stop the transfer and further data will be ignored.
   // TODO this is wasteful for small messages (since they get callbacked twice) so perhaps this
   // pre-filter can be optional.
@@ -141,6 +146,10 @@ public:
     MidiHandler *midi_handler = nullptr;
     MidiHandlerSys *sys_handler = nullptr;
     MidiHandlerRT *rt_handler = nullptr;
+    // If set, channel messages are queued instead of calling midi_handler. Sysex, system and
+    // realtime messages aren't affected, but queued events are dispatched before a sysex message is
+    // passed on so the order is kept. The caller has to limit the input to max_parse_len().
+    MidiEventQueue *event_queue = nullptr;
   };
 
   void Init(const Handlers &handlers);
@@ -149,13 +158,21 @@ public:
 
   void Parse(uint8_t byte);
 
-  void Parse(const uint8_t *data, size_t len)
-  {
-    while (len--) Parse(*data++);
-  }
+  // Same result as calling Parse(byte) for each byte, but sysex payload (or orphaned data) is
+  // handled in runs up to the next status byte. Once a sysex transfer is accepted, the runs are
+  // passed to the handler in-place, so the DATA chunks may be smaller than the buffer.
+  void Parse(const uint8_t *data, size_t len);
 
   auto current_state() const { return state_; }
 
+  // Number of bytes that can be parsed without overflowing the event queue. Each byte completes
+  // at most one message, so this is the free space in the queue; unparsed bytes should stay in the
+  // input buffer until the queue has been drained.
+  size_t max_parse_len() const
+  {
+    return event_queue_ ? event_queue_->writeable() : std::numeric_limits<size_t>::max();
+  }
+
 private:
   static constexpr unsigned kRxBufferSize = MIDI_PARSER_RX_BUFFER_SIZE;
   static constexpr unsigned kSysexMinLen = 3;
@@ -172,8 +189,11 @@ private:
   MidiHandler *midi_handler_ = nullptr;
   MidiHandlerSys *sys_handler_ = nullptr;
   MidiHandlerRT *rt_handler_ = nullptr;
+  MidiEventQueue *event_queue_ = nullptr;
 
   void DispatchMessage(uint8_t running_status) const;
+  void DispatchSysex(const uint8_t *data, unsigned len);
+  void FlushEvents() const;
 
   constexpr static unsigned expected_msg_len(uint8_t status_byte);
 };
@@ -0,0 +1,181 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "sysex_transfer.h"
+
+#include <algorithm>
+
+#include "misc/crc32.h"
+#include "misc/platform.h"
+
+ENABLE_WCONVERSION()
+
+namespace pfm2sid::midi {
+
+static constexpr size_t kHeaderLen = 2;  // id, command
+static constexpr size_t kBeginLen = kHeaderLen + 6;
+static constexpr size_t kEndLen = kHeaderLen + 5;
+
+void SysexTransfer::BeginSysex()
+{
+  command_ = 0;
+  pos_ = 0;
+  sum_ = 0;
+  group_pos_ = 0;
+  overflow_ = false;
+  chunk_len_ = 0;
+}
+
+void SysexTransfer::FeedSysex(const uint8_t *data, size_t len)
+{
+  while (len--) {
+    const auto byte = *data++;
+    const auto pos = pos_++;
+    if (pos < kHeaderLen) {
+      header_[pos] = byte;
+      if (pos == 1) command_ = byte;
+    } else if (static_cast<uint8_t>(COMMAND::DATA) == command_) {
+      if (pos == kHeaderLen) {
+        seq_in_ = byte;
+        sum_ = byte;
+      } else {
+        if (pos > kHeaderLen + 1) {
+          sum_ = static_cast<uint8_t>(sum_ + pending_);
+          Decode(pending_);
+        }
+        pending_ = byte;
+      }
+    } else if (pos < sizeof(header_)) {
+      header_[pos] = byte;
+    }
+  }
+}
+
+std::optional<SysexTransfer::Reply> SysexTransfer::EndSysex()
+{
+  const auto command = command_;
+  command_ = 0;
+  switch (static_cast<COMMAND>(command)) {
+    case COMMAND::BEGIN: return HandleBegin();
+    case COMMAND::DATA: return HandleData();
+    case COMMAND::END: return HandleEnd();
+    default: break;
+  }
+  return std::nullopt;
+}
+
+void SysexTransfer::Decode(uint8_t byte)
+{
+  if (!group_pos_) {
+    msbs_ = byte;
+    group_pos_ = 1;
+    return;
+  }
+  const auto value = static_cast<uint8_t>(byte | ((msbs_ >> (group_pos_ - 1)) & 1) << 7);
+  if (chunk_len_ < kChunkSize) {
+    chunk_[chunk_len_++] = value;
+  } else {
+    overflow_ = true;
+  }
+  group_pos_ = group_pos_ == 7 ? 0 : static_cast<uint8_t>(group_pos_ + 1);
+}
+
+void SysexTransfer::Cancel()
+{
+  if (sink_) (void)sink_->End(false);
+  sink_ = nullptr;
+}
+
+SysexTransfer::Reply SysexTransfer::HandleBegin()
+{
+  Cancel();
+  if (pos_ != kBeginLen || header_[2] >= util::enum_count<TYPE>())
+    return {COMMAND::BEGIN, 0, STATUS::INVALID};
+
+  const auto type = static_cast<TYPE>(header_[2]);
+  const auto slot = header_[3];
+  const auto version = header_[4];
+  const size_t size = static_cast<size_t>(header_[5]) << 14 | static_cast<size_t>(header_[6]) << 7 |
+                      header_[7];
+
+  auto sink = sinks_[util::enum_to_i(type)];
+  if (!sink) return {COMMAND::BEGIN, 0, STATUS::UNSUPPORTED};
+  if (!size || !sink->Begin(type, slot, version, size)) return {COMMAND::BEGIN, 0, STATUS::INVALID};
+
+  sink_ = sink;
+  type_ = type;
+  size_ = size;
+  offset_ = 0;
+  crc_ = 0;
+  seq_ = 0;
+  return {COMMAND::BEGIN, 0, STATUS::OK};
+}
+
+SysexTransfer::Reply SysexTransfer::HandleData()
+{
+  if (!sink_) return {COMMAND::DATA, seq_in_, STATUS::INVALID};
+
+  // Anything that could be the result of a dropped or damaged byte is resent
+  if (pos_ <= kHeaderLen + 1 || overflow_ || (sum_ & 0x7f) != pending_)
+    return {COMMAND::DATA, seq_, STATUS::CHECKSUM};
+
+  if (seq_in_ != seq_) {
+    // A chunk already received, e.g. after a resend was requested
+    const auto behind = static_cast<uint8_t>((seq_ - seq_in_) & 0x7f);
+    if (behind && behind <= kWindowSize) return {COMMAND::DATA, seq_in_, STATUS::OK};
+    return {COMMAND::DATA, seq_, STATUS::SEQUENCE};
+  }
+
+  if (chunk_len_ != std::min(kChunkSize, size_ - offset_)) {
+    Cancel();
+    return {COMMAND::DATA, seq_in_, STATUS::INVALID};
+  }
+  if (!sink_->Write(offset_, chunk_, chunk_len_)) {
+    Cancel();
+    return {COMMAND::DATA, seq_in_, STATUS::WRITE};
+  }
+
+  crc_ = util::Crc32(chunk_, chunk_len_, crc_);
+  offset_ += chunk_len_;
+  seq_ = static_cast<uint8_t>((seq_ + 1) & 0x7f);
+  return {COMMAND::DATA, seq_in_, STATUS::OK};
+}
+
+SysexTransfer::Reply SysexTransfer::HandleEnd()
+{
+  if (!sink_ || pos_ != kEndLen) {
+    Cancel();
+    return {COMMAND::END, seq_, STATUS::INVALID};
+  }
+
+  uint32_t crc = 0;
+  for (size_t i = kHeaderLen; i < kEndLen; ++i) crc = crc << 7 | header_[i];
+
+  const bool ok = offset_ == size_ && crc == crc_;
+  auto sink = sink_;
+  sink_ = nullptr;
+  const bool committed = sink->End(ok);
+  if (!ok) return {COMMAND::END, seq_, STATUS::CRC};
+  return {COMMAND::END, seq_, committed ? STATUS::OK : STATUS::WRITE};
+}
+
+}  // namespace pfm2sid::midi
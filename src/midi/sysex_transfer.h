@@ -0,0 +1,153 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_MIDI_SYSEX_TRANSFER_H_
+#define PFM2SID_MIDI_SYSEX_TRANSFER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "util/util_templates.h"
+
+namespace pfm2sid::midi {
+
+// Bulk transfers of patches, banks and SID tunes via sysex.
+//
+// Messages use the non-commercial manufacturer id (like the scale sysex, see synth/tuning.h):
+//   BEGIN [7D][10][type][slot][version][size x3]
+//   DATA  [7D][11][seq][packed data...][checksum]
+//   END   [7D][12][crc x5]
+// and every message is answered with
+//   REPLY [7D][13][command][seq][status]
+//
+// The size is 21 bit and the CRC (of the whole decoded data) 32 bit, both MSB first in 7-bit
+// bytes. DATA contains up to kChunkSize bytes; every 7 bytes are packed as a byte with their MSBs
+// (bit i is the MSB of byte i) followed by the 7 low bits of each. The checksum is the 7-bit sum
+// of seq and the packed bytes. seq is 0 for the first chunk and wraps at 128.
+//
+// Flow control: the host may send up to kWindowSize chunks ahead of the last OK. If a chunk is
+// corrupt or missing, the REPLY contains the expected seq and the host resends from there;
+// chunks that were already received are acknowledged again but not written twice. If there's no
+// reply (e.g. the message was interrupted) the host resends after a timeout.
+//
+// Each message is decoded as it arrives, so only a single chunk is buffered before it's verified
+// and passed to the sink for the type, which writes it (e.g. to flash) directly.
+class SysexTransfer {
+public:
+  static constexpr uint8_t kSysexId = 0x7D;
+  static constexpr size_t kChunkSize = 256;
+  static constexpr unsigned kWindowSize = 4;
+  static constexpr size_t kMaxSize = (1U << 21) - 1;
+
+  enum struct COMMAND : uint8_t { BEGIN = 0x10, DATA = 0x11, END = 0x12, REPLY = 0x13 };
+  enum struct TYPE : uint8_t { PATCH, BANK, WAVETABLE, SID, LAST };
+  enum struct STATUS : uint8_t {
+    OK,
+    CHECKSUM,     // chunk was corrupt, resend from seq
+    SEQUENCE,     // chunk was out of order, resend from seq
+    UNSUPPORTED,  // no sink for the type
+    INVALID,      // rejected by the sink, or unexpected message; the transfer is aborted
+    WRITE,        // the sink failed to write; the transfer is aborted
+    CRC,          // the data was incomplete or didn't match the CRC
+  };
+
+  struct Reply {
+    COMMAND command;
+    uint8_t seq;
+    STATUS status;
+
+    // Complete sysex message including F0/F7
+    std::array<uint8_t, 7> sysex() const
+    {
+      return {0xF0, kSysexId, static_cast<uint8_t>(COMMAND::REPLY),
+              static_cast<uint8_t>(command), seq, static_cast<uint8_t>(status), 0xF7};
+    }
+  };
+
+  class Sink {
+  public:
+    virtual ~Sink() = default;
+
+    // Return false to reject the transfer, e.g. if the version or size don't fit
+    virtual bool Begin(TYPE type, uint8_t slot, uint8_t version, size_t size) = 0;
+    // The data arrives in order, in chunks of kChunkSize except for the last one
+    virtual bool Write(size_t offset, const uint8_t *data, size_t len) = 0;
+    // Called with true if all the data was received and verified; returns true if it was committed
+    virtual bool End(bool ok) = 0;
+  };
+
+  static constexpr bool is_transfer_sysex(const uint8_t *data)
+  {
+    return kSysexId == data[0] && data[1] >= static_cast<uint8_t>(COMMAND::BEGIN) &&
+           data[1] <= static_cast<uint8_t>(COMMAND::END);
+  }
+
+  void set_sink(TYPE type, Sink *sink) { sinks_[util::enum_to_i(type)] = sink; }
+
+  // Incremental decoding of a message (excluding F0/F7). EndSysex returns the reply, or nullopt if
+  // it wasn't a transfer message.
+  void BeginSysex();
+  void FeedSysex(const uint8_t *data, size_t len);
+  std::optional<Reply> EndSysex();
+  void AbortSysex() { command_ = 0; }
+
+  bool active() const { return sink_; }
+  TYPE type() const { return type_; }
+  size_t size() const { return size_; }
+  size_t received() const { return offset_; }
+
+private:
+  std::array<Sink *, util::enum_count<TYPE>()> sinks_ = {};
+
+  // Current transfer
+  Sink *sink_ = nullptr;
+  TYPE type_ = TYPE::PATCH;
+  size_t size_ = 0;
+  size_t offset_ = 0;
+  uint32_t crc_ = 0;
+  uint8_t seq_ = 0;
+
+  // Current message
+  uint8_t command_ = 0;
+  size_t pos_ = 0;
+  uint8_t header_[8] = {};
+  uint8_t seq_in_ = 0;
+  uint8_t sum_ = 0;
+  uint8_t pending_ = 0;  // the last byte might be the checksum
+  uint8_t group_pos_ = 0;
+  uint8_t msbs_ = 0;
+  bool overflow_ = false;
+  size_t chunk_len_ = 0;
+  uint8_t chunk_[kChunkSize] = {};
+
+  void Decode(uint8_t byte);
+  void Cancel();
+  Reply HandleBegin();
+  Reply HandleData();
+  Reply HandleEnd();
+};
+
+}  // namespace pfm2sid::midi
+
+#endif  // PFM2SID_MIDI_SYSEX_TRANSFER_H_
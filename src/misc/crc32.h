@@ -0,0 +1,55 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_MISC_CRC32_H_
+#define PFM2SID_MISC_CRC32_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace util {
+
+namespace detail {
+inline constexpr auto kCrc32Table = [] {
+  std::array<uint32_t, 256> table = {};
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (int j = 0; j < 8; ++j) crc = (crc >> 1) ^ (crc & 1 ? 0xedb88320U : 0U);
+    table[i] = crc;
+  }
+  return table;
+}();
+}  // namespace detail
+
+// Standard (zlib) CRC-32. It can be computed incrementally by passing in the previous result.
+inline uint32_t Crc32(const void *data, size_t len, uint32_t crc = 0)
+{
+  auto bytes = static_cast<const uint8_t *>(data);
+  crc = ~crc;
+  while (len--) crc = detail::kCrc32Table[(crc ^ *bytes++) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+}  // namespace util
+
+#endif  // PFM2SID_MISC_CRC32_H_
@@ -0,0 +1,164 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_MISC_FLASH_FILE_H_
+#define PFM2SID_MISC_FLASH_FILE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "crc32.h"
+#include "flash_storage.h"
+
+namespace util {
+
+// A single file in flash storage, e.g. an uploaded SID tune, that can be read in place. The
+// sectors have to be contiguous in memory.
+//
+// The data is written sequentially after the header, which is written last (with the magic last
+// of all), so a partially written file is never valid.
+class FlashFile {
+public:
+  void Init(FlashStorage *storage)
+  {
+    storage_ = storage;
+    valid_ = Verify();
+  }
+
+  bool valid() const { return valid_; }
+  const uint8_t *data() const { return storage_->sector(0) + sizeof(Header); }
+  size_t size() const { return valid_ ? header()->size : 0; }
+
+  size_t capacity() const
+  {
+    return storage_->num_sectors() * storage_->sector_size() - sizeof(Header);
+  }
+
+  // Erase the current file to make room for size bytes
+  bool Begin(size_t size)
+  {
+    valid_ = false;
+    if (size > capacity()) return false;
+    const auto end = sizeof(Header) + size;
+    for (size_t s = 0; s * storage_->sector_size() < end; ++s) {
+      if (!storage_->Erase(s)) return false;
+    }
+    size_ = size;
+    offset_ = 0;
+    tail_len_ = 0;
+    return true;
+  }
+
+  // Append data; this fails if it's more than the size passed to Begin
+  bool Write(const uint8_t *data, size_t len)
+  {
+    if (offset_ + tail_len_ + len > size_) return false;
+    // Program in aligned blocks, the remainder is kept until the next write
+    while (len) {
+      const auto n = std::min(len, sizeof(tail_) - tail_len_);
+      memcpy(tail_ + tail_len_, data, n);
+      data += n;
+      len -= n;
+      tail_len_ += n;
+      if (sizeof(tail_) == tail_len_ && !Flush()) return false;
+      if (len >= sizeof(tail_)) {
+        const auto aligned = len - len % sizeof(tail_);
+        if (!Program(sizeof(Header) + offset_, data, aligned)) return false;
+        offset_ += aligned;
+        data += aligned;
+        len -= aligned;
+      }
+    }
+    return true;
+  }
+
+  bool Commit()
+  {
+    if (tail_len_) {
+      memset(tail_ + tail_len_, FlashStorage::kErasedValue, sizeof(tail_) - tail_len_);
+      if (!Flush()) return false;
+    }
+    if (offset_ < size_) return false;
+
+    Header header = {static_cast<uint32_t>(size_), Crc32(data(), size_), kMagic};
+    if (!Program(0, &header, offsetof(Header, magic)) ||
+        !Program(offsetof(Header, magic), &header.magic, sizeof(header.magic)))
+      return false;
+    valid_ = Verify();
+    return valid_;
+  }
+
+private:
+  static constexpr uint32_t kMagic = 0x454c4946;  // "FILE"
+
+  struct Header {
+    uint32_t size;
+    uint32_t crc;
+    uint32_t magic;
+  };
+  static_assert(!(sizeof(Header) % FlashStorage::kProgramAlignment));
+
+  FlashStorage *storage_ = nullptr;
+  bool valid_ = false;
+
+  size_t size_ = 0;
+  size_t offset_ = 0;
+  uint8_t tail_[FlashStorage::kProgramAlignment] = {};
+  size_t tail_len_ = 0;
+
+  const Header *header() const { return reinterpret_cast<const Header *>(storage_->sector(0)); }
+
+  bool Verify() const
+  {
+    auto h = header();
+    return kMagic == h->magic && h->size <= capacity() && Crc32(data(), h->size) == h->crc;
+  }
+
+  bool Flush()
+  {
+    if (!Program(sizeof(Header) + offset_, tail_, sizeof(tail_))) return false;
+    offset_ = std::min(offset_ + sizeof(tail_), size_);
+    tail_len_ = 0;
+    return true;
+  }
+
+  // Write across sector boundaries
+  bool Program(size_t offset, const void *data, size_t len)
+  {
+    auto src = static_cast<const uint8_t *>(data);
+    const auto sector_size = storage_->sector_size();
+    while (len) {
+      const auto n = std::min(len, sector_size - offset % sector_size);
+      if (!storage_->Program(offset / sector_size, offset % sector_size, src, n)) return false;
+      offset += n;
+      src += n;
+      len -= n;
+    }
+    return true;
+  }
+};
+
+}  // namespace util
+
+#endif  // PFM2SID_MISC_FLASH_FILE_H_
@@ -0,0 +1,57 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_MISC_FLASH_STORAGE_H_
+#define PFM2SID_MISC_FLASH_STORAGE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace util {
+
+// Minimal abstraction of NOR-type flash so the users can be tested on the host.
+//
+// The storage is a number of equally sized sectors. Erased bytes read as kErasedValue and can be
+// programmed once; changing them again requires erasing the whole sector. The contents are memory
+// mapped, so they can be read directly without a copy.
+class FlashStorage {
+public:
+  static constexpr uint8_t kErasedValue = 0xff;
+  // Offsets and lengths for Program have to be aligned to this
+  static constexpr size_t kProgramAlignment = 4;
+
+  virtual ~FlashStorage() = default;
+
+  virtual size_t num_sectors() const = 0;
+  virtual size_t sector_size() const = 0;
+
+  virtual const uint8_t *sector(size_t index) const = 0;
+
+  virtual bool Erase(size_t index) = 0;
+
+  // The destination is expected to be erased
+  virtual bool Program(size_t index, size_t offset, const void *data, size_t len) = 0;
+};
+
+}  // namespace util
+
+#endif  // PFM2SID_MISC_FLASH_STORAGE_H_
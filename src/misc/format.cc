@@ -0,0 +1,269 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "format.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+#include "platform.h"
+
+ENABLE_WCONVERSION()
+
+namespace util {
+
+namespace {
+
+class Writer {
+public:
+  Writer(char *buf, size_t len) : pos_(buf), begin_(buf), end_(buf + len) {}
+
+  void Put(char c)
+  {
+    if (pos_ < end_) *pos_++ = c;
+  }
+  void Fill(char c, int n)
+  {
+    while (n-- > 0) Put(c);
+  }
+  void Write(const char *s, int n)
+  {
+    while (n-- > 0) Put(*s++);
+  }
+
+  size_t written() const { return static_cast<size_t>(pos_ - begin_); }
+
+private:
+  char *pos_;
+  char *const begin_;
+  char *const end_;
+};
+
+struct Spec {
+  bool left = false;
+  bool zero = false;
+  int width = 0;
+  int precision = -1;
+};
+
+// Integers are converted as unsigned long, which is only 32 bit on the target so there's no 64-bit
+// division. This is enough for 64 bit on the host.
+constexpr int kMaxDigits = 24;
+
+// Digits are generated backwards from end; returns the number of digits
+int ToDigits(char *end, unsigned long value, unsigned base, bool upper)
+{
+  const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+  int n = 0;
+  do {
+    *--end = digits[value % base];
+    value /= base;
+    ++n;
+  } while (value);
+  return n;
+}
+
+void PutField(Writer &writer, const Spec &spec, char sign, const char *digits, int len)
+{
+  const int pad = spec.width - len - (sign ? 1 : 0);
+  if (!spec.left && !spec.zero) writer.Fill(' ', pad);
+  if (sign) writer.Put(sign);
+  if (!spec.left && spec.zero) writer.Fill('0', pad);
+  writer.Write(digits, len);
+  if (spec.left) writer.Fill(' ', pad);
+}
+
+void PutInteger(Writer &writer, Spec spec, bool negative, unsigned long value, unsigned base,
+                bool upper)
+{
+  char buf[kMaxDigits];
+  char *end = buf + kMaxDigits;
+  int len = 0;
+  if (spec.precision >= 0) {
+    spec.zero = false;
+    if (spec.precision || value) len = ToDigits(end, value, base, upper);
+    while (len < spec.precision && len < kMaxDigits) buf[kMaxDigits - ++len] = '0';
+  } else {
+    len = ToDigits(end, value, base, upper);
+  }
+  PutField(writer, spec, negative ? '-' : 0, end - len, len);
+}
+
+void PutFloat(Writer &writer, Spec spec, float value)
+{
+  static constexpr uint32_t kPow10[] = {1,      10,      100,      1000,     10000,
+                                        100000, 1000000, 10000000, 100000000};
+  static constexpr int kMaxPrecision = static_cast<int>(std::size(kPow10)) - 1;
+
+  const bool negative = value < 0.f;
+  if (negative) value = -value;
+  if (!(value == value) || value > 4e9f) {  // nan, inf or just too large
+    spec.zero = false;
+    PutField(writer, spec, negative ? '-' : 0, value == value ? "inf" : "nan", 3);
+    return;
+  }
+
+  const int precision = spec.precision < 0 ? 6 : std::min(spec.precision, kMaxPrecision);
+  const uint32_t scale = kPow10[precision];
+  auto integral = static_cast<uint32_t>(value);
+  auto fraction =
+      static_cast<uint32_t>((value - static_cast<float>(integral)) * static_cast<float>(scale) +
+                            0.5f);
+  if (fraction >= scale) {
+    ++integral;
+    fraction -= scale;
+  }
+
+  char buf[kMaxDigits];
+  char *end = buf + kMaxDigits;
+  int len = 0;
+  if (precision) {
+    len = ToDigits(end, fraction, 10, false);
+    while (len < precision) buf[kMaxDigits - ++len] = '0';
+    buf[kMaxDigits - ++len] = '.';
+  }
+  len += ToDigits(end - len, integral, 10, false);
+  PutField(writer, spec, negative ? '-' : 0, end - len, len);
+}
+
+}  // namespace
+
+size_t VFormat(char *buf, size_t len, const char *fmt, va_list args)
+{
+  Writer writer{buf, len};
+  while (*fmt) {
+    if ('%' != *fmt) {
+      writer.Put(*fmt++);
+      continue;
+    }
+    ++fmt;
+
+    Spec spec;
+    for (;; ++fmt) {
+      if ('-' == *fmt)
+        spec.left = true;
+      else if ('0' == *fmt)
+        spec.zero = true;
+      else
+        break;
+    }
+    if ('*' == *fmt) {
+      spec.width = va_arg(args, int);
+      if (spec.width < 0) {
+        spec.left = true;
+        spec.width = -spec.width;
+      }
+      ++fmt;
+    } else {
+      while (*fmt >= '0' && *fmt <= '9') spec.width = spec.width * 10 + (*fmt++ - '0');
+    }
+    if ('.' == *fmt) {
+      ++fmt;
+      spec.precision = 0;
+      if ('*' == *fmt) {
+        spec.precision = va_arg(args, int);
+        ++fmt;
+      } else {
+        while (*fmt >= '0' && *fmt <= '9') spec.precision = spec.precision * 10 + (*fmt++ - '0');
+      }
+    }
+
+    // Everything smaller than an int is promoted anyway
+    char length = 0;
+    while ('h' == *fmt || 'l' == *fmt || 'z' == *fmt) {
+      if ('h' != *fmt) length = *fmt;
+      ++fmt;
+    }
+
+    const char conversion = *fmt;
+    if (conversion) ++fmt;
+    switch (conversion) {
+      case 'd':
+      case 'i': {
+        long value;
+        if ('l' == length)
+          value = va_arg(args, long);
+        else if ('z' == length)
+          value = static_cast<long>(va_arg(args, size_t));
+        else
+          value = va_arg(args, int);
+        const bool negative = value < 0;
+        const auto magnitude = negative ? 0UL - static_cast<unsigned long>(value)
+                                        : static_cast<unsigned long>(value);
+        PutInteger(writer, spec, negative, magnitude, 10, false);
+      } break;
+      case 'u':
+      case 'x':
+      case 'X': {
+        unsigned long value;
+        if ('l' == length)
+          value = va_arg(args, unsigned long);
+        else if ('z' == length)
+          value = va_arg(args, size_t);
+        else
+          value = va_arg(args, unsigned);
+        PutInteger(writer, spec, false, value, 'u' == conversion ? 10 : 16, 'X' == conversion);
+      } break;
+      case 'c': {
+        const auto c = static_cast<char>(va_arg(args, int));
+        spec.zero = false;
+        PutField(writer, spec, 0, &c, 1);
+      } break;
+      case 's': {
+        const char *s = va_arg(args, const char *);
+        if (!s) s = "(null)";
+        int n = 0;
+        while (s[n] && (spec.precision < 0 || n < spec.precision)) ++n;
+        spec.zero = false;
+        PutField(writer, spec, 0, s, n);
+      } break;
+      case 'f':
+      case 'F': PutFloat(writer, spec, static_cast<float>(va_arg(args, double))); break;
+      case '%': writer.Put('%'); break;
+      default: writer.Put('?'); break;
+    }
+  }
+  return writer.written();
+}
+
+size_t Format(char *buf, size_t len, const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  auto n = VFormat(buf, len, fmt, args);
+  va_end(args);
+  return n;
+}
+
+size_t FormatString(char *buf, size_t size, const char *fmt, ...)
+{
+  if (!size) return 0;
+  va_list args;
+  va_start(args, fmt);
+  auto n = VFormat(buf, size - 1, fmt, args);
+  va_end(args);
+  buf[n] = 0;
+  return n;
+}
+
+}  // namespace util
@@ -0,0 +1,52 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_MISC_FORMAT_H_
+#define PFM2SID_MISC_FORMAT_H_
+
+#include <cstdarg>
+#include <cstddef>
+
+namespace util {
+
+// Minimal printf replacement for the display, so we don't need newlib's (float) printf.
+//
+// Supports the subset that's actually used: %d %i %u %x %X %c %s %f %% with the flags '-' and
+// '0', width and precision (including '*'), and the length modifiers h, hh, l and z. Floats are
+// converted in single precision via fixed-point so there's no double math beyond the vararg
+// promotion (i.e. PRINT_F32); they're only accurate to about 7 significant digits, and exact ties
+// round away from zero. Anything else is printed as '?'.
+//
+// The format strings are checked at compile time with the printf format attribute.
+//
+// Output is written directly into buf and truncated at len characters. Unlike snprintf there's no
+// terminating \0; this returns the number of characters written.
+size_t VFormat(char *buf, size_t len, const char *fmt, va_list args);
+size_t Format(char *buf, size_t len, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+// Like snprintf; the output is always \0 terminated (if size > 0)
+size_t FormatString(char *buf, size_t size, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+}  // namespace util
+
+#endif  // PFM2SID_MISC_FORMAT_H_
@@ -0,0 +1,131 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_MISC_LRU_LIST_H_
+#define PFM2SID_MISC_LRU_LIST_H_
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+namespace util {
+
+// Doubly-linked list of the indices [0, N) with the links stored in fixed arrays, so no nodes need
+// to be allocated or moved. Each index can be in the list at most once. Everything except iteration
+// is O(1); the front is the least recently added index.
+template <size_t N>
+class LruList {
+public:
+  using index_type = std::conditional_t<(N < 0xfe), uint8_t, uint16_t>;
+
+  class const_iterator {
+  public:
+    const_iterator(const LruList *list, index_type index) : list_(list), index_(index) {}
+
+    const index_type &operator*() const { return index_; }
+    const_iterator &operator++()
+    {
+      index_ = list_->next_[index_];
+      return *this;
+    }
+    bool operator==(const const_iterator &rhs) const { return index_ == rhs.index_; }
+    bool operator!=(const const_iterator &rhs) const { return index_ != rhs.index_; }
+
+  private:
+    const LruList *list_;
+    index_type index_;
+  };
+
+  LruList() { clear(); }
+
+  void clear()
+  {
+    next_.fill(kUnlinked);
+    prev_.fill(kUnlinked);
+    head_ = tail_ = kEnd;
+    size_ = 0;
+  }
+
+  bool contains(size_t index) const { return next_[index] != kUnlinked; }
+
+  void push_back(size_t index)
+  {
+    auto i = static_cast<index_type>(index);
+    prev_[i] = tail_;
+    next_[i] = kEnd;
+    if (tail_ != kEnd)
+      next_[tail_] = i;
+    else
+      head_ = i;
+    tail_ = i;
+    ++size_;
+  }
+
+  bool erase(size_t index)
+  {
+    if (!contains(index)) return false;
+    auto prev = prev_[index];
+    auto next = next_[index];
+    if (prev != kEnd)
+      next_[prev] = next;
+    else
+      head_ = next;
+    if (next != kEnd)
+      prev_[next] = prev;
+    else
+      tail_ = prev;
+    next_[index] = prev_[index] = kUnlinked;
+    --size_;
+    return true;
+  }
+
+  // Move (or add) index to the back, i.e. make it the most recently used
+  void touch(size_t index)
+  {
+    erase(index);
+    push_back(index);
+  }
+
+  index_type front() const { return head_; }
+  index_type back() const { return tail_; }
+
+  bool empty() const { return !size_; }
+  size_t size() const { return size_; }
+  static constexpr size_t capacity() { return N; }
+
+  const_iterator begin() const { return {this, head_}; }
+  const_iterator end() const { return {this, kEnd}; }
+
+private:
+  static constexpr index_type kEnd = static_cast<index_type>(N);
+  static constexpr index_type kUnlinked = static_cast<index_type>(N + 1);
+
+  std::array<index_type, N> next_;
+  std::array<index_type, N> prev_;
+  index_type head_ = kEnd;
+  index_type tail_ = kEnd;
+  size_t size_ = 0;
+};
+
+}  // namespace util
+
+#endif  // PFM2SID_MISC_LRU_LIST_H_
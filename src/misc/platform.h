@@ -28,6 +28,7 @@
 
 #define ENABLE_WCONVERSION() _Pragma("GCC diagnostic warning \"-Wconversion\"")
 
+// Explicit promotion of float varargs (e.g. for util::Format)
 #define PRINT_F32(x) static_cast<double>(x)
 
 #endif
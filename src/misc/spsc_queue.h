@@ -0,0 +1,105 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_MISC_SPSC_QUEUE_H_
+#define PFM2SID_MISC_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace util {
+
+// Single-producer, single-consumer queue, e.g. between an ISR and the main loop. Unlike the
+// stm32x RingBuffer, the consumer can access the readable items as contiguous spans (at most two
+// if the data wraps) which lets it process them in bulk.
+template <typename T, size_t N>
+class SpscQueue {
+public:
+  static_assert(N && !(N & (N - 1)), "N must be a power of two");
+
+  struct Span {
+    const T *data;
+    size_t size;
+  };
+
+  void Clear()
+  {
+    read_.store(0, std::memory_order_relaxed);
+    write_.store(0, std::memory_order_relaxed);
+  }
+
+  size_t readable() const
+  {
+    return write_.load(std::memory_order_acquire) - read_.load(std::memory_order_relaxed);
+  }
+
+  size_t writeable() const
+  {
+    return N - (write_.load(std::memory_order_relaxed) - read_.load(std::memory_order_acquire));
+  }
+
+  // Producer. Returns false (and drops the value) if full.
+  bool Write(const T &value)
+  {
+    auto w = write_.load(std::memory_order_relaxed);
+    if (w - read_.load(std::memory_order_acquire) >= N) return false;
+    buffer_[w & kMask] = value;
+    write_.store(w + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer
+  T Read()
+  {
+    auto r = read_.load(std::memory_order_relaxed);
+    T value = buffer_[r & kMask];
+    read_.store(r + 1, std::memory_order_release);
+    return value;
+  }
+
+  // Largest contiguous block of readable items, which remain valid until Consume
+  Span ReadableSpan() const
+  {
+    auto r = read_.load(std::memory_order_relaxed);
+    auto n = write_.load(std::memory_order_acquire) - r;
+    auto i = r & kMask;
+    if (n > N - i) n = N - i;
+    return {buffer_ + i, n};
+  }
+
+  void Consume(size_t n)
+  {
+    read_.store(read_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+  }
+
+private:
+  static constexpr size_t kMask = N - 1;
+
+  T buffer_[N];
+  std::atomic<size_t> read_{0};
+  std::atomic<size_t> write_{0};
+};
+
+}  // namespace util
+
+#endif  // PFM2SID_MISC_SPSC_QUEUE_H_
@@ -22,31 +22,38 @@
 //
 #include "pfm2sid.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
 
 #include "drivers/core_timer.h"
 #include "drivers/dac_4922.h"
+#include "drivers/internal_flash.h"
 #include "drivers/midi_serial.h"
 #include "drivers/pfm2sid_gpio.h"
 #include "menu/asid_player.h"
 #include "menu/sid_player.h"
 #include "menu/synth_editor.h"
 #include "midi/midi_parser.h"
+#include "midi/sysex_transfer.h"
+#include "misc/flash_file.h"
+#include "misc/spsc_queue.h"
 #include "pfm2sid_debug.h"
 #include "sidbits/asid_parser.h"
+#include "synth/controller_map.h"
 #include "synth/engine.h"
+#include "synth/governor.h"
+#include "synth/parameter_types.h"
 #include "synth/parameters.h"
 #include "synth/patch.h"
+#include "synth/patch_bank.h"
+#include "synth/patch_receiver.h"
+#include "synth/patch_switcher.h"
 #include "synth/sid_synth.h"
 #include "ui/display.h"
 #include "ui/ui.h"
 
-extern "C" {
-extern const uint8_t _binary_test_dmp_start;
-extern const uint8_t _binary_test_dmp_end;
-}
-
 STM32X_CORE_DEFINE(INCCMZ)
 namespace pfm2sid {
 GPIO gpio;
@@ -61,29 +68,56 @@ stm32x::AveragedCycles sid_clock_cycles;
 unsigned ui_event_counter = 0;
 }  // namespace stats
 
-static util::RingBuffer<uint8_t, kSerialMidiRxBufferSize> serial_midi_rx INCCM;
+static util::SpscQueue<uint8_t, kSerialMidiRxBufferSize> serial_midi_rx INCCM;
+static util::SpscQueue<uint8_t, kSerialMidiTxBufferSize> serial_midi_tx INCCM;
 static midi::MidiParser serial_midi_parser INCCM;
+static midi::MidiEventQueue midi_events INCCM;
+
+// Number of samples output by the DAC, used to timestamp ASID frames
+static volatile uint32_t dac_sample_clock = 0;
+// Number of samples rendered. A sample is output when the DAC clock reaches its index, so the
+// block start is on the same time base as the DAC clock.
+static uint32_t render_sample_clock = 0;
 
 static MODE current_mode = MODE::INVALID;
 synth::SystemParameters system_parameters INCCM;
 
 synth::Patch current_patch INCCM;
+synth::ChangeNotifier parameter_changes INCCM;
+static synth::PatchSwitcher patch_switcher INCCM;
+static InternalFlash patch_flash{10, 2};
+static synth::PatchBank patch_bank INCCM;
+static InternalFlash upload_flash{9, 1};
+static util::FlashFile sid_file;
 
 synth::Engine engine INCCM;
+synth::Governor governor INCCM;
 synth::SIDSynth sid_synth_ INCCM;
+static synth::ControllerMap controller_map INCCM;
 // TODO It's perhaps wasteful to allocate All The Menus even if only one is being used?
 // Might depend on how switching works...
 static SIDPlayer sid_player_;
 static ASIDPlayer asid_player_;
 static synth::SIDSynthEditor sid_synth_editor_;
 
+// The synth also needs to know which chips are rendered, otherwise notes end up on silent chips
+static void ApplyDegrade()
+{
+  engine.set_degrade(governor.degrade());
+  sid_synth_.set_chip_limit(engine.max_chips());
+}
+
 void set_mode(MODE mode)
 {
   if (mode != current_mode) {
+    // The load depends on the mode, so start from full quality
+    governor.Reset();
+    ApplyDegrade();
     switch (mode) {
       case MODE::SID_SYNTH: ui.SetMenu(&sid_synth_editor_); break;
       case MODE::SID_PLAYER:
-        // sid_player_.Init({&_binary_test_dmp_start, &_binary_test_dmp_end});
+        if (sid_file.valid())
+          sid_player_.Init({sid_file.data(), sid_file.data() + sid_file.size()});
         ui.SetMenu(&sid_player_);
         break;
       case MODE::ASID_PLAYER:
@@ -97,6 +131,47 @@ void set_mode(MODE mode)
   }
 }
 
+static void UpdateTuning()
+{
+  sid_synth_.SetTuning(current_patch.scale,
+                       system_parameters.get<synth::SYSTEM::SID_CLOCK, sidbits::SID_CLOCK>());
+}
+
+static void UpdateASIDJitterBuffer()
+{
+  asid_player_.set_jitter_buffer(
+      static_cast<uint32_t>(system_parameters.get<synth::SYSTEM::ASID_LATENCY>().value()),
+      static_cast<size_t>(system_parameters.get<synth::SYSTEM::ASID_DEPTH>().value()));
+}
+
+// An uploaded SID tune or stream replaces the file in flash, and is played once it's complete
+class SIDUpload : public midi::SysexTransfer::Sink {
+public:
+  bool Begin(midi::SysexTransfer::TYPE /*type*/, uint8_t /*slot*/, uint8_t /*version*/,
+             size_t size) final
+  {
+    // The player reads the file directly
+    if (MODE::SID_PLAYER == current_mode) set_mode(MODE::SID_SYNTH);
+    return sid_file.Begin(size);
+  }
+
+  bool Write(size_t /*offset*/, const uint8_t *data, size_t len) final
+  {
+    return sid_file.Write(data, len);
+  }
+
+  bool End(bool ok) final
+  {
+    if (!ok || !sid_file.Commit()) return false;
+    set_mode(MODE::SID_PLAYER);
+    return true;
+  }
+};
+
+static midi::SysexTransfer sysex_transfer INCCM;
+static synth::PatchReceiver patch_receiver;
+static SIDUpload sid_upload;
+
 class MidiHandler : public midi::MidiHandler, public synth::ParameterListener {
 public:
   MidiHandler() : midi::MidiHandler{1} {}
@@ -119,33 +194,88 @@ public:
     sid_synth_.Pitchbend(channel, value);
   }
 
+  // Listeners are notified once per block, see RenderSampleBlock. After a program change in the
+  // same block, the controller applies to the incoming patch.
+  void MidiControlChange(midi::Channel /*channel*/, uint8_t control, uint8_t value) final
+  {
+    if (MODE::SID_SYNTH == current_mode) {
+      controller_map.set_parameters(&patch_switcher.edit_target().parameters);
+      controller_map.ControlChange(control, value);
+    }
+  }
+
+  // The patch is loaded straight from flash into the shadow buffer, and swapped in before the
+  // next block is rendered. Empty slots are the default patch.
+  void MidiProgramChange(midi::Channel /*channel*/, uint8_t program) final
+  {
+    if (MODE::SID_SYNTH != current_mode) return;
+    auto &patch = patch_switcher.shadow();
+    if (!patch_bank.Load(program, patch)) patch = synth::Patch{};
+    patch.set_number(program);
+    patch_switcher.Commit();
+  }
+
+  // Sysex data arrives in chunks; ASID and transfers are decoded as they arrive, scales are
+  // collected first.
   bool MidiSysex(const uint8_t *data, unsigned len, midi::SYSEX_STATUS sysex_status) final
   {
     display.SetIcon<ICON_POS::MIDI>(ICON_MIDI_SYSEX, kMidiActivityTicks);
-    if (!len) return false;
-    bool accept = false;
 
     switch (sysex_status) {
       case midi::SYSEX_STATUS::START:
+        sysex_target_ = SYSEX_TARGET::NONE;
         if (sidbits::is_asid_sysex(data)) {
           if (MODE::ASID_PLAYER != current_mode) { set_mode(MODE::ASID_PLAYER); }
-          accept = true;
+          asid_player_.BeginSysex();
+          sysex_target_ = SYSEX_TARGET::ASID;
+        } else if (synth::is_scale_sysex(data)) {
+          scale_sysex_len_ = 0;
+          sysex_target_ = SYSEX_TARGET::SCALE;
+        } else if (midi::SysexTransfer::is_transfer_sysex(data)) {
+          sysex_transfer.BeginSysex();
+          sysex_target_ = SYSEX_TARGET::TRANSFER;
         }
-        break;
+        return SYSEX_TARGET::NONE != sysex_target_;
+      case midi::SYSEX_STATUS::DATA: return ConsumeSysex(data, len);
       case midi::SYSEX_STATUS::EOX:
-        if (MODE::ASID_PLAYER == current_mode) { accept = !!asid_player_.ParseSysex(data, len); }
+        if (!ConsumeSysex(data, len)) return false;
+        switch (sysex_target_) {
+          case SYSEX_TARGET::ASID: return !!asid_player_.EndSysex(dac_sample_clock);
+          case SYSEX_TARGET::SCALE:
+            if (!synth::ParseScaleSysex(scale_sysex_, scale_sysex_len_, current_patch.scale))
+              return false;
+            parameter_changes.mark_scale();
+            return true;
+          case SYSEX_TARGET::TRANSFER:
+            if (auto reply = sysex_transfer.EndSysex()) {
+              for (auto byte : reply->sysex()) serial_midi_tx.Write(byte);
+              return true;
+            }
+            return false;
+          default: break;
+        }
+        break;
+      case midi::SYSEX_STATUS::ABORT:
+        if (SYSEX_TARGET::ASID == sysex_target_) (void)asid_player_.EndSysex(dac_sample_clock);
+        if (SYSEX_TARGET::TRANSFER == sysex_target_) sysex_transfer.AbortSysex();
+        break;
       default: break;
     }
-    return accept;
+    return false;
   }
 
-  void SystemParameterChanged(synth::SYSTEM parameter) final
+  // Rebuilding the tuning table is relatively expensive, so it's only done once even if both the
+  // clock and scale changed
+  void ParametersChanged(const synth::ChangeSet &changes) final
   {
     using namespace synth;
-    if (SYSTEM::MIDI_CHANNEL == parameter) {
+    if (changes.test(SYSTEM::MIDI_CHANNEL)) {
       auto value = system_parameters.get<SYSTEM::MIDI_CHANNEL>().value();
       if (value > 0 && value <= 16) { set_rx_channel(value - 1); }
     }
+    if (changes.test(SYSTEM::SID_CLOCK) || changes.scale) UpdateTuning();
+    if (changes.test(SYSTEM::ASID_LATENCY) || changes.test(SYSTEM::ASID_DEPTH))
+      UpdateASIDJitterBuffer();
   }
 
   void set_rx_channel(midi::Channel channel)
@@ -154,6 +284,28 @@ public:
     enabled_channels_[channel] = true;
     if (MODE::SID_SYNTH == current_mode) { sid_synth_.set_midi_channel(channel); }
   }
+
+private:
+  enum struct SYSEX_TARGET { NONE, ASID, SCALE, TRANSFER };
+  SYSEX_TARGET sysex_target_ = SYSEX_TARGET::NONE;
+
+  uint8_t scale_sysex_[synth::kScaleSysexMaxLen] = {};
+  size_t scale_sysex_len_ = 0;
+
+  bool ConsumeSysex(const uint8_t *data, unsigned len)
+  {
+    switch (sysex_target_) {
+      case SYSEX_TARGET::ASID: asid_player_.FeedSysex(data, len); return true;
+      case SYSEX_TARGET::TRANSFER: sysex_transfer.FeedSysex(data, len); return true;
+      case SYSEX_TARGET::SCALE:
+        if (scale_sysex_len_ + len > sizeof(scale_sysex_)) return false;
+        memcpy(scale_sysex_ + scale_sysex_len_, data, len);
+        scale_sysex_len_ += len;
+        return true;
+      default: break;
+    }
+    return false;
+  }
 };
 
 static MidiHandler midi_handler;
@@ -171,43 +323,73 @@ static void Init()
   midi_serial.Init();
   ui.Init();
 
-  engine.Init(&current_patch.parameters);
+  if (patch_bank.Init(&patch_flash)) patch_bank.Load(0, current_patch);
+  sid_file.Init(&upload_flash);
+
+  patch_receiver.Init(&patch_bank);
+  sysex_transfer.set_sink(midi::SysexTransfer::TYPE::PATCH, &patch_receiver);
+  sysex_transfer.set_sink(midi::SysexTransfer::TYPE::BANK, &patch_receiver);
+  sysex_transfer.set_sink(midi::SysexTransfer::TYPE::SID, &sid_upload);
+
+  engine.Init(&current_patch.parameters, &system_parameters);
+  governor.Init(F_CPU / synth::kDacUpdateRateHz * synth::kSampleBlockSize);
   sid_synth_.Init(&current_patch.parameters);
+  UpdateTuning();
+  UpdateASIDJitterBuffer();
 
   sid_synth_editor_.MenuInit();
-  sid_synth_editor_.register_listener(&engine);
-  sid_synth_editor_.register_listener(&sid_synth_);
-  sid_synth_editor_.register_listener(&midi_handler);
+  parameter_changes.register_listener(&engine);
+  parameter_changes.register_listener(&sid_synth_);
+  parameter_changes.register_listener(&midi_handler);
+
+  patch_switcher.Init(&current_patch, &parameter_changes);
+  controller_map.Init(&current_patch.parameters, &system_parameters, &parameter_changes);
 
   core_timer.Start();
   STM32X_CORE_INIT(F_CPU / kSysTickUpdateHz);
 
-  serial_midi_parser.Init({&midi_handler, nullptr, nullptr});
+  serial_midi_parser.Init({&midi_handler, nullptr, nullptr, &midi_events});
   midi_handler.set_rx_channel(0);
-
-  synth::InitWaveTables();  // TODO
 }
 
 static void RenderSampleBlock()
 {
   while (sample_buffer.writeable() >= sample_buffer.block_size()) {
-    while (serial_midi_rx.readable()) { serial_midi_parser.Parse(serial_midi_rx.Read()); }
+    // Channel messages are handled once per block (sysex flushes them first, so the order is
+    // kept). If the event queue fills up, the rest stays in the rx buffer for the next block.
+    for (auto span = serial_midi_rx.ReadableSpan(); span.size;
+         span = serial_midi_rx.ReadableSpan()) {
+      const auto len = std::min(span.size, serial_midi_parser.max_parse_len());
+      if (!len) break;
+      serial_midi_parser.Parse(span.data, len);
+      serial_midi_rx.Consume(len);
+    }
+    midi::DispatchEvents(midi_events, midi_handler);
 
     stm32x::ScopedCycleMeasurement scm{stats::render_block_cycles};
+    const auto render_start = core_timer.now();
+    patch_switcher.Apply();
+    parameter_changes.Dispatch();
     switch (current_mode) {
       case MODE::SID_SYNTH:
         sid_synth_.Update();
-        engine.RenderBlock(sample_buffer.WriteableBlock(), sid_synth_.register_map());
+        engine.RenderBlock(sample_buffer.WriteableBlock(), sid_synth_.register_maps(),
+                           sid_synth_.register_ramps(), sid_synth_.register_writes(),
+                           sid_synth_.active_chips());
         break;
       case MODE::SID_PLAYER:
-        engine.RenderBlock(sample_buffer.WriteableBlock(), sid_player_.register_map());
+        sid_player_.RenderBlock(sample_buffer.WriteableBlock());
         break;
       case MODE::ASID_PLAYER:
-        engine.RenderBlock(sample_buffer.WriteableBlock(), asid_player_.register_map());
+        asid_player_.RenderBlock(sample_buffer.WriteableBlock(), render_sample_clock);
         break;
       default: break;
     }
     sample_buffer.Commit<sample_buffer.block_size()>();
+    render_sample_clock += sample_buffer.block_size();
+
+    // Degrade before the slack in the sample buffer runs out
+    if (governor.Update(core_timer.now() - render_start)) ApplyDegrade();
   }
 }
 
@@ -222,21 +404,26 @@ static void RenderSampleBlock()
     RenderSampleBlock();
     ui.DispatchEvents();
 
-    if (sid_synth_.voice_active(0))
-      display.SetIcon<ICON_POS::VOICE1>(ICON_VOICE_ACTIVE, kVoiceActivityTicks);
-    if (sid_synth_.voice_active(1))
-      display.SetIcon<ICON_POS::VOICE2>(ICON_VOICE_ACTIVE, kVoiceActivityTicks);
-    if (sid_synth_.voice_active(2))
-      display.SetIcon<ICON_POS::VOICE3>(ICON_VOICE_ACTIVE, kVoiceActivityTicks);
+    // With multiple chips, the icon shows the voice is active on any of them
+    for (unsigned chip = 0; chip < synth::kNumSIDs; ++chip) {
+      auto voice = chip * synth::SIDSynth::kVoicesPerChip;
+      if (sid_synth_.voice_active(voice + 0))
+        display.SetIcon<ICON_POS::VOICE1>(ICON_VOICE_ACTIVE, kVoiceActivityTicks);
+      if (sid_synth_.voice_active(voice + 1))
+        display.SetIcon<ICON_POS::VOICE2>(ICON_VOICE_ACTIVE, kVoiceActivityTicks);
+      if (sid_synth_.voice_active(voice + 2))
+        display.SetIcon<ICON_POS::VOICE3>(ICON_VOICE_ACTIVE, kVoiceActivityTicks);
+    }
 
-    // This isn't a super-precise method since we're polling
-    // TODO Handling the player/asid update via UI is sketchy
+    // This isn't a super-precise method since we're polling, but the players are clocked by the
+    // render loop so this is only the UI. Menus check for changes in Step, and the display is only
+    // redrawn when (and where) they did.
     auto now = core_timer.now();
     if (now - ticks > CoreTimer::ms_to_timer(20)) {
       ui.Step();
-      ui.UpdateDisplay();
       ticks = now;
     }
+    ui.UpdateDisplay();
   }
 }
 
@@ -262,14 +449,17 @@ extern "C" void PFM2SID_CORE_TIMER_HANDLER()
     dac.Load();
     sample_buffer.Consume<1>();
     dac.BeginFrame(next_sample.left, next_sample.right);
+    dac_sample_clock = dac_sample_clock + 1;
   }
 
   // Poll MIDI serial input here, it should way faster than we can receive bytes anyway.
-  // If we add a TX option perhaps an interrupt might be more useful.
   // Also this may be a better place to handle clock messages since we have "hires" time (or,
   // timestamp the incoming bytes).
   auto midi_rx = midi_serial.Receive();
   if (midi_rx) { serial_midi_rx.Write(midi_rx.value()); }
+  if (serial_midi_tx.readable() && midi_serial.tx_ready()) {
+    midi_serial.Transmit(serial_midi_tx.Read());
+  }
 }
 
 extern "C" void SysTick_Handler()
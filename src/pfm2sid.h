@@ -30,6 +30,8 @@ namespace pfm2sid {
 static constexpr uint32_t kSysTickUpdateHz = 1000UL;
 
 static constexpr size_t kSerialMidiRxBufferSize = 32;
+// Only used for sysex transfer replies
+static constexpr size_t kSerialMidiTxBufferSize = 32;
 
 enum struct MODE { INVALID, SID_SYNTH, SID_PLAYER, ASID_PLAYER };
 void set_mode(MODE mode);
@@ -0,0 +1,217 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "asid_jitter_buffer.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "asid_parser.h"
+#include "misc/platform.h"
+
+ENABLE_WCONVERSION()
+
+namespace pfm2sid::sidbits {
+
+static_assert(ASIDJitterBuffer::kMaxMessageWrites == ASIDParser::ASID_REGISTER_COUNT);
+static_assert(ASIDJitterBuffer::kMaxChips == ASIDParser::kMaxChips);
+static_assert(SID_REGISTER_COUNT <= (1 << 5));
+
+void ASIDJitterBuffer::Init(uint32_t nominal_period)
+{
+  nominal_period_q8_ = nominal_period << 8;
+  period_q8_ = nominal_period_q8_;
+}
+
+void ASIDJitterBuffer::Reset(const RegisterMap *register_maps)
+{
+  for (unsigned chip = 0; chip < kMaxChips; ++chip) {
+    register_maps_[chip] = register_maps ? register_maps[chip] : RegisterMap{};
+    block_writes_[chip].clear();
+  }
+  head_ = count_ = 0;
+  num_arrivals_ = 0;
+  period_q8_ = nominal_period_q8_;
+  stats_ = {};
+}
+
+void ASIDJitterBuffer::set_depth(size_t depth)
+{
+  depth_ = std::clamp<size_t>(depth, 1, kMaxFrames);
+  while (count_ > depth_) {
+    Release(frames_[head_]);
+    head_ = (head_ + 1) % kMaxFrames;
+    --count_;
+  }
+}
+
+void ASIDJitterBuffer::Push(uint32_t timestamp, const FrameWrites &frame_writes, unsigned chip)
+{
+  if (chip) {
+    if (chip >= kMaxChips) return;
+    if (count_) {
+      frames_[(head_ + count_ - 1) % kMaxFrames].Append(frame_writes, chip);
+    } else {
+      // The frame has already been released, so don't hold these back either
+      Frame frame;
+      frame.Append(frame_writes, chip);
+      Release(frame);
+    }
+    return;
+  }
+
+  const auto gap = num_arrivals_ ? timestamp - arrivals_[(num_arrivals_ - 1) % kArrivalWindow] : 0;
+  const auto target_q8 = (timestamp + latency_) << 8;
+  if (!num_arrivals_ || gap > 4 * (std::max(period_q8_, nominal_period_q8_) >> 8)) {
+    // New stream, or it's been paused. The old estimate is kept since it's likely the same rate.
+    num_arrivals_ = 0;
+    next_release_q8_ = target_q8;
+    phase_error_q8_ = 0;
+    ++stats_.resync;
+    UpdatePeriod(timestamp);
+  } else {
+    const auto previous_period_q8 = period_q8_;
+    UpdatePeriod(timestamp);
+    // Queued frames were scheduled using a bad estimate, e.g. a multispeed stream was started
+    const auto period_change = static_cast<int32_t>(period_q8_ - previous_period_q8);
+    if (count_ && std::abs(period_change) > static_cast<int32_t>(previous_period_q8 / 8)) {
+      auto release_q8 = frames_[head_].release_q8;
+      for (size_t i = 0; i < count_; ++i, release_q8 += period_q8_)
+        frames_[(head_ + i) % kMaxFrames].release_q8 = release_q8;
+      next_release_q8_ = release_q8;
+    }
+
+    // The error for individual frames of a burst is large, so only the average is used
+    auto error = static_cast<int32_t>(target_q8 - next_release_q8_);
+    phase_error_q8_ += (error - phase_error_q8_) / (1 << kPhaseShift);
+    next_release_q8_ += static_cast<uint32_t>(phase_error_q8_ / (1 << kPhaseCorrectionShift));
+    // The correction mustn't reorder frames
+    if (count_) {
+      auto last_release_q8 = frames_[(head_ + count_ - 1) % kMaxFrames].release_q8;
+      if (static_cast<int32_t>(next_release_q8_ - last_release_q8) < 0)
+        next_release_q8_ = last_release_q8;
+    }
+  }
+
+  if (count_ >= depth_) {
+    Release(frames_[head_]);
+    head_ = (head_ + 1) % kMaxFrames;
+    --count_;
+    ++stats_.overflow;
+  }
+
+  auto &frame = frames_[(head_ + count_) % kMaxFrames];
+  frame.release_q8 = next_release_q8_;
+  frame.num_writes = 0;
+  frame.Append(frame_writes, 0);
+  ++count_;
+  ++stats_.frames;
+
+  next_release_q8_ += period_q8_;
+}
+
+void ASIDJitterBuffer::Render(uint32_t block_start, unsigned block_size)
+{
+  ApplyBlockWrites();
+
+  const auto block_start_q8 = block_start << 8;
+  const auto block_size_q8 = static_cast<int32_t>(block_size << 8);
+  while (count_) {
+    const auto &frame = frames_[head_];
+    auto offset_q8 = static_cast<int32_t>(frame.release_q8 - block_start_q8);
+    if (offset_q8 >= block_size_q8) break;
+    // If a burst is very late, the rest has to wait for the next block
+    if (max_block_writes() + frame.num_writes > kMaxBlockRegisterWrites) break;
+
+    uint16_t offset = 0;
+    if (offset_q8 < 0) {
+      ++stats_.late;
+    } else {
+      offset = static_cast<uint16_t>(offset_q8 >> 8);
+    }
+    for (unsigned i = 0; i < frame.num_writes; ++i) {
+      const auto &w = frame.writes[i];
+      block_writes_[w.chip_reg >> kChipShift].push_back(offset, w.chip_reg & kRegisterMask,
+                                                        w.value);
+    }
+
+    head_ = (head_ + 1) % kMaxFrames;
+    --count_;
+  }
+}
+
+void ASIDJitterBuffer::UpdatePeriod(uint32_t timestamp)
+{
+  arrivals_[num_arrivals_ % kArrivalWindow] = timestamp;
+  ++num_arrivals_;
+
+  // Averaging over the window smooths out the bursts. Until the window is full the estimate is
+  // used directly, so a stream that doesn't match the nominal rate is picked up quickly.
+  const auto n = std::min<uint32_t>(num_arrivals_, kArrivalWindow);
+  if (n < 4) return;
+  const auto oldest = arrivals_[(num_arrivals_ - n) % kArrivalWindow];
+  const auto estimate_q8 = ((timestamp - oldest) << 8) / (n - 1);
+  if (!estimate_q8) return;
+
+  if (n < kArrivalWindow) {
+    period_q8_ = estimate_q8;
+  } else {
+    auto delta = static_cast<int32_t>(estimate_q8 - period_q8_);
+    period_q8_ += static_cast<uint32_t>(delta / 4);
+  }
+}
+
+// Conservative, since the frame's writes are usually spread over the chips
+size_t ASIDJitterBuffer::max_block_writes() const
+{
+  size_t max_writes = 0;
+  for (auto &block_writes : block_writes_) max_writes = std::max(max_writes, block_writes.size());
+  return max_writes;
+}
+
+void ASIDJitterBuffer::ApplyBlockWrites()
+{
+  for (unsigned chip = 0; chip < kMaxChips; ++chip) {
+    for (auto &w : block_writes_[chip]) register_maps_[chip].write(w.reg, w.value);
+    block_writes_[chip].clear();
+  }
+}
+
+void ASIDJitterBuffer::Release(const Frame &frame)
+{
+  // Anything in block_writes_ belongs to a block that's already been rendered
+  ApplyBlockWrites();
+  for (unsigned i = 0; i < frame.num_writes; ++i) {
+    const auto &w = frame.writes[i];
+    register_maps_[w.chip_reg >> kChipShift].write(w.chip_reg & kRegisterMask, w.value);
+  }
+}
+
+void ASIDJitterBuffer::Frame::Append(const FrameWrites &frame_writes, unsigned chip)
+{
+  for (auto &w : frame_writes) {
+    if (num_writes >= kMaxFrameWrites) break;
+    writes[num_writes++] = {static_cast<uint8_t>(chip << kChipShift | w.reg), w.value};
+  }
+}
+
+}  // namespace pfm2sid::sidbits
@@ -0,0 +1,143 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_SIDBITS_ASID_JITTER_BUFFER_H_
+#define PFM2SID_SIDBITS_ASID_JITTER_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "register_writes.h"
+#include "sidbits.h"
+
+namespace pfm2sid::sidbits {
+
+// ASID frames tend to arrive in bursts (depending on the MIDI interface, USB polling, etc.) so
+// applying them as soon as they are received makes the timing wobble. Instead, the frames are
+// buffered and released at the sender's frame rate, which is estimated from the average arrival
+// interval. The release times are adjusted slowly (PLL-ish) towards the average arrival + latency
+// so sender and receiver clock drift doesn't accumulate.
+//
+// All times are in samples of a free-running sample clock, the frames are released as timestamped
+// register writes at their offset within the render block.
+//
+// For multi-SID streams, the messages for the other chips are added to the most recent frame of
+// the first chip, which defines the timing.
+class ASIDJitterBuffer {
+public:
+  static constexpr size_t kMaxFrames = 16;
+  static constexpr unsigned kMaxChips = 3;
+  static constexpr size_t kMaxMessageWrites = 28;  // \sa ASIDParser::ASID_REGISTER_COUNT
+  static constexpr size_t kMaxFrameWrites = kMaxChips * kMaxMessageWrites;
+  using FrameWrites = RegisterWriteList<kMaxMessageWrites>;
+
+  struct Stats {
+    uint32_t frames = 0;
+    uint32_t late = 0;      // frames released after their scheduled time
+    uint32_t overflow = 0;  // frames released early because the buffer was full
+    uint32_t resync = 0;    // stream (re)started
+  };
+
+  // The nominal period is used until there are enough frames for an estimate
+  void Init(uint32_t nominal_period);
+
+  // Drop all frames and restart the period estimate. The register maps (one per chip) are the
+  // initial state, or the default state if nullptr.
+  void Reset(const RegisterMap *register_maps);
+
+  // latency is the delay from arrival to release in samples, depth is the max. number of buffered
+  // frames (clamped to kMaxFrames).
+  void set_latency(uint32_t latency) { latency_ = latency; }
+  void set_depth(size_t depth);
+
+  // Add a message of register writes (the offsets are ignored) received at timestamp. Only the
+  // messages for chip 0 start a new frame.
+  void Push(uint32_t timestamp, const FrameWrites &frame_writes, unsigned chip = 0);
+
+  // Release all frames due in the block [block_start, block_start + block_size). The writes from
+  // the previous block are first applied to the register maps, so register_map() is the state at
+  // the start of the block and block_writes() the changes within.
+  void Render(uint32_t block_start, unsigned block_size);
+
+  const RegisterMap &register_map(unsigned chip = 0) const { return register_maps_[chip]; }
+  const BlockRegisterWrites &block_writes(unsigned chip = 0) const { return block_writes_[chip]; }
+  // Per-chip arrays for Engine::RenderBlock
+  const RegisterMap *register_maps() const { return register_maps_; }
+  const BlockRegisterWrites *register_writes() const { return block_writes_; }
+
+  size_t fill() const { return count_; }
+  size_t depth() const { return depth_; }
+  uint32_t latency() const { return latency_; }
+  // Estimated frame period in samples
+  float period() const { return static_cast<float>(period_q8_) / 256.f; }
+  const Stats &stats() const { return stats_; }
+
+private:
+  // Arrival times used for the period estimate
+  static constexpr size_t kArrivalWindow = 16;
+  // The phase error is averaged over ~2^kPhaseShift frames, and the schedule is corrected by
+  // average / 2^kPhaseCorrectionShift per frame.
+  static constexpr int kPhaseShift = 4;
+  static constexpr int kPhaseCorrectionShift = 5;
+
+  // Registers are < 0x20 so the chip is stored in the upper bits
+  static constexpr int kChipShift = 5;
+  static constexpr uint8_t kRegisterMask = (1 << kChipShift) - 1;
+
+  struct Frame {
+    uint32_t release_q8 = 0;
+    uint8_t num_writes = 0;
+    struct {
+      uint8_t chip_reg;
+      uint8_t value;
+    } writes[kMaxFrameWrites];
+
+    void Append(const FrameWrites &frame_writes, unsigned chip);
+  };
+
+  Frame frames_[kMaxFrames];
+  size_t head_ = 0;  // oldest frame
+  size_t count_ = 0;
+  size_t depth_ = kMaxFrames / 2;
+  uint32_t latency_ = 0;
+
+  uint32_t nominal_period_q8_ = 0;
+  uint32_t period_q8_ = 0;
+  uint32_t arrivals_[kArrivalWindow] = {};
+  uint32_t num_arrivals_ = 0;
+  uint32_t next_release_q8_ = 0;  // scheduled time of the next pushed frame
+  int32_t phase_error_q8_ = 0;
+
+  RegisterMap register_maps_[kMaxChips];
+  BlockRegisterWrites block_writes_[kMaxChips];
+
+  Stats stats_;
+
+  void UpdatePeriod(uint32_t timestamp);
+  size_t max_block_writes() const;
+  void ApplyBlockWrites();
+  void Release(const Frame &frame);  // apply to register map immediately
+};
+
+}  // namespace pfm2sid::sidbits
+
+#endif  // PFM2SID_SIDBITS_ASID_JITTER_BUFFER_H_
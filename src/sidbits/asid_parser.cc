@@ -28,83 +28,127 @@ namespace pfm2sid::sidbits {
 
 void ASIDParser::Reset()
 {
-  register_map_.Reset();
-  register_map_.filter_set_mode_volume(FILTER_MODE::OFF, 0x0f, false);
+  for (auto &register_map : register_maps_) {
+    register_map.Reset();
+    register_map.filter_set_mode_volume(FILTER_MODE::OFF, 0x0f, false);
+  }
+  num_chips_ = 1;
   active_ = false;
+  state_ = STATE::INVALID;
 }
 
 static constexpr uint8_t ASID_REGISTER_MAP[ASIDParser::ASID_REGISTER_COUNT] = {
     0x00, 0x01, 0x02, 0x03, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0c, 0x0d, 0x0e, 0x0f,
     0x10, 0x11, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x04, 0x0b, 0x12, 0x04, 0x0b, 0x12};
 
-std::optional<size_t> ASIDParser::ParseSysex(const uint8_t *data, size_t len)
+// All the bytes only contain 7 bits so we get 4x7=28 registers
+static constexpr uint32_t unpack_register_bits(const uint8_t *bytes)
 {
-  if (!data || len < 2 || !is_asid_sysex(data)) return std::nullopt;
+  return static_cast<uint32_t>(bytes[0] & 0x7f) | static_cast<uint32_t>(bytes[1] & 0x7f) << 7 |
+         static_cast<uint32_t>(bytes[2] & 0x7f) << 14 | static_cast<uint32_t>(bytes[3] & 0x7f) << 21;
+}
 
-  switch (data[1]) {
-    case START_SID:
-      strcpy(lcd_data_, "start");
-      return 0;
-      break;
-    case STOP_SID:
-      strcpy(lcd_data_, "stop");
-      return 0;
-      break;
-    case COMMAND: return ParseCommandMessage(data + 2, len - 2); break;
-    case LCD_DATA: return ParseLcdDataMessage(data + 2, len - 2); break;
-  }
+void ASIDParser::BeginSysex()
+{
+  state_ = STATE::ID;
+  pos_ = 0;
+  register_count_ = 0;
+  pending_registers_ = 0;
+  chip_ = 0;
+  frame_writes_.clear();
+}
 
-  return std::nullopt;
+void ASIDParser::FeedSysex(const uint8_t *data, size_t len)
+{
+  if (!data) return;
+
+  const auto end = data + len;
+  while (data != end) {
+    switch (state_) {
+      case STATE::ID: state_ = is_asid_sysex(data++) ? STATE::TYPE : STATE::INVALID; break;
+      case STATE::TYPE:
+        switch (*data++) {
+          case START_SID:
+            strcpy(lcd_data_, "start");
+            state_ = STATE::DONE;
+            break;
+          case STOP_SID:
+            strcpy(lcd_data_, "stop");
+            state_ = STATE::DONE;
+            break;
+          case COMMAND_SID3: ++chip_; [[fallthrough]];
+          case COMMAND_SID2: ++chip_; [[fallthrough]];
+          case COMMAND:
+            if (chip_ >= num_chips_) num_chips_ = chip_ + 1U;
+            pos_ = 0;
+            state_ = STATE::COMMAND_HEADER;
+            break;
+          case LCD_DATA:
+            memset(lcd_data_, 0, sizeof(lcd_data_));
+            pos_ = 0;
+            state_ = STATE::LCD_DATA;
+            break;
+          default: state_ = STATE::INVALID; break;
+        }
+        break;
+      case STATE::COMMAND_HEADER: data = FeedCommandHeader(data, end); break;
+      case STATE::COMMAND_DATA: data = FeedCommandData(data, end); break;
+      case STATE::LCD_DATA:
+        while (data != end && pos_ < LCD_DATA_LEN) lcd_data_[pos_++] = static_cast<char>(*data++);
+        data = end;  // Anything beyond the display length is ignored
+        break;
+      case STATE::DONE:
+      case STATE::INVALID: return;  // Ignore any trailing data
+    }
+  }
 }
 
-std::optional<size_t> ASIDParser::ParseCommandMessage(const uint8_t *msg, size_t len)
+std::optional<size_t> ASIDParser::EndSysex()
 {
-  // TODO Technically we can count the set bits and derive an expected length
+  std::optional<size_t> result = std::nullopt;
+  switch (state_) {
+    case STATE::COMMAND_DATA:  // Truncated, but the registers so far have been written
+    case STATE::DONE: result = register_count_; break;
+    case STATE::LCD_DATA: result = pos_; break;
+    default: break;
+  }
+  state_ = STATE::INVALID;
+  return result;
+}
 
+const uint8_t *ASIDParser::FeedCommandHeader(const uint8_t *data, const uint8_t *end)
+{
   // [mask][mask][mask][mask][msb][msb][msb][msb](data)
-  if (len < 8) return std::nullopt;
-
-  if (!active()) { active_ = true; }
-
-  // There are a few ways of implementing this. The key is to remember that all the bytes only
-  // contain 7 bits so we get 4x7=28 registers.
   //
-  // The first 8 bytes are meta information: Four bytes are a bit mask indicating
-  // which registers are being set. There should be that many data bytes following the meta as there
-  // are bits set. The next four are the MSB of the data bytes, since MIDI data is 7-bit.
-
-  const uint8_t *mask_data = msg;
-
-  const uint8_t *data = mask_data + 8;
-  const uint8_t *end = msg + len;
-
-  size_t register_count = 0;
-
-  for (unsigned byte_index = 0; data < end && byte_index < 4; ++byte_index) {
-    for (unsigned bit = 0; data < end && bit < 7; ++bit) {
-      auto mask = 1 << bit;
-      if (mask_data[byte_index] & mask) {
-        auto asid_register = byte_index * 7 + bit;
-        uint8_t data_byte = *data++;
-        if (mask_data[4 + byte_index] & mask) data_byte |= 0x80;
-        register_map_.poke(ASID_REGISTER_MAP[asid_register], data_byte);
-        ++register_count;
-      }
-    }
+  // Four bytes are a bit mask indicating which registers are being set. There should be as many
+  // data bytes following the header as there are bits set. The next four are the MSB of the data
+  // bytes, since MIDI data is 7-bit. So we know the expected length once the header is complete.
+  while (data != end && pos_ < kCommandHeaderLen) header_[pos_++] = *data++;
+  if (pos_ == kCommandHeaderLen) {
+    if (!active()) { active_ = true; }
+    pending_registers_ = unpack_register_bits(header_);
+    msb_ = unpack_register_bits(header_ + 4);
+    pos_ = 0;
+    state_ = pending_registers_ ? STATE::COMMAND_DATA : STATE::DONE;
   }
-
-  return register_count;
+  return data;
 }
 
-size_t ASIDParser::ParseLcdDataMessage(const uint8_t *msg, size_t len)
+const uint8_t *ASIDParser::FeedCommandData(const uint8_t *data, const uint8_t *end)
 {
-  memset(lcd_data_, 0, sizeof(lcd_data_));
-  auto dst = lcd_data_;
-  len = std::min(len, LCD_DATA_LEN);
-
-  std::transform(msg, msg + len, dst, [](uint8_t b) { return static_cast<char>(b); });
-  dst[len] = 0;
-  return len;
+  auto pending = pending_registers_;
+  while (data != end && pending) {
+    auto asid_register = static_cast<unsigned>(__builtin_ctz(pending));
+    pending &= pending - 1;
+    uint8_t data_byte = *data++;
+    if (msb_ & (1U << asid_register)) data_byte |= 0x80;
+    register_maps_[chip_].write(ASID_REGISTER_MAP[asid_register], data_byte);
+    frame_writes_.push_back(0, ASID_REGISTER_MAP[asid_register], data_byte);
+    ++register_count_;
+  }
+  pending_registers_ = pending;
+  if (!pending) state_ = STATE::DONE;
+  return data;
 }
 
 }  // namespace pfm2sid::sidbits
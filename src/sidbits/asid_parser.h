@@ -23,10 +23,12 @@
 #ifndef PFM2SID_SIDBITS_ASID_PARSER_H_
 #define PFM2SID_SIDBITS_ASID_PARSER_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <optional>
 
+#include "register_writes.h"
 #include "sidbits.h"
 
 namespace pfm2sid::sidbits {
@@ -34,6 +36,9 @@ namespace pfm2sid::sidbits {
 // Parse SID commands-over-MIDI using the ASID protocol, which sends register contents via sysex.
 // Gleaned from a bunch of sources, including
 // https://paulus.kapsi.fi/asid_protocol.txt
+//
+// Senders supporting 2SID/3SID tunes use additional command IDs for the second and third chip,
+// with the same format as the regular register update command.
 
 static constexpr uint8_t ASID_SYSEX_ID = 0x2D;
 constexpr bool is_asid_sysex(const uint8_t *data)
@@ -47,28 +52,79 @@ public:
   static constexpr uint8_t STOP_SID = 0x4D;
   static constexpr uint8_t COMMAND = 0x4E;
   static constexpr uint8_t LCD_DATA = 0x4F;
+  static constexpr uint8_t COMMAND_SID2 = 0x50;
+  static constexpr uint8_t COMMAND_SID3 = 0x51;
+
+  static constexpr unsigned kMaxChips = 3;
 
   static constexpr uint8_t ASID_REGISTER_COUNT = sidbits::SID_REGISTER_COUNT + 3;
   static constexpr size_t LCD_DATA_LEN = 20;
 
+  using FrameWrites = RegisterWriteList<ASID_REGISTER_COUNT>;
+
   void Reset();
 
-  std::optional<size_t> ParseSysex(const uint8_t *data, size_t len);
+  // Decode a complete message (excluding F0/F7)
+  std::optional<size_t> ParseSysex(const uint8_t *data, size_t len)
+  {
+    BeginSysex();
+    FeedSysex(data, len);
+    return EndSysex();
+  }
+
+  // Incremental decoding, so the message can be decoded in chunks as it arrives. Register values
+  // are written to the map as soon as they're complete. EndSysex returns the number of registers
+  // written for a command message (0 for the other types), or nullopt if the message was invalid
+  // or incomplete.
+  void BeginSysex();
+  void FeedSysex(const uint8_t *data, size_t len);
+  std::optional<size_t> EndSysex();
 
   bool active() const { return active_; }
 
-  const auto &register_map() const { return register_map_; }
+  const auto &register_map(unsigned chip = 0) const { return register_maps_[chip]; }
+  const RegisterMap *register_maps() const { return register_maps_; }
+
+  // Number of chips used by the stream, i.e. the highest chip seen since the last Reset
+  unsigned num_chips() const { return num_chips_; }
+
+  // Registers changed since the last call; the next call after Reset or Resync returns all.
+  uint32_t take_dirty(unsigned chip = 0) { return register_maps_[chip].take_dirty(); }
+  void Resync()
+  {
+    for (auto &register_map : register_maps_) register_map.mark_dirty();
+  }
 
   const char *lcd_data() const { return lcd_data_; }
 
+  // The register writes of the current (or last) command message in the order they were sent,
+  // which includes the second write of the control registers. The offsets are all 0.
+  const FrameWrites &frame_writes() const { return frame_writes_; }
+  unsigned frame_chip() const { return chip_; }
+
 private:
+  enum struct STATE : uint8_t { ID, TYPE, COMMAND_HEADER, COMMAND_DATA, LCD_DATA, DONE, INVALID };
+
+  static constexpr size_t kCommandHeaderLen = 8;
+
   bool active_ = false;
 
   char lcd_data_[LCD_DATA_LEN + 1] = {0};
-  sidbits::RegisterMap register_map_;
-
-  std::optional<size_t> ParseCommandMessage(const uint8_t *msg, size_t len);
-  size_t ParseLcdDataMessage(const uint8_t *msg, size_t len);
+  RegisterMap register_maps_[kMaxChips];
+  unsigned num_chips_ = 1;
+  FrameWrites frame_writes_;
+
+  // Decoder state
+  STATE state_ = STATE::INVALID;
+  uint8_t pos_ = 0;
+  uint8_t chip_ = 0;
+  uint8_t register_count_ = 0;
+  uint8_t header_[kCommandHeaderLen] = {};
+  uint32_t pending_registers_ = 0;  // bit n = ASID register n still expected
+  uint32_t msb_ = 0;
+
+  const uint8_t *FeedCommandHeader(const uint8_t *data, const uint8_t *end);
+  const uint8_t *FeedCommandData(const uint8_t *data, const uint8_t *end);
 };
 
 }  // namespace pfm2sid::sidbits
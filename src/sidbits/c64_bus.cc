@@ -0,0 +1,120 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "c64_bus.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "misc/platform.h"
+#include "sidbits.h"
+
+ENABLE_WCONVERSION()
+
+namespace pfm2sid::sidbits {
+
+// PAL timing for the fake raster line
+static constexpr uint32_t kCyclesPerLine = 63;
+static constexpr uint32_t kLinesPerFrame = 312;
+
+void C64Bus::Reset()
+{
+  std::fill(std::begin(read_pages_), std::end(read_pages_), nullptr);
+  std::fill(std::begin(write_pages_), std::end(write_pages_), nullptr);
+  stats_ = {};
+  port_ = 0x37;
+  cia_timer_ = kDefaultCIATimer;
+  sid_writes_.clear();
+  // The processor port
+  AllocatePage(0)[1] = port_;
+}
+
+bool C64Bus::Map(uint16_t address, const uint8_t *data, size_t size)
+{
+  if (address + size > 0x10000) return false;
+
+  while (size) {
+    const auto page = address >> 8;
+    const auto offset = address & 0xff;
+    const auto n = std::min(size, kPageSize - offset);
+    if (!offset && n == kPageSize && !write_pages_[page]) {
+      read_pages_[page] = data;
+    } else {
+      auto ram = write_pages_[page] ? write_pages_[page] : AllocatePage(page);
+      if (!ram) return false;
+      memcpy(ram + offset, data, n);
+    }
+    address = static_cast<uint16_t>(address + n);
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+void C64Bus::set_port(uint8_t value)
+{
+  Write(1, value, 0);
+}
+
+uint8_t *C64Bus::AllocatePage(unsigned page)
+{
+  if (stats_.ram_pages >= kNumRamPages) return nullptr;
+  auto ram = ram_[stats_.ram_pages++];
+  if (read_pages_[page]) {
+    memcpy(ram, read_pages_[page], kPageSize);
+  } else {
+    memset(ram, 0, kPageSize);
+  }
+  read_pages_[page] = write_pages_[page] = ram;
+  return ram;
+}
+
+uint8_t C64Bus::ReadIO(uint16_t address, uint32_t cycle) const
+{
+  const auto line = (cycle / kCyclesPerLine) % kLinesPerFrame;
+  switch (address) {
+    case 0xd011: return static_cast<uint8_t>(0x1b | (line >> 1 & 0x80));
+    case 0xd012: return static_cast<uint8_t>(line);
+    case 0xd41b: return static_cast<uint8_t>(cycle * 0x9e37 >> 8);  // "random" OSC3
+    case 0xdc04: return static_cast<uint8_t>(cia_timer_ - cycle % (cia_timer_ + 1U));
+    case 0xdc05: return static_cast<uint8_t>((cia_timer_ - cycle % (cia_timer_ + 1U)) >> 8);
+    default: return 0;
+  }
+}
+
+void C64Bus::WriteIO(uint16_t address, uint8_t value, uint32_t cycle)
+{
+  if (address >= 0xd400 && address < 0xd800) {
+    const auto reg = static_cast<uint8_t>(address & 0x1f);
+    if (reg >= SID_REGISTER_COUNT) return;
+    const auto offset = cycle - block_cycle_;
+    if (!sid_writes_.push_back(static_cast<uint16_t>(std::min<uint32_t>(offset, 0xffff)), reg,
+                               value))
+      ++stats_.dropped_writes;
+  } else if (0xdc04 == address) {
+    cia_timer_ = static_cast<uint16_t>((cia_timer_ & 0xff00) | value);
+  } else if (0xdc05 == address) {
+    cia_timer_ = static_cast<uint16_t>((cia_timer_ & 0x00ff) | value << 8);
+  }
+}
+
+}  // namespace pfm2sid::sidbits
@@ -0,0 +1,128 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_SIDBITS_C64_BUS_H_
+#define PFM2SID_SIDBITS_C64_BUS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "register_writes.h"
+
+#ifndef PSID_RAM_PAGES
+#define PSID_RAM_PAGES 32
+#endif
+
+namespace pfm2sid::sidbits {
+
+// Sparse C64 memory map for running SID tunes; a full 64K image doesn't fit.
+//
+// Memory is mapped in 256 byte pages. Pages of the tune data point directly at the (flash) data,
+// everything else reads as 0 until written. Written pages are copied to one of a small pool of RAM
+// pages; most tunes only modify a handful (zero page, stack, some variables).
+//
+// The I/O area only has what tunes tend to look at: SID writes are recorded with their cycle, the
+// CIA 1 timer latch is tracked for CIA timed tunes and the raster line is faked from the cycle.
+class C64Bus {
+public:
+  static constexpr size_t kPageSize = 256;
+  static constexpr size_t kNumPages = 0x10000 / kPageSize;
+  static constexpr size_t kNumRamPages = PSID_RAM_PAGES;
+
+  // CIA 1 timer A default from the KERNAL (~60Hz)
+  static constexpr uint16_t kDefaultCIATimer = 0x4025;
+
+  using SIDWrites = RegisterWriteList<kMaxBlockRegisterWrites>;
+
+  struct Stats {
+    uint32_t ram_pages = 0;
+    uint32_t dropped_writes = 0;  // out of RAM pages, or too many SID writes in one block
+  };
+
+  void Reset();
+
+  // Map the data at address, it must be in memory for as long as the bus is used. Only partial
+  // pages at the start and end are copied.
+  bool Map(uint16_t address, const uint8_t *data, size_t size);
+
+  uint8_t Read(uint16_t address, uint32_t cycle)
+  {
+    if (is_io(address)) return ReadIO(address, cycle);
+    auto page = read_pages_[address >> 8];
+    return page ? page[address & 0xff] : 0;
+  }
+
+  void Write(uint16_t address, uint8_t value, uint32_t cycle)
+  {
+    if (is_io(address)) {
+      WriteIO(address, value, cycle);
+    } else {
+      auto page = write_pages_[address >> 8];
+      if (!page) page = AllocatePage(address >> 8);
+      if (page) {
+        page[address & 0xff] = value;
+      } else {
+        ++stats_.dropped_writes;
+      }
+      if (1 == address) port_ = value;
+    }
+  }
+
+  // With the KERNAL banked in, the tune returns from its IRQ handler by jumping into it
+  bool IsReturnTrap(uint16_t pc) const { return pc >= 0xe000 && kernal_visible(); }
+
+  bool kernal_visible() const { return port_ & 0x02; }
+  bool io_visible() const { return (port_ & 0x04) && (port_ & 0x03); }
+  void set_port(uint8_t value);
+
+  // SID writes since BeginBlock, with offsets in cycles from the block start
+  void BeginBlock(uint32_t cycle)
+  {
+    block_cycle_ = cycle;
+    sid_writes_.clear();
+  }
+  const SIDWrites &sid_writes() const { return sid_writes_; }
+
+  uint16_t cia_timer() const { return cia_timer_; }
+  const Stats &stats() const { return stats_; }
+
+private:
+  const uint8_t *read_pages_[kNumPages] = {};
+  uint8_t *write_pages_[kNumPages] = {};
+  uint8_t ram_[kNumRamPages][kPageSize];
+
+  uint8_t port_ = 0x37;
+  uint16_t cia_timer_ = kDefaultCIATimer;
+  uint32_t block_cycle_ = 0;
+  SIDWrites sid_writes_;
+  Stats stats_;
+
+  bool is_io(uint16_t address) const { return (address >> 12) == 0xd && io_visible(); }
+
+  uint8_t *AllocatePage(unsigned page);
+  uint8_t ReadIO(uint16_t address, uint32_t cycle) const;
+  void WriteIO(uint16_t address, uint8_t value, uint32_t cycle);
+};
+
+}  // namespace pfm2sid::sidbits
+
+#endif  // PFM2SID_SIDBITS_C64_BUS_H_
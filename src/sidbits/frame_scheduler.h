@@ -0,0 +1,84 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_SIDBITS_FRAME_SCHEDULER_H_
+#define PFM2SID_SIDBITS_FRAME_SCHEDULER_H_
+
+#include <cinttypes>
+
+#include "sidbits/sidbits.h"
+
+namespace pfm2sid::sidbits {
+
+// Player frame timing derived from the sample clock, so it doesn't depend on when the UI gets
+// around to polling. Frames are nominally 50Hz (PAL) or 60Hz (NTSC); multispeed tunes update 2, 4
+// or 8 times per frame.
+//
+// Frame positions are tracked in Q16 samples relative to the current block, so fractional frame
+// lengths (e.g. 110.25 samples for 8x PAL) don't drift.
+class FrameScheduler {
+public:
+  static constexpr uint32_t kPALFrameRate = 50;
+  static constexpr uint32_t kNTSCFrameRate = 60;
+  static constexpr unsigned kMaxSpeed = 8;
+
+  void Init(uint32_t sample_rate, SID_CLOCK video_standard, unsigned speed)
+  {
+    sample_rate_ = sample_rate;
+    video_standard_ = video_standard;
+    speed_ = speed < 1 ? 1 : (speed > kMaxSpeed ? kMaxSpeed : speed);
+    frame_samples_ = (sample_rate_ << 16) / frame_rate();
+    if (next_frame_ > frame_samples_) next_frame_ = frame_samples_;
+  }
+
+  // The next frame is at the start of the next block
+  void Reset() { next_frame_ = 0; }
+
+  // Call fn(offset) for each frame starting within the next block_size samples
+  template <typename F>
+  void Advance(uint32_t block_size, F &&fn)
+  {
+    const auto block_end = block_size << 16;
+    for (; next_frame_ < block_end; next_frame_ += frame_samples_)
+      fn(static_cast<uint16_t>(next_frame_ >> 16));
+    next_frame_ -= block_end;
+  }
+
+  SID_CLOCK video_standard() const { return video_standard_; }
+  unsigned speed() const { return speed_; }
+  uint32_t frame_rate() const
+  {
+    return (SID_CLOCK::NTSC == video_standard_ ? kNTSCFrameRate : kPALFrameRate) * speed_;
+  }
+
+private:
+  uint32_t sample_rate_ = 0;
+  SID_CLOCK video_standard_ = SID_CLOCK::PAL;
+  unsigned speed_ = 1;
+
+  uint32_t frame_samples_ = 0;  // Q16
+  uint32_t next_frame_ = 0;     // Q16, relative to the next block
+};
+
+}  // namespace pfm2sid::sidbits
+
+#endif  // PFM2SID_SIDBITS_FRAME_SCHEDULER_H_
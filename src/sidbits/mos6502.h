@@ -0,0 +1,562 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_SIDBITS_MOS6502_H_
+#define PFM2SID_SIDBITS_MOS6502_H_
+
+#include <cstdint>
+
+namespace pfm2sid::sidbits {
+
+// Cycle-counted NMOS 6502, just enough to run SID tune init/play routines. Decimal mode and the
+// stable undocumented opcodes are supported since tunes do use them; the unstable ones are
+// approximated. Interrupts are only "called" explicitly.
+//
+// The Bus provides the memory map:
+//   uint8_t Read(uint16_t address, uint32_t cycle);
+//   void Write(uint16_t address, uint8_t value, uint32_t cycle);
+//   bool IsReturnTrap(uint16_t pc) const;  // e.g. jumps into the (missing) KERNAL IRQ exit
+//
+// The cycle passed to the bus is the end of the current instruction, which is where the write
+// happens for all but a few instructions.
+template <typename Bus>
+class MOS6502 {
+public:
+  enum FLAG : uint8_t {
+    FLAG_C = 0x01,
+    FLAG_Z = 0x02,
+    FLAG_I = 0x04,
+    FLAG_D = 0x08,
+    FLAG_B = 0x10,
+    FLAG_U = 0x20,
+    FLAG_V = 0x40,
+    FLAG_N = 0x80,
+  };
+
+  enum struct STATE : uint8_t { RUNNING, RETURNED, JAMMED };
+
+  // Pushed as the return address of calls; execution stops when it gets there
+  static constexpr uint16_t kReturnAddress = 0xffff;
+
+  struct Registers {
+    uint16_t pc = kReturnAddress;
+    uint8_t a = 0, x = 0, y = 0;
+    uint8_t sp = 0xff;
+    uint8_t p = FLAG_U | FLAG_I;
+  };
+
+  explicit MOS6502(Bus &bus) : bus_(bus) {}
+
+  void Reset()
+  {
+    r_ = {};
+    state_ = STATE::RETURNED;
+  }
+
+  // Call a subroutine which returns with RTS. Each call starts with an empty stack, so a routine
+  // that was aborted doesn't leave anything behind.
+  void Call(uint16_t address, uint8_t a = 0)
+  {
+    r_.sp = 0xff;
+    Push16(kReturnAddress - 1);
+    r_.pc = address;
+    r_.a = a;
+    r_.x = r_.y = 0;
+    state_ = STATE::RUNNING;
+  }
+
+  // Call an interrupt handler which returns with RTI. With kernal_entry, A/X/Y are also pushed
+  // like the KERNAL does before jumping through $0314, since handlers may pull them on exit.
+  void Interrupt(uint16_t address, bool kernal_entry = false)
+  {
+    r_.sp = 0xff;
+    Push16(kReturnAddress);
+    Push(r_.p & ~FLAG_B);
+    r_.p |= FLAG_I;
+    if (kernal_entry) {
+      Push(r_.a);
+      Push(r_.x);
+      Push(r_.y);
+    }
+    r_.pc = address;
+    state_ = STATE::RUNNING;
+  }
+
+  // Execute until the routine returns, or the cycle count reaches the deadline. The last
+  // instruction may overshoot it a little, which is carried over to the next call.
+  STATE Run(uint32_t deadline)
+  {
+    while (STATE::RUNNING == state_ && static_cast<int32_t>(cycles_ - deadline) < 0) {
+      if (kReturnAddress == r_.pc || bus_.IsReturnTrap(r_.pc)) {
+        state_ = STATE::RETURNED;
+      } else {
+        Execute();
+      }
+    }
+    return state_;
+  }
+
+  // Stop the current routine (i.e. it's still running at the next frame)
+  void Abort() { state_ = STATE::RETURNED; }
+
+  STATE state() const { return state_; }
+  uint32_t cycles() const { return cycles_; }
+  void set_cycles(uint32_t cycles) { cycles_ = cycles; }
+  const Registers &registers() const { return r_; }
+
+private:
+  Bus &bus_;
+  Registers r_;
+  uint32_t cycles_ = 0;
+  STATE state_ = STATE::RETURNED;
+
+  // Base cycles, the page crossing and branch penalties are added separately
+  static constexpr uint8_t kCycles[256] = {
+      7, 6, 2, 8, 3, 3, 5, 5, 3, 2, 2, 2, 4, 4, 6, 6,  // 0x00
+      2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,  // 0x10
+      6, 6, 2, 8, 3, 3, 5, 5, 4, 2, 2, 2, 4, 4, 6, 6,  // 0x20
+      2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,  // 0x30
+      6, 6, 2, 8, 3, 3, 5, 5, 3, 2, 2, 2, 3, 4, 6, 6,  // 0x40
+      2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,  // 0x50
+      6, 6, 2, 8, 3, 3, 5, 5, 4, 2, 2, 2, 5, 4, 6, 6,  // 0x60
+      2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,  // 0x70
+      2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4,  // 0x80
+      2, 6, 2, 6, 4, 4, 4, 4, 2, 5, 2, 5, 5, 5, 5, 5,  // 0x90
+      2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4,  // 0xA0
+      2, 5, 2, 5, 4, 4, 4, 4, 2, 4, 2, 4, 4, 4, 4, 4,  // 0xB0
+      2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6,  // 0xC0
+      2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,  // 0xD0
+      2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6,  // 0xE0
+      2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,  // 0xF0
+  };
+
+  uint8_t Read(uint16_t address) { return bus_.Read(address, cycles_); }
+  void Write(uint16_t address, uint8_t value) { bus_.Write(address, value, cycles_); }
+
+  uint8_t Fetch() { return Read(r_.pc++); }
+  uint16_t Fetch16()
+  {
+    uint16_t lo = Fetch();
+    return static_cast<uint16_t>(lo | Fetch() << 8);
+  }
+
+  void Push(uint8_t value) { Write(0x100 | r_.sp--, value); }
+  uint8_t Pull() { return Read(0x100 | ++r_.sp); }
+  void Push16(uint16_t value)
+  {
+    Push(static_cast<uint8_t>(value >> 8));
+    Push(static_cast<uint8_t>(value));
+  }
+  uint16_t Pull16()
+  {
+    uint16_t lo = Pull();
+    return static_cast<uint16_t>(lo | Pull() << 8);
+  }
+
+  //
+  // Addressing modes. Reads (but not writes or read-modify-writes) take an extra cycle if the
+  // index crosses a page.
+  //
+  void PagePenalty(uint16_t base, uint16_t address, bool read)
+  {
+    if (read && (base ^ address) & 0xff00) ++cycles_;
+  }
+  uint16_t ZeroPage() { return Fetch(); }
+  uint16_t ZeroPageIndexed(uint8_t index) { return static_cast<uint8_t>(Fetch() + index); }
+  uint16_t Absolute() { return Fetch16(); }
+  uint16_t AbsoluteIndexed(uint8_t index, bool read)
+  {
+    auto base = Fetch16();
+    auto address = static_cast<uint16_t>(base + index);
+    PagePenalty(base, address, read);
+    return address;
+  }
+  uint16_t IndexedIndirect()  // (zp,X)
+  {
+    uint8_t zp = static_cast<uint8_t>(Fetch() + r_.x);
+    uint16_t lo = Read(zp);
+    return static_cast<uint16_t>(lo | Read(static_cast<uint8_t>(zp + 1)) << 8);
+  }
+  uint16_t IndirectIndexed(bool read)  // (zp),Y
+  {
+    uint8_t zp = Fetch();
+    uint16_t lo = Read(zp);
+    auto base = static_cast<uint16_t>(lo | Read(static_cast<uint8_t>(zp + 1)) << 8);
+    auto address = static_cast<uint16_t>(base + r_.y);
+    PagePenalty(base, address, read);
+    return address;
+  }
+
+  // The addressing mode for the regular opcodes aaabbbcc; the X-indexed modes are Y-indexed for
+  // the instructions using X. Returns the address of the operand for immediate mode.
+  uint16_t Address(unsigned bbb, bool index_y, bool read)
+  {
+    switch (bbb) {
+      case 0: return IndexedIndirect();
+      case 1: return ZeroPage();
+      case 2: return r_.pc++;
+      case 3: return Absolute();
+      case 4: return IndirectIndexed(read);
+      case 5: return ZeroPageIndexed(index_y ? r_.y : r_.x);
+      case 6: return AbsoluteIndexed(r_.y, read);
+      default: return AbsoluteIndexed(index_y ? r_.y : r_.x, read);
+    }
+  }
+
+  //
+  // Operations
+  //
+  void set_flag(uint8_t flag, bool set) { r_.p = set ? (r_.p | flag) : (r_.p & ~flag); }
+  uint8_t set_nz(uint8_t value)
+  {
+    r_.p = (r_.p & ~(FLAG_N | FLAG_Z)) | (value & FLAG_N) | (value ? 0 : FLAG_Z);
+    return value;
+  }
+
+  void ADC(uint8_t value)
+  {
+    const unsigned carry = r_.p & FLAG_C;
+    const unsigned sum = r_.a + value + carry;
+    if (!(r_.p & FLAG_D)) {
+      set_flag(FLAG_C, sum > 0xff);
+      set_flag(FLAG_V, ~(r_.a ^ value) & (r_.a ^ sum) & 0x80);
+      r_.a = set_nz(static_cast<uint8_t>(sum));
+    } else {
+      // NMOS: Z is from the binary sum, N and V from the intermediate result
+      unsigned lo = (r_.a & 0x0f) + (value & 0x0f) + carry;
+      if (lo > 9) lo += 6;
+      unsigned hi = (r_.a >> 4) + (value >> 4) + (lo > 0x0f);
+      set_flag(FLAG_Z, !(sum & 0xff));
+      set_flag(FLAG_N, hi & 0x08);
+      set_flag(FLAG_V, ~(r_.a ^ value) & (r_.a ^ (hi << 4)) & 0x80);
+      if (hi > 9) hi += 6;
+      set_flag(FLAG_C, hi > 0x0f);
+      r_.a = static_cast<uint8_t>(hi << 4 | (lo & 0x0f));
+    }
+  }
+
+  void SBC(uint8_t value)
+  {
+    if (!(r_.p & FLAG_D)) {
+      ADC(static_cast<uint8_t>(~value));
+    } else {
+      // NMOS: the flags are the same as for binary mode
+      const unsigned borrow = (r_.p & FLAG_C) ? 0 : 1;
+      const unsigned diff = r_.a - value - borrow;
+      unsigned lo = (r_.a & 0x0f) - (value & 0x0f) - borrow;
+      unsigned hi = (r_.a >> 4) - (value >> 4);
+      if (lo & 0x10) {
+        lo -= 6;
+        --hi;
+      }
+      if (hi & 0x10) hi -= 6;
+      set_flag(FLAG_C, diff < 0x100);
+      set_flag(FLAG_V, (r_.a ^ value) & (r_.a ^ diff) & 0x80);
+      set_nz(static_cast<uint8_t>(diff));
+      r_.a = static_cast<uint8_t>(hi << 4 | (lo & 0x0f));
+    }
+  }
+
+  void Compare(uint8_t reg, uint8_t value)
+  {
+    set_flag(FLAG_C, reg >= value);
+    set_nz(static_cast<uint8_t>(reg - value));
+  }
+
+  void BIT(uint8_t value)
+  {
+    set_flag(FLAG_Z, !(r_.a & value));
+    r_.p = (r_.p & ~(FLAG_N | FLAG_V)) | (value & (FLAG_N | FLAG_V));
+  }
+
+  // ASL ROL LSR ROR - - DEC INC
+  uint8_t Modify(unsigned aaa, uint8_t value)
+  {
+    const unsigned carry = r_.p & FLAG_C;
+    switch (aaa) {
+      case 0: set_flag(FLAG_C, value & 0x80); return set_nz(static_cast<uint8_t>(value << 1));
+      case 1:
+        set_flag(FLAG_C, value & 0x80);
+        return set_nz(static_cast<uint8_t>(value << 1 | carry));
+      case 2: set_flag(FLAG_C, value & 0x01); return set_nz(value >> 1);
+      case 3:
+        set_flag(FLAG_C, value & 0x01);
+        return set_nz(static_cast<uint8_t>(value >> 1 | carry << 7));
+      case 6: return set_nz(static_cast<uint8_t>(value - 1));
+      default: return set_nz(static_cast<uint8_t>(value + 1));
+    }
+  }
+
+  void Branch(bool taken)
+  {
+    auto offset = static_cast<int8_t>(Fetch());
+    if (taken) {
+      auto target = static_cast<uint16_t>(r_.pc + offset);
+      cycles_ += ((r_.pc ^ target) & 0xff00) ? 2 : 1;
+      r_.pc = target;
+    }
+  }
+
+  // The unstable "AND (high byte + 1)" stores
+  void StoreHigh(uint16_t address, uint8_t value)
+  {
+    Write(address, static_cast<uint8_t>(value & ((address >> 8) + 1)));
+  }
+
+  //
+  // Instruction groups
+  //
+  void Execute()
+  {
+    const auto opcode = Fetch();
+    cycles_ += kCycles[opcode];
+    switch (opcode & 3) {
+      case 0: ExecuteControl(opcode); break;
+      case 1: ExecuteALU(opcode); break;
+      case 2: ExecuteRMW(opcode); break;
+      default: ExecuteCombined(opcode); break;
+    }
+  }
+
+  // ORA AND EOR ADC STA LDA CMP SBC
+  void ExecuteALU(uint8_t opcode)
+  {
+    const unsigned aaa = opcode >> 5, bbb = (opcode >> 2) & 7;
+    const auto address = Address(bbb, false, aaa != 4);
+    if (4 == aaa) {
+      if (bbb != 2) Write(address, r_.a);  // 0x89 is NOP #imm
+      return;
+    }
+    const auto value = Read(address);
+    switch (aaa) {
+      case 0: r_.a = set_nz(r_.a | value); break;
+      case 1: r_.a = set_nz(r_.a & value); break;
+      case 2: r_.a = set_nz(r_.a ^ value); break;
+      case 3: ADC(value); break;
+      case 5: r_.a = set_nz(value); break;
+      case 6: Compare(r_.a, value); break;
+      default: SBC(value); break;
+    }
+  }
+
+  // ASL ROL LSR ROR STX LDX DEC INC, and the register transfers etc. in the same columns
+  void ExecuteRMW(uint8_t opcode)
+  {
+    const unsigned aaa = opcode >> 5, bbb = (opcode >> 2) & 7;
+    switch (bbb) {
+      case 0:
+        if (0xa2 == opcode) {
+          r_.x = set_nz(Fetch());
+        } else if (aaa >= 4) {
+          ++r_.pc;  // NOP #imm
+        } else {
+          state_ = STATE::JAMMED;
+        }
+        break;
+      case 2:
+        switch (aaa) {
+          case 4: r_.a = set_nz(r_.x); break;
+          case 5: r_.x = set_nz(r_.a); break;
+          case 6: r_.x = set_nz(static_cast<uint8_t>(r_.x - 1)); break;
+          case 7: break;
+          default: r_.a = Modify(aaa, r_.a); break;
+        }
+        break;
+      case 4: state_ = STATE::JAMMED; break;
+      case 6:
+        if (0x9a == opcode) {
+          r_.sp = r_.x;
+        } else if (0xba == opcode) {
+          r_.x = set_nz(r_.sp);
+        }
+        break;
+      default: {
+        const auto address = Address(bbb, aaa == 4 || aaa == 5, aaa == 5);
+        if (4 == aaa) {
+          if (7 == bbb) {
+            StoreHigh(address, r_.x);  // SHX
+          } else {
+            Write(address, r_.x);
+          }
+        } else if (5 == aaa) {
+          r_.x = set_nz(Read(address));
+        } else {
+          Write(address, Modify(aaa, Read(address)));
+        }
+      } break;
+    }
+  }
+
+  // The undocumented combinations of the ALU and RMW columns:
+  // SLO RLA SRE RRA SAX LAX DCP ISC, with immediate mode oddities.
+  void ExecuteCombined(uint8_t opcode)
+  {
+    const unsigned aaa = opcode >> 5, bbb = (opcode >> 2) & 7;
+    if (2 == bbb) {
+      const auto value = Fetch();
+      switch (aaa) {
+        case 0:
+        case 1:  // ANC
+          r_.a = set_nz(r_.a & value);
+          set_flag(FLAG_C, r_.a & 0x80);
+          break;
+        case 2: r_.a = Modify(2, r_.a & value); break;  // ALR
+        case 3: {                                         // ARR
+          const auto carry = r_.p & FLAG_C;
+          r_.a = set_nz(static_cast<uint8_t>((r_.a & value) >> 1 | carry << 7));
+          set_flag(FLAG_C, r_.a & 0x40);
+          set_flag(FLAG_V, ((r_.a >> 6) ^ (r_.a >> 5)) & 1);
+        } break;
+        case 4: r_.a = set_nz(r_.x & value); break;  // XAA
+        case 5: r_.a = r_.x = set_nz(value); break;  // LAX #imm
+        case 6: {                                    // SBX
+          const unsigned ax = r_.a & r_.x;
+          set_flag(FLAG_C, ax >= value);
+          r_.x = set_nz(static_cast<uint8_t>(ax - value));
+        } break;
+        default: SBC(value); break;
+      }
+      return;
+    }
+
+    const bool index_y = aaa == 4 || aaa == 5;
+    const auto address = Address(bbb, index_y, aaa == 5);
+    switch (aaa) {
+      case 4:
+        if (bbb == 4 || bbb == 7) {
+          StoreHigh(address, r_.a & r_.x);  // SHA
+        } else if (bbb == 6) {
+          r_.sp = r_.a & r_.x;  // TAS
+          StoreHigh(address, r_.sp);
+        } else {
+          Write(address, r_.a & r_.x);  // SAX
+        }
+        break;
+      case 5:
+        if (bbb == 6) {
+          r_.a = r_.x = r_.sp = set_nz(Read(address) & r_.sp);  // LAS
+        } else {
+          r_.a = r_.x = set_nz(Read(address));  // LAX
+        }
+        break;
+      default: {
+        // The RMW part followed by the ALU part, e.g. RRA uses the carry from ROR
+        auto value = Modify(aaa, Read(address));
+        Write(address, value);
+        switch (aaa) {
+          case 0: r_.a = set_nz(r_.a | value); break;
+          case 1: r_.a = set_nz(r_.a & value); break;
+          case 2: r_.a = set_nz(r_.a ^ value); break;
+          case 3: ADC(value); break;
+          case 6: Compare(r_.a, value); break;
+          default: SBC(value); break;
+        }
+      } break;
+    }
+  }
+
+  // Branches, flags, stack, jumps, and the X/Y compares and loads
+  void ExecuteControl(uint8_t opcode)
+  {
+    const unsigned aaa = opcode >> 5, bbb = (opcode >> 2) & 7;
+    if (4 == bbb) {
+      // BPL BMI BVC BVS BCC BCS BNE BEQ
+      static constexpr uint8_t kBranchFlags[4] = {FLAG_N, FLAG_V, FLAG_C, FLAG_Z};
+      Branch(!!(r_.p & kBranchFlags[aaa >> 1]) == !!(aaa & 1));
+      return;
+    }
+    if (6 == bbb) {
+      // CLC SEC CLI SEI TYA CLV CLD SED
+      static constexpr uint8_t kFlags[8] = {FLAG_C, FLAG_C, FLAG_I, FLAG_I, 0, FLAG_V, FLAG_D,
+                                            FLAG_D};
+      if (4 == aaa) {
+        r_.a = set_nz(r_.y);
+      } else {
+        set_flag(kFlags[aaa], aaa & 1 && aaa != 5);
+      }
+      return;
+    }
+
+    switch (opcode) {
+      case 0x00:  // BRK
+        Push16(static_cast<uint16_t>(r_.pc + 1));
+        Push(r_.p | FLAG_B | FLAG_U);
+        r_.p |= FLAG_I;
+        r_.pc = static_cast<uint16_t>(Read(0xfffe) | Read(0xffff) << 8);
+        break;
+      case 0x08: Push(r_.p | FLAG_B | FLAG_U); break;  // PHP
+      case 0x20: {                                     // JSR
+        const auto address = Fetch16();
+        Push16(static_cast<uint16_t>(r_.pc - 1));
+        r_.pc = address;
+      } break;
+      case 0x28: r_.p = (Pull() & ~FLAG_B) | FLAG_U; break;  // PLP
+      case 0x24:
+      case 0x2c: BIT(Read(Address(bbb, false, true))); break;
+      case 0x40:  // RTI
+        r_.p = (Pull() & ~FLAG_B) | FLAG_U;
+        r_.pc = Pull16();
+        break;
+      case 0x48: Push(r_.a); break;  // PHA
+      case 0x4c: r_.pc = Fetch16(); break;
+      case 0x60: r_.pc = static_cast<uint16_t>(Pull16() + 1); break;  // RTS
+      case 0x68: r_.a = set_nz(Pull()); break;                        // PLA
+      case 0x6c: {  // JMP (ind), with the page wrap bug
+        const auto pointer = Fetch16();
+        uint16_t lo = Read(pointer);
+        r_.pc = static_cast<uint16_t>(
+            lo | Read(static_cast<uint16_t>((pointer & 0xff00) | ((pointer + 1) & 0xff))) << 8);
+      } break;
+      case 0x84:
+      case 0x8c:
+      case 0x94: Write(Address(bbb, false, false), r_.y); break;  // STY
+      case 0x88: r_.y = set_nz(static_cast<uint8_t>(r_.y - 1)); break;  // DEY
+      case 0x9c: StoreHigh(AbsoluteIndexed(r_.x, false), r_.y); break;   // SHY
+      case 0xa0: r_.y = set_nz(Fetch()); break;
+      case 0xa4:
+      case 0xac:
+      case 0xb4:
+      case 0xbc: r_.y = set_nz(Read(Address(bbb, false, true))); break;  // LDY
+      case 0xa8: r_.y = set_nz(r_.a); break;                           // TAY
+      case 0xc0: Compare(r_.y, Fetch()); break;
+      case 0xc4:
+      case 0xcc: Compare(r_.y, Read(Address(bbb, false, true))); break;  // CPY
+      case 0xc8: r_.y = set_nz(static_cast<uint8_t>(r_.y + 1)); break;  // INY
+      case 0xe0: Compare(r_.x, Fetch()); break;
+      case 0xe4:
+      case 0xec: Compare(r_.x, Read(Address(bbb, false, true))); break;  // CPX
+      case 0xe8: r_.x = set_nz(static_cast<uint8_t>(r_.x + 1)); break;  // INX
+      default:
+        // NOPs with an operand
+        if (!bbb) {
+          ++r_.pc;
+        } else {
+          (void)Read(Address(bbb, false, true));
+        }
+        break;
+    }
+  }
+};
+
+}  // namespace pfm2sid::sidbits
+
+#endif  // PFM2SID_SIDBITS_MOS6502_H_
@@ -0,0 +1,84 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "psid.h"
+
+#include <cstring>
+
+#include "misc/platform.h"
+
+ENABLE_WCONVERSION()
+
+namespace pfm2sid::sidbits {
+
+static uint16_t read_be16(const uint8_t *data)
+{
+  return static_cast<uint16_t>(data[0] << 8 | data[1]);
+}
+
+static void read_string(char *dst, const uint8_t *src)
+{
+  memcpy(dst, src, PSIDTune::kStringLength);
+  dst[PSIDTune::kStringLength] = '\0';
+}
+
+std::optional<PSIDTune> ParsePSID(const uint8_t *data, size_t size)
+{
+  static constexpr size_t kHeaderSizeV1 = 0x76;
+
+  if (!data || size < kHeaderSizeV1 || memcmp(data, "PSID", 4)) return std::nullopt;
+
+  PSIDTune tune;
+  tune.version = read_be16(data + 0x04);
+  const auto data_offset = read_be16(data + 0x06);
+  if (tune.version < 1 || tune.version > 4 || data_offset < kHeaderSizeV1 || data_offset >= size)
+    return std::nullopt;
+
+  tune.load_address = read_be16(data + 0x08);
+  tune.init_address = read_be16(data + 0x0a);
+  tune.play_address = read_be16(data + 0x0c);
+  tune.songs = read_be16(data + 0x0e);
+  tune.start_song = read_be16(data + 0x10);
+  tune.speed = static_cast<uint32_t>(read_be16(data + 0x12)) << 16 | read_be16(data + 0x14);
+  read_string(tune.name, data + 0x16);
+  read_string(tune.author, data + 0x36);
+  read_string(tune.released, data + 0x56);
+  if (tune.version >= 2 && data_offset >= kHeaderSizeV1 + 2) tune.flags = read_be16(data + 0x76);
+
+  tune.data = data + data_offset;
+  tune.data_size = size - data_offset;
+  if (!tune.load_address) {
+    if (tune.data_size < 2) return std::nullopt;
+    tune.load_address = static_cast<uint16_t>(tune.data[0] | tune.data[1] << 8);
+    tune.data += 2;
+    tune.data_size -= 2;
+  }
+  if (!tune.init_address) tune.init_address = tune.load_address;
+  if (tune.load_address + tune.data_size > 0x10000) return std::nullopt;
+
+  if (!tune.songs) tune.songs = 1;
+  if (!tune.start_song || tune.start_song > tune.songs) tune.start_song = 1;
+
+  return tune;
+}
+
+}  // namespace pfm2sid::sidbits
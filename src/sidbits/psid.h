@@ -0,0 +1,65 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_SIDBITS_PSID_H_
+#define PFM2SID_SIDBITS_PSID_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "sidbits.h"
+
+namespace pfm2sid::sidbits {
+
+// PSID file header, see e.g. https://www.hvsc.c64.org/download/C64Music/DOCUMENTS/SID_file_format.txt
+// RSID files need a real C64 environment and aren't supported.
+struct PSIDTune {
+  static constexpr size_t kStringLength = 32;
+
+  uint16_t version = 0;
+  uint16_t load_address = 0;
+  uint16_t init_address = 0;
+  uint16_t play_address = 0;  // 0 = the init routine installs an IRQ handler
+  uint16_t songs = 0;
+  uint16_t start_song = 0;  // 1-based
+  uint32_t speed = 0;       // bit n set = song n + 1 uses CIA timing
+  uint16_t flags = 0;
+
+  char name[kStringLength + 1] = {};
+  char author[kStringLength + 1] = {};
+  char released[kStringLength + 1] = {};
+
+  // The C64 data, excluding the load address if it was embedded
+  const uint8_t *data = nullptr;
+  size_t data_size = 0;
+
+  bool cia_timing(unsigned song) const { return song > 32 || (speed & (1U << (song - 1))); }
+  SID_CLOCK clock() const { return ((flags >> 2) & 3) == 2 ? SID_CLOCK::NTSC : SID_CLOCK::PAL; }
+};
+
+// The tune refers to the data, so that has to stay around
+std::optional<PSIDTune> ParsePSID(const uint8_t *data, size_t size);
+
+}  // namespace pfm2sid::sidbits
+
+#endif  // PFM2SID_SIDBITS_PSID_H_
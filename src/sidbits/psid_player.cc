@@ -0,0 +1,152 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "psid_player.h"
+
+#include <algorithm>
+
+#include "misc/platform.h"
+
+ENABLE_WCONVERSION()
+
+namespace pfm2sid::sidbits {
+
+bool PSIDPlayer::Load(const uint8_t *data, size_t size)
+{
+  auto tune = ParsePSID(data, size);
+  if (!tune) return false;
+  tune_ = *tune;
+  return true;
+}
+
+bool PSIDPlayer::StartSong(unsigned song, float sample_rate)
+{
+  if (!loaded()) return false;
+  if (!song || song > tune_.songs) song = tune_.start_song;
+
+  bus_.Reset();
+  if (!bus_.Map(tune_.load_address, tune_.data, tune_.data_size)) return false;
+
+  // Bank out the ROMs the tune would overlap, as a PSID player does
+  if (tune_.init_address >= 0xd000) {
+    bus_.set_port(0x35);
+  } else if (tune_.init_address >= 0xa000 && tune_.init_address < 0xc000) {
+    bus_.set_port(0x36);
+  } else {
+    bus_.set_port(0x37);
+  }
+
+  song_ = song;
+  stats_ = {};
+  register_map_.Reset();
+  block_writes_.clear();
+
+  cycles_per_sample_ =
+      static_cast<uint32_t>(clock_freq(tune_.clock()) / sample_rate * 65536.f + .5f);
+  cycle_fraction_ = 0;
+  block_cycle_ = 0;
+
+  cpu_.Reset();
+  cpu_.set_cycles(0);
+  cpu_.Call(tune_.init_address, static_cast<uint8_t>(song - 1));
+  in_init_ = true;
+  init_deadline_ = kMaxInitCycles;
+  UpdateFramePeriod();
+  next_frame_ = frame_cycles_;
+  return true;
+}
+
+void PSIDPlayer::Render(size_t block_size)
+{
+  // The writes from the previous block are now in the past
+  for (auto &w : block_writes_) register_map_.write(w.reg, w.value);
+  block_writes_.clear();
+  if (!loaded()) return;
+
+  const auto cycles = static_cast<uint32_t>(block_size) * cycles_per_sample_ + cycle_fraction_;
+  cycle_fraction_ = cycles & 0xffff;
+  const auto block_end = block_cycle_ + (cycles >> 16);
+  bus_.BeginBlock(block_cycle_);
+
+  for (;;) {
+    const auto deadline = before(next_frame_, block_end) ? next_frame_ : block_end;
+    const auto state = cpu_.Run(deadline);
+    if (CPU::STATE::RUNNING != state) {
+      if (CPU::STATE::JAMMED == state) {
+        ++stats_.jams;
+        cpu_.Abort();
+      }
+      in_init_ = false;
+      // Idle until the next frame
+      if (before(cpu_.cycles(), deadline)) cpu_.set_cycles(deadline);
+    }
+    if (!before(cpu_.cycles(), next_frame_)) StartFrame();
+    if (!before(cpu_.cycles(), block_end)) break;
+  }
+
+  // Instructions may overshoot the block end a little; those writes go at the end
+  const auto last_offset = static_cast<uint32_t>(block_size - 1);
+  for (auto &w : bus_.sid_writes()) {
+    auto offset =
+        std::min((static_cast<uint32_t>(w.offset) << 16) / cycles_per_sample_, last_offset);
+    block_writes_.push_back(static_cast<uint16_t>(offset), w.reg, w.value);
+  }
+  block_cycle_ = block_end;
+}
+
+void PSIDPlayer::StartFrame()
+{
+  next_frame_ += frame_cycles_;
+  if (CPU::STATE::RUNNING == cpu_.state()) {
+    if (in_init_ && before(cpu_.cycles(), init_deadline_)) return;
+    cpu_.Abort();
+    if (in_init_) {
+      in_init_ = false;
+    } else {
+      ++stats_.overruns;
+    }
+  }
+
+  UpdateFramePeriod();
+  if (tune_.play_address) {
+    cpu_.Call(tune_.play_address);
+  } else if (bus_.kernal_visible()) {
+    const auto vector = static_cast<uint16_t>(bus_.Read(0x0314, 0) | bus_.Read(0x0315, 0) << 8);
+    cpu_.Interrupt(vector, true);
+  } else {
+    const auto vector = static_cast<uint16_t>(bus_.Read(0xfffe, 0) | bus_.Read(0xffff, 0) << 8);
+    cpu_.Interrupt(vector);
+  }
+  ++stats_.frames;
+}
+
+// CIA timed tunes may change the timer at any time, so this is checked every frame
+void PSIDPlayer::UpdateFramePeriod()
+{
+  if (tune_.cia_timing(song_)) {
+    frame_cycles_ = bus_.cia_timer() + 1U;
+  } else {
+    frame_cycles_ = SID_CLOCK::NTSC == tune_.clock() ? kNTSCFrameCycles : kPALFrameCycles;
+  }
+}
+
+}  // namespace pfm2sid::sidbits
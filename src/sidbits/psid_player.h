@@ -0,0 +1,111 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_SIDBITS_PSID_PLAYER_H_
+#define PFM2SID_SIDBITS_PSID_PLAYER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "c64_bus.h"
+#include "mos6502.h"
+#include "psid.h"
+#include "register_writes.h"
+#include "sidbits.h"
+
+namespace pfm2sid::sidbits {
+
+// Play a PSID tune by running its init/play routines on an emulated 6502.
+//
+// The CPU runs in lockstep with the sample clock: each Render advances it by the number of C64
+// cycles in the block, calling the play routine (or IRQ handler) whenever a frame is due. The SID
+// writes come out with their cycle, and are converted to sample offsets in the block.
+//
+// A play routine gets one frame worth of cycles; if it's still running when the next frame is due
+// it's aborted and counted as an overrun. The init routine gets kMaxInitCycles and play calls are
+// held off until it returns.
+class PSIDPlayer {
+public:
+  static constexpr uint32_t kMaxInitCycles = 2 * 985248;  // ~2s, some tunes depack at init
+
+  // Frame periods in cycles for VBI timed tunes
+  static constexpr uint32_t kPALFrameCycles = 312 * 63;
+  static constexpr uint32_t kNTSCFrameCycles = 263 * 65;
+
+  struct Stats {
+    uint32_t frames = 0;
+    uint32_t overruns = 0;
+    uint32_t jams = 0;
+  };
+
+  bool Load(const uint8_t *data, size_t size);
+  bool loaded() const { return !!tune_.data; }
+
+  // Songs are 1-based, 0 is the default song
+  bool StartSong(unsigned song, float sample_rate);
+
+  // Run the tune for the duration of block_size samples. After this, register_map is the state at
+  // the start of the block, and block_writes has the writes within it.
+  void Render(size_t block_size);
+
+  const RegisterMap &register_map() const { return register_map_; }
+  const BlockRegisterWrites &block_writes() const { return block_writes_; }
+
+  const PSIDTune &tune() const { return tune_; }
+  unsigned song() const { return song_; }
+  uint32_t frame_cycles() const { return frame_cycles_; }
+
+  const Stats &stats() const { return stats_; }
+  const C64Bus &bus() const { return bus_; }
+
+private:
+  PSIDTune tune_;
+  unsigned song_ = 0;
+
+  using CPU = MOS6502<C64Bus>;
+
+  C64Bus bus_;
+  CPU cpu_{bus_};
+
+  bool in_init_ = false;
+  uint32_t init_deadline_ = 0;
+  uint32_t frame_cycles_ = kPALFrameCycles;
+  uint32_t next_frame_ = 0;
+
+  // C64 cycles per sample in Q16, and the fractional cycles carried between blocks
+  uint32_t cycles_per_sample_ = 0;
+  uint32_t cycle_fraction_ = 0;
+  uint32_t block_cycle_ = 0;
+
+  RegisterMap register_map_;
+  BlockRegisterWrites block_writes_;
+  Stats stats_;
+
+  static bool before(uint32_t a, uint32_t b) { return static_cast<int32_t>(a - b) < 0; }
+
+  void StartFrame();
+  void UpdateFramePeriod();
+};
+
+}  // namespace pfm2sid::sidbits
+
+#endif  // PFM2SID_SIDBITS_PSID_PLAYER_H_
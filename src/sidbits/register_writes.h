@@ -0,0 +1,195 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_SIDBITS_REGISTER_WRITES_H_
+#define PFM2SID_SIDBITS_REGISTER_WRITES_H_
+
+#include <array>
+#include <cinttypes>
+
+#include "sidbits/sidbits.h"
+
+namespace pfm2sid::sidbits {
+
+// A register write at a sample offset within a render block. Writes at the same offset are applied
+// in order, so the last one wins.
+struct RegisterWrite {
+  uint16_t offset;
+  uint8_t reg;
+  uint8_t value;
+};
+
+// Fixed-capacity list of timestamped writes. The producer is responsible for adding writes in order
+// of offset.
+template <size_t N>
+class RegisterWriteList {
+public:
+  static constexpr size_t kCapacity = N;
+
+  void clear() { size_ = 0; }
+
+  bool push_back(uint16_t offset, uint8_t reg, uint8_t value)
+  {
+    if (size_ < N) {
+      writes_[size_++] = {offset, reg, value};
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  bool empty() const { return !size_; }
+  size_t size() const { return size_; }
+
+  // Stable sort by offset, for lists built from multiple sources. This is an insertion sort
+  // since the lists are short and usually consist of a few sorted runs.
+  void sort()
+  {
+    for (size_t i = 1; i < size_; ++i) {
+      auto w = writes_[i];
+      auto j = i;
+      for (; j > 0 && writes_[j - 1].offset > w.offset; --j) writes_[j] = writes_[j - 1];
+      writes_[j] = w;
+    }
+  }
+
+  const RegisterWrite *begin() const { return writes_.data(); }
+  const RegisterWrite *end() const { return writes_.data() + size_; }
+
+private:
+  std::array<RegisterWrite, N> writes_;
+  size_t size_ = 0;
+};
+
+// Timestamped writes generated by a synth for one chip in one render block
+static constexpr size_t kMaxBlockRegisterWrites = 128;
+using BlockRegisterWrites = RegisterWriteList<kMaxBlockRegisterWrites>;
+
+// Start/end values for the "continuous" registers that are updated every block. Instead of a step
+// at the start of the block, these can be interpolated within the block at a finer rate.
+//
+// The end value should also be set in the RegisterMap so the result is the same if the ramps are
+// ignored.
+enum struct RAMP_TARGET : uint8_t {
+  VOICE1_FREQ,
+  VOICE2_FREQ,
+  VOICE3_FREQ,
+  VOICE1_PWM,
+  VOICE2_PWM,
+  VOICE3_PWM,
+  FILTER_FREQ,
+  LAST
+};
+
+class RegisterRamps {
+public:
+  static constexpr unsigned kNumTargets = static_cast<unsigned>(RAMP_TARGET::LAST);
+
+  static constexpr RAMP_TARGET freq_target(VOICE_INDEX voice)
+  {
+    return static_cast<RAMP_TARGET>(static_cast<unsigned>(RAMP_TARGET::VOICE1_FREQ) + voice);
+  }
+  static constexpr RAMP_TARGET pwm_target(VOICE_INDEX voice)
+  {
+    return static_cast<RAMP_TARGET>(static_cast<unsigned>(RAMP_TARGET::VOICE1_PWM) + voice);
+  }
+
+  void clear() { active_ = 0; }
+  bool empty() const { return !active_; }
+
+  // No ramp is required if start == end
+  void set(RAMP_TARGET target, uint16_t start, uint16_t end)
+  {
+    auto t = static_cast<unsigned>(target);
+    if (start != end) {
+      ramps_[t] = {start, end};
+      active_ |= 1U << t;
+    } else {
+      active_ &= ~(1U << t);
+    }
+  }
+
+  // Generate writes that step from start towards end in num_steps equal steps over block_size
+  // samples, i.e. the value at offset is start + (end - start) * step / num_steps where step is the
+  // last one at or before offset. The end value itself is reached at the start of the next block.
+  //
+  // The writes are applied on top of the register map, so the chip already has the end value
+  // when the block starts; the first step sets the start value. Only bytes that differ from what's
+  // in the chip are written.
+  template <size_t N>
+  void Interpolate(unsigned num_steps, unsigned block_size, RegisterWriteList<N> &writes) const
+  {
+    if (!active_ || num_steps < 2) return;
+
+    uint8_t current[kNumTargets][2];
+    for (unsigned t = 0; t < kNumTargets; ++t) {
+      if (active_ & (1U << t)) Encode(t, ramps_[t].end, current[t]);
+    }
+
+    for (unsigned step = 0; step < num_steps; ++step) {
+      auto offset = static_cast<uint16_t>(step * block_size / num_steps);
+      for (unsigned t = 0; t < kNumTargets; ++t) {
+        if (!(active_ & (1U << t))) continue;
+        auto &ramp = ramps_[t];
+        auto delta = static_cast<int32_t>(ramp.end) - static_cast<int32_t>(ramp.start);
+        auto value = static_cast<uint16_t>(ramp.start + delta * static_cast<int32_t>(step) /
+                                                            static_cast<int32_t>(num_steps));
+        uint8_t bytes[2];
+        auto reg = Encode(t, value, bytes);
+        if (bytes[0] != current[t][0]) writes.push_back(offset, reg, bytes[0]);
+        if (bytes[1] != current[t][1]) writes.push_back(offset, reg + 1, bytes[1]);
+        current[t][0] = bytes[0];
+        current[t][1] = bytes[1];
+      }
+    }
+  }
+
+private:
+  struct Ramp {
+    uint16_t start;
+    uint16_t end;
+  };
+
+  std::array<Ramp, kNumTargets> ramps_ = {};
+  uint32_t active_ = 0;
+
+  // Returns first register, bytes are written to consecutive registers
+  static uint8_t Encode(unsigned target, uint16_t value, uint8_t *bytes)
+  {
+    if (target < static_cast<unsigned>(RAMP_TARGET::VOICE1_PWM)) {
+      auto voice = static_cast<VOICE_INDEX>(target);
+      RegisterMap::encode_voice_freq(value, bytes);
+      return RegisterMap::voice_register(voice, RegisterMap::VOICE_FREQ_LO);
+    } else if (target < static_cast<unsigned>(RAMP_TARGET::FILTER_FREQ)) {
+      auto voice = static_cast<VOICE_INDEX>(target - static_cast<unsigned>(RAMP_TARGET::VOICE1_PWM));
+      RegisterMap::encode_voice_pwm(value, bytes);
+      return RegisterMap::voice_register(voice, RegisterMap::VOICE_PWM_LO);
+    } else {
+      RegisterMap::encode_filter_freq(value, bytes);
+      return RegisterMap::FILTER_CUTOFF_LO;
+    }
+  }
+};
+
+}  // namespace pfm2sid::sidbits
+
+#endif  // PFM2SID_SIDBITS_REGISTER_WRITES_H_
@@ -0,0 +1,177 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "sid_stream.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "misc/platform.h"
+
+ENABLE_WCONVERSION()
+
+namespace pfm2sid::sidbits {
+
+void SIDStream::Init(const SIDStreamData &stream_data)
+{
+  stream_data_ = stream_data;
+  compressed_ = false;
+  num_frames_ = 0;
+  keyframe_interval_ = num_keyframes_ = 0;
+  data_start_ = 0;
+
+  auto data = stream_data_.start;
+  if (data && size() >= kHeaderSize && !memcmp(data, kMagic, sizeof(kMagic)) &&
+      kVersion == data[4] && SID_REGISTER_COUNT == data[5]) {
+    compressed_ = true;
+    keyframe_interval_ = data[6] | data[7] << 8;
+    num_frames_ = read_u32(8);
+    num_keyframes_ = read_u32(12);
+    data_start_ = kHeaderSize + num_keyframes_ * sizeof(uint32_t);
+    if (!keyframe_interval_ || data_start_ > size()) num_keyframes_ = 0;
+  } else if (data) {
+    num_frames_ = static_cast<uint32_t>(size() / SID_REGISTER_COUNT);
+  }
+  loop_start_ = 0;
+  loop_end_ = num_frames_;
+  Reset();
+}
+
+void SIDStream::Reset()
+{
+  pos_ = data_start_;
+  frame_ = 0;
+  repeat_ = 0;
+  replay_records_ = 0;
+  register_map_.Reset();
+}
+
+bool SIDStream::Step()
+{
+  if (!stream_data_.start) return false;
+
+  if (frame_ >= loop_end_ || !DecodeFrame()) {
+    Seek(loop_start_);
+    return true;
+  }
+  return false;
+}
+
+void SIDStream::Seek(uint32_t frame)
+{
+  if (!stream_data_.start || !num_frames_) return;
+  frame = std::min(frame, num_frames_ - 1);
+
+  if (!compressed_) {
+    pos_ = frame * SID_REGISTER_COUNT;
+    frame_ = frame;
+  } else if (num_keyframes_) {
+    // The decoded keyframe sets all registers
+    auto keyframe = std::min(frame / keyframe_interval_, num_keyframes_ - 1);
+    pos_ = read_u32(kHeaderSize + keyframe * sizeof(uint32_t));
+    frame_ = keyframe * keyframe_interval_;
+    repeat_ = 0;
+    replay_records_ = 0;
+  } else {
+    Reset();
+  }
+
+  while (frame_ <= frame) {
+    if (!DecodeFrame()) break;
+  }
+}
+
+void SIDStream::set_loop(uint32_t start, uint32_t end)
+{
+  loop_end_ = std::clamp<uint32_t>(end, 1, num_frames_);
+  loop_start_ = std::min(start, loop_end_ - 1);
+}
+
+uint32_t SIDStream::read_u32(size_t pos) const
+{
+  auto data = stream_data_.start + pos;
+  return data[0] | data[1] << 8 | data[2] << 16 | static_cast<uint32_t>(data[3]) << 24;
+}
+
+bool SIDStream::DecodeFrame()
+{
+  if (compressed_) {
+    if (repeat_) {
+      --repeat_;
+    } else if (!DecodeRecord()) {
+      return false;
+    }
+  } else {
+    if (pos_ + SID_REGISTER_COUNT > size()) return false;
+    for (uint8_t r = 0; r < SID_REGISTER_COUNT; ++r)
+      register_map_.write(r, stream_data_.start[pos_++]);
+  }
+  ++frame_;
+  return true;
+}
+
+bool SIDStream::DecodeRecord()
+{
+  const auto data = stream_data_.start;
+  const auto end = size();
+  if (pos_ >= end) return false;
+
+  auto tag = data[pos_++];
+  if (tag >= TAG_REPLAY) {
+    if (replay_records_ || pos_ + 2 > end) return false;
+    const size_t distance = data[pos_] | data[pos_ + 1] << 8;
+    const auto tag_pos = pos_ - 1;
+    if (distance > tag_pos - data_start_) return false;
+    replay_records_ = (tag & TAG_COUNT_MASK) + 1U;
+    replay_return_ = pos_ + 2;
+    pos_ = tag_pos - distance;
+    tag = data[pos_++];
+    if (tag >= TAG_REPLAY) return false;
+  }
+
+  if (tag >= TAG_REPEAT) {
+    // This is the first frame of the run
+    repeat_ = tag & TAG_COUNT_MASK;
+  } else if (TAG_KEYFRAME == tag) {
+    if (pos_ + SID_REGISTER_COUNT > end) return false;
+    for (uint8_t r = 0; r < SID_REGISTER_COUNT; ++r) register_map_.write(r, data[pos_++]);
+  } else if (tag < TAG_KEYFRAME) {
+    for (unsigned group = 0; group < kNumGroups; ++group) {
+      if (!(tag & (1 << group))) continue;
+      if (pos_ >= end) return false;
+      auto mask = data[pos_++];
+      auto reg = group * kGroupSize;
+      for (; mask && reg < SID_REGISTER_COUNT; mask >>= 1, ++reg) {
+        if (!(mask & 1)) continue;
+        if (pos_ >= end) return false;
+        register_map_.write(static_cast<uint8_t>(reg), data[pos_++]);
+      }
+    }
+  } else {
+    return false;
+  }
+
+  if (replay_records_ && !--replay_records_) pos_ = replay_return_;
+  return true;
+}
+
+}  // namespace pfm2sid::sidbits
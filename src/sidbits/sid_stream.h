@@ -23,8 +23,8 @@
 #ifndef PFM2SID_SID_STREAM_H_
 #define PFM2SID_SID_STREAM_H_
 
-#include <algorithm>
-#include <array>
+#include <cstddef>
+#include <cstdint>
 
 #include "sidbits.h"
 
@@ -35,47 +35,92 @@ struct SIDStreamData {
   const uint8_t *end = nullptr;
 };
 
-// Play a SID file from memory
+// Play a SID register dump from memory.
+//
+// Raw dumps are SID_REGISTER_COUNT bytes per frame. Compressed streams (see
+// resources/sid_stream.py) start with a header and an index of keyframe offsets, followed by one
+// record per frame or run of frames:
+//
+// 0x00-0x0F  Changed registers; the low bits are a mask of the groups of 7 registers that changed.
+//            Each group is followed by a mask byte and the new values in register order.
+// 0x10       Keyframe, followed by all register values. There's one every keyframe_interval
+//            frames and runs or replays don't cross them, so seeking only needs to decode from the
+//            last one.
+// 0x80-0xBF  The registers don't change for (tag & 0x3f) + 1 frames.
+// 0xC0-0xFF  Replay (tag & 0x3f) + 1 earlier records, starting at the 16-bit LE distance (in
+//            bytes) before the tag. Replayed records don't contain replays.
+//
+// Replays are a kind of LZ that works since the data is in memory anyway, so there's no window to
+// keep around. Decoding a frame only touches the changed registers.
 class SIDStream {
 public:
+  static constexpr uint8_t kMagic[4] = {'S', 'I', 'D', 'Z'};
+  static constexpr uint8_t kVersion = 2;
+  static constexpr size_t kHeaderSize = 16;
+
+  static constexpr unsigned kGroupSize = 7;
+  static constexpr unsigned kNumGroups = (SID_REGISTER_COUNT + kGroupSize - 1) / kGroupSize;
+  static constexpr uint8_t TAG_KEYFRAME = 0x10;
+  static constexpr uint8_t TAG_REPEAT = 0x80;
+  static constexpr uint8_t TAG_REPLAY = 0xC0;
+  static constexpr uint8_t TAG_COUNT_MASK = 0x3f;
+
   SIDStream() = default;
 
   size_t size() const { return stream_data_.end - stream_data_.start; }
   size_t pos() const { return pos_; }
+  bool compressed() const { return compressed_; }
 
-  float percent() const { return 100.f * static_cast<float>(pos_) / static_cast<float>(size()); }
+  uint32_t num_frames() const { return num_frames_; }
+  uint32_t keyframe_interval() const { return keyframe_interval_; }
+  // The next frame to be decoded
+  uint32_t frame() const { return frame_; }
 
-  void Init(const SIDStreamData &stream_data)
+  float percent() const
   {
-    stream_data_ = stream_data;
-    pos_ = 0;
+    return num_frames_ ? 100.f * static_cast<float>(frame_) / static_cast<float>(num_frames_)
+                       : 0.f;
   }
 
-  void Reset()
-  {
-    pos_ = 0;
-    register_map_.Reset();
-  }
+  void Init(const SIDStreamData &stream_data);
+  void Reset();
 
-  void Step()
-  {
-    if (!stream_data_.start) return;
+  // Decode the next frame, and loop at the loop end. Returns true if it jumped to the loop start
+  // (i.e. the register map isn't a continuation of the previous frame).
+  bool Step();
 
-    for (uint8_t r = 0; r < sidbits::SID_REGISTER_COUNT; ++r) {
-      auto value = stream_data_.start[pos_++];
-      register_map_.poke(r, value);
-    }
+  // Decode the given frame, starting from the closest keyframe
+  void Seek(uint32_t frame);
 
-    if (pos_ >= size()) { pos_ = 0; }
-  }
+  // Loop [start, end), which defaults to the whole stream
+  void set_loop(uint32_t start, uint32_t end);
+  uint32_t loop_start() const { return loop_start_; }
+  uint32_t loop_end() const { return loop_end_; }
 
-  auto register_map() const { return register_map_; }
+  const auto &register_map() const { return register_map_; }
 
 private:
   SIDStreamData stream_data_;
+  bool compressed_ = false;
+  uint32_t num_frames_ = 0;
+  uint32_t keyframe_interval_ = 0;
+  uint32_t num_keyframes_ = 0;
+  size_t data_start_ = 0;
+
+  uint32_t loop_start_ = 0;
+  uint32_t loop_end_ = 0;
+
   size_t pos_ = 0;
+  uint32_t frame_ = 0;
+  uint32_t repeat_ = 0;
+  uint32_t replay_records_ = 0;
+  size_t replay_return_ = 0;
 
   sidbits::RegisterMap register_map_;
+
+  uint32_t read_u32(size_t pos) const;
+  bool DecodeFrame();
+  bool DecodeRecord();
 };
 
 }  // namespace pfm2sid::sidbits
@@ -34,8 +34,22 @@
 
 namespace pfm2sid::sidbits {
 
-static constexpr float CLOCK_FREQ_PAL = 985248.f;  // PAL
+static constexpr float CLOCK_FREQ_PAL = 985248.f;    // PAL
+static constexpr float CLOCK_FREQ_NTSC = 1022727.f;  // NTSC
+
+enum struct SID_CLOCK : uint8_t { PAL, NTSC };
+
+constexpr float clock_freq(SID_CLOCK sid_clock)
+{
+  return SID_CLOCK::NTSC == sid_clock ? CLOCK_FREQ_NTSC : CLOCK_FREQ_PAL;
+}
+
 static constexpr size_t SID_REGISTER_COUNT = 25;
+static constexpr size_t SID_VOICE_COUNT = 3;
+
+// Nominal release (or decay) times of the 4-bit envelope rates in ms, from the datasheet
+static constexpr uint16_t ENV_RELEASE_MS[16] = {6,   24,   48,   72,   114,  168,  204,   240,
+                                                300, 750,  1500, 2400, 3000, 9000, 15000, 24000};
 
 //
 // Convert MIDI notes to frequency
@@ -104,7 +118,35 @@ public:
     VOICE_CONTROL_WAVE = 0xf0,
   };
 
-  void Reset() { std::fill(registers_.begin(), registers_.end(), 0); }
+  void Reset()
+  {
+    std::fill(registers_.begin(), registers_.end(), 0);
+    mark_dirty();
+  }
+
+  static constexpr uint8_t voice_register(VOICE_INDEX voice, REGISTER_OFFSET reg)
+  {
+    return static_cast<uint8_t>(voice * VOICE_REG_COUNT + reg);
+  }
+
+  // Register encoding of the multi-byte values, i.e. {lo, hi}
+  static constexpr void encode_voice_freq(uint16_t freq, uint8_t *bytes)
+  {
+    bytes[0] = freq & 0xff;
+    bytes[1] = (freq >> 8) & 0xff;
+  }
+
+  static constexpr void encode_voice_pwm(uint16_t duty_cycle, uint8_t *bytes)
+  {
+    bytes[0] = duty_cycle & 0xff;
+    bytes[1] = (duty_cycle >> 8) & 0xff;
+  }
+
+  static constexpr void encode_filter_freq(uint16_t freq, uint8_t *bytes)
+  {
+    bytes[0] = (freq & 0x7);
+    bytes[1] = (freq >> 3) & 0xff;
+  }
 
   void voice_set_freq(VOICE_INDEX voice, uint16_t freq)
   {
@@ -161,14 +203,19 @@ public:
     set_flag<VOICE_CONTROL, VOICE_CONTROL_GATE>(voice_register_base(voice), enable);
   }
 
-  void voice_set_control(VOICE_INDEX voice, OSC_WAVE wave, OSC_RING ring, OSC_SYNC sync, bool gate)
+  static constexpr uint8_t encode_voice_control(OSC_WAVE wave, OSC_RING ring, OSC_SYNC sync,
+                                                bool gate)
   {
-    auto *base = voice_register_base(voice);
     uint8_t control = static_cast<uint8_t>(wave);
     if (ring) control |= VOICE_CONTROL_RING;
     if (sync) control |= VOICE_CONTROL_SYNC;
     if (gate) control |= VOICE_CONTROL_GATE;
-    base[VOICE_CONTROL] = control;
+    return control;
+  }
+
+  void voice_set_control(VOICE_INDEX voice, OSC_WAVE wave, OSC_RING ring, OSC_SYNC sync, bool gate)
+  {
+    voice_register_base(voice)[VOICE_CONTROL] = encode_voice_control(wave, ring, sync, gate);
   }
 
   enum FILTER_BITS : uint8_t {
@@ -185,8 +232,13 @@ public:
 
   void filter_set_freq(uint16_t freq)
   {
-    registers_[FILTER_CUTOFF_LO] = (freq & 0x3);
-    registers_[FILTER_CUTOFF_HI] = (freq >> 3) & 0xff;
+    encode_filter_freq(freq, registers_.data() + FILTER_CUTOFF_LO);
+  }
+
+  uint16_t filter_get_freq() const
+  {
+    return static_cast<uint16_t>((registers_[FILTER_CUTOFF_HI] << 3) |
+                                 (registers_[FILTER_CUTOFF_LO] & 0x7));
   }
 
   void filter_set_resonance_enable(uint8_t resonance, bool voice1, bool voice2, bool voice3)
@@ -208,11 +260,33 @@ public:
   void poke(uint8_t reg, uint8_t value) { registers_[reg] = value; }
   uint8_t peek(uint8_t reg) const { return registers_[reg]; }
 
+  // Like poke, but flags the register as dirty if the value changed. This is only tracked for
+  // write (and Reset) so a consumer of a map that's only updated this way can skip the rest.
+  void write(uint8_t reg, uint8_t value)
+  {
+    if (registers_[reg] != value) {
+      registers_[reg] = value;
+      dirty_ |= 1U << reg;
+    }
+  }
+
+  static constexpr uint32_t kAllDirty = (1U << kNumRegisters) - 1;
+
+  auto dirty() const { return dirty_; }
+  void mark_dirty() { dirty_ = kAllDirty; }
+  uint32_t take_dirty()
+  {
+    auto dirty = dirty_;
+    dirty_ = 0;
+    return dirty;
+  }
+
   auto begin() const { return registers_.begin(); }
   auto end() const { return registers_.end(); }
 
 private:
   std::array<uint8_t, kNumRegisters> registers_ = {};
+  uint32_t dirty_ = 0;
 
   uint8_t *voice_register_base(VOICE_INDEX voice)
   {
@@ -0,0 +1,258 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "controller_map.h"
+
+#include "misc/platform.h"
+
+ENABLE_WCONVERSION()
+
+namespace pfm2sid::synth {
+
+namespace {
+
+enum CONTROL : uint8_t {
+  CC_PORTAMENTO_TIME = 5,
+  CC_DATA_ENTRY_MSB = 6,
+  CC_VOLUME = 7,
+  CC_DATA_ENTRY_LSB = 38,
+  CC_RESONANCE = 71,
+  CC_RELEASE = 72,
+  CC_ATTACK = 73,
+  CC_CUTOFF = 74,
+  CC_DECAY = 75,
+  CC_VIBRATO_RATE = 76,
+  CC_NRPN_LSB = 98,
+  CC_NRPN_MSB = 99,
+  CC_RPN_LSB = 100,
+  CC_RPN_MSB = 101,
+};
+
+// Controllers that have a fixed meaning and can't be mapped
+constexpr bool is_reserved_control(uint8_t control)
+{
+  return CC_DATA_ENTRY_MSB == control || CC_DATA_ENTRY_LSB == control ||
+         (control >= 96 && control <= CC_RPN_MSB) || control >= 120;
+}
+
+// Default NRPN layout: MSB selects the scope (and index), LSB is the parameter
+enum NRPN_MSB : uint16_t {
+  NRPN_GLOBAL = 0,
+  NRPN_VOICES = 4,
+  NRPN_LFO1 = 8,
+};
+
+constexpr uint16_t make_nrpn(uint16_t msb, parameter_enum_type lsb)
+{
+  return static_cast<uint16_t>((msb << 7) | (lsb & 0x7f));
+}
+
+// The defaults share the table with user mappings, and probing gets slow when it's (nearly) full
+constexpr size_t kNumDefaultNrpns =
+    kNumGlobalParameters + kNumVoiceParameters + kNumLfos * kNumLfoParameters;
+constexpr size_t kMinFreeNrpns = 8;
+static_assert(kNumDefaultNrpns + kMinFreeNrpns <= ControllerMap::kNrpnTableSize,
+              "Default NRPN mappings don't fit, increase kNrpnTableSize");
+
+}  // namespace
+
+void ControllerMap::Init(Parameters *parameters, SystemParameters *system_parameters,
+                         ChangeNotifier *change_notifier)
+{
+  parameters_ = parameters;
+  system_parameters_ = system_parameters;
+  change_notifier_ = change_notifier;
+  Reset();
+}
+
+void ControllerMap::Reset()
+{
+  for (auto &mapping : controls_) mapping = {};
+  for (auto &entry : nrpns_) entry = {};
+  nrpn_ = kNoNrpn;
+  data_msb_ = 0;
+
+  Map(CC_PORTAMENTO_TIME, VOICE::GLIDE_RATE);
+  Map(CC_VOLUME, GLOBAL::VOLUME);
+  Map(CC_RESONANCE, GLOBAL::FILTER_RES);
+  Map(CC_RELEASE, VOICE::ENV_R);
+  Map(CC_ATTACK, VOICE::ENV_A);
+  Map(CC_CUTOFF, GLOBAL::FILTER_FREQ);
+  Map(CC_DECAY, VOICE::ENV_D);
+  Map(CC_VIBRATO_RATE, LFO::RATE, LFO1);
+
+  for (parameter_enum_type p = 0; p < kNumGlobalParameters; ++p)
+    MapNrpn(make_nrpn(NRPN_GLOBAL, p), static_cast<GLOBAL>(p));
+  for (parameter_enum_type p = 0; p < kNumVoiceParameters; ++p)
+    MapNrpn(make_nrpn(NRPN_VOICES, p), static_cast<VOICE>(p));
+  for (unsigned lfo = 0; lfo < kNumLfos; ++lfo) {
+    for (parameter_enum_type p = 0; p < kNumLfoParameters; ++p)
+      MapNrpn(make_nrpn(static_cast<uint16_t>(NRPN_LFO1 + lfo), p), static_cast<LFO>(p),
+              static_cast<uint8_t>(lfo));
+  }
+}
+
+/*static*/
+ControllerMap::Mapping ControllerMap::MakeMapping(const ParameterRef parameter, uint8_t index)
+{
+  if (parameter.is_lfo() && index >= kNumLfos) index = 0;
+  if (parameter.is_voice() && index >= sidbits::SID_VOICE_COUNT) index = kAllVoices;
+  return {ParameterDesc::Find(parameter), index};
+}
+
+bool ControllerMap::Map(uint8_t control, const ParameterRef parameter, uint8_t index)
+{
+  if (control > 127 || is_reserved_control(control)) return false;
+  controls_[control] = MakeMapping(parameter, index);
+  return true;
+}
+
+bool ControllerMap::MapNrpn(uint16_t nrpn, const ParameterRef parameter, uint8_t index)
+{
+  if (nrpn >= kNumNrpns) return false;
+
+  auto i = FindNrpn(nrpn);
+  if (i >= kNrpnTableSize) {
+    for (i = nrpn_hash(nrpn); kNoNrpn != nrpns_[i].nrpn;) {
+      i = (i + 1) & (kNrpnTableSize - 1);
+      if (i == nrpn_hash(nrpn)) return false;
+    }
+  }
+
+  nrpns_[i].nrpn = nrpn;
+  nrpns_[i].mapping = MakeMapping(parameter, index);
+  return true;
+}
+
+void ControllerMap::UnmapNrpn(uint16_t nrpn)
+{
+  auto i = FindNrpn(nrpn);
+  if (i >= kNrpnTableSize) return;
+
+  // Re-insert the rest of the probe chain so lookups don't stop early at the hole
+  nrpns_[i] = {};
+  for (i = (i + 1) & (kNrpnTableSize - 1); kNoNrpn != nrpns_[i].nrpn;
+       i = (i + 1) & (kNrpnTableSize - 1)) {
+    auto moved = nrpns_[i];
+    nrpns_[i] = {};
+    for (auto j = nrpn_hash(moved.nrpn);; j = (j + 1) & (kNrpnTableSize - 1)) {
+      if (kNoNrpn == nrpns_[j].nrpn) {
+        nrpns_[j] = moved;
+        break;
+      }
+    }
+  }
+}
+
+size_t ControllerMap::FindNrpn(uint16_t nrpn) const
+{
+  for (auto i = nrpn_hash(nrpn), n = kNrpnTableSize; n; --n, i = (i + 1) & (kNrpnTableSize - 1)) {
+    if (nrpn == nrpns_[i].nrpn) return i;
+    if (kNoNrpn == nrpns_[i].nrpn) break;
+  }
+  return kNrpnTableSize;
+}
+
+const ControllerMap::Mapping *ControllerMap::nrpn_mapping(uint16_t nrpn) const
+{
+  auto i = FindNrpn(nrpn);
+  return i < kNrpnTableSize ? &nrpns_[i].mapping : nullptr;
+}
+
+bool ControllerMap::ControlChange(uint8_t control, uint8_t value)
+{
+  switch (control) {
+    case CC_NRPN_MSB:
+      nrpn_ = static_cast<uint16_t>((value << 7) | (kNoNrpn == nrpn_ ? 0 : nrpn_ & 0x7f));
+      return true;
+    case CC_NRPN_LSB:
+      nrpn_ = static_cast<uint16_t>((kNoNrpn == nrpn_ ? 0 : nrpn_ & 0x3f80) | value);
+      return true;
+    case CC_RPN_MSB:
+    case CC_RPN_LSB:
+      // RPNs aren't supported, but data entry shouldn't change the previous NRPN either
+      nrpn_ = kNoNrpn;
+      return false;
+    case CC_DATA_ENTRY_MSB:
+    case CC_DATA_ENTRY_LSB: {
+      if (kNoNrpn == nrpn_) return false;
+      auto mapping = nrpn_mapping(nrpn_);
+      if (!mapping) return false;
+      if (CC_DATA_ENTRY_MSB == control) {
+        data_msb_ = value;
+        Apply(*mapping, static_cast<uint32_t>(value) << 7, 14);
+      } else {
+        Apply(*mapping, static_cast<uint32_t>(data_msb_) << 7 | value, 14);
+      }
+      return true;
+    }
+    default: break;
+  }
+
+  const auto &mapping = controls_[control & 0x7f];
+  if (!mapping.valid()) return false;
+  Apply(mapping, value, 7);
+  return true;
+}
+
+void ControllerMap::Apply(const Mapping &mapping, uint32_t value, unsigned num_bits)
+{
+  const auto desc = mapping.desc;
+  const auto max_input = static_cast<int32_t>((1U << num_bits) - 1);
+  const auto range = desc->max_value - desc->min_value;
+  const auto scaled =
+      desc->min_value + (range * static_cast<int32_t>(value) + max_input / 2) / max_input;
+
+  const auto &ref = desc->parameter;
+  switch (ref.type) {
+    case PARAMETER_SCOPE::SYSTEM:
+      if (system_parameters_ && Write(system_parameters_->mutable_value(ref), scaled))
+        change_notifier_->mark(ref.system_param);
+      break;
+    case PARAMETER_SCOPE::GLOBAL:
+      if (Write(parameters_->mutable_value(ref), scaled))
+        change_notifier_->mark(ref.global_param);
+      break;
+    case PARAMETER_SCOPE::VOICE:
+      if (kAllVoices == mapping.index) {
+        for (auto voice : {sidbits::VOICE1, sidbits::VOICE2, sidbits::VOICE3})
+          Write(parameters_->mutable_value(ref, voice), scaled);
+      } else {
+        Write(parameters_->mutable_value(ref, static_cast<sidbits::VOICE_INDEX>(mapping.index)),
+              scaled);
+      }
+      break;
+    case PARAMETER_SCOPE::LFO:
+      Write(parameters_->mutable_value(ref, static_cast<LFO_INDEX>(mapping.index)), scaled);
+      break;
+    case PARAMETER_SCOPE::NONE: break;
+  }
+}
+
+bool ControllerMap::Write(ParameterValue parameter_value, parameter_value_type value)
+{
+  if (!parameter_value || parameter_value.value() == value) return false;
+  parameter_value.set(value);
+  return true;
+}
+
+}  // namespace pfm2sid::synth
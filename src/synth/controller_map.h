@@ -0,0 +1,110 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_SYNTH_CONTROLLER_MAP_H_
+#define PFM2SID_SYNTH_CONTROLLER_MAP_H_
+
+#include <cstdint>
+
+#include "parameter_listener.h"
+#include "parameter_structs.h"
+
+namespace pfm2sid::synth {
+
+// Map MIDI CC and NRPN messages to parameters.
+//
+// CCs use a direct lookup table, NRPNs a small hash table. The controller value is scaled to the
+// full range of the parameter and written directly into the Parameters. Since some controllers
+// send a lot of messages, the parameters that actually changed are only marked in the
+// ChangeNotifier, which sends the notifications once per block.
+class ControllerMap {
+public:
+  static constexpr uint8_t kAllVoices = 0xff;
+  static constexpr uint16_t kNumNrpns = 1 << 14;
+  static constexpr size_t kNrpnTableSize = 64;
+  static_assert(!(kNrpnTableSize & (kNrpnTableSize - 1)));
+
+  struct Mapping {
+    const ParameterDesc *desc = nullptr;
+    uint8_t index = 0;  // voice or LFO index if applicable, voices can also use kAllVoices
+
+    constexpr bool valid() const { return desc; }
+  };
+
+  void Init(Parameters *parameters, SystemParameters *system_parameters,
+            ChangeNotifier *change_notifier);
+
+  // Restore the default mappings
+  void Reset();
+
+  // Controllers write to these parameters, e.g. the patch switcher's edit target
+  void set_parameters(Parameters *parameters) { parameters_ = parameters; }
+
+  bool Map(uint8_t control, const ParameterRef parameter, uint8_t index = kAllVoices);
+  void Unmap(uint8_t control) { controls_[control & 0x7f] = {}; }
+
+  // Returns false if there's no space left
+  bool MapNrpn(uint16_t nrpn, const ParameterRef parameter, uint8_t index = kAllVoices);
+  void UnmapNrpn(uint16_t nrpn);
+
+  const Mapping &mapping(uint8_t control) const { return controls_[control & 0x7f]; }
+  const Mapping *nrpn_mapping(uint16_t nrpn) const;
+
+  // Handle a CC message, including NRPN select and data entry.
+  // Returns true if the controller was handled.
+  bool ControlChange(uint8_t control, uint8_t value);
+
+private:
+  static constexpr uint16_t kNoNrpn = 0xffff;
+
+  struct NrpnEntry {
+    uint16_t nrpn = kNoNrpn;
+    Mapping mapping;
+  };
+
+  Parameters *parameters_ = nullptr;
+  SystemParameters *system_parameters_ = nullptr;
+  ChangeNotifier *change_notifier_ = nullptr;
+
+  Mapping controls_[128] = {};
+  NrpnEntry nrpns_[kNrpnTableSize] = {};
+
+  uint16_t nrpn_ = kNoNrpn;
+  uint8_t data_msb_ = 0;
+
+  static constexpr size_t nrpn_hash(uint16_t nrpn)
+  {
+    return (nrpn * 2654435761U) >> 16 & (kNrpnTableSize - 1);
+  }
+
+  // Returns kNrpnTableSize if not found
+  size_t FindNrpn(uint16_t nrpn) const;
+  static Mapping MakeMapping(const ParameterRef parameter, uint8_t index);
+
+  // Scale value with num_bits resolution into the parameter range and write it
+  void Apply(const Mapping &mapping, uint32_t value, unsigned num_bits);
+  static bool Write(ParameterValue parameter_value, parameter_value_type value);
+};
+
+}  // namespace pfm2sid::synth
+
+#endif  // PFM2SID_SYNTH_CONTROLLER_MAP_H_
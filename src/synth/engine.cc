@@ -23,6 +23,7 @@
 #include "engine.h"
 
 #include "misc/platform.h"
+#include "parameter_types.h"
 #include "pfm2sid_stats.h"
 #include "stm32x/stm32x_core.h"
 #include "stm32x/stm32x_debug.h"
@@ -40,30 +41,64 @@ constexpr auto typed_value<reSID::chip_model>(pfm2sid::synth::parameter_value_ty
 }
 }  // namespace detail
 
-void Engine::Init(Parameters *parameters)
+void Engine::Init(Parameters *parameters, const SystemParameters *system_parameters)
 {
   parameters_ = parameters;
-  sid_instance_.Init(parameters_->get<GLOBAL::CHIP_MODEL, reSID::chip_model>());
+  system_parameters_ = system_parameters;
+  update_mod_substeps();
+  for (auto &sid_instance : sid_instances_)
+    sid_instance.Init(parameters_->get<GLOBAL::CHIP_MODEL, reSID::chip_model>(),
+                      system_parameters_->get<SYSTEM::SID_CLOCK, sidbits::SID_CLOCK>());
 }
 
 void Engine::Reset()
 {
-  sid_instance_.Reset();
+  for (auto &sid_instance : sid_instances_) sid_instance.Reset();
 }
 
-void Engine::SystemParameterChanged(SYSTEM parameter)
+void Engine::ParametersChanged(const ChangeSet &changes)
 {
-  (void)parameter;
+  if (changes.test(SYSTEM::MOD_SMOOTHING)) update_mod_substeps();
+  if (changes.test(SYSTEM::SID_CLOCK)) {
+    for (auto &sid_instance : sid_instances_)
+      sid_instance.set_clock(system_parameters_->get<SYSTEM::SID_CLOCK, sidbits::SID_CLOCK>());
+  }
+  if (changes.test(GLOBAL::CHIP_MODEL)) {
+    for (auto &sid_instance : sid_instances_)
+      sid_instance.set_chip_model(parameters_->get<GLOBAL::CHIP_MODEL, reSID::chip_model>());
+  }
 }
 
-void Engine::GlobalParameterChanged(GLOBAL parameter)
+void Engine::set_degrade(uint8_t degrade)
 {
-  if (GLOBAL::CHIP_MODEL == parameter) {
-    sid_instance_.set_chip_model(parameters_->get<GLOBAL::CHIP_MODEL, reSID::chip_model>());
+  if ((degrade ^ degrade_) & Governor::DEGRADE_EXTERNAL_FILTER) {
+    for (auto &sid_instance : sid_instances_)
+      sid_instance.enable_external_filter(!(degrade & Governor::DEGRADE_EXTERNAL_FILTER));
   }
+  max_chips_ = (degrade & Governor::DEGRADE_SECONDARY_SIDS) ? 1 : kNumSIDs;
+  degrade_ = degrade;
+  // Instances that aren't clocked start from scratch when they come back
+  for (unsigned chip = max_chips_; chip < kNumSIDs; ++chip) sid_instances_[chip].Reset();
 }
 
 static reSID::output_sample_t render_buffer[kSampleBlockSize] INCCMZ;
+static int32_t mix_buffer[kSampleBlockSize] INCCMZ;
+
+// Worst case is every ramp target changing both bytes on every step
+static sidbits::RegisterWriteList<sidbits::RegisterRamps::kNumTargets * 2 * 16> ramp_writes INCCMZ;
+
+// A single instance's raw output is scaled to the DAC range; multiple instances are summed at the
+// same level so adding (or dropping) one doesn't change the level of the others.
+static constexpr int32_t kOutputShift = 2;
+
+template <typename T>
+static void WriteBlock(SampleBuffer::MutableBlock block, const T *src, int32_t shift)
+{
+  for (auto &dst : block) {
+    auto s = static_cast<int32_t>(*src++) >> shift;
+    dst.left = dst.right = __SSAT(s, 18);
+  }
+}
 
 // NOTE
 // With an incorrect clock_delta_t value, the single call to clock(...) doesn't return
@@ -71,18 +106,74 @@ static reSID::output_sample_t render_buffer[kSampleBlockSize] INCCMZ;
 // using ceil to calculate the factor also "seems to work". There's probably also a way to calculate
 // the error and work around it that way (the sample tracking internally is a 16.16 value).
 
-void Engine::RenderBlock(SampleBuffer::MutableBlock block, const sidbits::RegisterMap &register_map)
+void Engine::RenderChip(unsigned chip, const sidbits::RegisterMap &register_map,
+                        const sidbits::RegisterRamps *register_ramps,
+                        const sidbits::BlockRegisterWrites *register_writes)
 {
+  ramp_writes.clear();
+  if (register_ramps && mod_substeps_ > 1 && !(degrade_ & Governor::DEGRADE_MOD_SMOOTHING))
+    register_ramps->Interpolate(mod_substeps_, kSampleBlockSize, ramp_writes);
+
+  if (!ramp_writes.empty() || (register_writes && !register_writes->empty())) {
+    if (register_writes) {
+      sid_instances_[chip].Render(render_buffer, kSampleBlockSize, register_map,
+                                  ramp_writes.begin(), ramp_writes.end(), register_writes->begin(),
+                                  register_writes->end());
+    } else {
+      sid_instances_[chip].Render(render_buffer, kSampleBlockSize, register_map,
+                                  ramp_writes.begin(), ramp_writes.end());
+    }
+  } else {
+    sid_instances_[chip].Render(render_buffer, kSampleBlockSize, register_map);
+  }
+}
+
+void Engine::RenderBlock(SampleBuffer::MutableBlock block,
+                         const sidbits::RegisterMap *register_maps,
+                         const sidbits::RegisterRamps *register_ramps,
+                         const sidbits::BlockRegisterWrites *register_writes, uint32_t chip_mask)
+{
+  chip_mask &= first_chips(max_chips_);
+
+  if (!chip_mask) {
+    for (auto &dst : block) dst.left = dst.right = 0;
+    return;
+  }
+
+  if (!(chip_mask & (chip_mask - 1))) {
+    const auto chip = static_cast<unsigned>(__builtin_ctz(chip_mask));
+    {
+      stm32x::ScopedCycleMeasurement scm{stats::sid_clock_cycles};
+      RenderChip(chip, register_maps[chip], register_ramps ? register_ramps + chip : nullptr,
+                 register_writes ? register_writes + chip : nullptr);
+    }
+    WriteBlock(block, render_buffer, kOutputShift);
+    return;
+  }
+
   {
     stm32x::ScopedCycleMeasurement scm{stats::sid_clock_cycles};
-    sid_instance_.Render(render_buffer, kSampleBlockSize, register_map);
+    for (auto &m : mix_buffer) m = 0;
+    while (chip_mask) {
+      const auto chip = static_cast<unsigned>(__builtin_ctz(chip_mask));
+      chip_mask &= chip_mask - 1;
+      RenderChip(chip, register_maps[chip], register_ramps ? register_ramps + chip : nullptr,
+                 register_writes ? register_writes + chip : nullptr);
+      for (unsigned i = 0; i < kSampleBlockSize; ++i) mix_buffer[i] += render_buffer[i];
+    }
   }
 
-  auto src = render_buffer;
-  for (auto &dst : block) {
-    auto s = *src++ >> 2;
-    dst.left = dst.right = __SSAT(s, 18);
+  WriteBlock(block, mix_buffer, kOutputShift);
+}
+
+void Engine::RenderBlock(SampleBuffer::MutableBlock block, const sidbits::RegisterMap &register_map,
+                         uint32_t dirty_mask)
+{
+  {
+    stm32x::ScopedCycleMeasurement scm{stats::sid_clock_cycles};
+    sid_instances_[0].Render(render_buffer, kSampleBlockSize, register_map, dirty_mask);
   }
+  WriteBlock(block, render_buffer, kOutputShift);
 }
 
 }  // namespace pfm2sid::synth
@@ -23,6 +23,7 @@
 #ifndef PFM2SID_ENGINE_H_
 #define PFM2SID_ENGINE_H_
 
+#include "synth/governor.h"
 #include "synth/parameter_listener.h"
 #include "synth/parameter_structs.h"
 #include "synth/sid_instance.h"
@@ -33,29 +34,77 @@ namespace pfm2sid::synth {
 
 // Obligatory abstraction of sound generation. Engine? Processor? Generator?
 //
-// For now it's just a wrapper around a SID instance, and the actual "fun" happens in a wrapper
-// (ASID player, synth, etc.) that can set a suitable register map...
+// For now it's just a wrapper around kNumSIDs SID instances, and the actual "fun" happens in a
+// wrapper (ASID player, synth, etc.) that can set suitable register maps...
 //
 class Engine : public ParameterListener {
 public:
   Engine() = default;
   DELETE_COPY_MOVE(Engine);
 
-  void Init(Parameters *parameters);
+  void Init(Parameters *parameters, const SystemParameters *system_parameters);
   void Reset();
 
-  void RenderBlock(SampleBuffer::MutableBlock block, const sidbits::RegisterMap &register_map);
+  // Set the instance to the registers immediately, e.g. after seeking in a stream
+  void RestoreState(unsigned chip, const sidbits::RegisterMap &register_map)
+  {
+    sid_instances_[chip].RestoreState(register_map);
+  }
 
-  const sidbits::RegisterMap &register_map() const { return sid_instance_.register_map(); }
+  // Render the instances in chip_mask, one register map each, and mix them. Each instance is
+  // mixed at the same level as a single one, and the sum saturates. The other instances aren't
+  // clocked, and neither are the ones above max_chips. If register_ramps is set, the ramps for
+  // each chip are interpolated within the block (if enabled). Timestamped register_writes are
+  // applied at their offset.
+  void RenderBlock(SampleBuffer::MutableBlock block, const sidbits::RegisterMap *register_maps,
+                   const sidbits::RegisterRamps *register_ramps,
+                   const sidbits::BlockRegisterWrites *register_writes, uint32_t chip_mask);
 
-  // parameter hooks
-  void SystemParameterChanged(SYSTEM parameter) final;
-  void GlobalParameterChanged(GLOBAL parameter) final;
+  static_assert(kNumSIDs < 32);
+  static constexpr uint32_t first_chips(unsigned num_chips) { return (1U << num_chips) - 1; }
+
+  void RenderBlock(SampleBuffer::MutableBlock block, const sidbits::RegisterMap &register_map)
+  {
+    RenderBlock(block, &register_map, nullptr, nullptr, first_chips(1));
+  }
+
+  // Render a single instance, but only write the registers in dirty_mask. This requires the map
+  // to have been fully written once since the last Reset.
+  void RenderBlock(SampleBuffer::MutableBlock block, const sidbits::RegisterMap &register_map,
+                   uint32_t dirty_mask);
+
+  const sidbits::RegisterMap &register_map(unsigned chip = 0) const
+  {
+    return sid_instances_[chip].register_map();
+  }
+
+  auto clock_delta_t() const { return sid_instances_[0].clock_delta_t(); }
+
+  // Apply the Governor::DEGRADE flags
+  void set_degrade(uint8_t degrade);
+  uint8_t degrade() const { return degrade_; }
+  unsigned max_chips() const { return max_chips_; }
+
+  void ParametersChanged(const ChangeSet &changes) final;
 
 protected:
   Parameters *parameters_ = nullptr;
+  const SystemParameters *system_parameters_ = nullptr;
+
+  unsigned mod_substeps_ = 1;
+  uint8_t degrade_ = Governor::DEGRADE_NONE;
+  unsigned max_chips_ = kNumSIDs;
+
+  void update_mod_substeps()
+  {
+    mod_substeps_ = 1U << system_parameters_->get<SYSTEM::MOD_SMOOTHING>().value();
+  }
+
+  SIDInstance sid_instances_[kNumSIDs];
 
-  SIDInstance sid_instance_;
+  void RenderChip(unsigned chip, const sidbits::RegisterMap &register_map,
+                  const sidbits::RegisterRamps *register_ramps,
+                  const sidbits::BlockRegisterWrites *register_writes);
 };
 
 }  // namespace pfm2sid::synth
@@ -0,0 +1,184 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_SYNTH_GOVERNOR_H_
+#define PFM2SID_SYNTH_GOVERNOR_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "synth/synth.h"
+
+namespace pfm2sid::synth {
+
+// Render load governor. Multiple SID instances (or a busy patch) can need more time per block than
+// there is, and the result is an underrun. Instead, the governor steps through levels of reduced
+// quality while the load is high, and back again once there's headroom.
+//
+// The load is a short moving average of the render cycles per block. Above kHighLoadPercent of the
+// budget, the next level is applied; the average then gets kSettleBlocks to reflect it before
+// the next step. Below kLowLoadPercent for long enough, the previous level is restored. If that
+// overloads again shortly after, the wait before the next attempt is doubled so a load that's just
+// on the edge doesn't bounce between levels.
+//
+class Governor {
+public:
+  enum DEGRADE : uint8_t {
+    DEGRADE_NONE = 0,
+    DEGRADE_MOD_SMOOTHING = 0x01,    // Register ramps aren't interpolated within the block
+    DEGRADE_EXTERNAL_FILTER = 0x02,  // reSID's external filter is bypassed
+    DEGRADE_SECONDARY_SIDS = 0x04,   // Only the first instance is rendered
+  };
+
+  // Each level includes the previous ones, least audible first. Level 0 is always DEGRADE_NONE.
+  static constexpr uint8_t kDefaultLevels[] = {
+      DEGRADE_MOD_SMOOTHING,
+      DEGRADE_MOD_SMOOTHING | DEGRADE_EXTERNAL_FILTER,
+      DEGRADE_MOD_SMOOTHING | DEGRADE_EXTERNAL_FILTER | DEGRADE_SECONDARY_SIDS,
+  };
+  static constexpr size_t kMaxLevels = 8;
+
+  static constexpr uint32_t kHighLoadPercent = 90;
+  static constexpr uint32_t kLowLoadPercent = 70;
+
+  static constexpr uint32_t kBlocksPerSecond = kDacUpdateRateHz / kSampleBlockSize;
+  static constexpr uint32_t kSettleBlocks = 16;
+  static constexpr uint32_t kRecoverBlocks = kBlocksPerSecond;
+  static constexpr uint32_t kMaxRecoverBlocks = 16 * kBlocksPerSecond;
+  // Overloads within this time after stepping up count against that step
+  static constexpr uint32_t kRetryBlocks = kBlocksPerSecond;
+  static_assert(kSettleBlocks < kRetryBlocks);
+
+  struct Stats {
+    uint32_t downgrades = 0;
+    uint32_t upgrades = 0;
+    unsigned max_level = 0;
+  };
+
+  Governor() { set_levels(kDefaultLevels); }
+
+  // Budget is the available cycles per block
+  void Init(uint32_t budget_cycles)
+  {
+    high_load_ = static_cast<int32_t>(budget_cycles / 100 * kHighLoadPercent);
+    low_load_ = static_cast<int32_t>(budget_cycles / 100 * kLowLoadPercent);
+    budget_cycles_ = budget_cycles;
+    Reset();
+  }
+
+  void Reset()
+  {
+    level_ = 0;
+    load_ = 0;
+    blocks_ = headroom_blocks_ = 0;
+    recover_blocks_ = kRecoverBlocks;
+    stepped_up_ = false;
+    stats_ = {};
+  }
+
+  template <size_t N>
+  void set_levels(const uint8_t (&levels)[N])
+  {
+    static_assert(N < kMaxLevels);
+    levels_[0] = DEGRADE_NONE;
+    std::copy(levels, levels + N, levels_ + 1);
+    num_levels_ = N + 1;
+    Reset();
+  }
+
+  // Returns true if the level changed
+  bool Update(uint32_t block_cycles)
+  {
+    load_ += (static_cast<int32_t>(block_cycles) - load_) >> kAverageShift;
+    blocks_ = std::min(blocks_ + 1, kRetryBlocks);
+    if (blocks_ < kSettleBlocks) return false;
+
+    if (load_ > high_load_) {
+      headroom_blocks_ = 0;
+      if (level_ + 1 >= num_levels_) return false;
+      if (stepped_up_ && blocks_ < kRetryBlocks)
+        recover_blocks_ = std::min(recover_blocks_ * 2, kMaxRecoverBlocks);
+      else
+        recover_blocks_ = kRecoverBlocks;
+      set_level(level_ + 1);
+      stepped_up_ = false;
+      ++stats_.downgrades;
+      stats_.max_level = std::max(stats_.max_level, level_);
+      return true;
+    }
+
+    if (load_ < low_load_ && level_) {
+      if (++headroom_blocks_ < recover_blocks_) return false;
+      set_level(level_ - 1);
+      stepped_up_ = true;
+      ++stats_.upgrades;
+      return true;
+    }
+
+    headroom_blocks_ = 0;
+    return false;
+  }
+
+  unsigned level() const { return level_; }
+  unsigned num_levels() const { return num_levels_; }
+  uint8_t degrade() const { return levels_[level_]; }
+
+  // Averaged load in cycles per block, and in % of the budget
+  uint32_t load() const { return static_cast<uint32_t>(load_); }
+  uint32_t load_percent() const
+  {
+    return budget_cycles_ ? static_cast<uint32_t>(load_) * 100 / budget_cycles_ : 0;
+  }
+
+  const Stats &stats() const { return stats_; }
+
+private:
+  // Average over ~4 blocks, which is also all the slack the sample buffer has
+  static constexpr int32_t kAverageShift = 2;
+
+  uint8_t levels_[kMaxLevels] = {};
+  unsigned num_levels_ = 1;
+
+  uint32_t budget_cycles_ = 0;
+  int32_t high_load_ = 0;
+  int32_t low_load_ = 0;
+
+  unsigned level_ = 0;
+  int32_t load_ = 0;
+  uint32_t blocks_ = 0;  // Since the last change, up to kRetryBlocks
+  uint32_t headroom_blocks_ = 0;
+  uint32_t recover_blocks_ = kRecoverBlocks;
+  bool stepped_up_ = false;
+
+  Stats stats_;
+
+  void set_level(unsigned level)
+  {
+    level_ = level;
+    blocks_ = headroom_blocks_ = 0;
+  }
+};
+
+}  // namespace pfm2sid::synth
+
+#endif  // PFM2SID_SYNTH_GOVERNOR_H_
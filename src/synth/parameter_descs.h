@@ -0,0 +1,273 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_SYNTH_PARAMETER_DESCS_H_
+#define PFM2SID_SYNTH_PARAMETER_DESCS_H_
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+#include "modulation.h"
+#include "parameters.h"
+#include "ui/status_icons.h"
+#include "util/util_macros.h"
+#include "wavetable.h"
+
+// TODO Centralize the min/max range definitions
+
+namespace pfm2sid::synth {
+
+class ParameterRef {
+public:
+  const PARAMETER_SCOPE type;
+  union {
+    const SYSTEM system_param;
+    const GLOBAL global_param;
+    const VOICE voice_param;
+    const LFO lfo_param;
+  };
+  constexpr ParameterRef() : type{PARAMETER_SCOPE::NONE}, global_param{GLOBAL::LAST} {}
+
+  template <typename T>
+  constexpr ParameterRef(T t);
+
+  constexpr bool is_system() const { return PARAMETER_SCOPE::SYSTEM == type; }
+  constexpr bool is_global() const { return PARAMETER_SCOPE::GLOBAL == type; }
+  constexpr bool is_voice() const { return PARAMETER_SCOPE::VOICE == type; }
+  constexpr bool is_lfo() const { return PARAMETER_SCOPE::LFO == type; }
+};
+
+template <>
+constexpr ParameterRef::ParameterRef(SYSTEM p) : type{PARAMETER_SCOPE::SYSTEM}, system_param{p}
+{}
+template <>
+constexpr ParameterRef::ParameterRef(GLOBAL p) : type{PARAMETER_SCOPE::GLOBAL}, global_param{p}
+{}
+template <>
+constexpr ParameterRef::ParameterRef(VOICE p) : type{PARAMETER_SCOPE::VOICE}, voice_param{p}
+{}
+template <>
+constexpr ParameterRef::ParameterRef(LFO p) : type{PARAMETER_SCOPE::LFO}, lfo_param{p}
+{}
+
+// We're just editing everything as an "int" (or eventually as a float) and always keep the stored
+// value within the correct range. This simplifies some things, but does require a mapping later to
+// "native" values (i.e. in this case, SID registers). There also needs to be a MIDI CC -> parameter
+// mapping of some kind.
+//
+// I seem to re-use this pattern a lot, perhaps it's time to find a better model...
+enum struct FORMATTER { DEFAULT, ZEROISOFF };
+struct ParameterDesc {
+  const char name[5] = {0};
+  const parameter_value_type min_value = 0;
+  const parameter_value_type max_value = 0;
+  const ParameterRef parameter;
+  const parameter_value_type default_value = 0;
+  const char *const *label_strings = nullptr;
+  const FORMATTER formatter = FORMATTER::DEFAULT;
+
+  constexpr auto clamp(parameter_value_type value) const
+  {
+    return std::clamp(value, min_value, max_value);
+  }
+
+  ParameterDesc() = delete;
+  DELETE_COPY_MOVE(ParameterDesc);
+
+  // For parameters only known at runtime; parameter_desc<> resolves at compile time
+  static constexpr const ParameterDesc *Find(const ParameterRef parameter);
+};
+
+namespace detail {
+
+inline constexpr const char *BOOL_STR[2] = {"off", "ON"};
+
+#define W_P "\005"
+#define W_S "\004"
+#define W_T "\003"
+
+// NOTE sort order differs from enum!
+inline constexpr const char *OSC_WAVE_STR[] = {
+    "off",         W_T " TRI",       W_S " SAW", W_P "PULS", "& " W_P "_" W_T, "& " W_P W_S "_",
+    "& _" W_S W_T, "& " W_P W_S W_T, "NOIS",
+};
+
+#undef W_P
+#undef W_S
+#undef W_T
+
+inline constexpr const char *CHIP_MODEL_STR[] = {"6581", "8580"};
+
+inline constexpr const char *FILTER_MODE_STR[] = {"off", "LP", "BP", "HP", "NTCH"};
+
+inline constexpr const char *LFO_SHAPE_STR[] = {"TRI", "SAW", "SQUA", "SINE", "RAMP", "RAND"};
+
+inline constexpr const char *LFO_SYNC_STR[] = {"none", "note"};
+
+inline constexpr const char *VOICE_MODE_STR[] = {"poly", "unis"};
+
+inline constexpr const char *MOD_SMOOTHING_STR[] = {"off", "x2", "x4", "x8", "x16"};
+
+inline constexpr const char *SID_CLOCK_STR[] = {"PAL", "NTSC"};
+
+inline constexpr const char *MOD_SRC_STR[] = {"none", "LFO1", "LFO2", "LFO3", "BEND"};
+static_assert(ARRAY_SIZE(MOD_SRC_STR) == kNumModulationSrc);
+
+inline constexpr const char *WAVETABLE_STR[] = {"off", "TBL1", "TBL2", "TBL3", "TBL4", "TBL5"};
+static_assert(ARRAY_SIZE(WAVETABLE_STR) == kNumWaveTables + 1);
+
+inline constexpr ParameterDesc none_parameter_desc = {"NONE", 0, 0, {}};
+
+inline constexpr ParameterDesc system_parameter_descs[] = {
+    {"CHAN", 1, 16, SYSTEM::MIDI_CHANNEL, 1},
+    {"SMTH", 0, 4, SYSTEM::MOD_SMOOTHING, 2, MOD_SMOOTHING_STR},
+    {"CLCK", 0, 1, SYSTEM::SID_CLOCK, 0, SID_CLOCK_STR},
+    {"ALAT", 0, 100, SYSTEM::ASID_LATENCY, 20, nullptr, FORMATTER::ZEROISOFF},
+    {"ADPT", 1, 16, SYSTEM::ASID_DEPTH, 8},
+};
+
+inline constexpr ParameterDesc global_parameter_descs[] = {
+    {"CHIP", 0, 1, GLOBAL::CHIP_MODEL, 0, CHIP_MODEL_STR},
+    {"MODE", 0, 4, GLOBAL::FILTER_MODE, 1, FILTER_MODE_STR},
+    {"FREQ", 0, 1024, GLOBAL::FILTER_FREQ, 512},
+    {"RES", 0, 15, GLOBAL::FILTER_RES, 0, nullptr, FORMATTER::ZEROISOFF},
+    {"VOI1", 0, 1, GLOBAL::FILTER_VOICE1_ENABLE, 0, BOOL_STR},
+    {"VOI2", 0, 1, GLOBAL::FILTER_VOICE2_ENABLE, 0, BOOL_STR},
+    {"VOI3", 0, 1, GLOBAL::FILTER_VOICE3_ENABLE, 0, BOOL_STR},
+    {"3OFF", 0, 1, GLOBAL::FILTER_3OFF, 0, BOOL_STR},
+    {"TRAK", -64, 63, GLOBAL::FILTER_KEY_TRACKING, 0, nullptr, FORMATTER::ZEROISOFF},
+    {"NOTE", 0, 1, GLOBAL::FILTER_KEY_TRACK_NOTE},
+    {RIGHT_ARROW_STR "frq", 0, util::enum_count<MOD_SRC>() - 1, GLOBAL::FILTER_FREQ_MOD_SRC, 0,
+     MOD_SRC_STR},
+    {"Dpth", kModDepthMin, kModDepthMax, GLOBAL::FILTER_FREQ_MOD_DEPTH},
+    {RIGHT_ARROW_STR "res", 0, util::enum_count<MOD_SRC>() - 1, GLOBAL::FILTER_RES_MOD_SRC, 0,
+     MOD_SRC_STR},
+    {"Dpth", kModDepthMin, kModDepthMax, GLOBAL::FILTER_RES_MOD_DEPTH},
+    {"VOL", 0, 15, GLOBAL::VOLUME, 15},
+    {"VOIC", 0, 1, GLOBAL::VOICE_MODE, 0, VOICE_MODE_STR},
+};
+
+inline constexpr ParameterDesc voice_parameter_descs[] = {
+    {"OCT", -3, 3, VOICE::TUNE_OCTAVE},
+    {"SEMI", -11, 11, VOICE::TUNE_SEMITONE},
+    {"FINE", -128, 127, VOICE::TUNE_FINE},
+    {"GLID", 0, 127, VOICE::GLIDE_RATE, 0, nullptr, FORMATTER::ZEROISOFF},
+    {"WAVE", 0, static_cast<int32_t>(sidbits::OSC_WAVE::NOISE) >> 4, VOICE::OSC_WAVE, 2,
+     OSC_WAVE_STR},
+    {"PWM", 0, 4095, VOICE::OSC_PWM, 2048},
+    {"RING", 0, 1, VOICE::OSC_RING, 0, BOOL_STR},
+    {"SYNC", 0, 1, VOICE::OSC_SYNC, 0, BOOL_STR},
+    {"ATT", 0, 15, VOICE::ENV_A, 0},
+    {"DEC", 0, 15, VOICE::ENV_D, 0},
+    {"SUS", 0, 15, VOICE::ENV_S, 15},
+    {"REL", 0, 15, VOICE::ENV_R, 9},
+    {RIGHT_ARROW_STR "frq", 0, util::enum_count<MOD_SRC>() - 1, VOICE::FREQ_MOD_SRC, 0,
+     MOD_SRC_STR},
+    {"Dpth", kModDepthMin, kModDepthMax, VOICE::FREQ_MOD_DEPTH},
+    {RIGHT_ARROW_STR "PWM", 0, util::enum_count<MOD_SRC>() - 1, VOICE::PWM_MOD_SRC, 0, MOD_SRC_STR},
+    {"Dpth", kModDepthMin, kModDepthMax, VOICE::PWM_MOD_DEPTH},
+    {"WTBL", 0, kNumWaveTables, VOICE::WAVETABLE_IDX, 0, WAVETABLE_STR},
+    {"RATE", WaveTableScanner::kRateMin, WaveTableScanner::kRateMax, VOICE::WAVETABLE_RATE, 63},
+};
+
+inline constexpr ParameterDesc lfo_parameter_descs[] = {
+    {"RATE", 0, 127, LFO::RATE, 63},      {"SHAP", 0, 5, LFO::SHAPE, 0, LFO_SHAPE_STR},
+    {"PHA", 0, 127, LFO::PHASE, 0},       {"SYNC", 0, 1, LFO::SYNC, 0, LFO_SYNC_STR},
+    {"ABS", 0, 1, LFO::ABS, 0, BOOL_STR},
+};
+
+static_assert(ARRAY_SIZE(system_parameter_descs) == kNumSystemParameters);
+static_assert(ARRAY_SIZE(global_parameter_descs) == kNumGlobalParameters);
+static_assert(ARRAY_SIZE(voice_parameter_descs) == kNumVoiceParameters);
+static_assert(ARRAY_SIZE(lfo_parameter_descs) == kNumLfoParameters);
+
+// Values are stored as parameter_storage_type, so all ranges have to fit
+template <size_t N>
+constexpr bool descs_fit_storage(const ParameterDesc (&descs)[N])
+{
+  for (auto &desc : descs) {
+    if (desc.min_value < std::numeric_limits<parameter_storage_type>::min() ||
+        desc.max_value > std::numeric_limits<parameter_storage_type>::max())
+      return false;
+  }
+  return true;
+}
+
+static_assert(descs_fit_storage(system_parameter_descs));
+static_assert(descs_fit_storage(global_parameter_descs));
+static_assert(descs_fit_storage(voice_parameter_descs));
+static_assert(descs_fit_storage(lfo_parameter_descs));
+
+template <typename parameter_enum>
+constexpr const ParameterDesc *parameter_descs();
+
+template <>
+constexpr const ParameterDesc *parameter_descs<SYSTEM>()
+{
+  return system_parameter_descs;
+}
+template <>
+constexpr const ParameterDesc *parameter_descs<GLOBAL>()
+{
+  return global_parameter_descs;
+}
+template <>
+constexpr const ParameterDesc *parameter_descs<VOICE>()
+{
+  return voice_parameter_descs;
+}
+template <>
+constexpr const ParameterDesc *parameter_descs<LFO>()
+{
+  return lfo_parameter_descs;
+}
+
+}  // namespace detail
+
+template <auto parameter>
+constexpr const ParameterDesc &parameter_desc()
+{
+  static_assert(parameter < decltype(parameter)::LAST);
+  return detail::parameter_descs<decltype(parameter)>()[util::enum_to_i(parameter)];
+}
+
+/*static*/
+constexpr const ParameterDesc *ParameterDesc::Find(const ParameterRef parameter)
+{
+  switch (parameter.type) {
+    case PARAMETER_SCOPE::SYSTEM:
+      return &detail::system_parameter_descs[util::enum_to_i(parameter.system_param)];
+    case PARAMETER_SCOPE::GLOBAL:
+      return &detail::global_parameter_descs[util::enum_to_i(parameter.global_param)];
+    case PARAMETER_SCOPE::VOICE:
+      return &detail::voice_parameter_descs[util::enum_to_i(parameter.voice_param)];
+    case PARAMETER_SCOPE::LFO:
+      return &detail::lfo_parameter_descs[util::enum_to_i(parameter.lfo_param)];
+    case PARAMETER_SCOPE::NONE: break;
+  }
+  return &detail::none_parameter_desc;
+}
+
+}  // namespace pfm2sid::synth
+
+#endif  // PFM2SID_SYNTH_PARAMETER_DESCS_H_
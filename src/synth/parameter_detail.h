@@ -24,57 +24,36 @@
 #define PFM2SID_SYNTH_PARAMETER_DETAIL_H_
 
 #include <array>
-#include <utility>
 
-#include "util/util_macros.h"
+#include "parameter_descs.h"
 #include "util/util_templates.h"
 
 namespace pfm2sid::synth {
 
-class ParameterValue;
-class ParameterRef;
-
 namespace detail {
 
-// Building ParameterValue arrays, or arrays of arrays
-template <typename parameter_enum, size_t... Is>
-constexpr auto build_parameter_array_impl(std::index_sequence<Is...>)
-{
-  return std::array<ParameterValue, sizeof...(Is)>{
-      ParameterRef{static_cast<parameter_enum>(Is)}...};
-}
-
+// Default values for all parameters of an enum, or N arrays of them
 template <typename parameter_enum>
-constexpr auto build_parameter_array([[maybe_unused]] size_t i = 0)
-{
-  return build_parameter_array_impl<parameter_enum>(
-      std::make_index_sequence<util::enum_count<parameter_enum>()>());
-}
-
-template <typename parameter_enum, size_t... Is>
-constexpr auto build_parameter_arrays_impl(std::index_sequence<Is...>)
-    -> std::array<std::array<ParameterValue, util::enum_count<parameter_enum>()>, sizeof...(Is)>
+constexpr auto default_values()
 {
-  return {build_parameter_array<parameter_enum>(Is)...};
+  std::array<parameter_storage_type, util::enum_count<parameter_enum>()> values = {};
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] =
+        static_cast<parameter_storage_type>(parameter_descs<parameter_enum>()[i].default_value);
+  }
+  return values;
 }
 
 template <typename parameter_enum, size_t N>
-constexpr auto build_parameter_arrays()
-{
-  return build_parameter_arrays_impl<parameter_enum>(std::make_index_sequence<N>());
-}
-
-template <typename T>
-void ResetArray(T& arr)
+constexpr auto default_values()
 {
-  for (auto& v : arr) v.Reset();
+  std::array<decltype(default_values<parameter_enum>()), N> values = {};
+  for (auto &v : values) v = default_values<parameter_enum>();
+  return values;
 }
 
-template <typename T, size_t N>
-void ResetArrays(std::array<T, N>& arr)
-{
-  for (auto& a : arr) ResetArray(a);
-}
+// Formatting isn't performance critical so there's only one instance
+void FormatParameter(const ParameterDesc &desc, parameter_value_type value, char *buf);
 
 }  // namespace detail
 
@@ -23,18 +23,97 @@
 #ifndef PFM2SID_SYNTH_PARAMETER_LISTENER_H_
 #define PFM2SID_SYNTH_PARAMETER_LISTENER_H_
 
+#include <bitset>
+
+#include "misc/static_stack.h"
 #include "synth/parameters.h"
 
 namespace pfm2sid::synth {
 
-// In some places we need a notification when a parameter has changed.
-// This solution isn't super scaleable.
+// The parameters changed since the last notification, one dirty bit per parameter. Only system
+// and global parameters are tracked; voice and LFO parameters are read directly by the voices.
+struct ChangeSet {
+  std::bitset<kNumSystemParameters> system_parameters;
+  std::bitset<kNumGlobalParameters> global_parameters;
+  bool scale = false;
+
+  void set(SYSTEM parameter) { system_parameters.set(util::enum_to_i(parameter)); }
+  void set(GLOBAL parameter) { global_parameters.set(util::enum_to_i(parameter)); }
+
+  bool test(SYSTEM parameter) const { return system_parameters.test(util::enum_to_i(parameter)); }
+  bool test(GLOBAL parameter) const { return global_parameters.test(util::enum_to_i(parameter)); }
+
+  bool any() const { return system_parameters.any() || global_parameters.any() || scale; }
+
+  void clear()
+  {
+    system_parameters.reset();
+    global_parameters.reset();
+    scale = false;
+  }
+
+  ChangeSet &operator|=(const ChangeSet &other)
+  {
+    system_parameters |= other.system_parameters;
+    global_parameters |= other.global_parameters;
+    scale |= other.scale;
+    return *this;
+  }
+
+  template <typename F>
+  void for_each_system(F &&fn) const
+  {
+    for (parameter_enum_type p = 0; p < kNumSystemParameters; ++p) {
+      if (system_parameters[p]) fn(static_cast<SYSTEM>(p));
+    }
+  }
+
+  template <typename F>
+  void for_each_global(F &&fn) const
+  {
+    for (parameter_enum_type p = 0; p < kNumGlobalParameters; ++p) {
+      if (global_parameters[p]) fn(static_cast<GLOBAL>(p));
+    }
+  }
+};
+
+// In some places we need a notification when a parameter has changed. Listeners get all the
+// changes at once and test for the parameters they're interested in.
 class ParameterListener {
 public:
   virtual ~ParameterListener() = default;
 
-  virtual void SystemParameterChanged(SYSTEM /*parameter*/) {}
-  virtual void GlobalParameterChanged(GLOBAL /*parameter*/) {}
+  virtual void ParametersChanged(const ChangeSet &changes) = 0;
+};
+
+// Collects the changes from all the writers (editor, controllers, patch switching) and notifies
+// the listeners once per block, so a burst of changes only costs one call per listener.
+class ChangeNotifier {
+public:
+  void register_listener(ParameterListener *listener) { listeners_.push_back(listener); }
+
+  template <typename P>
+  void mark(P parameter)
+  {
+    pending_.set(parameter);
+  }
+  void mark(const ChangeSet &changes) { pending_ |= changes; }
+  void mark_scale() { pending_.scale = true; }
+
+  bool changes_pending() const { return pending_.any(); }
+
+  // Changes marked by listeners are dispatched next time
+  void Dispatch()
+  {
+    if (!pending_.any()) return;
+    const auto changes = pending_;
+    pending_.clear();
+    for (auto l : listeners_) l->ParametersChanged(changes);
+  }
+
+private:
+  ChangeSet pending_;
+  util::StaticStack<ParameterListener *, 8> listeners_;
 };
 
 }  // namespace pfm2sid::synth
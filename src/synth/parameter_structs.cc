@@ -22,21 +22,23 @@
 //
 #include "parameter_structs.h"
 
-#include <cstdio>
+#include <cstring>
+
+#include "misc/format.h"
 
 namespace pfm2sid::synth {
 
-void ParameterValue::Fmt(char* buf) const
+void detail::FormatParameter(const ParameterDesc& desc, parameter_value_type value, char* buf)
 {
-  if (desc_->parameter.type == synth::PARAMETER_SCOPE::NONE)
+  if (desc.parameter.type == synth::PARAMETER_SCOPE::NONE)
     memset(buf, ' ', 5);
-  else if (desc_->label_strings) {
-    snprintf(buf, 6, "%5s", desc_->label_strings[ivalue]);
+  else if (desc.label_strings) {
+    util::Format(buf, 5, "%5s", desc.label_strings[value]);
   } else {
-    if (desc_->formatter == FORMATTER::ZEROISOFF && ivalue == 0)
-      snprintf(buf, 6, "%5s", "off");
+    if (desc.formatter == FORMATTER::ZEROISOFF && value == 0)
+      util::Format(buf, 5, "%5s", "off");
     else
-      snprintf(buf, 6, "%5ld", (long)ivalue);
+      util::Format(buf, 5, "%5ld", (long)value);
   }
 }
 }  // namespace pfm2sid::synth
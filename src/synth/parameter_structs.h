@@ -23,107 +23,47 @@
 #ifndef PFM2SID_SYNTH_PARAMETER_STRUCTS_H_
 #define PFM2SID_SYNTH_PARAMETER_STRUCTS_H_
 
-#include <algorithm>
 #include <array>
+#include <type_traits>
 
+#include "parameter_descs.h"
 #include "parameter_detail.h"
 #include "parameters.h"
 
 namespace pfm2sid::synth {
 
-class ParameterRef {
+// Reference to a stored parameter value and its descriptor.
+// The values themselves are just dense arrays in Parameters and SystemParameters, so those are
+// trivially copyable and cheap to compare. These handles are what the accessors hand out; the
+// const variant (V = const parameter_storage_type) can't modify the value.
+template <typename V>
+class BasicParameterValue {
 public:
-  const PARAMETER_SCOPE type;
-  union {
-    const SYSTEM system_param;
-    const GLOBAL global_param;
-    const VOICE voice_param;
-    const LFO lfo_param;
-  };
-  constexpr ParameterRef() : type{PARAMETER_SCOPE::NONE}, global_param{GLOBAL::LAST} {}
-
-  template <typename T>
-  constexpr ParameterRef(T t);
-
-  constexpr bool is_system() const { return PARAMETER_SCOPE::SYSTEM == type; }
-  constexpr bool is_global() const { return PARAMETER_SCOPE::GLOBAL == type; }
-  constexpr bool is_voice() const { return PARAMETER_SCOPE::VOICE == type; }
-  constexpr bool is_lfo() const { return PARAMETER_SCOPE::LFO == type; }
-};
-
-template <>
-constexpr ParameterRef::ParameterRef(SYSTEM p) : type{PARAMETER_SCOPE::SYSTEM}, system_param{p}
-{}
-template <>
-constexpr ParameterRef::ParameterRef(GLOBAL p) : type{PARAMETER_SCOPE::GLOBAL}, global_param{p}
-{}
-template <>
-constexpr ParameterRef::ParameterRef(VOICE p) : type{PARAMETER_SCOPE::VOICE}, voice_param{p}
-{}
-template <>
-constexpr ParameterRef::ParameterRef(LFO p) : type{PARAMETER_SCOPE::LFO}, lfo_param{p}
-{}
-
-// We're just editing everything as an "int" (or eventually as a float) and always keep the stored
-// value within the correct range. This simplifies some things, but does require a mapping later to
-// "native" values (i.e. in this case, SID registers). There also needs to be a MIDI CC -> parameter
-// mapping of some kind.
-//
-// I seem to re-use this pattern a lot, perhaps it's time to find a better model...
-enum struct FORMATTER { DEFAULT, ZEROISOFF };
-struct ParameterDesc {
-  const char name[5] = {0};
-  const parameter_value_type min_value = 0;
-  const parameter_value_type max_value = 0;
-  const ParameterRef parameter;
-  const parameter_value_type default_value = 0;
-  const char* const* label_strings = nullptr;
-  const FORMATTER formatter = FORMATTER::DEFAULT;
-
-  constexpr auto clamp(parameter_value_type value) const
-  {
-    return std::clamp(value, min_value, max_value);
-  }
-
-  ParameterDesc() = delete;
-  DELETE_COPY_MOVE(ParameterDesc);
-
-  static const ParameterDesc* Find(const ParameterRef parameter);
-};
-
-// Generic parameter value storage
-// Contains a pointer to the ParameterDesc, which in turn contains a ParameterRef.
-// TODO include voice/lfo index?
-
-class ParameterValue {
-public:
-  /*constexpr*/ ParameterValue(const ParameterRef parameter_ref)
-      : desc_(ParameterDesc::Find(parameter_ref)), ivalue(desc_->default_value)
+  constexpr BasicParameterValue() = default;
+  constexpr BasicParameterValue(const ParameterDesc *desc, V *value) : desc_(desc), value_(value)
   {}
-  ParameterValue() = delete;
-  DELETE_COPY_MOVE(ParameterValue);
-  // -> This might be overkill; we want to avoid copies from ::get() type functions, but it does
-  // inhibit keeping parameters in a Patch (which might be copyable).
 
-  constexpr const char* name() const { return desc_->name; }
+  constexpr explicit operator bool() const { return value_; }
+
+  constexpr const char *name() const { return desc_->name; }
   constexpr auto ref() const { return desc_->parameter; }
   constexpr auto desc() const { return desc_; }
-  constexpr auto value() const { return ivalue; }
+  constexpr parameter_value_type value() const { return *value_; }
 
-  void Reset() { ivalue = desc_->default_value; }
+  void Reset() { set(desc_->default_value); }
 
-  ParameterValue& operator=(parameter_value_type value)
+  void set(parameter_value_type value)
   {
-    ivalue = desc_->clamp(value);
-    return *this;
+    static_assert(!std::is_const_v<V>);
+    *value_ = static_cast<parameter_storage_type>(desc_->clamp(value));
   }
 
   // For editor use
-  auto change_value(int delta)
+  bool change_value(int delta)
   {
-    auto value = desc_->clamp(ivalue + delta);
-    if (ivalue != value) {
-      ivalue = value;
+    auto value = desc_->clamp(*value_ + delta);
+    if (*value_ != value) {
+      set(value);
       return true;
     } else {
       return false;
@@ -131,7 +71,7 @@ public:
   }
 
   // Helpers for modulated values
-  auto modulate_value(int delta) const { return desc_->clamp(ivalue + delta); }
+  auto modulate_value(int delta) const { return desc_->clamp(*value_ + delta); }
 
   template <typename T>
   auto modulate_value(int delta) const
@@ -139,36 +79,41 @@ public:
     return detail::typed_value<T>(modulate_value(delta));
   }
 
-  void Fmt(char* buf) const;
+  void Fmt(char *buf) const { detail::FormatParameter(*desc_, value(), buf); }
 
 private:
-  const ParameterDesc* const desc_;
-  parameter_value_type ivalue;
+  const ParameterDesc *desc_ = nullptr;
+  V *value_ = nullptr;
 };
 
+using ParameterValue = BasicParameterValue<parameter_storage_type>;
+using ConstParameterValue = BasicParameterValue<const parameter_storage_type>;
+
 class Parameters {
 public:
   void Reset();
+  // Clamp all values to their range, e.g. after loading data from outside
+  void Clamp();
 
   template <GLOBAL parameter>
-  auto& get() const
+  auto get() const
   {
-    static_assert(parameter < GLOBAL::LAST);
-    return global_parameters_[util::enum_to_i(parameter)];
+    return ConstParameterValue{&parameter_desc<parameter>(),
+                               &global_parameters_[util::enum_to_i(parameter)]};
   }
 
   template <LFO_INDEX lfo_index, LFO parameter>
-  auto& get() const
+  auto get() const
   {
-    static_assert(parameter < LFO::LAST);
-    return lfo_parameters_[lfo_index][util::enum_to_i(parameter)];
+    return ConstParameterValue{&parameter_desc<parameter>(),
+                               &lfo_parameters_[lfo_index][util::enum_to_i(parameter)]};
   }
 
   template <auto voice_index, VOICE parameter>
-  auto& get() const
+  auto get() const
   {
-    static_assert(parameter < VOICE::LAST);
-    return voice_parameters_[voice_index][util::enum_to_i(parameter)];
+    return ConstParameterValue{&parameter_desc<parameter>(),
+                               &voice_parameters_[voice_index][util::enum_to_i(parameter)]};
   }
 
   template <auto parameter, typename T>
@@ -184,9 +129,10 @@ public:
   }
 
   template <VOICE parameter>
-  auto& get(sidbits::VOICE_INDEX voice_index) const
+  auto get(sidbits::VOICE_INDEX voice_index) const
   {
-    return voice_parameters_[voice_index][util::enum_to_i(parameter)];
+    return ConstParameterValue{&parameter_desc<parameter>(),
+                               &voice_parameters_[voice_index][util::enum_to_i(parameter)]};
   }
 
   template <VOICE parameter, typename T>
@@ -195,53 +141,76 @@ public:
     return detail::typed_value<T>(get<parameter>(voice_index).value());
   }
 
-  // These are for editor use
-  ParameterValue* mutable_value(const ParameterRef& parameter_ref)
+  // These are for editor use. The result is empty if the parameter is of the wrong scope.
+  ParameterValue mutable_value(const ParameterRef &parameter_ref)
   {
-    if (parameter_ref.is_global())
-      return &global_parameters_[util::enum_to_i(parameter_ref.global_param)];
-    return nullptr;
+    if (parameter_ref.is_global()) {
+      return {ParameterDesc::Find(parameter_ref),
+              &global_parameters_[util::enum_to_i(parameter_ref.global_param)]};
+    }
+    return {};
   }
 
-  ParameterValue* mutable_value(const ParameterRef& parameter_ref, sidbits::VOICE_INDEX voice_index)
+  ParameterValue mutable_value(const ParameterRef &parameter_ref, sidbits::VOICE_INDEX voice_index)
   {
-    return parameter_ref.is_voice()
-               ? &voice_parameters_[voice_index][util::enum_to_i(parameter_ref.voice_param)]
-               : nullptr;
+    if (parameter_ref.is_voice()) {
+      return {ParameterDesc::Find(parameter_ref),
+              &voice_parameters_[voice_index][util::enum_to_i(parameter_ref.voice_param)]};
+    }
+    return {};
   }
 
-  ParameterValue* mutable_value(const ParameterRef& parameter_ref, LFO_INDEX lfo_index)
+  ParameterValue mutable_value(const ParameterRef &parameter_ref, LFO_INDEX lfo_index)
   {
-    return parameter_ref.is_lfo()
-               ? &lfo_parameters_[lfo_index][util::enum_to_i(parameter_ref.lfo_param)]
-               : nullptr;
+    if (parameter_ref.is_lfo()) {
+      return {ParameterDesc::Find(parameter_ref),
+              &lfo_parameters_[lfo_index][util::enum_to_i(parameter_ref.lfo_param)]};
+    }
+    return {};
   }
 
-private:
-  using global_parameter_array = std::array<ParameterValue, kNumGlobalParameters>;
-  using lfo_parameter_array = std::array<ParameterValue, kNumLfoParameters>;
-  using voice_parameter_array = std::array<ParameterValue, kNumVoiceParameters>;
+  bool operator==(const Parameters &other) const
+  {
+    return global_parameters_ == other.global_parameters_ &&
+           lfo_parameters_ == other.lfo_parameters_ &&
+           voice_parameters_ == other.voice_parameters_;
+  }
+  bool operator!=(const Parameters &other) const { return !(*this == other); }
 
-  global_parameter_array global_parameters_ = detail::build_parameter_array<GLOBAL>();
+  // Mask of global parameters that differ from other
+  template <typename Mask>
+  Mask diff_global(const Parameters &other) const
+  {
+    Mask mask;
+    for (size_t i = 0; i < kNumGlobalParameters; ++i)
+      mask[i] = global_parameters_[i] != other.global_parameters_[i];
+    return mask;
+  }
 
-  std::array<lfo_parameter_array, kNumLfos> lfo_parameters_ =
-      detail::build_parameter_arrays<LFO, kNumLfos>();
+private:
+  using global_parameter_array = std::array<parameter_storage_type, kNumGlobalParameters>;
+  using lfo_parameter_array = std::array<parameter_storage_type, kNumLfoParameters>;
+  using voice_parameter_array = std::array<parameter_storage_type, kNumVoiceParameters>;
 
-  std::array<voice_parameter_array, 3> voice_parameters_ =
-      detail::build_parameter_arrays<VOICE, 3>();
+  global_parameter_array global_parameters_ = detail::default_values<GLOBAL>();
+  std::array<lfo_parameter_array, kNumLfos> lfo_parameters_ =
+      detail::default_values<LFO, kNumLfos>();
+  std::array<voice_parameter_array, 3> voice_parameters_ = detail::default_values<VOICE, 3>();
 };
 
+static_assert(std::is_trivially_copyable_v<Parameters>);
+
 class SystemParameters {
 public:
-  using system_parameter_array = std::array<ParameterValue, kNumSystemParameters>;
+  using system_parameter_array = std::array<parameter_storage_type, kNumSystemParameters>;
 
   void Reset();
 
   template <SYSTEM parameter>
-  auto& get() const
+  auto get() const
   {
-    static_assert(parameter < SYSTEM::LAST);
-    return system_parameters_[util::enum_to_i(parameter)];
+    return ConstParameterValue{&parameter_desc<parameter>(),
+                               &system_parameters_[util::enum_to_i(parameter)]};
   }
 
   template <SYSTEM parameter, typename T>
@@ -250,21 +219,17 @@ public:
     return detail::typed_value<T>(get<parameter>().value());
   }
 
-  ParameterValue* mutable_value(const ParameterRef& parameter_ref)
+  ParameterValue mutable_value(const ParameterRef &parameter_ref)
   {
-    if (parameter_ref.is_system())
-      return &system_parameters_[util::enum_to_i(parameter_ref.system_param)];
-    return nullptr;
+    if (parameter_ref.is_system()) {
+      return {ParameterDesc::Find(parameter_ref),
+              &system_parameters_[util::enum_to_i(parameter_ref.system_param)]};
+    }
+    return {};
   }
 
 private:
-  system_parameter_array system_parameters_ = detail::build_parameter_array<SYSTEM>();
-
-  template <auto parameter, typename T>
-  auto get() const
-  {
-    return detail::typed_value<T>(get<parameter>().value());
-  }
+  system_parameter_array system_parameters_ = detail::default_values<SYSTEM>();
 };
 
 }  // namespace pfm2sid::synth
@@ -24,6 +24,7 @@
 #define PFM2SID_SYNTH_PARAMETER_TYPES_H_
 
 #include "lfo.h"
+#include "modulation.h"
 #include "parameters.h"
 #include "synth.h"
 
@@ -127,6 +128,12 @@ constexpr auto typed_value<MOD_SRC>(parameter_value_type value)
   return static_cast<MOD_SRC>(value);
 }
 
+template <>
+constexpr auto typed_value<sidbits::SID_CLOCK>(parameter_value_type value)
+{
+  return value ? sidbits::SID_CLOCK::NTSC : sidbits::SID_CLOCK::PAL;
+}
+
 }  // namespace detail
 }  // namespace pfm2sid::synth
 
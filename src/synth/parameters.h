@@ -31,6 +31,8 @@ namespace pfm2sid::synth {
 
 using parameter_enum_type = unsigned;
 using parameter_value_type = int32_t;
+// Values are stored more compactly, all the parameter ranges fit
+using parameter_storage_type = int16_t;
 
 enum struct PARAMETER_SCOPE { NONE, SYSTEM, GLOBAL, VOICE, LFO };
 
@@ -46,7 +48,14 @@ enum struct PARAMETER_SCOPE { NONE, SYSTEM, GLOBAL, VOICE, LFO };
 //
 // TODO The basic question eventually becomes, why the enums at all?
 
-enum struct SYSTEM : parameter_enum_type { MIDI_CHANNEL, LAST };
+enum struct SYSTEM : parameter_enum_type {
+  MIDI_CHANNEL,
+  MOD_SMOOTHING,
+  SID_CLOCK,
+  ASID_LATENCY,  // ms, 0 = frames are applied immediately
+  ASID_DEPTH,    // frames
+  LAST
+};
 
 enum struct GLOBAL : parameter_enum_type {
   CHIP_MODEL,
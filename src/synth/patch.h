@@ -23,7 +23,10 @@
 #ifndef PFM2SID_SYNTH_PATCH_H_
 #define PFM2SID_SYNTH_PATCH_H_
 
+#include <type_traits>
+
 #include "synth/parameter_structs.h"
+#include "synth/tuning.h"
 
 namespace pfm2sid::synth {
 
@@ -34,13 +37,27 @@ public:
   int number() const { return number_; }
   const char *name() const { return name_; }
 
+  void set_number(int number) { number_ = number; }
+
+  // Make sure data from outside (e.g. a sysex transfer) is usable
+  void Sanitize()
+  {
+    name_[sizeof(name_) - 1] = 0;
+    parameters.Clamp();
+    if (!scale.valid() || !(scale.reference_freq > 0.f)) scale = Scale{};
+  }
+
   Parameters parameters;
+  Scale scale;
 
 private:
   char name_[20] = {0};
   int number_ = 0;
 };
 
+// Patches are plain data so they can be copied around (or stored) as they are
+static_assert(std::is_trivially_copyable_v<Patch>);
+
 }  // namespace pfm2sid::synth
 
 #endif  // PFM2SID_SYNTH_PATCH_H_
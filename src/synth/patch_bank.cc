@@ -0,0 +1,284 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "patch_bank.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include "misc/crc32.h"
+#include "misc/platform.h"
+
+ENABLE_WCONVERSION()
+
+namespace pfm2sid::synth {
+
+namespace {
+
+constexpr uint32_t kSectorMagic = 0x4b4e4250;  // "PBNK"
+constexpr uint32_t kRecordMagic = 0x54415050;  // "PPAT"
+constexpr uint32_t kRecordCommitted = 0x54494d43;  // "CMIT"
+
+uint32_t RecordCrc(uint8_t slot, uint8_t version, uint16_t size, const void *patch)
+{
+  const uint8_t header[] = {slot, version, static_cast<uint8_t>(size),
+                            static_cast<uint8_t>(size >> 8)};
+  return util::Crc32(patch, size, util::Crc32(header, sizeof(header)));
+}
+
+}  // namespace
+
+bool PatchBank::Init(util::FlashStorage *storage)
+{
+  storage_ = storage;
+  if (Scan() && MakeRoom()) return true;
+
+  storage_ = nullptr;
+  index_ = {};
+  return false;
+}
+
+bool PatchBank::Scan()
+{
+  num_sectors_ = storage_->num_sectors();
+  sectors_ = {};
+  index_ = {};
+  head_ = kMaxSectors;
+  head_offset_ = 0;
+  sequence_ = kNoSequence;
+  stats_ = {};
+
+  // There has to be a spare sector, and the live records of all slots (plus an interrupted one)
+  // have to fit into a single sector for Collect to work.
+  if (num_sectors_ < 2 || num_sectors_ > kMaxSectors) return false;
+  if ((storage_->sector_size() - sizeof(SectorHeader)) / kRecordSize < kNumSlots + 2) return false;
+
+  std::array<size_t, kMaxSectors> order = {};
+  size_t num_used = 0;
+  uint32_t max_erase_count = 0;
+  for (size_t s = 0; s < num_sectors_; ++s) {
+    auto header = reinterpret_cast<const SectorHeader *>(storage_->sector(s));
+    if (kSectorMagic == header->magic && kNoSequence != header->sequence) {
+      sectors_[s] = {header->sequence, header->erase_count};
+      max_erase_count = std::max(max_erase_count, header->erase_count);
+      order[num_used++] = s;
+    } else if (!blank(s, 0, storage_->sector_size())) {
+      // Interrupted erase or sector start
+      if (!storage_->Erase(s)) return false;
+    }
+  }
+  for (size_t s = 0; s < num_sectors_; ++s) {
+    if (kNoSequence == sectors_[s].sequence) sectors_[s].erase_count = max_erase_count;
+  }
+
+  std::sort(order.begin(), order.begin() + num_used,
+            [this](size_t a, size_t b) { return sectors_[a].sequence < sectors_[b].sequence; });
+  for (size_t i = 0; i < num_used; ++i) {
+    head_ = order[i];
+    head_offset_ = ScanSector(head_);
+    sequence_ = sectors_[head_].sequence;
+  }
+  return true;
+}
+
+const Patch *PatchBank::Find(size_t slot) const
+{
+  if (slot >= kNumSlots || !index_[slot]) return nullptr;
+  return reinterpret_cast<const Patch *>(index_[slot] + 1);
+}
+
+bool PatchBank::Load(size_t slot, Patch &patch) const
+{
+  auto stored = Find(slot);
+  if (stored) patch = *stored;
+  return stored;
+}
+
+bool PatchBank::Save(size_t slot, const Patch &patch)
+{
+  if (!storage_ || slot >= kNumSlots) return false;
+  // Append only fails without a write if there's unexpected data in the head sector
+  for (int retry = 0; retry < 2; ++retry) {
+    if (!MakeRoom()) return false;
+    if (Append(slot, patch)) return true;
+  }
+  return false;
+}
+
+bool PatchBank::blank(size_t sector, size_t offset, size_t len) const
+{
+  auto data = storage_->sector(sector) + offset;
+  return std::all_of(data, data + len,
+                     [](uint8_t value) { return util::FlashStorage::kErasedValue == value; });
+}
+
+bool PatchBank::head_full() const
+{
+  return head_ >= num_sectors_ || head_offset_ + kRecordSize > storage_->sector_size();
+}
+
+size_t PatchBank::FindSpare() const
+{
+  size_t spare = kMaxSectors;
+  for (size_t s = 0; s < num_sectors_; ++s) {
+    if (kNoSequence == sectors_[s].sequence &&
+        (kMaxSectors == spare || sectors_[s].erase_count < sectors_[spare].erase_count)) {
+      spare = s;
+    }
+  }
+  return spare;
+}
+
+bool PatchBank::IsSlotIn(size_t slot, size_t sector) const
+{
+  auto record = reinterpret_cast<const uint8_t *>(index_[slot]);
+  auto data = storage_->sector(sector);
+  return record && record >= data && record < data + storage_->sector_size();
+}
+
+bool PatchBank::IsValid(const RecordHeader *record) const
+{
+  return kRecordCommitted == record->commit && kPatchVersion == record->version &&
+         sizeof(Patch) == record->size && record->slot < kNumSlots &&
+         RecordCrc(record->slot, record->version, record->size, record + 1) == record->crc;
+}
+
+// Returns the offset after the last record
+size_t PatchBank::ScanSector(size_t sector)
+{
+  auto data = storage_->sector(sector);
+  auto sector_size = storage_->sector_size();
+  size_t offset = sizeof(SectorHeader);
+  while (offset + sizeof(RecordHeader) <= sector_size) {
+    auto record = reinterpret_cast<const RecordHeader *>(data + offset);
+    size_t size = kRecordSize;
+    if (kRecordMagic == record->magic) {
+      // Records of other versions may have a different size
+      size = sizeof(RecordHeader) + record->size;
+      if (record->size % util::FlashStorage::kProgramAlignment || offset + size > sector_size)
+        return sector_size;
+      if (IsValid(record)) {
+        index_[record->slot] = record;
+        ++stats_.records;
+      } else {
+        ++stats_.invalid;
+      }
+    } else if (blank(sector, offset, sizeof(RecordHeader))) {
+      break;
+    } else {
+      ++stats_.invalid;  // interrupted while writing the header
+    }
+    offset += size;
+  }
+  return offset;
+}
+
+bool PatchBank::StartSector(size_t sector)
+{
+  SectorHeader header = {sequence_ + 1, sectors_[sector].erase_count, kSectorMagic};
+  if (!storage_->Program(sector, 0, &header, offsetof(SectorHeader, magic)) ||
+      !storage_->Program(sector, offsetof(SectorHeader, magic), &header.magic,
+                         sizeof(header.magic)))
+    return false;
+
+  sectors_[sector].sequence = ++sequence_;
+  head_ = sector;
+  head_offset_ = sizeof(SectorHeader);
+  return true;
+}
+
+bool PatchBank::EraseSector(size_t sector)
+{
+  if (!storage_->Erase(sector)) return false;
+  sectors_[sector].sequence = kNoSequence;
+  ++sectors_[sector].erase_count;
+  ++stats_.erases;
+  return true;
+}
+
+bool PatchBank::Append(size_t slot, const Patch &patch)
+{
+  if (head_full()) return false;
+  auto offset = head_offset_;
+  if (!blank(head_, offset, kRecordSize)) {
+    head_offset_ = storage_->sector_size();
+    return false;
+  }
+  // The space is used even if the write fails
+  head_offset_ += kRecordSize;
+
+  RecordHeader header;
+  memset(&header, util::FlashStorage::kErasedValue, sizeof(header));
+  header.slot = static_cast<uint8_t>(slot);
+  header.version = kPatchVersion;
+  header.size = sizeof(Patch);
+  header.crc = RecordCrc(header.slot, header.version, header.size, &patch);
+  header.magic = kRecordMagic;
+  if (!storage_->Program(head_, offset, &header, offsetof(RecordHeader, magic)) ||
+      !storage_->Program(head_, offset + offsetof(RecordHeader, magic), &header.magic,
+                         sizeof(header.magic)) ||
+      !storage_->Program(head_, offset + sizeof(RecordHeader), &patch, sizeof(Patch)))
+    return false;
+
+  header.commit = kRecordCommitted;
+  if (!storage_->Program(head_, offset + offsetof(RecordHeader, commit), &header.commit,
+                         sizeof(header.commit)))
+    return false;
+
+  index_[slot] = reinterpret_cast<const RecordHeader *>(storage_->sector(head_) + offset);
+  return true;
+}
+
+// Copy the live records of the oldest sector to the head and erase it
+bool PatchBank::Collect()
+{
+  size_t oldest = kMaxSectors;
+  for (size_t s = 0; s < num_sectors_; ++s) {
+    if (kNoSequence == sectors_[s].sequence || s == head_) continue;
+    if (kMaxSectors == oldest || sectors_[s].sequence < sectors_[oldest].sequence) oldest = s;
+  }
+  if (kMaxSectors == oldest) return false;
+
+  for (size_t slot = 0; slot < kNumSlots; ++slot) {
+    if (IsSlotIn(slot, oldest) && !Append(slot, *Find(slot))) return false;
+  }
+  return EraseSector(oldest);
+}
+
+// Make sure there's space for a record in the head, and a spare sector to continue with
+bool PatchBank::MakeRoom()
+{
+  for (size_t i = 0; i <= num_sectors_; ++i) {
+    auto spare = FindSpare();
+    if (kMaxSectors == spare) {
+      if (!Collect()) return false;
+    } else if (head_full()) {
+      if (!StartSector(spare)) return false;
+    } else {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace pfm2sid::synth
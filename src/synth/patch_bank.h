@@ -0,0 +1,142 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_SYNTH_PATCH_BANK_H_
+#define PFM2SID_SYNTH_PATCH_BANK_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "misc/flash_storage.h"
+#include "patch.h"
+
+namespace pfm2sid::synth {
+
+// Patch storage as an append-only log in flash.
+//
+// Saving a patch appends a record to the current (head) sector, so nothing is ever overwritten in
+// place. The RAM index of the latest record for each slot is built once in Init by replaying the
+// sectors in order. Loading reads the patch directly from the mapped flash.
+//
+// Sectors are used as a ring: when the head is full the spare (erased) sector becomes the new
+// head, and the live records of the oldest sector are copied into it before it's erased to be the
+// next spare. This spreads the erases evenly across the sectors.
+//
+// Power loss: a record is only valid once its commit word, which is written last, is set and the
+// CRC matches. A collected sector is only erased after its live records have been copied, and a
+// partially erased or started sector is erased again in Init. So after an interruption each slot
+// has either the previous or the new patch.
+//
+// Erasing a sector stalls the flash (and therefore the CPU) for a while, so saving can glitch the
+// audio when the head sector is full.
+class PatchBank {
+public:
+  static constexpr size_t kNumSlots = 128;
+  static constexpr size_t kMaxSectors = 8;
+  // Records of other versions are ignored, so this has to change with the layout of Patch
+  static constexpr uint8_t kPatchVersion = 2;
+
+  struct Stats {
+    uint32_t records = 0;  // committed records found in Init
+    uint32_t invalid = 0;  // uncommitted or corrupt records found in Init
+    uint32_t erases = 0;   // since Init
+  };
+
+  // Scans the storage, and completes any interrupted sector change. Returns false if the storage
+  // can't be used.
+  bool Init(util::FlashStorage *storage);
+
+  // Returns the patch in flash, or nullptr if the slot is empty
+  const Patch *Find(size_t slot) const;
+
+  // Returns false if the slot is empty
+  bool Load(size_t slot, Patch &patch) const;
+
+  bool Save(size_t slot, const Patch &patch);
+
+  // Erase count of each sector. This isn't known for sectors that were erased at boot, so it's
+  // approximated with the maximum of the others.
+  uint32_t erase_count(size_t sector) const { return sectors_[sector].erase_count; }
+
+  const Stats &stats() const { return stats_; }
+
+private:
+  // The magic numbers are written last, so a header with a valid magic is complete
+  struct SectorHeader {
+    uint32_t sequence;
+    uint32_t erase_count;
+    uint32_t magic;
+  };
+
+  struct RecordHeader {
+    uint8_t slot;
+    uint8_t version;
+    uint16_t size;
+    uint32_t crc;
+    uint32_t magic;
+    uint32_t commit;  // written after the patch
+  };
+
+  static_assert(!(sizeof(SectorHeader) % util::FlashStorage::kProgramAlignment));
+  static_assert(!(sizeof(RecordHeader) % util::FlashStorage::kProgramAlignment));
+  static_assert(!(sizeof(Patch) % util::FlashStorage::kProgramAlignment));
+  static_assert(alignof(Patch) <= util::FlashStorage::kProgramAlignment);
+
+  static constexpr size_t kRecordSize = sizeof(RecordHeader) + sizeof(Patch);
+
+  static constexpr uint32_t kNoSequence = 0;  // sector is erased
+
+  struct SectorState {
+    uint32_t sequence = kNoSequence;
+    uint32_t erase_count = 0;
+  };
+
+  util::FlashStorage *storage_ = nullptr;
+  size_t num_sectors_ = 0;
+  std::array<SectorState, kMaxSectors> sectors_ = {};
+  std::array<const RecordHeader *, kNumSlots> index_ = {};
+
+  size_t head_ = kMaxSectors;
+  size_t head_offset_ = 0;
+  uint32_t sequence_ = kNoSequence;
+
+  Stats stats_;
+
+  bool blank(size_t sector, size_t offset, size_t len) const;
+  bool head_full() const;
+  size_t FindSpare() const;
+  bool IsSlotIn(size_t slot, size_t sector) const;
+  bool IsValid(const RecordHeader *record) const;
+
+  bool Scan();
+  size_t ScanSector(size_t sector);
+  bool StartSector(size_t sector);
+  bool EraseSector(size_t sector);
+  bool Append(size_t slot, const Patch &patch);
+  bool Collect();
+  bool MakeRoom();
+};
+
+}  // namespace pfm2sid::synth
+
+#endif  // PFM2SID_SYNTH_PATCH_BANK_H_
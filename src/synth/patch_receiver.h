@@ -0,0 +1,84 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_SYNTH_PATCH_RECEIVER_H_
+#define PFM2SID_SYNTH_PATCH_RECEIVER_H_
+
+#include <algorithm>
+#include <cstring>
+
+#include "midi/sysex_transfer.h"
+#include "patch_bank.h"
+
+namespace pfm2sid::synth {
+
+// Receive patches via sysex into the patch bank. The data is the Patch as it's stored, and a bank
+// is a sequence of patches starting at the slot. Each patch is decoded directly into a Patch and
+// saved as soon as it's complete.
+class PatchReceiver : public midi::SysexTransfer::Sink {
+public:
+  using TYPE = midi::SysexTransfer::TYPE;
+
+  void Init(PatchBank *patch_bank) { patch_bank_ = patch_bank; }
+
+  bool Begin(TYPE type, uint8_t slot, uint8_t version, size_t size) final
+  {
+    const auto num_patches = size / sizeof(Patch);
+    if (PatchBank::kPatchVersion != version || size % sizeof(Patch) || !num_patches) return false;
+    if (TYPE::PATCH == type && num_patches != 1) return false;
+    if (slot + num_patches > PatchBank::kNumSlots) return false;
+
+    slot_ = slot;
+    len_ = 0;
+    return true;
+  }
+
+  bool Write(size_t /*offset*/, const uint8_t *data, size_t len) final
+  {
+    while (len) {
+      const auto n = std::min(len, sizeof(Patch) - len_);
+      memcpy(reinterpret_cast<uint8_t *>(&patch_) + len_, data, n);
+      data += n;
+      len -= n;
+      len_ += n;
+      if (sizeof(Patch) == len_) {
+        patch_.Sanitize();
+        patch_.set_number(slot_);
+        if (!patch_bank_->Save(slot_++, patch_)) return false;
+        len_ = 0;
+      }
+    }
+    return true;
+  }
+
+  bool End(bool ok) final { return ok; }
+
+private:
+  PatchBank *patch_bank_ = nullptr;
+  Patch patch_;
+  uint8_t slot_ = 0;
+  size_t len_ = 0;
+};
+
+}  // namespace pfm2sid::synth
+
+#endif  // PFM2SID_SYNTH_PATCH_RECEIVER_H_
@@ -0,0 +1,88 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_SYNTH_PATCH_SWITCHER_H_
+#define PFM2SID_SYNTH_PATCH_SWITCHER_H_
+
+#include <utility>
+
+#include "parameter_listener.h"
+#include "patch.h"
+
+namespace pfm2sid::synth {
+
+// Double-buffered patch switching.
+//
+// The next patch is prepared in the shadow buffer (e.g. on program change) and only swapped in by
+// Apply, which is called at a block boundary. So the synth never sees a partially loaded patch,
+// and everything that changed is marked at once in the ChangeNotifier. Only the last commit before
+// Apply is used.
+//
+// Edits that arrive between Commit and Apply, e.g. a CC following a program change in the same
+// block, have to go to edit_target(). Otherwise they'd be made to the outgoing patch and lost in
+// the swap.
+//
+// After the swap the shadow buffer contains the previous patch.
+class PatchSwitcher {
+public:
+  void Init(Patch *current, ChangeNotifier *change_notifier)
+  {
+    current_ = current;
+    change_notifier_ = change_notifier;
+  }
+
+  Patch &shadow() { return shadow_; }
+  const Patch &current() const { return *current_; }
+
+  // The patch that will be current after the next Apply
+  Patch &edit_target() { return pending_ ? shadow_ : *current_; }
+
+  // The shadow buffer is ready to be swapped in
+  void Commit() { pending_ = true; }
+  bool pending() const { return pending_; }
+
+  // Returns true if a patch was swapped in
+  bool Apply()
+  {
+    if (!pending_) return false;
+    pending_ = false;
+
+    ChangeSet changes;
+    changes.global_parameters =
+        current_->parameters.diff_global<decltype(changes.global_parameters)>(shadow_.parameters);
+    changes.scale = current_->scale != shadow_.scale;
+
+    std::swap(*current_, shadow_);
+    change_notifier_->mark(changes);
+    return true;
+  }
+
+private:
+  Patch *current_ = nullptr;
+  ChangeNotifier *change_notifier_ = nullptr;
+  Patch shadow_;
+  bool pending_ = false;
+};
+
+}  // namespace pfm2sid::synth
+
+#endif  // PFM2SID_SYNTH_PATCH_SWITCHER_H_
@@ -24,9 +24,9 @@
 
 namespace pfm2sid::synth {
 
-void SIDInstance::Init(reSID::chip_model chip_model)
+void SIDInstance::Init(reSID::chip_model chip_model, sidbits::SID_CLOCK sid_clock)
 {
-  sid_.set_sampling_parameters(sidbits::CLOCK_FREQ_PAL, reSID::SAMPLE_FAST, kDacUpdateRateHz);
+  set_clock(sid_clock);
   sid_.set_chip_model(chip_model);
 }
 
@@ -36,10 +36,61 @@ void SIDInstance::Reset()
   sid_.reset();
 }
 
+// Clocking through all the frames since the last keyframe would be too slow, so approximate the
+// state: gated voices are at their sustain level, the others have been released. Otherwise the
+// gated voices would restart their attack.
+void SIDInstance::RestoreState(const sidbits::RegisterMap &register_map)
+{
+  using sidbits::RegisterMap;
+
+  sid_.reset();
+  for (reSID::reg8 r = 0; r < register_map.kNumRegisters; ++r) sid_.write(r, register_map.peek(r));
+  cached_registers_ = register_map;
+
+  auto state = sid_.read_state();
+  for (unsigned voice = 0; voice < sidbits::SID_VOICE_COUNT; ++voice) {
+    auto control = register_map.peek(RegisterMap::voice_register(
+        static_cast<sidbits::VOICE_INDEX>(voice), RegisterMap::VOICE_CONTROL));
+    if (!(control & RegisterMap::VOICE_CONTROL_GATE)) continue;
+
+    auto sr = register_map.peek(RegisterMap::voice_register(
+        static_cast<sidbits::VOICE_INDEX>(voice), RegisterMap::VOICE_ENV_SR));
+    reSID::reg8 level = static_cast<reSID::reg8>((sr >> 4) * 0x11);
+    state.envelope_state[voice] = reSID::EnvelopeGenerator::DECAY_SUSTAIN;
+    state.envelope_counter[voice] = level;
+    state.rate_counter[voice] = 0;
+    state.exponential_counter[voice] = 0;
+    // \sa EnvelopeGenerator::clock
+    state.exponential_counter_period[voice] = level > 93   ? 1
+                                              : level > 54 ? 2
+                                              : level > 26 ? 4
+                                              : level > 14 ? 8
+                                              : level > 6  ? 16
+                                              : level      ? 30
+                                                           : 1;
+    state.hold_zero[voice] = !level;
+  }
+  sid_.write_state(state);
+
+  // The rate period is still the attack rate; writing AD in the new state fixes that
+  for (unsigned voice = 0; voice < sidbits::SID_VOICE_COUNT; ++voice) {
+    auto r = RegisterMap::voice_register(static_cast<sidbits::VOICE_INDEX>(voice),
+                                         RegisterMap::VOICE_ENV_AD);
+    sid_.write(r, register_map.peek(r));
+  }
+}
+
 void SIDInstance::set_chip_model(reSID::chip_model chip_model)
 {
   sid_.set_chip_model(chip_model);
   Reset();
 }
 
+void SIDInstance::set_clock(sidbits::SID_CLOCK sid_clock)
+{
+  sid_.set_sampling_parameters(sidbits::clock_freq(sid_clock), reSID::SAMPLE_FAST,
+                               kDacUpdateRateHz);
+  clock_delta_t_ = calc_clock_delta_t(sid_clock);
+}
+
 }  // namespace pfm2sid::synth
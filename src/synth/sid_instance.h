@@ -26,6 +26,7 @@
 #include <cmath>
 
 #include "sid.h"
+#include "sidbits/register_writes.h"
 #include "sidbits/sidbits.h"
 #include "synth/synth.h"
 
@@ -34,25 +35,69 @@ namespace pfm2sid::synth {
 class SIDInstance {
 public:
   // \sa RenderBlock
-  static constexpr reSID::cycle_count clock_delta_t =
-      ceilf(sidbits::CLOCK_FREQ_PAL / (float)kDacUpdateRateHz * (float)kSampleBlockSize);
+  static constexpr reSID::cycle_count calc_clock_delta_t(sidbits::SID_CLOCK sid_clock)
+  {
+    return static_cast<reSID::cycle_count>(ceilf(sidbits::clock_freq(sid_clock) /
+                                                 (float)kDacUpdateRateHz * (float)kSampleBlockSize));
+  }
 
-  void Init(reSID::chip_model chip_model);
+  void Init(reSID::chip_model chip_model, sidbits::SID_CLOCK sid_clock);
   void Reset();
 
+  // Jump straight to the registers, with the envelopes where they'd have settled
+  void RestoreState(const sidbits::RegisterMap &register_map);
+
   const auto &register_map() const { return cached_registers_; }
   void set_chip_model(reSID::chip_model chip_model);
+  void set_clock(sidbits::SID_CLOCK sid_clock);
+  void enable_external_filter(bool enable) { sid_.enable_external_filter(enable); }
+
+  auto clock_delta_t() const { return clock_delta_t_; }
 
   inline void Render(reSID::output_sample_t *dst, int n, const sidbits::RegisterMap &register_map)
   {
     WriteRegisterMap(register_map);
-    auto delta_t = clock_delta_t;
+    auto delta_t = clock_delta_t_;
     sid_.clock(delta_t, dst, n, 1);
   }
 
+  // Same as above, but only write the registers flagged in dirty_mask
+  inline void Render(reSID::output_sample_t *dst, int n, const sidbits::RegisterMap &register_map,
+                     uint32_t dirty_mask)
+  {
+    while (dirty_mask) {
+      auto r = static_cast<reSID::reg8>(__builtin_ctz(dirty_mask));
+      dirty_mask &= dirty_mask - 1;
+      WriteRegister(r, register_map.peek(r));
+    }
+    auto delta_t = clock_delta_t_;
+    sid_.clock(delta_t, dst, n, 1);
+  }
+
+  // Same as above, but apply timestamped writes within the block. The register map is written
+  // first, so writes at offset 0 override it. The two sorted lists are merged by offset, with
+  // writes from the first list going first if offsets are the same.
+  inline void Render(reSID::output_sample_t *dst, int n, const sidbits::RegisterMap &register_map,
+                     const sidbits::RegisterWrite *a, const sidbits::RegisterWrite *a_end,
+                     const sidbits::RegisterWrite *b = nullptr,
+                     const sidbits::RegisterWrite *b_end = nullptr)
+  {
+    WriteRegisterMap(register_map);
+    auto delta_t = clock_delta_t_;
+    int pos = 0;
+    while (a != a_end || b != b_end) {
+      auto write = (b == b_end || (a != a_end && a->offset <= b->offset)) ? a++ : b++;
+      int offset = write->offset < n ? write->offset : n;
+      if (offset > pos) pos += sid_.clock(delta_t, dst + pos, offset - pos, 1);
+      WriteRegister(write->reg, write->value);
+    }
+    if (pos < n) sid_.clock(delta_t, dst + pos, n - pos, 1);
+  }
+
 private:
   sidbits::RegisterMap cached_registers_;
   reSID::SID sid_;
+  reSID::cycle_count clock_delta_t_ = calc_clock_delta_t(sidbits::SID_CLOCK::PAL);
 
   void WriteRegisterMap(const sidbits::RegisterMap &register_map)
   {
@@ -24,7 +24,6 @@
 
 #include "misc/platform.h"
 #include "parameter_types.h"
-#include "stm32x/stm32x_debug.h"
 
 ENABLE_WCONVERSION()
 
@@ -34,9 +33,10 @@ void SIDSynth::Init(Parameters *parameters)
 {
   parameters_ = parameters;
 
-  voices_[0].Init(sidbits::VOICE1, parameters);
-  voices_[1].Init(sidbits::VOICE2, parameters);
-  voices_[2].Init(sidbits::VOICE3, parameters);
+  for (unsigned i = 0; i < kVoiceCount; ++i)
+    voices_[i].Init(static_cast<sidbits::VOICE_INDEX>(i % kVoicesPerChip), parameters,
+                    &tuning_table_);
+  SetTuning(Scale{}, tuning_table_.sid_clock());
 
   for (auto &lfo : lfo_) lfo.Init(0, 0.f);
 
@@ -47,12 +47,16 @@ void SIDSynth::Init(Parameters *parameters)
 
 void SIDSynth::Reset()
 {
-  register_map_.Reset();
+  for (auto &register_map : register_maps_) register_map.Reset();
 
   for (auto &v : voices_) v.Reset();
   for (auto &lfo : lfo_) lfo.Reset(0.f);
 
-  filter_key_tracking_ = 0;
+  for (auto &f : filter_key_tracking_) f = 0;
+  for (auto &f : filter_freq_) f = 0;
+  for (auto &r : register_ramps_) r.clear();
+  for (auto &w : register_writes_) w.clear();
+  for (auto &i : chip_idle_updates_) i = 1;  // Flush the reset state
   pitch_bend_ = 0.f;
 
   voice_allocator_mono_.Clear();
@@ -60,14 +64,15 @@ void SIDSynth::Reset()
   played_notes_.Clear();
 }
 
-void SIDSynth::GlobalParameterChanged(GLOBAL parameter)
+void SIDSynth::ParametersChanged(const ChangeSet &changes)
 {
-  switch (parameter) {
-    case GLOBAL::VOICE_MODE:
-      SetVoiceMode(parameters_->get<GLOBAL::VOICE_MODE, VOICE_MODE>());
-      break;
-    default: break;
-  }
+  if (changes.test(GLOBAL::VOICE_MODE))
+    SetVoiceMode(parameters_->get<GLOBAL::VOICE_MODE, VOICE_MODE>());
+}
+
+void SIDSynth::SetTuning(const Scale &scale, sidbits::SID_CLOCK sid_clock)
+{
+  tuning_table_.Init(scale, sid_clock);
 }
 
 void SIDSynth::SetVoiceMode(VOICE_MODE voice_mode, bool force /*= false*/)
@@ -87,6 +92,22 @@ void SIDSynth::SetVoiceMode(VOICE_MODE voice_mode, bool force /*= false*/)
   }
 }
 
+void SIDSynth::set_chip_limit(unsigned num_chips)
+{
+  if (num_chips > kNumSIDs) num_chips = kNumSIDs;
+  if (num_chips == chip_limit_) return;
+
+  voice_allocator_poly_.set_chip_limit(num_chips, [](VoiceIndex) {});
+  for (unsigned v = num_chips * kVoicesPerChip; v < kVoiceCount; ++v) {
+    if (voices_[v].active()) voices_[v].Reset();
+  }
+  // One more update to clear the gates, but no release
+  for (unsigned chip = num_chips; chip < kNumSIDs; ++chip) {
+    if (chip_idle_updates_[chip]) chip_idle_updates_[chip] = 1;
+  }
+  chip_limit_ = num_chips;
+}
+
 void SIDSynth::NoteOn([[maybe_unused]] midi::Channel channel, midi::Note note,
                       midi::Velocity velocity)
 {
@@ -96,7 +117,7 @@ void SIDSynth::NoteOn([[maybe_unused]] midi::Channel channel, midi::Note note,
   if (velocity) {
     switch (voice_mode_) {
       case VOICE_MODE::POLY: {
-        auto v = voice_allocator_poly_.NoteOn(note, velocity);
+        auto v = voice_allocator_poly_.NoteOn(note, velocity, filter_group(note));
         if (v) {
           voices_[v.value()].NoteOn(note, velocity);
           note_on = true;
@@ -105,7 +126,7 @@ void SIDSynth::NoteOn([[maybe_unused]] midi::Channel channel, midi::Note note,
       case VOICE_MODE::UNISON: {
         bool glide = voice_allocator_mono_.size() > 0;
         voice_allocator_mono_.NoteOn(note, velocity);
-        for (auto &v : voices_) v.NoteOn(note, velocity, glide);
+        for (unsigned v = 0; v < num_voices(); ++v) voices_[v].NoteOn(note, velocity, glide);
         note_on = true;
       } break;
     }
@@ -129,15 +150,21 @@ void SIDSynth::NoteOff([[maybe_unused]] midi::Channel channel, midi::Note note,
   switch (voice_mode_) {
     case VOICE_MODE::POLY: {
       auto v = voice_allocator_poly_.NoteOff(note);
-      if (v) voices_[v.value()].NoteOff(note);
+      if (v) {
+        voices_[v.value()].NoteOff(note);
+        ReleaseVoice(v.value());
+      }
     } break;
     case VOICE_MODE::UNISON: {
       for (auto &v : voices_) v.NoteOff(note);
       voice_allocator_mono_.NoteOff(note);
-      if (voice_allocator_mono_.size()) {
+      if (!voice_allocator_mono_.size()) {
+        for (unsigned v = 0; v < kVoiceCount; ++v) ReleaseVoice(v);
+      } else {
         auto active_note = voice_allocator_mono_.active_note();
         played_notes_.NoteOn(active_note.note, active_note.velocity);
-        for (auto &v : voices_) v.NoteOn(active_note.note, active_note.velocity, true);
+        for (unsigned v = 0; v < num_voices(); ++v)
+          voices_[v].NoteOn(active_note.note, active_note.velocity, true);
         // TODO Should this resync the LFOs?
       }
     } break;
@@ -146,9 +173,12 @@ void SIDSynth::NoteOff([[maybe_unused]] midi::Channel channel, midi::Note note,
 
 void SIDSynth::AllNotesOff()
 {
-  for (auto &v : voices_) v.Reset();
+  for (unsigned v = 0; v < kVoiceCount; ++v) {
+    if (voices_[v].active()) ReleaseVoice(v);
+    voices_[v].Reset();
+  }
 
-  filter_key_tracking_ = 0;
+  for (auto &f : filter_key_tracking_) f = 0;
   pitch_bend_ = 0.f;
 
   voice_allocator_mono_.Clear();
@@ -156,22 +186,65 @@ void SIDSynth::AllNotesOff()
   played_notes_.Clear();
 }
 
+FilterGroup SIDSynth::filter_group(midi::Note note) const
+{
+  // With key tracking, the cutoff depends on the highest note on the chip, so try and keep notes in
+  // a similar range together. Otherwise all notes share the same filter settings.
+  if (parameters_->get<GLOBAL::FILTER_KEY_TRACKING>().value())
+    return static_cast<FilterGroup>(note >> 4);
+  else
+    return 0;
+}
+
+void SIDSynth::ReleaseVoice(unsigned voice)
+{
+  // One more update to clear the gate, then wait for the release to finish.
+  auto release_updates = static_cast<uint32_t>(
+      sidbits::ENV_RELEASE_MS[voices_[voice].release() & 0xf] * kModulatorUpdateRateHz / 1000.f);
+  auto chip = voice / kVoicesPerChip;
+  if (chip_idle_updates_[chip] < release_updates + 1)
+    chip_idle_updates_[chip] = release_updates + 1;
+}
+
 void SIDSynth::Update()
 {
   UpdateModulation();
 
+  active_chips_ = 0;
+  for (unsigned chip = 0; chip < kNumSIDs; ++chip) {
+    register_ramps_[chip].clear();
+    register_writes_[chip].clear();
+    bool voices_active = false;
+    for (unsigned v = 0; v < kVoicesPerChip; ++v)
+      voices_active |= voices_[chip * kVoicesPerChip + v].active();
+
+    if (voices_active || chip_idle_updates_[chip]) {
+      UpdateChip(chip);
+      active_chips_ |= 1U << chip;
+      if (!voices_active) --chip_idle_updates_[chip];
+    }
+  }
+}
+
+void SIDSynth::UpdateChip(unsigned chip)
+{
+  auto &register_map = register_maps_[chip];
+  auto &register_ramps = register_ramps_[chip];
+  auto &register_writes = register_writes_[chip];
+  auto *voices = voices_ + chip * kVoicesPerChip;
+
   auto res_mod =
       modulation_values_.get(parameters_->get<GLOBAL::FILTER_RES_MOD_SRC, MOD_SRC>(),
                              parameters_->get<GLOBAL::FILTER_RES_MOD_DEPTH>().value(), 16.f);
   auto filter_res = parameters_->get<GLOBAL::FILTER_RES>().modulate_value<nibble>(res_mod);
 
   if (VOICE_MODE::POLY == voice_mode_)
-    register_map_.filter_set_resonance_enable(
+    register_map.filter_set_resonance_enable(
         filter_res, parameters_->get<GLOBAL::FILTER_VOICE1_ENABLE, bool>(),
         parameters_->get<GLOBAL::FILTER_VOICE1_ENABLE, bool>(),
         parameters_->get<GLOBAL::FILTER_VOICE1_ENABLE, bool>());
   else
-    register_map_.filter_set_resonance_enable(
+    register_map.filter_set_resonance_enable(
         filter_res, parameters_->get<GLOBAL::FILTER_VOICE1_ENABLE, bool>(),
         parameters_->get<GLOBAL::FILTER_VOICE2_ENABLE, bool>(),
         parameters_->get<GLOBAL::FILTER_VOICE3_ENABLE, bool>());
@@ -181,22 +254,43 @@ void SIDSynth::Update()
                              parameters_->get<GLOBAL::FILTER_FREQ_MOD_DEPTH>().value(), 1024.f);
 
   // TODO This is a fairly abrupt transition
-  auto filter_key_tracking = filter_key_tracking_;
-  if (played_notes_.size()) {
-    filter_key_tracking =
-        sidbits::midi_to_filter_freq(played_notes_.sorted_notes().back(),
-                                     parameters_->get<GLOBAL::FILTER_KEY_TRACKING>().value());
-    filter_key_tracking_ = filter_key_tracking;
+  // In poly mode, the filter tracks the highest note on this chip.
+  auto filter_key_tracking = filter_key_tracking_[chip];
+  int32_t key_tracking_note = -1;
+  if (VOICE_MODE::POLY == voice_mode_) {
+    for (unsigned v = 0; v < kVoicesPerChip; ++v) {
+      if (voices[v].active() && voices[v].note() > key_tracking_note)
+        key_tracking_note = voices[v].note();
+    }
+  } else if (played_notes_.size()) {
+    key_tracking_note = played_notes_.sorted_notes().back();
+  }
+  if (key_tracking_note >= 0) {
+    filter_key_tracking = sidbits::midi_to_filter_freq(
+        key_tracking_note, parameters_->get<GLOBAL::FILTER_KEY_TRACKING>().value());
+    filter_key_tracking_[chip] = filter_key_tracking;
   }
   f_mod += filter_key_tracking;
+
+  // Wavetable filter track; with multiple voices running tables, the first one wins
+  for (unsigned v = 0; v < kVoicesPerChip; ++v) {
+    if (voices[v].filter_offset()) {
+      f_mod += voices[v].filter_offset();
+      break;
+    }
+  }
   auto ff = parameters_->get<GLOBAL::FILTER_FREQ>().modulate_value<uint16_t>(f_mod);
-  register_map_.filter_set_freq(ff);
+  register_map.filter_set_freq(ff);
+  register_ramps.set(sidbits::RAMP_TARGET::FILTER_FREQ, filter_freq_[chip], ff);
+  filter_freq_[chip] = ff;
 
-  register_map_.filter_set_mode_volume(
+  register_map.filter_set_mode_volume(
       parameters_->get<GLOBAL::FILTER_MODE, sidbits::FILTER_MODE>(),
       parameters_->get<GLOBAL::VOLUME, nibble>(), parameters_->get<GLOBAL::FILTER_3OFF, bool>());
 
-  for (auto &voice : voices_) { voice.Update(register_map_, modulation_values_); }
+  for (unsigned v = 0; v < kVoicesPerChip; ++v)
+    voices[v].Update(register_map, register_ramps, register_writes, modulation_values_);
+  register_writes.sort();
 }
 
 void SIDSynth::UpdateModulation()
@@ -24,6 +24,7 @@
 #define PFM2SID_SID_SYNTH_H_
 
 #include "midi/midi_types.h"
+#include "sidbits/register_writes.h"
 #include "sidbits/sidbits.h"
 #include "synth/lfo.h"
 #include "synth/modulation.h"
@@ -31,6 +32,7 @@
 #include "synth/parameter_structs.h"
 #include "synth/sid_voice.h"
 #include "synth/synth.h"
+#include "synth/tuning.h"
 #include "synth/voice_allocator.h"
 #include "util/util_macros.h"
 
@@ -38,7 +40,8 @@ namespace pfm2sid::synth {
 
 class SIDSynth : public ParameterListener {
 public:
-  static constexpr unsigned kVoiceCount = 3;
+  static constexpr unsigned kVoicesPerChip = sidbits::SID_VOICE_COUNT;
+  static constexpr unsigned kVoiceCount = kNumSIDs * kVoicesPerChip;
 
   SIDSynth() = default;
   DELETE_COPY_MOVE(SIDSynth);
@@ -46,12 +49,28 @@ public:
   void Init(Parameters *parameters);
   void Reset();
 
-  const auto &register_map() const { return register_map_; }
+  const auto &register_map(unsigned chip = 0) const { return register_maps_[chip]; }
+  const auto *register_maps() const { return register_maps_; }
+  const auto *register_ramps() const { return register_ramps_; }
+  const auto *register_writes() const { return register_writes_; }
 
   void Update();
 
+  // Chips that were updated in the last Update, i.e. that have active or releasing voices. The
+  // others are silent and don't need to be rendered.
+  uint32_t active_chips() const { return active_chips_; }
+
   void SetVoiceMode(VOICE_MODE voice_mode, bool force = false);
 
+  // Only play voices on the first num_chips chips, e.g. if the engine doesn't render the others.
+  // Voices on those chips are cut off, since they can't be heard anyway.
+  void set_chip_limit(unsigned num_chips);
+  unsigned chip_limit() const { return chip_limit_; }
+
+  // Rebuild the tuning table, e.g. on patch load or when the SID clock changes. This takes a few
+  // hundred us so shouldn't be called on every update.
+  void SetTuning(const Scale &scale, sidbits::SID_CLOCK sid_clock);
+
   void NoteOn(midi::Channel channel, midi::Note note, midi::Velocity velocity);
   void NoteOff(midi::Channel channel, midi::Note note, midi::Velocity velocity);
   void AllNotesOff();
@@ -60,13 +79,12 @@ public:
     if (channel == midi_channel_) pitch_bend_ = static_cast<float>(bend) / 8192.f;
   }
 
-  bool voice_active(unsigned i) { return voices_[i].active(); }
+  bool voice_active(unsigned i) const { return voices_[i].active(); }
 
   // Debug?
   auto bend() const { return pitch_bend_; }
 
-  // ParameterListener hooks
-  void GlobalParameterChanged(GLOBAL parameter) final;
+  void ParametersChanged(const ChangeSet &changes) final;
 
   void set_midi_channel(midi::Channel midi_channel)
   {
@@ -79,25 +97,42 @@ public:
 private:
   Parameters *parameters_ = nullptr;
 
-  sidbits::RegisterMap register_map_;
+  sidbits::RegisterMap register_maps_[kNumSIDs];
+  sidbits::RegisterRamps register_ramps_[kNumSIDs];
+  sidbits::BlockRegisterWrites register_writes_[kNumSIDs];
 
   midi::Channel midi_channel_ = 0;
 
   SIDVoice voices_[kVoiceCount];
+  TuningTable tuning_table_;
   Lfo lfo_[kNumLfos];
 
-  int32_t filter_key_tracking_ = 0;
+  // Voices are chip-major, so voices_[chip * kVoicesPerChip + n] is voice n on that chip
+  int32_t filter_key_tracking_[kNumSIDs] = {};
+  uint16_t filter_freq_[kNumSIDs] = {};
   float pitch_bend_ = 0.f;
   ModulationValues modulation_values_;
 
   VOICE_MODE voice_mode_ = VOICE_MODE::UNISON;
 
   VoiceAllocatorMono<8> voice_allocator_mono_;
-  VoiceAllocator<kVoiceCount, STEAL_STRATEGY::LRU> voice_allocator_poly_;
+  ChipVoiceAllocator<kNumSIDs, kVoicesPerChip, STEAL_STRATEGY::LRU> voice_allocator_poly_;
+
+  // A chip's register map only needs updating while a voice is active or releasing; this counts
+  // down the remaining updates after the last gate off.
+  uint32_t chip_idle_updates_[kNumSIDs] = {};
+  uint32_t active_chips_ = 0;
+  unsigned chip_limit_ = kNumSIDs;
 
   NoteStack<8, SORT_NOTES::YES> played_notes_;
 
   void UpdateModulation();
+  void UpdateChip(unsigned chip);
+
+  unsigned num_voices() const { return chip_limit_ * kVoicesPerChip; }
+
+  FilterGroup filter_group(midi::Note note) const;
+  void ReleaseVoice(unsigned voice);
 };
 
 }  // namespace pfm2sid::synth
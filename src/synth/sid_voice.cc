@@ -36,10 +36,12 @@
 
 namespace pfm2sid::synth {
 
-void SIDVoice::Init(sidbits::VOICE_INDEX voice_index, const Parameters *parameters)
+void SIDVoice::Init(sidbits::VOICE_INDEX voice_index, const Parameters *parameters,
+                    const TuningTable *tuning_table)
 {
   sid_voice_ = voice_index;
   parameters_ = parameters;
+  tuning_table_ = tuning_table;
 }
 
 void SIDVoice::Reset()
@@ -68,8 +70,8 @@ void SIDVoice::NoteOn(midi::Note note, midi::Velocity velocity, bool glide)
   // We'll only initialze the wavetable on note on, but change the rate later
   auto wavetable_idx = parameters_->get<VOICE::WAVETABLE_IDX>(parameter_voice_).value();
   if (wavetable_idx) {
-    wavetable_.SetSource(&wavetables[wavetable_idx - 1]);
     wavetable_.set_rate(parameters_->get<VOICE::WAVETABLE_RATE>(parameter_voice_).value());
+    wavetable_.SetSource(&wavetables[wavetable_idx - 1]);
   } else {
     wavetable_.Reset();
   }
@@ -81,13 +83,18 @@ void SIDVoice::NoteOff(midi::Note note)
   if (gate_state_ && note == note_) { gate_state_ = GATE_FALLING; }
 }
 
-void SIDVoice::Update(sidbits::RegisterMap &register_map, const ModulationValues &modulation_values)
+void SIDVoice::Update(sidbits::RegisterMap &register_map, sidbits::RegisterRamps &register_ramps,
+                      sidbits::BlockRegisterWrites &register_writes,
+                      const ModulationValues &modulation_values)
 {
   if (active()) {
-    WaveTable::Entry wte;
+    // Wavetable steps may start within the block. The state at the start of the block goes into
+    // the register map, later steps are added as timestamped writes.
+    WaveTable::Step wts;
+    WaveTableScanner::Events events;
     if (wavetable_.active()) {
       wavetable_.set_rate(parameters_->get<VOICE::WAVETABLE_RATE>(parameter_voice_).value());
-      wte = wavetable_.Update();
+      wts = wavetable_.Advance(kSampleBlockSize, events);
     }
 
     // Apply glide to the note value, then apply modulation, then get frequency
@@ -97,8 +104,6 @@ void SIDVoice::Update(sidbits::RegisterMap &register_map, const ModulationValues
     // TODO it's a bit unclear if we should add octave/transpose to the glide target?
     auto note_offset = parameters_->get<VOICE::TUNE_OCTAVE>(parameter_voice_).value() * 12 +
                        parameters_->get<VOICE::TUNE_SEMITONE>(parameter_voice_).value();
-    if (wte.is_enabled<WaveTable::TRANSPOSE>()) note_offset += wte.transpose;
-
     note.add_integral(note_offset);
 
     // note is a fixed-point value, so we need to ensure fine is compatible.
@@ -110,9 +115,14 @@ void SIDVoice::Update(sidbits::RegisterMap &register_map, const ModulationValues
 
     note.add_fractional(fine_offset << 8);
 
-    uint16_t freq = sidbits::midi_to_osc_freq_fp(note);
+    auto osc_freq = [note, tuning_table = tuning_table_](const WaveTable::Step &state) {
+      auto n = note;
+      if (state.is_enabled<WaveTable::TRANSPOSE>()) n.add_integral(state.transpose);
+      return tuning_table->osc_freq(n);
+    };
 
     auto gate_state = gate_state_;
+    const bool ramp = GATE_RISING != gate_state;
     if (GATE_RISING == gate_state) {
       register_map.voice_set_adsr(sid_voice_, adsr_.data());
       gate_state = GATE_HIGH;
@@ -121,26 +131,71 @@ void SIDVoice::Update(sidbits::RegisterMap &register_map, const ModulationValues
       note_ = midi::INVALID_NOTE;
     }
 
+    uint16_t freq = osc_freq(wts);
     register_map.voice_set_freq(sid_voice_, freq);
 
     auto pwm_mod = modulation_values.get(
         parameters_->get<VOICE::PWM_MOD_SRC, MOD_SRC>(parameter_voice_),
         parameters_->get<VOICE::PWM_MOD_DEPTH>(parameter_voice_).value(), 2048.f);
-    auto pwm = parameters_->get<VOICE::OSC_PWM>(parameter_voice_).modulate_value<uint16_t>(pwm_mod);
+    auto pwm_parameter = parameters_->get<VOICE::OSC_PWM>(parameter_voice_);
+    auto osc_pwm = [&pwm_parameter, pwm_mod](const WaveTable::Step &state) -> uint16_t {
+      if (state.is_enabled<WaveTable::PWM>())
+        return static_cast<uint16_t>(pwm_parameter.desc()->clamp(state.pwm12() + pwm_mod));
+      else
+        return pwm_parameter.modulate_value<uint16_t>(pwm_mod);
+    };
+    auto pwm = osc_pwm(wts);
     register_map.voice_set_pwm(sid_voice_, pwm);
 
-    sidbits::OSC_WAVE wave;
-    if (wte.is_enabled<WaveTable::WAVEFORM>())
-      wave = wte.waveform;
-    else
-      wave = parameters_->get<VOICE::OSC_WAVE, sidbits::OSC_WAVE>(parameter_voice_);
-
-    register_map.voice_set_control(
-        sid_voice_, wave, parameters_->get<VOICE::OSC_RING, sidbits::OSC_RING>(parameter_voice_),
-        parameters_->get<VOICE::OSC_SYNC, sidbits::OSC_SYNC>(parameter_voice_),
-        GATE_HIGH == gate_state);
+    auto ring = parameters_->get<VOICE::OSC_RING, sidbits::OSC_RING>(parameter_voice_);
+    auto sync = parameters_->get<VOICE::OSC_SYNC, sidbits::OSC_SYNC>(parameter_voice_);
+    auto wave = parameters_->get<VOICE::OSC_WAVE, sidbits::OSC_WAVE>(parameter_voice_);
+    const bool gate = GATE_HIGH == gate_state;
+    auto osc_control = [=](const WaveTable::Step &state) {
+      return sidbits::RegisterMap::encode_voice_control(
+          state.is_enabled<WaveTable::WAVEFORM>() ? state.waveform() : wave, ring, sync,
+          gate && (!state.is_enabled<WaveTable::GATE>() || state.gate()));
+    };
+    using sidbits::RegisterMap;
+    const auto freq_reg = RegisterMap::voice_register(sid_voice_, RegisterMap::VOICE_FREQ_LO);
+    const auto pwm_reg = RegisterMap::voice_register(sid_voice_, RegisterMap::VOICE_PWM_LO);
+    const auto control_reg = RegisterMap::voice_register(sid_voice_, RegisterMap::VOICE_CONTROL);
+    register_map.poke(control_reg, osc_control(wts));
+
+    for (auto &event : events) {
+      uint8_t bytes[2];
+      if (event.tracks & WaveTable::Step::track_mask<WaveTable::TRANSPOSE>()) {
+        freq = osc_freq(event.state);
+        RegisterMap::encode_voice_freq(freq, bytes);
+        register_writes.push_back(event.offset, freq_reg, bytes[0]);
+        register_writes.push_back(event.offset, freq_reg + 1, bytes[1]);
+      }
+      if (event.tracks & WaveTable::Step::track_mask<WaveTable::PWM>()) {
+        pwm = osc_pwm(event.state);
+        RegisterMap::encode_voice_pwm(pwm, bytes);
+        register_writes.push_back(event.offset, pwm_reg, bytes[0]);
+        register_writes.push_back(event.offset, pwm_reg + 1, bytes[1]);
+      }
+      if (event.tracks & (WaveTable::Step::track_mask<WaveTable::WAVEFORM>() |
+                          WaveTable::Step::track_mask<WaveTable::GATE>())) {
+        register_writes.push_back(event.offset, control_reg, osc_control(event.state));
+      }
+    }
 
+    // Ramps only make sense if the values weren't stepped by the wavetable
+    if (ramp && !events.any<WaveTable::TRANSPOSE>())
+      register_ramps.set(register_ramps.freq_target(sid_voice_), freq_, freq);
+    if (ramp && !events.any<WaveTable::PWM>())
+      register_ramps.set(register_ramps.pwm_target(sid_voice_), pwm_, pwm);
+    freq_ = freq;
+    pwm_ = pwm;
+
+    filter_offset_ = wavetable_.active() && wavetable_.state().is_enabled<WaveTable::FILTER>()
+                         ? wavetable_.state().filter_offset()
+                         : 0;
     gate_state_ = gate_state;
+  } else {
+    filter_offset_ = 0;
   }
 }
 
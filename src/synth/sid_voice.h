@@ -27,7 +27,9 @@
 #include "midi/midi_types.h"
 #include "modulation.h"
 #include "sid.h"
+#include "sidbits/register_writes.h"
 #include "sidbits/sidbits.h"
+#include "tuning.h"
 #include "util/util_macros.h"
 #include "wavetable.h"
 
@@ -42,7 +44,8 @@ public:
   SIDVoice() = default;
   DELETE_COPY_MOVE(SIDVoice);
 
-  void Init(sidbits::VOICE_INDEX voice_index, const Parameters *parameter);
+  void Init(sidbits::VOICE_INDEX voice_index, const Parameters *parameter,
+            const TuningTable *tuning_table);
 
   void Reset();
 
@@ -51,9 +54,18 @@ public:
   void NoteOn(midi::Note note, midi::Velocity velocity, bool glide = false);
   void NoteOff(midi::Note note);
 
-  void Update(sidbits::RegisterMap &register_map, const ModulationValues &modulation_values);
+  // Frequency and PWM changes are also added to register_ramps, except on a new note. Wavetable
+  // steps within the block are added to register_writes.
+  void Update(sidbits::RegisterMap &register_map, sidbits::RegisterRamps &register_ramps,
+              sidbits::BlockRegisterWrites &register_writes,
+              const ModulationValues &modulation_values);
 
   bool active() const { return note_ != 0xff; }
+  auto note() const { return note_; }
+  auto release() const { return adsr_[3]; }
+
+  // Cutoff offset from wavetable filter track
+  auto filter_offset() const { return filter_offset_; }
 
   auto sid_voice() const { return sid_voice_; }
 
@@ -62,12 +74,18 @@ private:
   sidbits::VOICE_INDEX parameter_voice_ = sidbits::VOICE1;
 
   const Parameters *parameters_ = nullptr;
+  const TuningTable *tuning_table_ = nullptr;
 
   midi::Note note_ = midi::INVALID_NOTE;
   uint8_t velocity_ = 0;
-  std::array<uint8_t, 4> adsr_;
+  std::array<uint8_t, 4> adsr_ = {};
   GATE_STATE gate_state_ = GATE_LOW;
 
+  // Values from previous update, i.e. start of the ramps
+  uint16_t freq_ = 0;
+  uint16_t pwm_ = 0;
+  int32_t filter_offset_ = 0;
+
   Glide glide_;
   WaveTableScanner wavetable_;
 };
@@ -27,8 +27,16 @@
 
 #include "sample_buffer.h"
 
+// Number of SID instances rendered by the engine. The synth spreads its voices across all of them.
+#ifndef PFM2SID_NUM_SIDS
+#define PFM2SID_NUM_SIDS 1
+#endif
+
 namespace pfm2sid::synth {
 
+static constexpr unsigned kNumSIDs = PFM2SID_NUM_SIDS;
+static_assert(kNumSIDs > 0);
+
 static constexpr uint32_t kSampleBlockSize = 32;
 static constexpr uint32_t kNumSampleBlocks = 4UL;
 static constexpr uint32_t kDacUpdateRateHz = 44100;
@@ -0,0 +1,121 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "tuning.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "misc/platform.h"
+
+ENABLE_WCONVERSION()
+
+namespace pfm2sid::synth {
+
+Scale::Scale() : num_degrees{12}
+{
+  for (unsigned i = 0; i < num_degrees; ++i) set_degree_cents(i, 100.f * static_cast<float>(i + 1));
+}
+
+bool Scale::operator==(const Scale &other) const
+{
+  return num_degrees == other.num_degrees && root_note == other.root_note &&
+         reference_note == other.reference_note && reference_freq == other.reference_freq &&
+         std::equal(degrees, degrees + num_degrees, other.degrees);
+}
+
+float Scale::note_cents(int32_t note) const
+{
+  const auto n = static_cast<int32_t>(num_degrees);
+  auto offset = note - static_cast<int32_t>(root_note);
+  auto periods = offset / n;
+  auto degree = offset % n;
+  if (degree < 0) {
+    degree += n;
+    --periods;
+  }
+  auto cents = static_cast<float>(periods) * period();
+  if (degree) cents += degree_cents(static_cast<unsigned>(degree - 1));
+  return cents;
+}
+
+float Scale::note_freq(int32_t note) const
+{
+  return reference_freq * exp2f((note_cents(note) - note_cents(reference_note)) / 1200.f);
+}
+
+void TuningTable::Init(const Scale &scale, sidbits::SID_CLOCK sid_clock)
+{
+  const float freq_to_osc = static_cast<float>(1 << 24) / sidbits::clock_freq(sid_clock);
+  static constexpr float kStep = 1.f / static_cast<float>(1 << kFractionalBits);
+
+  // One exp2f per note and the fractional steps are interpolated geometrically between them,
+  // which also handles unequal step sizes.
+  auto *dst = table_;
+  auto freq = scale.note_freq(0);
+  for (size_t note = 0; note < kNumNotes; ++note) {
+    auto next = scale.note_freq(static_cast<int32_t>(note + 1));
+    auto ratio = exp2f(log2f(next / freq) * kStep);
+    auto f = freq;
+    for (int32_t i = 0; i < (1 << kFractionalBits); ++i) {
+      auto osc = f * freq_to_osc + .5f;
+      *dst++ = osc < 65535.f ? static_cast<uint16_t>(osc) : 0xffff;
+      f *= ratio;
+    }
+    freq = next;
+  }
+  sid_clock_ = sid_clock;
+}
+
+static uint32_t read_u21(const uint8_t *data)
+{
+  return (static_cast<uint32_t>(data[0] & 0x7f) << 14) |
+         (static_cast<uint32_t>(data[1] & 0x7f) << 7) | (data[2] & 0x7f);
+}
+
+bool ParseScaleSysex(const uint8_t *data, size_t len, Scale &scale)
+{
+  static constexpr size_t kHeaderLen = 8;
+  if (!data || len < kHeaderLen || !is_scale_sysex(data)) return false;
+
+  const auto num_degrees = data[7];
+  if (!num_degrees || num_degrees > Scale::kMaxDegrees) return false;
+  if (len != kHeaderLen + num_degrees * 3U) return false;
+
+  Scale s;
+  s.root_note = data[2];
+  s.reference_note = data[3];
+  s.reference_freq = static_cast<float>(read_u21(data + 4)) / 1000.f;
+  s.num_degrees = num_degrees;
+  auto src = data + kHeaderLen;
+  for (unsigned i = 0; i < num_degrees; ++i, src += 3) {
+    const auto cents = static_cast<float>(read_u21(src)) / 100.f;
+    if (cents > Scale::kMaxDegreeCents) return false;
+    s.set_degree_cents(i, cents);
+  }
+
+  if (!s.valid() || s.reference_freq <= 0.f) return false;
+  scale = s;
+  return true;
+}
+
+}  // namespace pfm2sid::synth
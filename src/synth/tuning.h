@@ -0,0 +1,128 @@
+// pfm2sid: PreenFM2 meets SID
+//
+// Copyright (C) 2023-2024 Patrick Dowling (pld@gurkenkiste.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PFM2SID_SYNTH_TUNING_H_
+#define PFM2SID_SYNTH_TUNING_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "midi/midi_types.h"
+#include "misc/fixed_point.h"
+#include "sidbits/sidbits.h"
+
+namespace pfm2sid::synth {
+
+// Scala-style scale: the degrees are given in cents relative to the root note, the last degree is
+// the period (i.e. 1200 cents for octave-repeating scales). The keyboard mapping is linear, with
+// the root note mapped to degree 0, and the reference note tuned to the reference frequency.
+//
+// The scale is part of every patch, so the degrees are stored in 1/10 cents. That's well below the
+// resolution of the tuning table and allows periods up to 6553.5 cents.
+//
+// The defaults follow the existing note range where midi::C0 is 16.35Hz, so A=440Hz is note 81.
+struct Scale {
+  static constexpr unsigned kMaxDegrees = 64;
+  static constexpr float kDegreeUnitsPerCent = 10.f;
+  static constexpr float kMaxDegreeCents = 65535.f / kDegreeUnitsPerCent;
+
+  Scale();
+
+  uint8_t num_degrees = 0;
+  midi::Note root_note = midi::C0 + 48;
+  midi::Note reference_note = midi::C0 + 57;
+  float reference_freq = 440.f;
+  uint16_t degrees[kMaxDegrees] = {};
+
+  bool valid() const { return num_degrees > 0 && num_degrees <= kMaxDegrees && period() > 0.f; }
+
+  // Only the used degrees are compared
+  bool operator==(const Scale &other) const;
+  bool operator!=(const Scale &other) const { return !(*this == other); }
+  float period() const { return degree_cents(num_degrees - 1U); }
+
+  float degree_cents(unsigned degree) const
+  {
+    return static_cast<float>(degrees[degree]) / kDegreeUnitsPerCent;
+  }
+  // Cents are rounded to the storage resolution, and have to be in [0, kMaxDegreeCents]
+  void set_degree_cents(unsigned degree, float cents)
+  {
+    degrees[degree] = static_cast<uint16_t>(cents * kDegreeUnitsPerCent + .5f);
+  }
+
+  // Cents of the note relative to the root note
+  float note_cents(int32_t note) const;
+
+  // Absolute frequency of note in Hz
+  float note_freq(int32_t note) const;
+};
+
+// Dense lookup of fractional note -> SID oscillator frequency for notes [0, 127], so pitch is a
+// single indexed lookup per update. It has to be rebuilt when the scale or SID clock changes.
+//
+// 32 steps per semitone (in 12-TET at least) means the rounding error is < 1.6 cents, at the cost
+// of 8K. Values above the oscillator range are clamped to 0xffff.
+class TuningTable {
+public:
+  static constexpr int32_t kFractionalBits = 5;
+  static constexpr size_t kNumNotes = 128;
+  static constexpr size_t kTableSize = kNumNotes << kFractionalBits;
+
+  TuningTable() = default;
+
+  void Init(const Scale &scale, sidbits::SID_CLOCK sid_clock);
+
+  uint16_t osc_freq(util::s816 note) const
+  {
+    static constexpr int32_t kShift = 16 - kFractionalBits;
+    auto idx = (note.value() + (1 << (kShift - 1))) >> kShift;
+    if (idx < 0) return table_[0];
+    if (idx >= static_cast<int32_t>(kTableSize)) return table_[kTableSize - 1];
+    return table_[idx];
+  }
+
+  auto sid_clock() const { return sid_clock_; }
+
+private:
+  uint16_t table_[kTableSize] = {};
+  sidbits::SID_CLOCK sid_clock_ = sidbits::SID_CLOCK::PAL;
+};
+
+// Scales can be sent via sysex using the non-commercial manufacturer id:
+// [7D][01][root note][reference note][reference freq mHz x3][num degrees]([cents/100 x3]...)
+// The 3-byte values are 21 bit, MSB first.
+static constexpr uint8_t PFM2SID_SYSEX_ID = 0x7D;
+static constexpr uint8_t SYSEX_SCALE = 0x01;
+static constexpr size_t kScaleSysexMaxLen = 8 + Scale::kMaxDegrees * 3;
+
+constexpr bool is_scale_sysex(const uint8_t *data)
+{
+  return data[0] == PFM2SID_SYSEX_ID && data[1] == SYSEX_SCALE;
+}
+
+// Data excludes the leading F0. Returns false (and leaves scale unchanged) if invalid.
+bool ParseScaleSysex(const uint8_t *data, size_t len, Scale &scale);
+
+}  // namespace pfm2sid::synth
+
+#endif  // PFM2SID_SYNTH_TUNING_H_
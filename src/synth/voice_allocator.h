@@ -24,10 +24,12 @@
 #define PFM2SID_SYNTH_VOICE_ALLOCATOR_H_
 
 #include <array>
+#include <cstdint>
 #include <memory>
 #include <optional>
 
 #include "midi/midi_types.h"
+#include "misc/lru_list.h"
 #include "misc/sorted_array.h"
 #include "misc/static_stack.h"
 
@@ -134,15 +136,71 @@ private:
   }
 };
 
+namespace detail {
+template <size_t N>
+using voice_mask_t = std::conditional_t<(N <= 32), uint32_t, uint64_t>;
+
+inline unsigned ctz(uint32_t v)
+{
+  return static_cast<unsigned>(__builtin_ctz(v));
+}
+inline unsigned ctz(uint64_t v)
+{
+  return static_cast<unsigned>(__builtin_ctzll(v));
+}
+
+// Index of the first set bit at or after start, wrapping around. mask must be non-zero.
+template <typename T>
+inline unsigned find_next_set(T mask, unsigned start)
+{
+  T upper = mask & (~T{0} << start);
+  return ctz(upper ? upper : mask);
+}
+
+// Map of MIDI note -> voice
+template <size_t NUM_VOICES>
+class NoteVoiceTable {
+public:
+  static_assert(NUM_VOICES < 0xff);
+  static constexpr uint8_t kNoVoice = 0xff;
+
+  NoteVoiceTable() { clear(); }
+
+  void clear() { table_.fill(kNoVoice); }
+
+  std::optional<VoiceIndex> find(midi::Note note) const
+  {
+    if (note < table_.size() && table_[note] != kNoVoice) return table_[note];
+    return std::nullopt;
+  }
+
+  void set(midi::Note note, VoiceIndex voice) { table_[note & 0x7f] = static_cast<uint8_t>(voice); }
+  void reset(midi::Note note) { table_[note & 0x7f] = kNoVoice; }
+
+private:
+  std::array<uint8_t, 128> table_;
+};
+}  // namespace detail
+
+// Polyphonic allocation: a note that's already playing retriggers its voice, otherwise the next
+// free voice round-robin (so release tails aren't cut short), then depending on the strategy the
+// least recently used voice is stolen.
+//
+// All operations are O(1): free voices are tracked in a bitmask (round-robin is a mask + count
+// trailing zeros), notes are mapped to voices via a 128 entry table, and the LRU order is an
+// intrusive doubly-linked list.
 template <size_t NUM_VOICES, STEAL_STRATEGY strategy = STEAL_STRATEGY::NONE>
 class VoiceAllocator {
 public:
   static_assert(NUM_VOICES > 0);
+  static_assert(NUM_VOICES <= 64);
 
   void Clear()
   {
     for (auto &v : voice_pool_) v = {};
+    note_table_.clear();
     lru_.clear();
+    free_voices_ = kAllVoices;
     next_ = 0;
   }
 
@@ -151,24 +209,23 @@ public:
     // Find voice already playing requested note
     auto v = Find(note);
     if (v) {
-      lru_.erase(std::find(lru_.begin(), lru_.end(), v.value()));
       AssignVoice(v.value(), note, velocity);
       return v;
     }
 
     // Try and find free slot instead
-    v = FindFreeVoice();
-    if (v) {
-      AssignVoice(v.value(), note, velocity);
-      return v;
+    if (free_voices_) {
+      VoiceIndex voice = detail::find_next_set(free_voices_, next_);
+      AssignVoice(voice, note, velocity);
+      return voice;
     }
 
     // All voices assigned. What next depends on provided strategy
     if constexpr (STEAL_STRATEGY::NONE == strategy) {
       return std::nullopt;
     } else if constexpr (STEAL_STRATEGY::LRU == strategy) {
-      auto voice = lru_.front();
-      lru_.erase(lru_.begin());
+      VoiceIndex voice = lru_.front();
+      note_table_.reset(voice_pool_[voice].note);
       AssignVoice(voice, note, velocity);
       return voice;
     } else {
@@ -181,41 +238,220 @@ public:
     auto v = Find(note);
     if (v) {
       voice_pool_[v.value()] = {};
-      lru_.erase(std::find(lru_.begin(), lru_.end(), v.value()));
+      note_table_.reset(note);
+      lru_.erase(v.value());
+      free_voices_ |= mask_t{1} << v.value();
     }
     return v;
   }
 
-  std::optional<VoiceIndex> Find(midi::Note note) const noexcept
-  {
-    for (VoiceIndex i = 0; i < NUM_VOICES; ++i)
-      if (voice_pool_[i].note == note) return i;
-    return std::nullopt;
-  }
+  std::optional<VoiceIndex> Find(midi::Note note) const noexcept { return note_table_.find(note); }
 
 private:
+  using mask_t = detail::voice_mask_t<NUM_VOICES>;
+  static constexpr mask_t kAllVoices = ~mask_t{0} >> (sizeof(mask_t) * 8 - NUM_VOICES);
+
   std::array<Note, NUM_VOICES> voice_pool_;
-  util::StaticStack<VoiceIndex, NUM_VOICES> lru_;
-  VoiceIndex next_ = 0;
+  detail::NoteVoiceTable<NUM_VOICES> note_table_;
+  util::LruList<NUM_VOICES> lru_;
+  mask_t free_voices_ = kAllVoices;
+  unsigned next_ = 0;
+
+  void AssignVoice(VoiceIndex voice_index, midi::Note note, midi::Velocity velocity)
+  {
+    voice_pool_[voice_index] = {note, velocity};
+    note_table_.set(note, voice_index);
+    free_voices_ &= ~(mask_t{1} << voice_index);
+    next_ = voice_index < NUM_VOICES - 1 ? voice_index + 1 : 0;
+    lru_.touch(voice_index);
+  }
+
+public:
+  auto &lru() const { return lru_; }
+  auto &voices() const { return voice_pool_; }
+};
+
+template <size_t STACK_DEPTH>
+using VoiceAllocatorMono = NoteStack<STACK_DEPTH>;
+
+// Polyphonic allocation across multiple chips.
+//
+// Voices are numbered chip-major, i.e. voice = chip * VOICES_PER_CHIP + n, so the chip is just a
+// division away. Filter, resonance and volume are shared by all voices of a chip, so notes that
+// need the same filter setting should end up on the same chip. Each note is tagged with a
+// FilterGroup; an idle chip is claimed by the group of the first note that lands on it, and
+// released again when its last voice is freed.
+//
+// The order of preference is
+// 1. The voice already playing the note (retrigger)
+// 2. A free voice on a chip claimed by the same group (least loaded chip first)
+// 3. A free voice on an idle chip
+// 4. Any free voice; this shares another group's filter, but beats stealing
+// 5. Steal the least recently used voice, preferring one from the same group
+//
+// Free voices are a bitmask per chip, notes are mapped to voices via a 128 entry table, and there's
+// an intrusive LRU list of all voices plus one per group, so apart from the scan over the chips
+// everything is O(1). Groups share lists modulo kNumGroupLists, which only affects the preference
+// when stealing.
+using FilterGroup = uint8_t;
+
+template <size_t NUM_CHIPS, size_t VOICES_PER_CHIP, STEAL_STRATEGY strategy = STEAL_STRATEGY::LRU>
+class ChipVoiceAllocator {
+public:
+  static_assert(NUM_CHIPS > 0);
+  static_assert(VOICES_PER_CHIP > 0 && VOICES_PER_CHIP <= 32);
+
+  static constexpr size_t kNumChips = NUM_CHIPS;
+  static constexpr size_t kVoicesPerChip = VOICES_PER_CHIP;
+  static constexpr size_t kNumVoices = NUM_CHIPS * VOICES_PER_CHIP;
 
-  static constexpr auto next(VoiceIndex i) { return i < NUM_VOICES - 1 ? ++i : 0; }
+  static constexpr size_t kNumGroupLists = 8;
 
-  std::optional<VoiceIndex> FindFreeVoice() const
+  static constexpr size_t chip(VoiceIndex voice) { return voice / VOICES_PER_CHIP; }
+
+  void Clear()
   {
-    auto slot = next_;
-    do {
-      if (voice_pool_[slot].is_free()) return slot;
-      slot = next(slot);
-    } while (slot != next_);
+    for (auto &v : voice_pool_) v = {};
+    for (auto &c : chips_) c = {};
+    note_table_.clear();
+    lru_.clear();
+    for (auto &l : group_lru_) l.clear();
+  }
 
-    return std::nullopt;
+  [[nodiscard]] std::optional<VoiceIndex> NoteOn(midi::Note note, midi::Velocity velocity,
+                                                 FilterGroup group = 0) noexcept
+  {
+    auto v = Find(note);
+    if (v) {
+      lru_.touch(v.value());
+      group_lru(chip(v.value())).touch(v.value());
+      voice_pool_[v.value()].velocity = velocity;
+      return v;
+    }
+
+    v = FindFreeVoice(group);
+    if (v) {
+      AssignVoice(v.value(), note, velocity, group);
+      return v;
+    }
+
+    if constexpr (STEAL_STRATEGY::NONE == strategy) {
+      return std::nullopt;
+    } else if constexpr (STEAL_STRATEGY::LRU == strategy) {
+      if (lru_.empty()) return std::nullopt;
+      const auto &same_group = group_lru_[group % kNumGroupLists];
+      VoiceIndex voice = same_group.empty() ? lru_.front() : same_group.front();
+      FreeVoice(voice);
+      AssignVoice(voice, note, velocity, group);
+      return voice;
+    } else {
+      // Doh
+    }
   }
 
-  void AssignVoice(VoiceIndex voice_index, midi::Note note, midi::Velocity velocity)
+  [[nodiscard]] std::optional<VoiceIndex> NoteOff(midi::Note note) noexcept
+  {
+    auto v = Find(note);
+    if (v) FreeVoice(v.value());
+    return v;
+  }
+
+  std::optional<VoiceIndex> Find(midi::Note note) const noexcept { return note_table_.find(note); }
+
+  // Only allocate voices on the first num_chips chips. Voices on the others are freed, and
+  // release(voice) is called for each.
+  template <typename F>
+  void set_chip_limit(size_t num_chips, F &&release)
+  {
+    chip_limit_ = num_chips < kNumChips ? num_chips : kNumChips;
+    for (auto voice = static_cast<VoiceIndex>(chip_limit_ * kVoicesPerChip); voice < kNumVoices;
+         ++voice) {
+      if (!voice_pool_[voice].is_free()) {
+        FreeVoice(voice);
+        release(voice);
+      }
+    }
+  }
+  size_t chip_limit() const { return chip_limit_; }
+
+  bool chip_active(size_t c) const { return chips_[c].active_voices > 0; }
+  auto chip_active_voices(size_t c) const { return chips_[c].active_voices; }
+  auto chip_group(size_t c) const { return chips_[c].group; }
+
+private:
+  using mask_t = detail::voice_mask_t<VOICES_PER_CHIP>;
+  static constexpr mask_t kAllVoices = ~mask_t{0} >> (sizeof(mask_t) * 8 - VOICES_PER_CHIP);
+
+  struct ChipState {
+    unsigned active_voices = 0;
+    FilterGroup group = 0;
+    mask_t free_voices = kAllVoices;
+    unsigned next = 0;  // round-robin within chip so release tails aren't cut short
+  };
+
+  std::array<Note, kNumVoices> voice_pool_;
+  std::array<ChipState, NUM_CHIPS> chips_;
+  detail::NoteVoiceTable<kNumVoices> note_table_;
+  util::LruList<kNumVoices> lru_;
+  // Voices by the group of their chip
+  std::array<util::LruList<kNumVoices>, kNumGroupLists> group_lru_;
+  size_t chip_limit_ = kNumChips;
+
+  auto &group_lru(size_t c) { return group_lru_[chips_[c].group % kNumGroupLists]; }
+
+  std::optional<VoiceIndex> FindFreeVoice(FilterGroup group) const
+  {
+    // Least loaded chip of the same group, then an idle chip, then whatever is left
+    size_t best = kNumChips;
+    size_t idle = kNumChips;
+    size_t any = kNumChips;
+    for (size_t c = 0; c < chip_limit_; ++c) {
+      auto active_voices = chips_[c].active_voices;
+      if (active_voices >= kVoicesPerChip) continue;
+      if (!active_voices) {
+        if (idle == kNumChips) idle = c;
+      } else if (chips_[c].group == group) {
+        if (best == kNumChips || active_voices < chips_[best].active_voices) best = c;
+      } else if (any == kNumChips) {
+        any = c;
+      }
+    }
+
+    if (best == kNumChips) best = idle;
+    if (best == kNumChips) best = any;
+    if (best == kNumChips) return std::nullopt;
+
+    auto &c = chips_[best];
+    return static_cast<VoiceIndex>(best * kVoicesPerChip +
+                                   detail::find_next_set(c.free_voices, c.next));
+  }
+
+  void AssignVoice(VoiceIndex voice_index, midi::Note note, midi::Velocity velocity,
+                   FilterGroup group)
   {
     voice_pool_[voice_index] = {note, velocity};
-    next_ = next(voice_index);
-    lru_.emplace_back(voice_index);
+    note_table_.set(note, voice_index);
+
+    auto &c = chips_[chip(voice_index)];
+    if (!c.active_voices) c.group = group;
+    ++c.active_voices;
+    auto slot = voice_index % kVoicesPerChip;
+    c.free_voices &= ~(mask_t{1} << slot);
+    c.next = slot < kVoicesPerChip - 1 ? slot + 1 : 0;
+    lru_.push_back(voice_index);
+    group_lru(chip(voice_index)).push_back(voice_index);
+  }
+
+  void FreeVoice(VoiceIndex voice_index)
+  {
+    note_table_.reset(voice_pool_[voice_index].note);
+    voice_pool_[voice_index] = {};
+    lru_.erase(voice_index);
+    group_lru(chip(voice_index)).erase(voice_index);
+
+    auto &c = chips_[chip(voice_index)];
+    --c.active_voices;
+    c.free_voices |= mask_t{1} << (voice_index % kVoicesPerChip);
   }
 
 public:
@@ -223,9 +459,6 @@ public:
   auto &voices() const { return voice_pool_; }
 };
 
-template <size_t STACK_DEPTH>
-using VoiceAllocatorMono = NoteStack<STACK_DEPTH>;
-
 }  // namespace pfm2sid::synth
 
 #endif  // PFM2SID_SYNTH_VOICE_ALLOCATOR_H_
@@ -22,70 +22,96 @@
 //
 #include "wavetable.h"
 
-#include <ios>
-
 namespace pfm2sid::synth {
 
-// std::array<WaveTable, kNumWaveTables> wavetables = {
-WaveTable wavetables[kNumWaveTables];
+using Step = WaveTable::Step;
+using sidbits::OSC_WAVE;
+
+static constexpr Step wavetable_octaves[] = {
+    Step::Play(4).Transpose(0),
+    Step::Play(4).Transpose(12),
+    Step::Play(4).Transpose(0),
+    Step::Play(4).Transpose(12),
+    Step::Loop(),
+};
 
-void InitWaveTables()
+static constexpr Step wavetable_drum[] = {
+    Step::Play(4).Transpose(0).Wave(OSC_WAVE::TRI),
+    Step::Play(4).Transpose(0).Wave(OSC_WAVE::NOISE),
+    Step::Play(4).Transpose(0).Wave(OSC_WAVE::PULSE),
+    Step::Play(4).Transpose(-24).Wave(OSC_WAVE::PULSE).End(),
+};
+
+template <int direction>
+static constexpr auto make_chromatic_sweep()
 {
-  {
-    auto &data = wavetables[0].mutable_data();
-    data[0] = {0};
-    data[1] = {12};
-    data[2] = {0};
-    data[3] = {12};
-    data[4] = {WaveTable::LOOP};
-  }
+  std::array<Step, 13> steps = {};
+  for (int i = 0; i <= 12; ++i)
+    steps[i] = Step::Play(4).Transpose(static_cast<int8_t>(i * direction));
+  steps[12] = steps[12].End();
+  return steps;
+}
 
-  {
-    auto &data = wavetables[1].mutable_data();
-    data[0] = {0, sidbits::OSC_WAVE::TRI};
-    data[1] = {0, sidbits::OSC_WAVE::NOISE};
-    data[2] = {0, sidbits::OSC_WAVE::PULSE};
-    data[3] = {-24, sidbits::OSC_WAVE::PULSE};
-    data[3].action = WaveTable::END;
-  }
+static constexpr auto wavetable_up = make_chromatic_sweep<1>();
+static constexpr auto wavetable_down = make_chromatic_sweep<-1>();
 
-  {
-    auto &data = wavetables[2].mutable_data();
-    for (int i = 0; i <= 12; ++i) { data[i] = {i}; }
-    data[12].action = WaveTable::END;
-  }
+// Gated pulse sweep with a filter accent on the first step
+static constexpr Step wavetable_pulse_gate[] = {
+    Step::Play(2).Wave(OSC_WAVE::PULSE).Gate(true).Pwm(0x20).Filter(32),
+    Step::Play(2).Gate(false).Filter(0),
+    Step::Play(2).Gate(true).Pwm(0x40),
+    Step::Play(2).Gate(false),
+    Step::Play(2).Gate(true).Pwm(0x60),
+    Step::Play(2).Gate(false),
+    Step::Play(2).Gate(true).Pwm(0x80).Transpose(12),
+    Step::Play(2).Gate(false).Transpose(0),
+    Step::Loop(),
+};
 
-  {
-    auto &data = wavetables[3].mutable_data();
-    for (int i = 0; i <= 12; ++i) { data[i] = {-i}; }
-    data[12].action = WaveTable::END;
-  }
+const WaveTable wavetables[kNumWaveTables] = {
+    {wavetable_octaves}, {wavetable_drum}, {wavetable_up}, {wavetable_down}, {wavetable_pulse_gate},
+};
+
+void WaveTableScanner::Next()
+{
+  ++pos_;
+  if (WaveTable::LOOP == source_->at(pos_).action()) pos_ = 0;
+  samples_left_ = current().ticks() * tick_samples_;
 }
 
-// TODO This seems overly complex
-WaveTable::Entry WaveTableScanner::Update()
+uint8_t WaveTableScanner::Apply(const WaveTable::Step &step)
 {
-  auto pos = pos_;
-  auto action = source_->at(pos).action;
-  if (WaveTable::LOOP == action) {
-    pos = pos_ = 0;
-    action = source_->at(pos).action;
-  }
+  using Step = WaveTable::Step;
+  const uint8_t tracks = step.control & ~Step::kActionMask;
+  if (step.is_enabled<WaveTable::TRANSPOSE>()) state_.transpose = step.transpose;
+  if (step.is_enabled<WaveTable::WAVEFORM>())
+    state_.wave_gate = static_cast<uint8_t>((state_.wave_gate & Step::kGateBit) |
+                                            (step.wave_gate & ~Step::kGateBit));
+  if (step.is_enabled<WaveTable::GATE>())
+    state_.wave_gate = static_cast<uint8_t>((state_.wave_gate & ~Step::kGateBit) |
+                                            (step.wave_gate & Step::kGateBit));
+  if (step.is_enabled<WaveTable::PWM>()) state_.pwm = step.pwm;
+  if (step.is_enabled<WaveTable::FILTER>()) state_.filter = step.filter;
+  state_.control = static_cast<uint8_t>(state_.control | tracks);
+  return tracks;
+}
 
-  bool ticked = true;
-  if (rate_) {
-    if (ticks_) {
-      --ticks_;
-      ticked = false;
-    } else {
-      ticks_ = rate_;
-    }
-  }
+WaveTable::Step WaveTableScanner::Advance(uint32_t num_samples, Events &events)
+{
+  events.clear();
+  const auto start = state_;
 
-  if (ticked && WaveTable::END != action) {
-    if (pos_ < source_->size() - 1) ++pos_;
+  uint32_t offset = 0;
+  while (WaveTable::END != current().action() && samples_left_ <= num_samples - offset) {
+    offset += samples_left_;
+    Next();
+    auto tracks = Apply(current());
+    if (offset < num_samples && tracks)
+      events.push_back(static_cast<uint16_t>(offset), tracks, state_);
   }
+  if (WaveTable::END != current().action()) samples_left_ -= num_samples - offset;
 
-  return source_->at(pos);
+  return start;
 }
+
 }  // namespace pfm2sid::synth
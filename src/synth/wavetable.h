@@ -23,127 +23,255 @@
 #ifndef PFM2SID_SYNTH_WAVETABLE_H_
 #define PFM2SID_SYNTH_WAVETABLE_H_
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
 
 #include "sidbits/sidbits.h"
+#include "synth/synth.h"
 
 namespace pfm2sid::synth {
 
-static constexpr size_t kNumWaveTables = 4;
+static constexpr size_t kNumWaveTables = 5;
 
-// We can afford to be a bit wasteful with the types.
+// Wavetables are constexpr arrays of packed steps that live in flash, so they don't cost any RAM
+// and there's no init step at boot.
 //
-// This uses fixed-purpose fields rather than generic ones that can be assigned to parameters/CC,
-// which can be added later.
+// Each step is 6 bytes and contains an action, a set of enabled tracks and a duration in ticks
+// (\sa WaveTableScanner for the tick length). Tracks that aren't enabled leave the value as set by
+// the voice parameters.
 //
-// TODO Move the enable_ flags to the scanner and make it parametrizable?
-// TODO Store an array of values and use detail::typed_value (\sa parameter_types.h_ to convert
-
+// The builder functions allow defining tables in a semi-readable way, e.g.
+//   Step::Play(4).Transpose(12).Wave(sidbits::OSC_WAVE::SAW)
+//
+// TODO Store tracks in patches? Editor?
 class WaveTable {
 public:
-  static constexpr size_t kMaxSteps = 128;
+  enum ACTION : uint8_t { PLAY, LOOP, END };
+  enum TRACK : uint8_t { TRANSPOSE, WAVEFORM, GATE, PWM, FILTER };
 
-  enum ACTION { PLAY, LOOP, END };
-  enum TRACK : unsigned { TRANSPOSE, WAVEFORM };
-  struct Entry {
-    ACTION action = END;
-    unsigned enabled = 0;
+  struct Step {
+    uint8_t control = END;  // ACTION in the low bits, enabled tracks above
+    uint8_t duration = 1;   // Ticks until next step, 0 is treated as 1
+    int8_t transpose = 0;   // Semitones
+    uint8_t wave_gate = 0;  // OSC_WAVE in upper nibble, gate in bit 0
+    uint8_t pwm = 0;        // Pulse width >> 4
+    int8_t filter = 0;      // Cutoff offset >> 3
 
-    int32_t transpose = 0;
-    sidbits::OSC_WAVE waveform = sidbits::OSC_WAVE::SILENCE;
+    static constexpr uint8_t kActionMask = 0x03;
+    static constexpr uint8_t kGateBit = 0x01;
 
     template <TRACK track>
-    constexpr auto is_enabled() const -> bool
+    static constexpr uint8_t track_mask()
     {
-      return enabled & (1 << track);
+      return 0x04 << track;
     }
 
+    constexpr ACTION action() const { return static_cast<ACTION>(control & kActionMask); }
+
     template <TRACK track>
-    static constexpr auto track_mask() -> unsigned
+    constexpr bool is_enabled() const
     {
-      return 1 << track;
+      return control & track_mask<track>();
     }
 
-    // template <TRACK track> auto get() const { return values_[track]; }
-    constexpr Entry() = default;
-    constexpr Entry(ACTION a) : action(a) {}
-    constexpr Entry(int t, sidbits::OSC_WAVE w)
-        : action(PLAY),
-          enabled(track_mask<TRANSPOSE>() | track_mask<WAVEFORM>()),
-          transpose(t),
-          waveform(w)
-    {}
-    constexpr Entry(int t) : action(PLAY), enabled(track_mask<TRANSPOSE>()), transpose(t) {}
+    constexpr auto waveform() const { return static_cast<sidbits::OSC_WAVE>(wave_gate & 0xf0); }
+    constexpr bool gate() const { return wave_gate & kGateBit; }
+    constexpr uint16_t pwm12() const { return static_cast<uint16_t>(pwm) << 4; }
+    constexpr int32_t filter_offset() const { return static_cast<int32_t>(filter) * 8; }
+    constexpr uint32_t ticks() const { return duration ? duration : 1; }
+
+    static constexpr Step Play(uint8_t duration = 1) { return Step{PLAY, duration}; }
+    static constexpr Step Loop() { return Step{LOOP, 1}; }
+
+    constexpr Step Transpose(int8_t semitones) const
+    {
+      auto step = with<TRANSPOSE>();
+      step.transpose = semitones;
+      return step;
+    }
+    constexpr Step Wave(sidbits::OSC_WAVE wave) const
+    {
+      auto step = with<WAVEFORM>();
+      step.wave_gate = static_cast<uint8_t>((wave_gate & kGateBit) | static_cast<uint8_t>(wave));
+      return step;
+    }
+    constexpr Step Gate(bool gate) const
+    {
+      auto step = with<GATE>();
+      step.wave_gate = static_cast<uint8_t>((wave_gate & 0xf0) | (gate ? kGateBit : 0));
+      return step;
+    }
+    constexpr Step Pwm(uint8_t pulse_width) const
+    {
+      auto step = with<PWM>();
+      step.pwm = pulse_width;
+      return step;
+    }
+    constexpr Step Filter(int8_t offset) const
+    {
+      auto step = with<FILTER>();
+      step.filter = offset;
+      return step;
+    }
+    // Hold this step at the end of the table
+    constexpr Step End() const
+    {
+      auto step = *this;
+      step.control = static_cast<uint8_t>((control & ~kActionMask) | END);
+      return step;
+    }
+
+  private:
+    template <TRACK track>
+    constexpr Step with() const
+    {
+      auto step = *this;
+      step.control |= track_mask<track>();
+      return step;
+    }
   };
+  static_assert(sizeof(Step) == 6);
 
-  auto size() const { return kMaxSteps; }
+  constexpr WaveTable() = default;
 
-  auto at(size_t pos) const { return data_[pos]; }
+  template <size_t N>
+  constexpr WaveTable(const Step (&steps)[N]) : steps_(steps), length_(N)
+  {}
+  template <size_t N>
+  constexpr WaveTable(const std::array<Step, N> &steps) : steps_(steps.data()), length_(N)
+  {}
 
-  auto begin() const { return data_.begin(); }
-  auto end() const { return data_.end(); }
+  constexpr size_t size() const { return length_; }
 
-  auto &mutable_data() { return data_; }
+  // Out of range reads return the default END step
+  const Step &at(size_t pos) const { return pos < length_ ? steps_[pos] : end_step(); }
+
+  constexpr const Step *begin() const { return steps_; }
+  constexpr const Step *end() const { return steps_ + length_; }
 
 private:
-  std::array<Entry, kMaxSteps> data_;
+  const Step *steps_ = nullptr;
+  size_t length_ = 0;
+
+  static const Step &end_step()
+  {
+    static constexpr Step step;
+    return step;
+  }
 };
 
-// extern std::array<WaveTable, kNumWaveTables> wavetables;
-extern WaveTable wavetables[kNumWaveTables];
-void InitWaveTables();
+extern const WaveTable wavetables[kNumWaveTables];
 
+// Steps through a table with sample offsets, so steps can change within a render block.
+//
+// The tick length depends on the rate, at the maximum rate it's kTickSamples; with the default
+// tables using 4 ticks/step, that's one step per 32 sample block.
 class WaveTableScanner {
 public:
   static constexpr int32_t kRateMin = 0;
   static constexpr int32_t kRateMax = 127;
+  static constexpr uint32_t kTickSamples = 8;
+
+  // The state holds the most recent value of each track since the start of the table, i.e. tracks
+  // hold their value until a later step changes them. tracks is the mask of tracks that changed.
+  struct Event {
+    uint16_t offset;
+    uint8_t tracks;
+    WaveTable::Step state;
+  };
+
+  static constexpr size_t kMaxEvents = kSampleBlockSize / kTickSamples + 1;
+
+  class Events {
+  public:
+    void clear() { size_ = 0; }
+    bool empty() const { return !size_; }
+    size_t size() const { return size_; }
+
+    void push_back(uint16_t offset, uint8_t tracks, const WaveTable::Step &state)
+    {
+      if (size_ < kMaxEvents) events_[size_++] = {offset, tracks, state};
+    }
+
+    template <WaveTable::TRACK track>
+    bool any() const
+    {
+      for (size_t i = 0; i < size_; ++i)
+        if (events_[i].tracks & WaveTable::Step::track_mask<track>()) return true;
+      return false;
+    }
+
+    auto begin() const { return events_.data(); }
+    auto end() const { return events_.data() + size_; }
+
+  private:
+    std::array<Event, kMaxEvents> events_;
+    size_t size_ = 0;
+  };
 
   void SetSource(const WaveTable *src)
   {
     source_ = src;
     pos_ = 0;
-    ticks_ = rate_;
+    state_ = {};
+    if (src) {
+      Apply(src->at(0));
+      samples_left_ = src->at(0).ticks() * tick_samples_;
+    } else {
+      samples_left_ = 0;
+    }
   }
 
   void set_rate(int32_t rate)
   {
-    rate = (kRateMax - std::clamp(rate, kRateMin, kRateMax));
-    if (ticks_ > rate) ticks_ = rate;
-    rate_ = rate;
+    tick_samples_ =
+        static_cast<uint32_t>(kRateMax + 1 - std::clamp(rate, kRateMin, kRateMax)) * kTickSamples;
+    if (source_) samples_left_ = std::min(samples_left_, current().ticks() * tick_samples_);
   }
 
   void Reset()
   {
     SetSource(nullptr);
-    set_rate(0);
-    ticks_ = 0;
+    set_rate(kRateMax);
   }
 
   bool active() const { return nullptr != source_; }
 
-  auto Update() -> WaveTable::Entry;
+  const WaveTable::Step &current() const { return source_->at(pos_); }
+  const WaveTable::Step &state() const { return state_; }
+
+  // Advance by num_samples. Returns the state at the start; steps starting within the num_samples
+  // are added to events (which is cleared first).
+  WaveTable::Step Advance(uint32_t num_samples, Events &events);
 
 private:
   const WaveTable *source_ = nullptr;
   size_t pos_ = 0;
-  int32_t rate_ = kRateMax;
-  int32_t ticks_ = kRateMax;
+  uint32_t samples_left_ = 0;
+  uint32_t tick_samples_ = kTickSamples;
+  WaveTable::Step state_;
+
+  void Next();
+  uint8_t Apply(const WaveTable::Step &step);
 };
 
-constexpr const char *action_to_string(const WaveTable::Entry &entry, char *buf)
+constexpr const char *action_to_string(const WaveTable::Step &step, char *buf)
 {
-  if (WaveTable::PLAY == entry.action)
+  if (WaveTable::PLAY == step.action())
     buf[0] = 'P';
-  else if (WaveTable::LOOP == entry.action)
+  else if (WaveTable::LOOP == step.action())
     buf[0] = 'L';
-  else if (WaveTable::END == entry.action)
+  else if (WaveTable::END == step.action())
     buf[0] = 'E';
   else
     buf[0] = '?';
   buf[1] = '_';
-  buf[2] = entry.is_enabled<WaveTable::TRANSPOSE>() ? 'T' : '_';
-  buf[3] = entry.is_enabled<WaveTable::WAVEFORM>() ? 'W' : '_';
+  buf[2] = step.is_enabled<WaveTable::TRANSPOSE>() ? 'T' : '_';
+  buf[3] = step.is_enabled<WaveTable::WAVEFORM>() ? 'W' : '_';
+  buf[4] = step.is_enabled<WaveTable::GATE>() ? 'G' : '_';
+  buf[5] = step.is_enabled<WaveTable::PWM>() ? 'P' : '_';
+  buf[6] = step.is_enabled<WaveTable::FILTER>() ? 'F' : '_';
 
   return buf;
 }
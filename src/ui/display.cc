@@ -23,10 +23,13 @@
 #include "display.h"
 #include "stm32x/stm32x_core.h"
 
+#include <atomic>
 #include <cstdarg>
-#include <cstdio>
 #include <cstring>
 
+#include "drivers/core_timer.h"
+#include "misc/format.h"
+
 namespace pfm2sid {
 
 void Display::Clear()
@@ -34,36 +37,54 @@ void Display::Clear()
   // lcd.Clear();
   memset(line_buffer_, ' ', sizeof(line_buffer_));
   memset(status_bar_, ' ', kNumStatusIcons);
+  for (uint8_t line = 0; line < kNumLines; ++line) MarkDirty(line, 0, kLineWidth);
+}
+
+void Display::MarkDirty(uint8_t line, int col, int len)
+{
+  const auto *buf = line_buffer_ + (line * kLineWidth);
+  const auto *lcd = lcd_buffer_ + (line * kLineWidth);
+  DirtyMask mask = 0;
+  DirtyMask dirty = 0;
+  for (int i = col; i < col + len; ++i) {
+    mask |= DirtyMask{1} << i;
+    if (buf[i] != lcd[i]) dirty |= DirtyMask{1} << i;
+  }
+  // The characters have to be in the buffer before Tick sees the bits
+  std::atomic_signal_fence(std::memory_order_release);
+  dirty_[line] = (dirty_[line] & ~mask) | dirty;
 }
 
-static char fmt_buf[Display::kLineWidth + 1] INCCMZ;
+// Lines are always written in full, so the status bar is put back right away
+void Display::LineChanged(uint8_t line)
+{
+  if (!line && enable_status_bar_)
+    memcpy(line_buffer_ + (kLineWidth - kNumStatusIcons), status_bar_, kNumStatusIcons);
+  MarkDirty(line, 0, kLineWidth);
+}
 
-// We don't actually want the \0 in the screen buffer, but do want the convenience of printf.
-// So this ends up being mildly awkward and not exactly efficient...
+// Formats directly into the line (without the \0) and pads the rest with spaces
 void Display::Fmt(uint8_t line, const char *fmt, ...)
 {
   va_list args;
   va_start(args, fmt);
-  auto n = vsnprintf(fmt_buf, sizeof(fmt_buf), fmt, args);
-  if (n < 0) n = 0; // ignore encoding errors
   auto *buf = line_buffer_ + (line * kLineWidth);
-  if (n < kLineWidth) {
-    memcpy(buf, fmt_buf, n);
-    memset(buf + n, ' ', kLineWidth - n);
-  } else {
-    memcpy(buf, fmt_buf, kLineWidth);
-  }
+  auto n = util::VFormat(buf, kLineWidth, fmt, args);
+  memset(buf + n, ' ', kLineWidth - n);
   va_end(args);
+  LineChanged(line);
 }
 
 void Display::Write(uint8_t line, const char *data)
 {
   memcpy(line_buffer_ + (line * kLineWidth), data, kLineWidth);
+  LineChanged(line);
 }
 
 void Display::Clear(uint8_t line)
 {
   memset(line_buffer_ + (line * kLineWidth), ' ', kLineWidth);
+  LineChanged(line);
 }
 
 void Display::Update()
@@ -80,44 +101,62 @@ void Display::Update()
   }
   if (enable_status_bar_) {
     memcpy(line_buffer_ + (kLineWidth - kNumStatusIcons), status_bar_, kNumStatusIcons);
+    MarkDirty(0, kLineWidth - kNumStatusIcons, kNumStatusIcons);
   }
 }
 
-static constexpr uint8_t kCharsPerTick = 1;  // ca 100us
+// Each write (character or cursor move) takes ca. 95us because of the delays in the Lcd driver.
+// Tick keeps writing while there's time for another one in the budget, i.e. one per Tick. This runs
+// in the SysTick ISR, so it preempts rendering and is included in the governor's load; at 1kHz it's
+// < 10% of the CPU.
+static constexpr uint32_t kTickBudgetUs = 120;
+static constexpr uint32_t kWriteUs = 100;
 
 void Display::Tick()
 {
+  const auto start = CoreTimer::now();
   auto row = scan_row_;
   auto col = scan_col_;
+  auto cursor_valid = cursor_valid_;
+
+  while (CoreTimer::now() - start <= CoreTimer::us_to_timer(kTickBudgetUs - kWriteUs)) {
+    // Find the next dirty character from the scan position, wrapping around to the start of the
+    // current line last.
+    uint_fast8_t next_row = row;
+    DirtyMask dirty = dirty_[row] & (~DirtyMask{0} << col);
+    for (uint_fast8_t i = 1; !dirty && i <= kNumLines; ++i) {
+      next_row = (row + i) % kNumLines;
+      dirty = dirty_[next_row];
+    }
+    if (!dirty) break;
+    const auto next_col = static_cast<uint_fast8_t>(__builtin_ctz(dirty));
 
-  if (col < Lcd::kCols) {
-    // Send data, up to end of current line
-    auto nchars = std::min<uint8_t>(Lcd::kCols - col, kCharsPerTick);
-    lcd.Print(scan_pos_, nchars);
-    memcpy(lcd_pos_, scan_pos_, nchars);  // TODO There shouldn't be a race condition here?
-    scan_pos_ += nchars;
-    lcd_pos_ += nchars;
-    col += nchars;
-  } else {
-    // Advance to next line
-    row = (row + 1) % Lcd::kRows;
-    col = 0;
-    scan_pos_ = line_buffer_ + (row * kLineWidth);
-    lcd_pos_ = lcd_buffer_ + (row * kLineWidth);
-
-    // Check if there's a change in this line. This effectively skips it and falls through to the
-    // next line in the next Tick. Only update the cursor if we actually find a changed character.
-    for (; col < kLineWidth; ++col)
-      if (lcd_pos_[col] != scan_pos_[col]) {
-        lcd.MoveCursor(row, col);
-        break;
-      }
-    scan_pos_ += col;
-    lcd_pos_ += col;
+    if (!cursor_valid || next_row != row || next_col != col) {
+      lcd.MoveCursor(next_row, next_col);
+      row = next_row;
+      col = next_col;
+      cursor_valid = true;
+      continue;
+    }
+
+    // Clear the bit before reading the character, anything written after that marks it again
+    dirty_[row] = dirty_[row] & ~(DirtyMask{1} << col);
+    const auto pos = row * kLineWidth + col;
+    const char c = line_buffer_[pos];
+    lcd.Print(&c, 1);
+    lcd_buffer_[pos] = c;
+
+    // The LCD address doesn't continue on the next line
+    if (++col >= kLineWidth) {
+      row = (row + 1) % kNumLines;
+      col = 0;
+      cursor_valid = false;
+    }
   }
 
   scan_row_ = row;
   scan_col_ = col;
+  cursor_valid_ = cursor_valid;
 }
 
 void Display::EnableStatusBar(bool enable)
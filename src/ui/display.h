@@ -40,11 +40,12 @@ namespace pfm2sid {
 // Initial measurements show the status bar update (move cursor + 4 icons) clocks in at 500us and
 // full lines at > 1ms. Which is about the right order of magnitude given the 45us delay per nibble
 // in the Lcd driver, but this is a long time to wait during normal processing. So the ::Tick
-// function here sends some small amount.
+// function here sends as much as fits in a small time budget (measured with the cycle counter).
 //
-// Even if we send 1 character every Tick we still have an update rate of 1000/(20x4) = 12.5 fps
-// which may be visible on full-screen transitions.
-// The "dirty" check is fairly simple and finds the first changed character in a line.
+// Writes into the line buffer mark the characters that differ from the LCD in a dirty bitmap, so
+// Tick can go straight to the next changed character, or return immediately if there isn't one.
+// Consecutive characters don't need a cursor move. With one write per Tick a full-screen
+// transition takes about 84ms.
 //
 // Initially the status bar was prioritized and updated more frequently, but this doesn't actually
 // seem necessary.
@@ -79,10 +80,16 @@ private:
   char line_buffer_[kNumLines * kLineWidth] = {};  // buffer application writes to
   char lcd_buffer_[kNumLines * kLineWidth] = {};   // cache of what's on LCD
 
+  // One bit per character in each line that differs from the LCD. Only Tick (in the ISR) clears
+  // bits for characters it writes; races with MarkDirty can at most cause an extra write.
+  using DirtyMask = uint32_t;
+  static_assert(kLineWidth <= 32);
+  volatile DirtyMask dirty_[kNumLines] = {};
+
+  // Where the next write goes without moving the cursor
   uint_fast8_t scan_row_ = 0;
   uint_fast8_t scan_col_ = 0;
-  const char *scan_pos_ = line_buffer_;
-  char *lcd_pos_ = lcd_buffer_;
+  bool cursor_valid_ = false;
 
   struct StatusIcon {
     char character = 0;
@@ -92,6 +99,9 @@ private:
   std::array<StatusIcon, kNumStatusIcons> status_icons_;
   char status_bar_[kNumStatusIcons + 1] = {0};
   bool enable_status_bar_ = true;
+
+  void MarkDirty(uint8_t line, int col, int len);
+  void LineChanged(uint8_t line);
 };
 
 extern Display display;
@@ -23,12 +23,24 @@
 #ifndef PFM2SID_UI_MENU_H_
 #define PFM2SID_UI_MENU_H_
 
+#include <cstdint>
+
 #include "control_event.h"
 
 namespace pfm2sid {
 
 enum class MENU_EVENT { ENTER, EXIT };
 
+// Display lines to redraw, one bit per line
+using LineMask = uint8_t;
+static constexpr LineMask kAllLines = 0x0f;
+constexpr LineMask LINE(unsigned line)
+{
+  return static_cast<LineMask>(1U << line);
+}
+
+// Menus only redraw the lines they invalidated, e.g. when handling an event, or in Step if a value
+// they show has changed. The Ui calls UpdateDisplay with those lines at a limited rate.
 class Menu {
 public:
   virtual ~Menu() = default;
@@ -39,14 +51,48 @@ public:
 
   virtual void HandleMenuEvent(MENU_EVENT) = 0;
   virtual void HandleEvent(const Event &) = 0;
-  virtual void UpdateDisplay() const = 0;
+  virtual void UpdateDisplay(LineMask lines) const = 0;
 
+  // Called periodically to check for changes
   virtual void Step() = 0;
 
+  void Invalidate(LineMask lines = kAllLines) { invalid_lines_ |= lines; }
+
+  LineMask TakeInvalidLines()
+  {
+    auto lines = invalid_lines_;
+    invalid_lines_ = 0;
+    return lines;
+  }
+
 protected:
   Menu(const char *name) : name_(name) {}
 
   const char *const name_ = nullptr;
+
+private:
+  LineMask invalid_lines_ = kAllLines;
+};
+
+// A value shown on the display. Changed returns true if it changed by more than the threshold
+// since the last time it did, so noisy stats don't cause constant redraws.
+template <typename T>
+class WatchedValue {
+public:
+  constexpr explicit WatchedValue(T threshold = {}) : threshold_(threshold) {}
+
+  bool Changed(T value)
+  {
+    if (value > last_ + threshold_ || last_ > value + threshold_) {
+      last_ = value;
+      return true;
+    }
+    return false;
+  }
+
+private:
+  const T threshold_;
+  T last_ = {};
 };
 
 }  // namespace pfm2sid
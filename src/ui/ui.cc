@@ -140,10 +140,17 @@ void Ui::DispatchEvents()
   }
 }
 
-void Ui::UpdateDisplay() const
+// This is called from the main loop as often as possible, but only redraws what the menu has
+// invalidated (and only so often, the display can't keep up anyway).
+void Ui::UpdateDisplay()
 {
-  if (current_menu_) current_menu_->UpdateDisplay();
-  display.Update();
+  if (!current_menu_ || ticks_ - redraw_ticks_ < kMinRedrawTicks) return;
+
+  auto lines = current_menu_->TakeInvalidLines();
+  if (lines) {
+    current_menu_->UpdateDisplay(lines);
+    redraw_ticks_ = ticks_;
+  }
 }
 
 void Ui::AddTimer(TIMER timer_id, uint32_t timeout)
@@ -163,6 +170,7 @@ void Ui::SetMenu(Menu *menu)
     if (menu) {
       display.Fmt(0, "%-16s", menu->name());
       menu->HandleMenuEvent(MENU_EVENT::ENTER);
+      menu->Invalidate();
     }
     current_menu_ = menu;
   }
@@ -171,6 +179,7 @@ void Ui::SetMenu(Menu *menu)
 void Ui::Step()
 {
   if (current_menu_) current_menu_->Step();
+  display.Update();
 }
 
 }  // namespace pfm2sid
@@ -45,11 +45,12 @@ public:
   static constexpr size_t kMaxEventQueueSize = 16;
 
   static constexpr uint32_t kLongPressTicks = 1000;  // tick = ms
+  static constexpr uint32_t kMinRedrawTicks = 40;    // i.e. at most 25 redraws/s
 
   void Init();
   void Tick();
   void DispatchEvents();
-  void UpdateDisplay() const;
+  void UpdateDisplay();
 
   void AddTimer(TIMER timer_id, uint32_t timeout);
 
@@ -62,6 +63,7 @@ private:
   static constexpr size_t kNumEncoders = 4;
 
   uint32_t ticks_ = 0;
+  uint32_t redraw_ticks_ = 0;
 
   class SwitchStateEx : public stm32x::SwitchState {
   public:
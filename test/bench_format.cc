@@ -0,0 +1,73 @@
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include "misc/format.h"
+#include "misc/platform.h"
+#include "pfm2sid_bench.h"
+
+namespace pfm2sid::bench {
+
+namespace {
+
+constexpr int kLineWidth = 20;
+
+// The previous Display::Fmt
+void PrintfLine(char *line, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void PrintfLine(char *line, const char *fmt, ...)
+{
+  static char fmt_buf[kLineWidth + 1];
+  va_list args;
+  va_start(args, fmt);
+  auto n = vsnprintf(fmt_buf, sizeof(fmt_buf), fmt, args);
+  if (n < 0) n = 0;
+  if (n < kLineWidth) {
+    memcpy(line, fmt_buf, n);
+    memset(line + n, ' ', kLineWidth - n);
+  } else {
+    memcpy(line, fmt_buf, kLineWidth);
+  }
+  va_end(args);
+}
+
+void FormatLine(char *line, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void FormatLine(char *line, const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  auto n = util::VFormat(line, kLineWidth, fmt, args);
+  memset(line + n, ' ', kLineWidth - n);
+  va_end(args);
+}
+
+// A selection of the menu lines
+template <typename F>
+void RunLines(const char *variant, F &&fmt_line)
+{
+  char lines[4][kLineWidth];
+  Random random;
+  auto ns = Measure(
+      [&]() {
+        const auto r = random.next(1000);
+        const auto f = static_cast<float>(r) / 10.f;
+        fmt_line(lines[0], "%-16s", "SID Synth");
+        fmt_line(lines[1], "%02u:%02u/%02u:%02u%9s", r % 60, r % 13, 3u, 59u, "");
+        fmt_line(lines[2], "%6.2fms %2u/%-2u %3" PRIu32 "ms", PRINT_F32(f), r % 16, 16u,
+                 uint32_t{r});
+        fmt_line(lines[3], "load %3.0f%% %5.1f%%", PRINT_F32(f), PRINT_F32(f));
+        DoNotOptimize(lines);
+      },
+      4);
+  Report("display_fmt", variant, ns, "line");
+}
+
+}  // namespace
+
+PFM2SID_BENCHMARK(BM_DisplayFmt)
+{
+  RunLines("vsnprintf", [](char *line, auto... args) { PrintfLine(line, args...); });
+  RunLines("util::VFormat", [](char *line, auto... args) { FormatLine(line, args...); });
+}
+
+}  // namespace pfm2sid::bench
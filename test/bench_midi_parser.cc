@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <vector>
+
+#include "fmt/format.h"
+#include "midi/midi_parser.h"
+#include "midi_corpus.h"
+#include "pfm2sid_bench.h"
+#include "sidbits/asid_parser.h"
+
+namespace pfm2sid::bench {
+
+namespace {
+
+// Accepts ASID sysex, but doesn't do anything with the data
+class SysexSink : public midi::MidiHandler {
+public:
+  SysexSink() : midi::MidiHandler(midi::ALL_CHANNELS) {}
+
+  bool MidiSysex(const uint8_t *data, unsigned len, midi::SYSEX_STATUS status) final
+  {
+    bytes_ += len;
+    return midi::SYSEX_STATUS::START != status || data[0] == 0x2D;
+  }
+
+  void MidiNoteOn(midi::Channel, midi::Note note, midi::Velocity) final { bytes_ += note; }
+
+  size_t bytes_ = 0;
+};
+
+// Decode ASID either by staging the message and parsing at EOX, or incrementally
+template <bool incremental>
+class AsidDecoder : public midi::MidiHandler {
+public:
+  AsidDecoder() : midi::MidiHandler(midi::ALL_CHANNELS) {}
+
+  bool MidiSysex(const uint8_t *data, unsigned len, midi::SYSEX_STATUS status) final
+  {
+    switch (status) {
+      case midi::SYSEX_STATUS::START:
+        if (incremental) asid_parser_.BeginSysex();
+        len_ = 0;
+        return sidbits::is_asid_sysex(data);
+      case midi::SYSEX_STATUS::DATA:
+      case midi::SYSEX_STATUS::EOX:
+        if (incremental) {
+          asid_parser_.FeedSysex(data, len);
+        } else {
+          std::copy(data, data + len, buffer_ + len_);
+          len_ += len;
+        }
+        if (midi::SYSEX_STATUS::EOX == status) {
+          auto r = incremental ? asid_parser_.EndSysex() : asid_parser_.ParseSysex(buffer_, len_);
+          DoNotOptimize(r);
+        }
+        return true;
+      default: break;
+    }
+    return false;
+  }
+
+  uint32_t dirty() { return asid_parser_.take_dirty(); }
+
+private:
+  sidbits::ASIDParser asid_parser_;
+  uint8_t buffer_[256] = {};
+  size_t len_ = 0;
+};
+
+// Serial MIDI at 31250 baud, 10 bits per byte
+constexpr double kMidiBytesPerSecond = 3125.0;
+
+// Bytes arriving per render block (32 samples @ 44.1kHz) at a multiple of the MIDI rate, i.e. the
+// chunk size the parser sees when the rx buffer is drained once per block.
+constexpr size_t block_chunk_size(unsigned realtime_factor)
+{
+  return static_cast<size_t>(kMidiBytesPerSecond * realtime_factor * 32 / 44100.0) + 1;
+}
+
+void ReportThroughput(const char *corpus, const char *variant, double ns, double cycles)
+{
+  const auto bytes_per_second = 1e9 / ns;
+  fmt::println("{:<32} {:<32} {:10.2f} ns/byte {:8.2f} MB/s {:10.0f}x realtime {:8.1f} cycles/byte",
+               corpus, variant, ns, bytes_per_second / 1e6, bytes_per_second / kMidiBytesPerSecond,
+               cycles);
+}
+
+}  // namespace
+
+PFM2SID_BENCHMARK(BM_MidiParser)
+{
+  const auto stream = GenerateAsidStream(256);
+
+  SysexSink sink;
+  midi::MidiParser midi_parser;
+  midi_parser.Init({&sink, nullptr, nullptr});
+
+  auto ns = Measure(
+      [&]() {
+        for (auto byte : stream) midi_parser.Parse(byte);
+      },
+      stream.size());
+  Report("midi_parser_asid", "per-byte", ns, "byte");
+
+  // Chunks similar to what the serial rx buffer might have available
+  for (size_t chunk_size : {8, 32}) {
+    ns = Measure(
+        [&]() {
+          for (size_t pos = 0; pos < stream.size(); pos += chunk_size)
+            midi_parser.Parse(stream.data() + pos, std::min(chunk_size, stream.size() - pos));
+        },
+        stream.size());
+    Report("midi_parser_asid", chunk_size == 8 ? "bulk/8" : "bulk/32", ns, "byte");
+  }
+
+  ns = Measure([&]() { midi_parser.Parse(stream.data(), stream.size()); }, stream.size());
+  Report("midi_parser_asid", "bulk", ns, "byte");
+  DoNotOptimize(sink.bytes_);
+}
+
+template <bool incremental>
+static void RunAsidDecoder(const char *variant, const std::vector<uint8_t> &stream)
+{
+  AsidDecoder<incremental> decoder;
+  midi::MidiParser midi_parser;
+  midi_parser.Init({&decoder, nullptr, nullptr});
+  auto ns = Measure(
+      [&]() {
+        for (size_t pos = 0; pos < stream.size(); pos += 32)
+          midi_parser.Parse(stream.data() + pos, std::min<size_t>(32, stream.size() - pos));
+        DoNotOptimize(decoder.dirty());
+      },
+      stream.size());
+  Report("asid_decode", variant, ns, "byte");
+}
+
+PFM2SID_BENCHMARK(BM_AsidDecode)
+{
+  const auto stream = GenerateAsidStream(256);
+  RunAsidDecoder<false>("staged", stream);
+  RunAsidDecoder<true>("incremental", stream);
+}
+
+// Throughput over the different corpora, fed in chunks matching several multiples of the MIDI
+// rate. The worst of these is the ceiling for faster transports.
+PFM2SID_BENCHMARK(BM_MidiCorpus)
+{
+  for (auto &corpus : GenerateMidiCorpora()) {
+    MidiSink sink;
+    midi::MidiParser midi_parser;
+    midi_parser.Init({&sink, &sink, &sink});
+
+    const auto &stream = corpus.data;
+    auto parse_chunked = [&](size_t chunk_size) {
+      for (size_t pos = 0; pos < stream.size(); pos += chunk_size)
+        midi_parser.Parse(stream.data() + pos, std::min(chunk_size, stream.size() - pos));
+      DoNotOptimize(sink.dirty());
+    };
+
+    auto per_byte = [&]() {
+      for (auto byte : stream) midi_parser.Parse(byte);
+    };
+    ReportThroughput(corpus.name, "per-byte", Measure(per_byte, stream.size()),
+                     MeasureCycles(per_byte, stream.size()));
+
+    for (unsigned factor : {1, 4, 16, 64}) {
+      const auto chunk_size = block_chunk_size(factor);
+      auto fn = [&]() { parse_chunked(chunk_size); };
+      auto variant = fmt::format("{}x ({} bytes/block)", factor, chunk_size);
+      ReportThroughput(corpus.name, variant.c_str(), Measure(fn, stream.size()),
+                       MeasureCycles(fn, stream.size()));
+    }
+    DoNotOptimize(sink.events());
+  }
+}
+
+}  // namespace pfm2sid::bench
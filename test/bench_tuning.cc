@@ -0,0 +1,35 @@
+#include <vector>
+
+#include "pfm2sid_bench.h"
+#include "sidbits/sidbits.h"
+#include "synth/tuning.h"
+
+namespace pfm2sid::bench {
+
+PFM2SID_BENCHMARK(BM_NoteToOscFreq)
+{
+  Random random;
+  std::vector<util::s816> notes(1024);
+  for (auto &n : notes) n = util::s816::from_raw(static_cast<int32_t>(random.next(96 << 16)));
+
+  auto ns = Measure(
+      [&]() {
+        for (auto n : notes) DoNotOptimize(sidbits::midi_to_osc_freq_fp(n));
+      },
+      notes.size());
+  Report("note_to_osc_freq", "interpolated", ns, "note");
+
+  static synth::TuningTable tuning_table;
+  tuning_table.Init(synth::Scale{}, sidbits::SID_CLOCK::PAL);
+  ns = Measure(
+      [&]() {
+        for (auto n : notes) DoNotOptimize(tuning_table.osc_freq(n));
+      },
+      notes.size());
+  Report("note_to_osc_freq", "tuning_table", ns, "note");
+
+  ns = Measure([&]() { tuning_table.Init(synth::Scale{}, sidbits::SID_CLOCK::NTSC); });
+  Report("tuning_table", "init", ns, "table");
+}
+
+}  // namespace pfm2sid::bench
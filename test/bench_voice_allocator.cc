@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <vector>
+
+#include "fmt/core.h"
+#include "linear_voice_allocator.h"
+#include "pfm2sid_bench.h"
+#include "synth/voice_allocator.h"
+
+namespace pfm2sid::bench {
+
+namespace {
+
+struct NoteEvent {
+  midi::Note note;
+  midi::Velocity velocity;  // 0 = note off
+};
+
+// Generate a stream of note on/offs with up to max_held keys down; this will cause some voice
+// stealing if it exceeds the number of voices.
+std::vector<NoteEvent> GenerateNoteEvents(size_t num_events, size_t max_held)
+{
+  Random random;
+  std::vector<NoteEvent> events;
+  std::vector<midi::Note> held;
+  events.reserve(num_events);
+  while (events.size() < num_events) {
+    if (held.empty() || (held.size() < max_held && random.next(3))) {
+      auto note = static_cast<midi::Note>(24 + random.next(72));
+      if (std::find(held.begin(), held.end(), note) != held.end()) continue;
+      held.push_back(note);
+      events.push_back({note, static_cast<midi::Velocity>(1 + random.next(127))});
+    } else {
+      auto i = held.begin() + random.next(static_cast<uint32_t>(held.size()));
+      events.push_back({*i, 0});
+      held.erase(i);
+    }
+  }
+  for (auto note : held) events.push_back({note, 0});
+  return events;
+}
+
+template <typename Allocator, typename... Args>
+void RunAllocator(const char *variant, const std::vector<NoteEvent> &events, Args... args)
+{
+  Allocator allocator;
+  auto ns = Measure(
+      [&]() {
+        for (auto &e : events) {
+          auto v = e.velocity ? allocator.NoteOn(e.note, e.velocity, args...)
+                              : allocator.NoteOff(e.note);
+          DoNotOptimize(v);
+        }
+      },
+      events.size());
+  Report("voice_allocator", variant, ns, "event");
+}
+
+}  // namespace
+
+PFM2SID_BENCHMARK(BM_VoiceAllocator)
+{
+  using synth::STEAL_STRATEGY;
+  using synth::VoiceAllocator;
+  using test::LinearVoiceAllocator;
+
+  const auto events_3 = GenerateNoteEvents(4096, 3 + 2);
+  RunAllocator<VoiceAllocator<3, STEAL_STRATEGY::LRU>>("indexed<3>", events_3);
+  RunAllocator<LinearVoiceAllocator<3, STEAL_STRATEGY::LRU>>("linear<3>", events_3);
+
+  const auto events_12 = GenerateNoteEvents(4096, 12 + 4);
+  RunAllocator<VoiceAllocator<12, STEAL_STRATEGY::LRU>>("indexed<12>", events_12);
+  RunAllocator<LinearVoiceAllocator<12, STEAL_STRATEGY::LRU>>("linear<12>", events_12);
+
+  const auto events_48 = GenerateNoteEvents(4096, 48 + 4);
+  RunAllocator<VoiceAllocator<48, STEAL_STRATEGY::LRU>>("indexed<48>", events_48);
+  RunAllocator<LinearVoiceAllocator<48, STEAL_STRATEGY::LRU>>("linear<48>", events_48);
+}
+
+// Different policy (filter groups), so not directly comparable with the above
+PFM2SID_BENCHMARK(BM_ChipVoiceAllocator)
+{
+  using synth::ChipVoiceAllocator;
+  using synth::STEAL_STRATEGY;
+
+  const auto events_3 = GenerateNoteEvents(4096, 3 + 2);
+  RunAllocator<ChipVoiceAllocator<1, 3, STEAL_STRATEGY::LRU>>("chip<1x3>", events_3,
+                                                               synth::FilterGroup{0});
+
+  const auto events_12 = GenerateNoteEvents(4096, 12 + 4);
+  RunAllocator<ChipVoiceAllocator<4, 3, STEAL_STRATEGY::LRU>>("chip<4x3>", events_12,
+                                                               synth::FilterGroup{0});
+
+  const auto events_48 = GenerateNoteEvents(4096, 48 + 4);
+  RunAllocator<ChipVoiceAllocator<16, 3, STEAL_STRATEGY::LRU>>("chip<16x3>", events_48,
+                                                                synth::FilterGroup{0});
+}
+
+}  // namespace pfm2sid::bench
@@ -0,0 +1,70 @@
+#include <cstdio>
+
+#include "fmt/core.h"
+#include "midi/midi_event.h"
+#include "midi/midi_parser.h"
+#include "midi_corpus.h"
+#include "pfm2sid_bench.h"
+
+// libFuzzer harness for the MIDI parser.
+//
+// Besides the sanitizer checks, this keeps track of the worst case parse cost per byte. Whenever an
+// input exceeds the previous worst, it's written to worst_case_midi.bin so it can be inspected or
+// turned into a benchmark corpus.
+//
+// The first byte of the input selects the chunk size (the low bits) and whether the channel
+// messages go through the event queue, so the chunk boundaries get fuzzed as well.
+
+namespace {
+
+using namespace pfm2sid;
+
+// Short inputs are dominated by the call overhead and timer noise
+constexpr size_t kMinTimedInputSize = 64;
+
+double worst_cycles_per_byte = 0.0;
+
+void SaveWorstCase(const uint8_t *data, size_t size, double cycles_per_byte)
+{
+  fmt::println("New worst case: {:.1f} cycles/byte, {} bytes", cycles_per_byte, size);
+  if (auto file = fopen("worst_case_midi.bin", "wb")) {
+    fwrite(data, 1, size, file);
+    fclose(file);
+  }
+}
+
+}  // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  if (size < 2) return 0;
+
+  static bench::MidiSink sink;
+  static midi::MidiEventQueue event_queue;
+  static midi::MidiParser midi_parser;
+
+  const auto chunk_size = 1 + (data[0] & 0x3f);
+  const bool use_queue = data[0] & 0x80;
+  ++data;
+  --size;
+
+  midi_parser.Reset();
+  midi_parser.Init({&sink, &sink, &sink, use_queue ? &event_queue : nullptr});
+
+  const auto start = bench::ReadCycleCounter();
+  for (size_t pos = 0; pos < size; pos += chunk_size) {
+    midi_parser.Parse(data + pos, std::min<size_t>(chunk_size, size - pos));
+    if (use_queue) midi::DispatchEvents(event_queue, sink);
+  }
+  const auto cycles = bench::ReadCycleCounter() - start;
+  bench::DoNotOptimize(sink.dirty());
+
+  if (size >= kMinTimedInputSize) {
+    const auto cycles_per_byte = static_cast<double>(cycles) / static_cast<double>(size);
+    if (cycles_per_byte > worst_cycles_per_byte) {
+      worst_cycles_per_byte = cycles_per_byte;
+      SaveWorstCase(data - 1, size + 1, cycles_per_byte);
+    }
+  }
+  return 0;
+}
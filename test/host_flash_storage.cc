@@ -0,0 +1,73 @@
+#include "host_flash_storage.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace pfm2sid::test {
+
+HostFlashStorage::HostFlashStorage(size_t num_sectors, size_t sector_size, const std::string &path)
+    : num_sectors_{num_sectors},
+      sector_size_{sector_size},
+      path_{path},
+      data_(num_sectors * sector_size, kErasedValue),
+      erases_(num_sectors, 0)
+{
+  if (path_.empty()) return;
+  if (auto f = fopen(path_.c_str(), "rb")) {
+    auto read = fread(data_.data(), 1, data_.size(), f);
+    fclose(f);
+    if (read == data_.size()) return;
+    std::fill(data_.begin(), data_.end(), kErasedValue);
+  }
+  WriteThrough(0, data_.size());
+}
+
+bool HostFlashStorage::Erase(size_t index)
+{
+  if (index >= num_sectors_ || !powered_) return false;
+  auto len = Consume(sector_size_);
+  std::fill_n(data_.begin() + static_cast<ptrdiff_t>(index * sector_size_), len, kErasedValue);
+  WriteThrough(index * sector_size_, len);
+  if (len == sector_size_) ++erases_[index];
+  return powered_;
+}
+
+bool HostFlashStorage::Program(size_t index, size_t offset, const void *data, size_t len)
+{
+  if (index >= num_sectors_ || !powered_) return false;
+  if (offset % kProgramAlignment || len % kProgramAlignment || offset + len > sector_size_)
+    return false;
+  auto dst = data_.data() + index * sector_size_ + offset;
+  if (!std::all_of(dst, dst + len, [](uint8_t value) { return kErasedValue == value; }))
+    return false;
+
+  len = Consume(len);
+  std::copy_n(static_cast<const uint8_t *>(data), len, dst);
+  WriteThrough(index * sector_size_ + offset, len);
+  return powered_;
+}
+
+size_t HostFlashStorage::Consume(size_t len)
+{
+  if (budget_ == kUnlimited) return len;
+  if (len <= budget_) {
+    budget_ -= len;
+    return len;
+  }
+  len = budget_;
+  budget_ = 0;
+  powered_ = false;
+  return len;
+}
+
+void HostFlashStorage::WriteThrough(size_t offset, size_t len)
+{
+  if (path_.empty() || !len) return;
+  auto f = fopen(path_.c_str(), "r+b");
+  if (!f) f = fopen(path_.c_str(), "w+b");
+  if (!f) return;
+  if (!fseek(f, static_cast<long>(offset), SEEK_SET)) fwrite(data_.data() + offset, 1, len, f);
+  fclose(f);
+}
+
+}  // namespace pfm2sid::test
@@ -0,0 +1,60 @@
+#ifndef PFM2SID_HOST_FLASH_STORAGE_H_
+#define PFM2SID_HOST_FLASH_STORAGE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "misc/flash_storage.h"
+
+namespace pfm2sid::test {
+
+// Flash storage in RAM, optionally written through to a file so the contents persist.
+//
+// Like the real thing, programming bytes that aren't erased fails. Power loss can be simulated
+// with a budget of bytes that can be programmed or erased; the operation that exceeds it is only
+// partially completed, and everything after that fails until PowerOn.
+class HostFlashStorage : public util::FlashStorage {
+public:
+  static constexpr uint64_t kUnlimited = ~0ULL;
+
+  HostFlashStorage(size_t num_sectors, size_t sector_size, const std::string &path = {});
+
+  size_t num_sectors() const final { return num_sectors_; }
+  size_t sector_size() const final { return sector_size_; }
+  const uint8_t *sector(size_t index) const final { return data_.data() + index * sector_size_; }
+
+  bool Erase(size_t index) final;
+  bool Program(size_t index, size_t offset, const void *data, size_t len) final;
+
+  void set_budget(uint64_t budget) { budget_ = budget; }
+  bool powered() const { return powered_; }
+  void PowerOn()
+  {
+    powered_ = true;
+    budget_ = kUnlimited;
+  }
+
+  const std::vector<uint8_t> &data() const { return data_; }
+  void set_data(const std::vector<uint8_t> &data) { data_ = data; }
+
+  uint32_t erases(size_t index) const { return erases_[index]; }
+
+private:
+  const size_t num_sectors_;
+  const size_t sector_size_;
+  const std::string path_;
+
+  std::vector<uint8_t> data_;
+  std::vector<uint32_t> erases_;
+  uint64_t budget_ = kUnlimited;
+  bool powered_ = true;
+
+  // Returns how many of len bytes can be written, and cuts the power if that's not all of them
+  size_t Consume(size_t len);
+  void WriteThrough(size_t offset, size_t len);
+};
+
+}  // namespace pfm2sid::test
+
+#endif  // PFM2SID_HOST_FLASH_STORAGE_H_
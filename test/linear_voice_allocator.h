@@ -0,0 +1,110 @@
+#ifndef PFM2SID_LINEAR_VOICE_ALLOCATOR_H_
+#define PFM2SID_LINEAR_VOICE_ALLOCATOR_H_
+
+#include <algorithm>
+#include <array>
+#include <optional>
+
+#include "misc/static_stack.h"
+#include "synth/voice_allocator.h"
+
+namespace pfm2sid::test {
+
+using synth::Note;
+using synth::STEAL_STRATEGY;
+using synth::VoiceIndex;
+
+// The original linear scan implementation of synth::VoiceAllocator, as a reference for the tests
+// and the benchmark.
+template <size_t NUM_VOICES, STEAL_STRATEGY strategy = STEAL_STRATEGY::NONE>
+class LinearVoiceAllocator {
+public:
+  static_assert(NUM_VOICES > 0);
+
+  void Clear()
+  {
+    for (auto &v : voice_pool_) v = {};
+    lru_.clear();
+    next_ = 0;
+  }
+
+  [[nodiscard]] std::optional<VoiceIndex> NoteOn(midi::Note note, midi::Velocity velocity) noexcept
+  {
+    // Find voice already playing requested note
+    auto v = Find(note);
+    if (v) {
+      lru_.erase(std::find(lru_.begin(), lru_.end(), v.value()));
+      AssignVoice(v.value(), note, velocity);
+      return v;
+    }
+
+    // Try and find free slot instead
+    v = FindFreeVoice();
+    if (v) {
+      AssignVoice(v.value(), note, velocity);
+      return v;
+    }
+
+    // All voices assigned. What next depends on provided strategy
+    if constexpr (STEAL_STRATEGY::NONE == strategy) {
+      return std::nullopt;
+    } else if constexpr (STEAL_STRATEGY::LRU == strategy) {
+      auto voice = lru_.front();
+      lru_.erase(lru_.begin());
+      AssignVoice(voice, note, velocity);
+      return voice;
+    } else {
+      // Doh
+    }
+  }
+
+  [[nodiscard]] std::optional<VoiceIndex> NoteOff(midi::Note note) noexcept
+  {
+    auto v = Find(note);
+    if (v) {
+      voice_pool_[v.value()] = {};
+      lru_.erase(std::find(lru_.begin(), lru_.end(), v.value()));
+    }
+    return v;
+  }
+
+  std::optional<VoiceIndex> Find(midi::Note note) const noexcept
+  {
+    for (VoiceIndex i = 0; i < NUM_VOICES; ++i)
+      if (voice_pool_[i].note == note) return i;
+    return std::nullopt;
+  }
+
+private:
+  std::array<Note, NUM_VOICES> voice_pool_;
+  util::StaticStack<VoiceIndex, NUM_VOICES> lru_;
+  VoiceIndex next_ = 0;
+
+  static constexpr auto next(VoiceIndex i) { return i < NUM_VOICES - 1 ? ++i : 0; }
+
+  std::optional<VoiceIndex> FindFreeVoice() const
+  {
+    auto slot = next_;
+    do {
+      if (voice_pool_[slot].is_free()) return slot;
+      slot = next(slot);
+    } while (slot != next_);
+
+    return std::nullopt;
+  }
+
+  void AssignVoice(VoiceIndex voice_index, midi::Note note, midi::Velocity velocity)
+  {
+    voice_pool_[voice_index] = {note, velocity};
+    next_ = next(voice_index);
+    lru_.emplace_back(voice_index);
+  }
+
+public:
+  auto &lru() const { return lru_; }
+  auto &voices() const { return voice_pool_; }
+};
+
+}  // namespace pfm2sid::test
+
+#endif  // PFM2SID_LINEAR_VOICE_ALLOCATOR_H_
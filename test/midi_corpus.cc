@@ -0,0 +1,114 @@
+#include "midi_corpus.h"
+
+#include "pfm2sid_bench.h"
+
+namespace pfm2sid::bench {
+
+namespace {
+uint8_t data_byte(Random &random)
+{
+  return static_cast<uint8_t>(random.next(0x80));
+}
+}  // namespace
+
+std::vector<uint8_t> GenerateAsidStream(size_t num_frames)
+{
+  Random random;
+  std::vector<uint8_t> stream;
+  for (size_t frame = 0; frame < num_frames; ++frame) {
+    stream.insert(stream.end(), {0xF0, 0x2D, 0x4E});
+    const auto num_registers = 12 + random.next(16);
+    for (int i = 0; i < 8; ++i) stream.push_back(data_byte(random));
+    for (uint32_t i = 0; i < num_registers; ++i) {
+      if (!random.next(32)) stream.push_back(0xF8);
+      stream.push_back(data_byte(random));
+    }
+    stream.push_back(0xF7);
+    if (!random.next(8)) stream.insert(stream.end(), {0x90, 0x40, 0x7F});
+  }
+  return stream;
+}
+
+std::vector<uint8_t> GenerateNoteStream(size_t num_notes)
+{
+  Random random;
+  std::vector<uint8_t> stream;
+  stream.push_back(0x90);
+  for (size_t i = 0; i < num_notes; ++i) {
+    const auto note = static_cast<uint8_t>(24 + random.next(72));
+    stream.insert(stream.end(), {note, static_cast<uint8_t>(1 + random.next(127))});
+    stream.insert(stream.end(), {note, 0x00});
+  }
+  return stream;
+}
+
+std::vector<uint8_t> GenerateControllerFlood(size_t num_messages)
+{
+  Random random;
+  std::vector<uint8_t> stream;
+  for (size_t i = 0; i < num_messages; ++i) {
+    // Mostly running status, with the occasional channel switch
+    if (!(i % 16)) stream.push_back(static_cast<uint8_t>(0xB0 | random.next(4)));
+    stream.insert(stream.end(), {static_cast<uint8_t>(16 + random.next(4)),
+                                 static_cast<uint8_t>(i & 0x7f)});
+  }
+  return stream;
+}
+
+std::vector<uint8_t> GenerateClockInterleaved(size_t num_messages)
+{
+  Random random;
+  std::vector<uint8_t> stream;
+  auto maybe_clock = [&]() {
+    if (!random.next(4)) stream.push_back(0xF8);
+  };
+  for (size_t i = 0; i < num_messages; ++i) {
+    const uint8_t status = random.next(2) ? 0x90 : 0xB0;
+    stream.push_back(status);
+    maybe_clock();
+    stream.push_back(data_byte(random));
+    maybe_clock();
+    stream.push_back(data_byte(random));
+    maybe_clock();
+  }
+  return stream;
+}
+
+std::vector<uint8_t> GenerateNoise(size_t num_bytes)
+{
+  Random random;
+  std::vector<uint8_t> stream(num_bytes);
+  for (auto &byte : stream) byte = static_cast<uint8_t>(random.next(0x100));
+  return stream;
+}
+
+std::vector<MidiCorpus> GenerateMidiCorpora(size_t num_bytes)
+{
+  return {
+      {"notes", GenerateNoteStream(num_bytes / 4)},
+      {"cc_flood", GenerateControllerFlood(num_bytes / 2)},
+      {"clock", GenerateClockInterleaved(num_bytes / 4)},
+      {"asid", GenerateAsidStream(num_bytes / 32)},
+      {"noise", GenerateNoise(num_bytes)},
+  };
+}
+
+bool MidiSink::MidiSysex(const uint8_t *data, unsigned len, midi::SYSEX_STATUS status)
+{
+  switch (status) {
+    case midi::SYSEX_STATUS::START:
+      if (!sidbits::is_asid_sysex(data)) return false;
+      asid_parser_.BeginSysex();
+      return true;
+    case midi::SYSEX_STATUS::DATA: asid_parser_.FeedSysex(data, len); return true;
+    case midi::SYSEX_STATUS::EOX:
+      asid_parser_.FeedSysex(data, len);
+      events_ += !!asid_parser_.EndSysex();
+      return true;
+    case midi::SYSEX_STATUS::ABORT: (void)asid_parser_.EndSysex(); break;
+    default: break;
+  }
+  return false;
+}
+
+}  // namespace pfm2sid::bench
@@ -0,0 +1,61 @@
+#ifndef PFM2SID_MIDI_CORPUS_H_
+#define PFM2SID_MIDI_CORPUS_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "midi/midi_parser.h"
+#include "sidbits/asid_parser.h"
+
+// Synthetic MIDI byte streams for benchmarking and seeding the parser fuzzer
+
+namespace pfm2sid::bench {
+
+struct MidiCorpus {
+  const char *name;
+  std::vector<uint8_t> data;
+};
+
+// Something resembling an ASID stream: a register update message per frame with most of the
+// registers changing, a sprinkling of MIDI clock and the occasional note.
+std::vector<uint8_t> GenerateAsidStream(size_t num_frames);
+
+// Dense note on/off stream using running status, with note offs as velocity 0 note ons
+std::vector<uint8_t> GenerateNoteStream(size_t num_notes);
+
+// Continuous controller sweeps on a few channels, e.g. from a fader box
+std::vector<uint8_t> GenerateControllerFlood(size_t num_messages);
+
+// Notes and controllers with MIDI clock bytes interleaved anywhere, including mid-message
+std::vector<uint8_t> GenerateClockInterleaved(size_t num_messages);
+
+// Random bytes, i.e. a lot of incomplete messages and orphaned data
+std::vector<uint8_t> GenerateNoise(size_t num_bytes);
+
+// All of the above with roughly the same size
+std::vector<MidiCorpus> GenerateMidiCorpora(size_t num_bytes = 8192);
+
+// Handles everything the parser can dispatch, and decodes ASID incrementally
+class MidiSink : public midi::MidiHandler, public midi::MidiHandlerSys, public midi::MidiHandlerRT {
+public:
+  MidiSink() : midi::MidiHandler(midi::ALL_CHANNELS) {}
+
+  void MidiNoteOff(midi::Channel, midi::Note note, midi::Velocity) final { events_ += note; }
+  void MidiNoteOn(midi::Channel, midi::Note note, midi::Velocity) final { events_ += note; }
+  void MidiControlChange(midi::Channel, uint8_t, uint8_t value) final { events_ += value; }
+  void MidiPitchbend(midi::Channel, int16_t value) final { events_ += static_cast<uint32_t>(value); }
+  void MidiClock() final { ++events_; }
+
+  bool MidiSysex(const uint8_t *data, unsigned len, midi::SYSEX_STATUS status) final;
+
+  auto events() const { return events_; }
+  uint32_t dirty() { return asid_parser_.take_dirty(); }
+
+private:
+  sidbits::ASIDParser asid_parser_;
+  uint32_t events_ = 0;
+};
+
+}  // namespace pfm2sid::bench
+
+#endif  // PFM2SID_MIDI_CORPUS_H_
@@ -0,0 +1,54 @@
+#include "pfm2sid_bench.h"
+
+#include <cstring>
+
+#include "fmt/core.h"
+
+namespace pfm2sid::bench {
+
+namespace {
+struct Benchmark {
+  const char *name;
+  BenchmarkFn fn;
+};
+
+// Function-local so registration order across translation units doesn't matter
+Benchmark *benchmarks(size_t **count)
+{
+  static Benchmark registry[64];
+  static size_t num_benchmarks = 0;
+  *count = &num_benchmarks;
+  return registry;
+}
+}  // namespace
+
+Registration::Registration(const char *name, BenchmarkFn fn)
+{
+  size_t *count;
+  auto registry = benchmarks(&count);
+  if (*count < 64) registry[(*count)++] = {name, fn};
+}
+
+void Report(const char *benchmark, const char *variant, double ns_per_op, const char *op)
+{
+  fmt::println("{:<32} {:<32} {:10.2f} ns/{}", benchmark, variant, ns_per_op, op);
+}
+
+}  // namespace pfm2sid::bench
+
+// Usage: pfm2sid_bench [filter]
+// Runs all benchmarks whose name contains the filter string.
+int main(int argc, char **argv)
+{
+  using namespace pfm2sid::bench;
+
+  const char *filter = argc > 1 ? argv[1] : nullptr;
+
+  size_t *count;
+  auto registry = benchmarks(&count);
+  for (size_t i = 0; i < *count; ++i) {
+    if (filter && !strstr(registry[i].name, filter)) continue;
+    registry[i].fn();
+  }
+  return 0;
+}
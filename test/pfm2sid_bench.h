@@ -0,0 +1,107 @@
+#ifndef PFM2SID_BENCH_H_
+#define PFM2SID_BENCH_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Minimal host benchmark harness. These are mostly useful to compare implementations relative to
+// each other; absolute numbers on the host don't say much about the STM32.
+
+namespace pfm2sid::bench {
+
+// Prevent the compiler from optimizing away a result
+template <typename T>
+inline void DoNotOptimize(const T &value)
+{
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Call fn repeatedly for a minimum time, and return the best time per op in ns over a few runs.
+// Each call of fn is assumed to perform ops_per_call operations.
+template <typename F>
+double Measure(F &&fn, size_t ops_per_call = 1)
+{
+  using clock = std::chrono::steady_clock;
+  static constexpr auto kMinDuration = std::chrono::milliseconds(20);
+  static constexpr int kRuns = 5;
+
+  fn();  // warm-up, and find a rough iteration count
+  size_t iterations = 1;
+  for (;;) {
+    auto start = clock::now();
+    for (size_t i = 0; i < iterations; ++i) fn();
+    if (clock::now() - start >= kMinDuration / 4) break;
+    iterations *= 2;
+  }
+
+  double best = 0.0;
+  for (int run = 0; run < kRuns; ++run) {
+    auto start = clock::now();
+    for (size_t i = 0; i < iterations; ++i) fn();
+    std::chrono::duration<double, std::nano> elapsed = clock::now() - start;
+    auto ns = elapsed.count() / static_cast<double>(iterations * ops_per_call);
+    if (!run || ns < best) best = ns;
+  }
+  return best;
+}
+
+// Host cycle counter, if there is one. Returns 0 otherwise.
+inline uint64_t ReadCycleCounter()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#else
+  return 0;
+#endif
+}
+
+// Like Measure, but returns the best number of cycles per op (or 0 if there's no counter)
+template <typename F>
+double MeasureCycles(F &&fn, size_t ops_per_call = 1, size_t iterations = 64)
+{
+  static constexpr int kRuns = 5;
+
+  fn();
+  uint64_t best = 0;
+  for (int run = 0; run < kRuns; ++run) {
+    auto start = ReadCycleCounter();
+    for (size_t i = 0; i < iterations; ++i) fn();
+    auto cycles = ReadCycleCounter() - start;
+    if (!run || cycles < best) best = cycles;
+  }
+  return static_cast<double>(best) / static_cast<double>(iterations * ops_per_call);
+}
+
+void Report(const char *benchmark, const char *variant, double ns_per_op, const char *op = "op");
+
+using BenchmarkFn = void (*)();
+
+struct Registration {
+  Registration(const char *name, BenchmarkFn fn);
+};
+
+// Simple deterministic PRNG so runs are comparable
+class Random {
+public:
+  explicit Random(uint32_t seed = 0x5eed) : state_(seed) {}
+
+  uint32_t next()
+  {
+    state_ = state_ * 1664525U + 1013904223U;
+    return state_ >> 8;
+  }
+  uint32_t next(uint32_t range) { return next() % range; }
+
+private:
+  uint32_t state_;
+};
+
+}  // namespace pfm2sid::bench
+
+#define PFM2SID_BENCHMARK(name)                                                            \
+  static void name();                                                                      \
+  static const ::pfm2sid::bench::Registration name##_registration{#name, name}; \
+  static void name()
+
+#endif  // PFM2SID_BENCH_H_
@@ -0,0 +1,167 @@
+#include <vector>
+
+#include "fmt/core.h"
+#include "gtest/gtest.h"
+#include "sidbits/asid_jitter_buffer.h"
+#include "sidbits/asid_parser.h"
+
+namespace pfm2sid::test {
+
+using sidbits::ASIDJitterBuffer;
+
+static constexpr unsigned kBlockSize = 32;
+static constexpr uint32_t kPeriod = 882;  // 50Hz @ 44.1kHz
+
+// Frame n writes n to register 0
+static ASIDJitterBuffer::FrameWrites MakeFrame(uint8_t n)
+{
+  ASIDJitterBuffer::FrameWrites frame_writes;
+  frame_writes.push_back(0, 0, n);
+  frame_writes.push_back(0, 4, 0x41);
+  return frame_writes;
+}
+
+// Push frames at their arrival times and render blocks in between; returns the release time of
+// each frame.
+static std::vector<uint32_t> ReleaseFrames(ASIDJitterBuffer &jitter_buffer,
+                                           const std::vector<uint32_t> &arrivals)
+{
+  std::vector<uint32_t> releases;
+  size_t next = 0;
+  for (uint32_t block_start = 0; releases.size() < arrivals.size(); block_start += kBlockSize) {
+    while (next < arrivals.size() && arrivals[next] <= block_start) {
+      jitter_buffer.Push(arrivals[next], MakeFrame(static_cast<uint8_t>(next)));
+      ++next;
+    }
+    jitter_buffer.Render(block_start, kBlockSize);
+    for (auto &w : jitter_buffer.block_writes()) {
+      if (!w.reg) {
+        EXPECT_EQ(releases.size(), w.value);
+        releases.push_back(block_start + w.offset);
+      }
+    }
+    if (block_start > arrivals.back() + 100 * kPeriod) break;
+  }
+  return releases;
+}
+
+TEST(ASIDJitterBufferTest, Bursts)
+{
+  ASIDJitterBuffer jitter_buffer;
+  jitter_buffer.Init(kPeriod);
+  jitter_buffer.Reset(nullptr);
+  jitter_buffer.set_latency(3 * kPeriod);
+  jitter_buffer.set_depth(8);
+
+  // Frames sent every period, but they arrive in clumps of three
+  std::vector<uint32_t> arrivals;
+  for (uint32_t i = 0; i < 64; ++i) arrivals.push_back(1000 + (i / 3) * 3 * kPeriod + (i % 3) * 5);
+
+  auto releases = ReleaseFrames(jitter_buffer, arrivals);
+  ASSERT_EQ(arrivals.size(), releases.size());
+
+  fmt::println("period={:.2f} late={} overflow={}", jitter_buffer.period(),
+               jitter_buffer.stats().late, jitter_buffer.stats().overflow);
+  EXPECT_NEAR(kPeriod, jitter_buffer.period(), 5.f);
+  EXPECT_EQ(0U, jitter_buffer.stats().overflow);
+
+  // Once the estimate has settled, frames are released at the original cadence
+  for (size_t i = 24; i < releases.size(); ++i)
+    EXPECT_NEAR(kPeriod, releases[i] - releases[i - 1], kPeriod / 20) << i;
+}
+
+TEST(ASIDJitterBufferTest, Multispeed)
+{
+  ASIDJitterBuffer jitter_buffer;
+  jitter_buffer.Init(kPeriod);
+  jitter_buffer.Reset(nullptr);
+  jitter_buffer.set_latency(kPeriod);
+
+  std::vector<uint32_t> arrivals;
+  for (uint32_t i = 0; i < 64; ++i) arrivals.push_back(i * kPeriod / 4 + (i & 1) * 40);
+
+  auto releases = ReleaseFrames(jitter_buffer, arrivals);
+  ASSERT_EQ(arrivals.size(), releases.size());
+  EXPECT_NEAR(kPeriod / 4, jitter_buffer.period(), 2.f);
+  EXPECT_NEAR(kPeriod / 4, releases.back() - releases[releases.size() - 2], kPeriod / 40);
+}
+
+TEST(ASIDJitterBufferTest, Overflow)
+{
+  ASIDJitterBuffer jitter_buffer;
+  jitter_buffer.Init(kPeriod);
+  jitter_buffer.Reset(nullptr);
+  jitter_buffer.set_latency(10 * kPeriod);
+  jitter_buffer.set_depth(2);
+
+  for (uint8_t i = 0; i < 4; ++i) jitter_buffer.Push(i * kPeriod, MakeFrame(i));
+  EXPECT_EQ(2U, jitter_buffer.fill());
+  EXPECT_EQ(2U, jitter_buffer.stats().overflow);
+
+  // The dropped frames are applied immediately
+  EXPECT_EQ(1, jitter_buffer.register_map().peek(0));
+  EXPECT_EQ(0x41, jitter_buffer.register_map().peek(4));
+
+  jitter_buffer.Render(0, kBlockSize);
+  EXPECT_TRUE(jitter_buffer.block_writes().empty());
+  jitter_buffer.Render(12 * kPeriod, kBlockSize);
+  ASSERT_EQ(2U, jitter_buffer.block_writes().size());
+  EXPECT_EQ(2, jitter_buffer.block_writes().begin()->value);
+  EXPECT_EQ(0, jitter_buffer.block_writes().begin()->offset);
+
+  // The map is the state at the start of the block
+  EXPECT_EQ(1, jitter_buffer.register_map().peek(0));
+  jitter_buffer.Render(12 * kPeriod + kBlockSize, kBlockSize);
+  EXPECT_EQ(2, jitter_buffer.register_map().peek(0));
+}
+
+TEST(ASIDJitterBufferTest, ParserFrameWrites)
+{
+  // All registers, so the control registers are written twice
+  sidbits::ASIDParser parser;
+  const uint8_t data[] = {0x2d, 0x4e, 0x7f, 0x7f, 0x7f, 0x7f, 0x00, 0x00, 0x00, 0x00,
+                          0,    1,    2,    3,    5,    6,    7,    8,    9,    10,
+                          12,   13,   14,   15,   16,   17,   19,   20,   21,   22,
+                          23,   24,   0x11, 0x21, 0x41, 0x10, 0x20, 0x40};
+  ASSERT_TRUE(parser.ParseSysex(data, sizeof(data)));
+  ASSERT_EQ(28U, parser.frame_writes().size());
+  auto w = parser.frame_writes().begin();
+  EXPECT_EQ(4, w[22].reg);
+  EXPECT_EQ(0x11, w[22].value);
+  EXPECT_EQ(4, w[25].reg);
+  EXPECT_EQ(0x10, w[25].value);
+}
+
+TEST(ASIDJitterBufferTest, MultiSID)
+{
+  ASIDJitterBuffer jitter_buffer;
+  jitter_buffer.Init(kPeriod);
+  jitter_buffer.Reset(nullptr);
+  jitter_buffer.set_latency(kPeriod);
+  jitter_buffer.set_depth(4);
+
+  // The other chips are part of the first chip's frame
+  jitter_buffer.Push(0, MakeFrame(1));
+  jitter_buffer.Push(0, MakeFrame(2), 1);
+  jitter_buffer.Push(0, MakeFrame(3), 2);
+  EXPECT_EQ(1U, jitter_buffer.fill());
+  EXPECT_EQ(1U, jitter_buffer.stats().frames);
+
+  jitter_buffer.Render(kPeriod, kBlockSize);
+  for (unsigned chip = 0; chip < ASIDJitterBuffer::kMaxChips; ++chip) {
+    auto &block_writes = jitter_buffer.register_writes()[chip];
+    ASSERT_EQ(2U, block_writes.size()) << chip;
+    EXPECT_EQ(0, block_writes.begin()->reg);
+    EXPECT_EQ(chip + 1, block_writes.begin()->value);
+  }
+  jitter_buffer.Render(kPeriod + kBlockSize, kBlockSize);
+  for (unsigned chip = 0; chip < ASIDJitterBuffer::kMaxChips; ++chip)
+    EXPECT_EQ(chip + 1, jitter_buffer.register_maps()[chip].peek(0));
+
+  // Without a pending frame the writes are applied immediately
+  jitter_buffer.Push(2 * kPeriod, MakeFrame(4), 1);
+  EXPECT_EQ(0U, jitter_buffer.fill());
+  EXPECT_EQ(4, jitter_buffer.register_map(1).peek(0));
+}
+
+}  // namespace pfm2sid::test
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "fmt/core.h"
 #include "gtest/gtest.h"
 #include "pfm2sid_test.h"
@@ -79,4 +81,90 @@ TEST(ASIDParserTest, lcd)
   }
 }
 
+TEST(ASIDParserTest, Incremental)
+{
+  uint8_t data[2 + 8 + 28] = {0x2d, 0x4e, 0x7f, 0x7f, 0x7f, 0x7f, 0x55, 0x2a, 0x55, 0x2a};
+  for (uint8_t r = 0x0; r < 28; ++r) data[10 + r] = r;
+
+  ASIDParser expected;
+  ASSERT_TRUE(expected.ParseSysex(data, sizeof(data)));
+
+  for (size_t chunk_size : {1, 3, 7, 16}) {
+    ASIDParser parser;
+    parser.BeginSysex();
+    for (size_t pos = 0; pos < sizeof(data); pos += chunk_size)
+      parser.FeedSysex(data + pos, std::min(chunk_size, sizeof(data) - pos));
+    auto r = parser.EndSysex();
+    ASSERT_TRUE(r);
+    EXPECT_EQ(28, r.value());
+    for (uint8_t reg = 0; reg < sidbits::SID_REGISTER_COUNT; ++reg)
+      EXPECT_EQ(expected.register_map().peek(reg), parser.register_map().peek(reg)) << chunk_size;
+  }
+
+  // Incomplete header
+  ASIDParser parser;
+  parser.BeginSysex();
+  parser.FeedSysex(data, 9);
+  EXPECT_FALSE(parser.EndSysex());
+  EXPECT_FALSE(parser.active());
+
+  // Truncated data still writes the registers so far
+  parser.BeginSysex();
+  parser.FeedSysex(data, 12);
+  auto r = parser.EndSysex();
+  ASSERT_TRUE(r);
+  EXPECT_EQ(2, r.value());
+}
+
+TEST(ASIDParserTest, Dirty)
+{
+  ASIDParser parser;
+  parser.Reset();
+  EXPECT_EQ(sidbits::RegisterMap::kAllDirty, parser.take_dirty());
+  EXPECT_EQ(0U, parser.take_dirty());
+
+  // Registers 0 and 5 (ASID index 4)
+  const uint8_t data[] = {0x2d, 0x4e, 0x11, 0x00, 0x00, 0x00, 0x11, 0x00, 0x00, 0x00, 0x7f, 0x70};
+  ASSERT_TRUE(parser.ParseSysex(data, sizeof(data)));
+  EXPECT_EQ((1U << 0) | (1U << 5), parser.take_dirty());
+
+  // Unchanged values aren't dirty
+  ASSERT_TRUE(parser.ParseSysex(data, sizeof(data)));
+  EXPECT_EQ(0U, parser.take_dirty());
+
+  parser.Resync();
+  EXPECT_EQ(sidbits::RegisterMap::kAllDirty, parser.take_dirty());
+}
+
+TEST(ASIDParserTest, MultiSID)
+{
+  ASIDParser parser;
+  parser.Reset();
+  EXPECT_EQ(1U, parser.num_chips());
+  for (unsigned chip = 0; chip < ASIDParser::kMaxChips; ++chip) (void)parser.take_dirty(chip);
+
+  // Register 0 on the third chip, then register 5 on the second
+  const uint8_t sid3[] = {0x2d, 0x51, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x33};
+  ASSERT_TRUE(parser.ParseSysex(sid3, sizeof(sid3)));
+  EXPECT_EQ(3U, parser.num_chips());
+  EXPECT_EQ(2U, parser.frame_chip());
+  EXPECT_EQ(0x33, parser.register_map(2).peek(0));
+  EXPECT_EQ(1U, parser.take_dirty(2));
+
+  const uint8_t sid2[] = {0x2d, 0x50, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x22};
+  ASSERT_TRUE(parser.ParseSysex(sid2, sizeof(sid2)));
+  EXPECT_EQ(3U, parser.num_chips());
+  EXPECT_EQ(1U, parser.frame_chip());
+  EXPECT_EQ(0x22, parser.register_map(1).peek(5));
+  EXPECT_EQ(1U << 5, parser.take_dirty(1));
+
+  // The first chip is untouched
+  EXPECT_EQ(0U, parser.take_dirty(0));
+  EXPECT_EQ(0, parser.register_map(0).peek(0));
+
+  parser.Reset();
+  EXPECT_EQ(1U, parser.num_chips());
+  EXPECT_EQ(0, parser.register_map(2).peek(0));
+}
+
 }  // namespace pfm2sid::test
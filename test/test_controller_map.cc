@@ -0,0 +1,162 @@
+#include <vector>
+
+#include "fmt/core.h"
+#include "gtest/gtest.h"
+#include "synth/controller_map.h"
+
+namespace pfm2sid::test {
+
+using synth::GLOBAL;
+using synth::LFO;
+using synth::VOICE;
+
+class ParameterListener : public synth::ParameterListener {
+public:
+  void ParametersChanged(const synth::ChangeSet &changes) final
+  {
+    ++notifications_;
+    changes.for_each_global([this](GLOBAL parameter) {
+      fmt::println("GlobalParameterChanged {}", util::enum_to_i(parameter));
+      changes_.push_back(parameter);
+    });
+  }
+
+  int notifications_ = 0;
+  std::vector<GLOBAL> changes_;
+};
+
+class ControllerMapTest : public ::testing::Test {
+public:
+  void SetUp() final
+  {
+    controller_map_.Init(&parameters_, &system_parameters_, &change_notifier_);
+    change_notifier_.register_listener(&listener_);
+  }
+
+protected:
+  synth::Parameters parameters_;
+  synth::SystemParameters system_parameters_;
+  synth::ChangeNotifier change_notifier_;
+  synth::ControllerMap controller_map_;
+  ParameterListener listener_;
+
+  void NRPN(uint16_t nrpn, uint16_t value)
+  {
+    controller_map_.ControlChange(99, static_cast<uint8_t>(nrpn >> 7));
+    controller_map_.ControlChange(98, nrpn & 0x7f);
+    controller_map_.ControlChange(6, static_cast<uint8_t>(value >> 7));
+    controller_map_.ControlChange(38, value & 0x7f);
+  }
+};
+
+TEST_F(ControllerMapTest, Scaling)
+{
+  EXPECT_TRUE(controller_map_.Map(20, GLOBAL::FILTER_FREQ));
+  auto freq = parameters_.get<GLOBAL::FILTER_FREQ>();
+
+  EXPECT_TRUE(controller_map_.ControlChange(20, 0));
+  EXPECT_EQ(freq.desc()->min_value, freq.value());
+  EXPECT_TRUE(controller_map_.ControlChange(20, 127));
+  EXPECT_EQ(freq.desc()->max_value, freq.value());
+
+  EXPECT_FALSE(controller_map_.ControlChange(21, 127));
+  EXPECT_FALSE(controller_map_.Map(6, GLOBAL::FILTER_FREQ));
+  EXPECT_FALSE(controller_map_.Map(99, GLOBAL::FILTER_FREQ));
+}
+
+TEST_F(ControllerMapTest, Coalesce)
+{
+  controller_map_.Map(20, GLOBAL::FILTER_FREQ);
+  controller_map_.Map(21, GLOBAL::FILTER_RES);
+  for (uint8_t i = 0; i < 128; ++i) {
+    controller_map_.ControlChange(20, i);
+    controller_map_.ControlChange(21, 127 - i);
+  }
+  EXPECT_TRUE(listener_.changes_.empty());
+
+  change_notifier_.Dispatch();
+  EXPECT_EQ(1, listener_.notifications_);
+  ASSERT_EQ(2U, listener_.changes_.size());
+  EXPECT_EQ(GLOBAL::FILTER_FREQ, listener_.changes_[0]);
+  EXPECT_EQ(GLOBAL::FILTER_RES, listener_.changes_[1]);
+  EXPECT_FALSE(change_notifier_.changes_pending());
+
+  // No change in value, no notification
+  controller_map_.ControlChange(20, 127);
+  EXPECT_FALSE(change_notifier_.changes_pending());
+  change_notifier_.Dispatch();
+  EXPECT_EQ(1, listener_.notifications_);
+}
+
+TEST_F(ControllerMapTest, Voices)
+{
+  controller_map_.Map(20, VOICE::ENV_A);
+  controller_map_.Map(21, VOICE::ENV_D, sidbits::VOICE2);
+
+  controller_map_.ControlChange(20, 127);
+  controller_map_.ControlChange(21, 127);
+  for (auto voice : {sidbits::VOICE1, sidbits::VOICE2, sidbits::VOICE3}) {
+    EXPECT_EQ(15, parameters_.get<VOICE::ENV_A>(voice).value());
+    EXPECT_EQ(sidbits::VOICE2 == voice ? 15 : 0, parameters_.get<VOICE::ENV_D>(voice).value());
+  }
+
+  controller_map_.ControlChange(20, 0);
+  EXPECT_EQ(0, parameters_.get<VOICE::ENV_A>(sidbits::VOICE3).value());
+
+  // Default mapping
+  controller_map_.ControlChange(76, 127);
+  EXPECT_EQ(127, (parameters_.get<synth::LFO1, LFO::RATE>().value()));
+  EXPECT_EQ(63, (parameters_.get<synth::LFO2, LFO::RATE>().value()));
+}
+
+TEST_F(ControllerMapTest, NRPN)
+{
+  auto pwm = parameters_.get<VOICE::OSC_PWM>(sidbits::VOICE1);
+
+  // Default layout, 14-bit resolution
+  const uint16_t nrpn = (4 << 7) | util::enum_to_i(VOICE::OSC_PWM);
+  NRPN(nrpn, 0);
+  EXPECT_EQ(0, pwm.value());
+  NRPN(nrpn, 0x3fff);
+  EXPECT_EQ(4095, pwm.value());
+  NRPN(nrpn, 0x2000);
+  EXPECT_EQ(2048, pwm.value());
+
+  EXPECT_TRUE(controller_map_.MapNrpn(0x1234, GLOBAL::FILTER_RES));
+  NRPN(0x1234, 0x3fff);
+  EXPECT_EQ(15, parameters_.get<GLOBAL::FILTER_RES>().value());
+
+  controller_map_.UnmapNrpn(0x1234);
+  EXPECT_EQ(nullptr, controller_map_.nrpn_mapping(0x1234));
+  EXPECT_NE(nullptr, controller_map_.nrpn_mapping(nrpn));
+
+  // Data entry after RPN select is ignored
+  controller_map_.ControlChange(101, 0);
+  EXPECT_FALSE(controller_map_.ControlChange(6, 0));
+  EXPECT_EQ(2048, pwm.value());
+}
+
+TEST_F(ControllerMapTest, NrpnTable)
+{
+  // Fill the table, all entries should still be found
+  uint16_t end = 0x2000;
+  while (controller_map_.MapNrpn(end, GLOBAL::VOLUME)) ++end;
+  fmt::println("{} free NRPN entries", end - 0x2000);
+  EXPECT_LT(0x2000, end);
+
+  for (uint16_t nrpn = 0x2000; nrpn < end; ++nrpn) {
+    auto mapping = controller_map_.nrpn_mapping(nrpn);
+    ASSERT_NE(nullptr, mapping);
+    EXPECT_EQ(GLOBAL::VOLUME, mapping->desc->parameter.global_param);
+  }
+
+  // Removing entries mustn't break the probe chains of others
+  for (uint16_t nrpn = 0x2000; nrpn < end; nrpn += 2) controller_map_.UnmapNrpn(nrpn);
+  for (uint16_t nrpn = 0x2000; nrpn < end; ++nrpn)
+    EXPECT_EQ(!!(nrpn & 1), !!controller_map_.nrpn_mapping(nrpn)) << nrpn;
+  for (uint16_t p = 0; p < synth::kNumGlobalParameters; ++p)
+    EXPECT_NE(nullptr, controller_map_.nrpn_mapping(p));
+  EXPECT_TRUE(controller_map_.MapNrpn(0x2000, GLOBAL::VOLUME));
+}
+
+}  // namespace pfm2sid::test
@@ -0,0 +1,83 @@
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "misc/format.h"
+#include "misc/platform.h"
+
+// Truncation is intentional here
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wformat-truncation"
+#endif
+
+namespace pfm2sid::test {
+
+// Compare against snprintf, including the truncation at the display width
+#define EXPECT_FORMAT(...)                                                       \
+  do {                                                                           \
+    char expected[64];                                                           \
+    char actual[64];                                                             \
+    snprintf(expected, sizeof(expected), __VA_ARGS__);                           \
+    auto n = util::Format(actual, sizeof(actual), __VA_ARGS__);                  \
+    EXPECT_EQ(std::string(expected), std::string(actual, n));                    \
+    snprintf(expected, 21, __VA_ARGS__);                                         \
+    n = util::Format(actual, 20, __VA_ARGS__);                                   \
+    EXPECT_EQ(std::string(expected), std::string(actual, n));                    \
+  } while (0)
+
+TEST(FormatTest, Integers)
+{
+  EXPECT_FORMAT("%d", 0);
+  EXPECT_FORMAT("%d %i", -12345, 678);
+  EXPECT_FORMAT("%5d|%-5d|%05d", 42, 42, -42);
+  EXPECT_FORMAT("%02d:%02d", 3, 59);
+  EXPECT_FORMAT("%u %lu %5ld", 4000000000U, 1234567UL, (long)-1000);
+  EXPECT_FORMAT("%x %X %02X %04x", 0xdeadU, 0xbeefU, 0x7U, 0xabU);
+  EXPECT_FORMAT("%" PRIu32 " %4" PRIu32 " %-5" PRIu32 "|", UINT32_MAX, uint32_t{12}, uint32_t{7});
+  EXPECT_FORMAT("%zu %hhu %hd", sizeof(int), (unsigned char)200, (short)-3);
+  EXPECT_FORMAT("%.3d %5.2d %.0d|", 7, 7, 0);
+  EXPECT_FORMAT("%*d %-*d|", 4, 1, 4, 2);
+  EXPECT_FORMAT("%d", INT32_MIN);
+}
+
+TEST(FormatTest, Strings)
+{
+  EXPECT_FORMAT("%s", "");
+  EXPECT_FORMAT("%-16s|", "Patch");
+  EXPECT_FORMAT("%5s|%5s", "off", "toolong");
+  EXPECT_FORMAT("%-20.20s", "A very long name that doesn't fit");
+  EXPECT_FORMAT("[%.*s]", 4, "abcdefgh");
+  EXPECT_FORMAT("%c%-18s%c", '<', "Voice1 OSC", '>');
+  EXPECT_FORMAT("%20s", "");
+  EXPECT_FORMAT("100%%");
+}
+
+TEST(FormatTest, Floats)
+{
+  EXPECT_FORMAT("%5.1f%%", PRINT_F32(12.34f));
+  EXPECT_FORMAT("%3.0f%%", PRINT_F32(99.7f));
+  EXPECT_FORMAT("%4.1fx", PRINT_F32(44.1f));
+  EXPECT_FORMAT("%6.2fms", PRINT_F32(0.72562f));
+  EXPECT_FORMAT("%.3f %f", PRINT_F32(-1.0627f), PRINT_F32(3.25f));
+  EXPECT_FORMAT("%06.2f|%-7.1f|", PRINT_F32(-2.5f), PRINT_F32(9.96f));
+  EXPECT_FORMAT("%.0f %.1f", PRINT_F32(0.4f), PRINT_F32(0.96f));
+  EXPECT_FORMAT("%8.3f", PRINT_F32(123456.f));
+
+  char buf[8];
+  auto n = util::Format(buf, sizeof(buf), "%f", PRINT_F32(1e20f));
+  EXPECT_EQ("inf", std::string(buf, n));
+}
+
+TEST(FormatTest, Truncation)
+{
+  char buf[8] = {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'};
+  EXPECT_EQ(4U, util::Format(buf, 4, "%d", 1234567));
+  EXPECT_EQ("1234xxxx", std::string(buf, sizeof(buf)));
+
+  EXPECT_EQ(3U, util::FormatString(buf, 4, "%s", "abcdef"));
+  EXPECT_STREQ("abc", buf);
+  EXPECT_EQ(0U, util::FormatString(buf, 0, "%s", "abcdef"));
+}
+
+}  // namespace pfm2sid::test
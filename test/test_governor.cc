@@ -0,0 +1,132 @@
+#include <algorithm>
+
+#include "gtest/gtest.h"
+#include "synth/governor.h"
+
+namespace pfm2sid::test {
+
+using synth::Governor;
+
+static constexpr uint32_t kBudget = 120000;
+static constexpr uint32_t kOverload = kBudget;
+static constexpr uint32_t kIdle = kBudget / 2;
+
+// Returns the number of blocks until the level changed, or 0 if it didn't
+static uint32_t RunBlocks(Governor &governor, uint32_t cycles, uint32_t max_blocks)
+{
+  for (uint32_t i = 1; i <= max_blocks; ++i) {
+    if (governor.Update(cycles)) return i;
+  }
+  return 0;
+}
+
+TEST(GovernorTest, Basics)
+{
+  Governor governor;
+  governor.Init(kBudget);
+  EXPECT_EQ(0U, governor.level());
+  EXPECT_EQ(4U, governor.num_levels());
+  EXPECT_EQ(Governor::DEGRADE_NONE, governor.degrade());
+
+  EXPECT_EQ(0U, RunBlocks(governor, kBudget * 85 / 100, 10 * Governor::kBlocksPerSecond));
+  EXPECT_EQ(0U, RunBlocks(governor, kIdle, 10 * Governor::kBlocksPerSecond));
+  EXPECT_EQ(0U, governor.level());
+  EXPECT_EQ(kBudget / 2, governor.load());
+  EXPECT_EQ(50U, governor.load_percent());
+}
+
+TEST(GovernorTest, Overload)
+{
+  Governor governor;
+  governor.Init(kBudget);
+
+  // Nothing happens until it settled
+  auto blocks = RunBlocks(governor, kOverload, 1000);
+  EXPECT_EQ(Governor::kSettleBlocks, blocks);
+  EXPECT_EQ(1U, governor.level());
+  EXPECT_EQ(Governor::DEGRADE_MOD_SMOOTHING, governor.degrade());
+
+  EXPECT_EQ(Governor::kSettleBlocks, RunBlocks(governor, kOverload, 1000));
+  EXPECT_EQ(Governor::kSettleBlocks, RunBlocks(governor, kOverload, 1000));
+  EXPECT_EQ(3U, governor.level());
+  EXPECT_TRUE(governor.degrade() & Governor::DEGRADE_SECONDARY_SIDS);
+
+  // That's all there is
+  EXPECT_EQ(0U, RunBlocks(governor, kOverload, 1000));
+  EXPECT_EQ(3U, governor.level());
+  EXPECT_EQ(3U, governor.stats().downgrades);
+  EXPECT_EQ(3U, governor.stats().max_level);
+}
+
+TEST(GovernorTest, Recover)
+{
+  Governor governor;
+  governor.Init(kBudget);
+  RunBlocks(governor, kOverload, 1000);
+  RunBlocks(governor, kOverload, 1000);
+  ASSERT_EQ(2U, governor.level());
+
+  // Between the thresholds it stays put
+  EXPECT_EQ(0U, RunBlocks(governor, kBudget * 80 / 100, 10 * Governor::kBlocksPerSecond));
+
+  // The average takes a few blocks to drop
+  auto blocks = RunBlocks(governor, kIdle, 10 * Governor::kBlocksPerSecond);
+  EXPECT_GE(blocks, Governor::kRecoverBlocks);
+  EXPECT_LT(blocks, Governor::kRecoverBlocks + 8);
+  EXPECT_EQ(1U, governor.level());
+  EXPECT_GE(RunBlocks(governor, kIdle, 10 * Governor::kBlocksPerSecond), Governor::kRecoverBlocks);
+  EXPECT_EQ(0U, governor.level());
+  EXPECT_EQ(2U, governor.stats().upgrades);
+  EXPECT_EQ(2U, governor.stats().max_level);
+}
+
+TEST(GovernorTest, Backoff)
+{
+  Governor governor;
+  governor.Init(kBudget);
+  RunBlocks(governor, kOverload, 1000);
+  ASSERT_EQ(1U, governor.level());
+
+  // Each time the step up fails, the next attempt takes twice as long. Counting only starts once
+  // the level has settled.
+  uint32_t recover_blocks = Governor::kRecoverBlocks;
+  for (int i = 0; i < 6; ++i) {
+    auto blocks = RunBlocks(governor, kIdle, 20 * Governor::kBlocksPerSecond);
+    EXPECT_GE(blocks, recover_blocks);
+    EXPECT_LE(blocks, recover_blocks + Governor::kSettleBlocks);
+    ASSERT_EQ(0U, governor.level());
+    ASSERT_EQ(Governor::kSettleBlocks, RunBlocks(governor, kOverload, 1000));
+    ASSERT_EQ(1U, governor.level());
+    recover_blocks = std::min(recover_blocks * 2, Governor::kMaxRecoverBlocks);
+  }
+
+  // An overload long after the last step up starts over
+  auto blocks = RunBlocks(governor, kIdle, 20 * Governor::kBlocksPerSecond);
+  ASSERT_EQ(0U, governor.level());
+  EXPECT_GE(blocks, Governor::kMaxRecoverBlocks);
+  EXPECT_EQ(0U, RunBlocks(governor, kIdle, Governor::kRetryBlocks));
+  RunBlocks(governor, kOverload, 1000);
+  ASSERT_EQ(1U, governor.level());
+  blocks = RunBlocks(governor, kIdle, 20 * Governor::kBlocksPerSecond);
+  EXPECT_LE(blocks, Governor::kRecoverBlocks + Governor::kSettleBlocks);
+}
+
+TEST(GovernorTest, Levels)
+{
+  static constexpr uint8_t kLevels[] = {Governor::DEGRADE_SECONDARY_SIDS};
+
+  Governor governor;
+  governor.set_levels(kLevels);
+  governor.Init(kBudget);
+  EXPECT_EQ(2U, governor.num_levels());
+
+  RunBlocks(governor, kOverload, 1000);
+  EXPECT_EQ(Governor::DEGRADE_SECONDARY_SIDS, governor.degrade());
+  EXPECT_EQ(0U, RunBlocks(governor, kOverload, 1000));
+
+  governor.Reset();
+  EXPECT_EQ(0U, governor.level());
+  EXPECT_EQ(0U, governor.stats().downgrades);
+}
+
+}  // namespace pfm2sid::test
@@ -0,0 +1,52 @@
+#include <vector>
+
+#include "fmt/core.h"
+#include "gtest/gtest.h"
+#include "misc/lru_list.h"
+
+namespace pfm2sid::test {
+
+template <size_t N>
+static std::vector<size_t> ToVector(const util::LruList<N> &list)
+{
+  std::vector<size_t> v;
+  for (auto i : list) v.push_back(i);
+  return v;
+}
+
+TEST(LruListTest, Basics)
+{
+  util::LruList<4> list;
+  EXPECT_TRUE(list.empty());
+  EXPECT_EQ(list.begin(), list.end());
+  EXPECT_FALSE(list.erase(0));
+
+  list.push_back(2);
+  list.push_back(0);
+  list.push_back(3);
+  EXPECT_EQ(3U, list.size());
+  EXPECT_TRUE(list.contains(0));
+  EXPECT_FALSE(list.contains(1));
+  EXPECT_EQ(2, list.front());
+  EXPECT_EQ(3, list.back());
+  EXPECT_EQ((std::vector<size_t>{2, 0, 3}), ToVector(list));
+
+  list.touch(2);
+  EXPECT_EQ((std::vector<size_t>{0, 3, 2}), ToVector(list));
+  list.touch(1);
+  EXPECT_EQ((std::vector<size_t>{0, 3, 2, 1}), ToVector(list));
+
+  EXPECT_TRUE(list.erase(3));
+  EXPECT_EQ((std::vector<size_t>{0, 2, 1}), ToVector(list));
+  EXPECT_TRUE(list.erase(0));
+  EXPECT_TRUE(list.erase(1));
+  EXPECT_EQ((std::vector<size_t>{2}), ToVector(list));
+  EXPECT_EQ(2, list.front());
+  EXPECT_EQ(2, list.back());
+
+  list.clear();
+  EXPECT_TRUE(list.empty());
+  EXPECT_FALSE(list.contains(2));
+}
+
+}  // namespace pfm2sid::test
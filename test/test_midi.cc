@@ -1,5 +1,7 @@
 #include <fmt/core.h>
 
+#include <algorithm>
+#include <string>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -24,6 +26,12 @@ public:
   {
     fmt::println("BEND {}, {}", channel, value);
     pitch_bend_ = value;
+    ++num_pitch_bends_;
+  }
+  void MidiControlChange(midi::Channel channel, uint8_t control, uint8_t value) final
+  {
+    fmt::println("CC {}, {}, {}", channel, control, value);
+    controls_.push_back({channel, control, value});
   }
 
   struct Note {
@@ -33,8 +41,16 @@ public:
     midi::Velocity velocity = 0;
   };
 
+  struct Control {
+    midi::Channel channel = 0;
+    uint8_t control = 0;
+    uint8_t value = 0;
+  };
+
   std::vector<Note> notes_;
+  std::vector<Control> controls_;
   int16_t pitch_bend_ = 0;
+  int num_pitch_bends_ = 0;
 };
 
 class MidiHandlerRT : public midi::MidiHandlerRT {
@@ -184,4 +200,137 @@ TEST_F(MidiTest, RunningStatus)
   EXPECT_EQ(126, midi_handler_.notes_[1].velocity);
 }
 
+TEST_F(MidiTest, EventQueue)
+{
+  midi::MidiEventQueue event_queue;
+  midi_parser_.Init({&midi_handler_, nullptr, nullptr, &event_queue});
+
+  const uint8_t data[] = {0x91, 0x3F, 0x7F, 0x3F, 0x00, 0xE1, 0x00, 0x40};
+  midi_parser_.Parse(data, sizeof(data));
+
+  EXPECT_TRUE(midi_handler_.notes_.empty());
+  ASSERT_EQ(3U, event_queue.readable());
+
+  auto event = event_queue.Read();
+  EXPECT_EQ(0x91, event.status);
+  EXPECT_EQ(0x3F, event.data[0]);
+  EXPECT_EQ(0x7F, event.data[1]);
+
+  midi::DispatchEvents(event_queue, midi_handler_);
+  EXPECT_EQ(0U, event_queue.readable());
+
+  // Note on with zero velocity is a note off
+  ASSERT_EQ(1, midi_handler_.notes_.size());
+  EXPECT_FALSE(midi_handler_.notes_[0].on);
+  EXPECT_EQ(1, midi_handler_.num_pitch_bends_);
+  EXPECT_EQ(0, midi_handler_.pitch_bend_);
+}
+
+TEST_F(MidiTest, EventQueueSysexOrder)
+{
+  // Records the order in which messages arrive
+  class OrderHandler : public MidiHandler {
+  public:
+    void MidiProgramChange(midi::Channel /*channel*/, uint8_t program) final
+    {
+      log_.push_back(fmt::format("PC {}", program));
+    }
+    bool MidiSysex(const uint8_t * /*data*/, unsigned len, midi::SYSEX_STATUS status) final
+    {
+      log_.push_back(fmt::format("SYSEX {} {}", static_cast<int>(status), len));
+      return true;
+    }
+    std::vector<std::string> log_;
+  } handler;
+
+  midi::MidiEventQueue event_queue;
+  midi_parser_.Init({&handler, nullptr, nullptr, &event_queue});
+
+  // A program change before a sysex is handled first, one after it is queued as usual
+  const uint8_t data[] = {0xC0, 0x05, 0xF0, 0x7D, 0x01, 0x02, 0xF7, 0xC0, 0x06};
+  midi_parser_.Parse(data, sizeof(data));
+  ASSERT_EQ(3U, handler.log_.size());
+  EXPECT_EQ("PC 5", handler.log_[0]);
+  EXPECT_EQ(1U, event_queue.readable());
+  midi::DispatchEvents(event_queue, handler);
+  EXPECT_EQ("PC 6", handler.log_.back());
+
+  // Same for a sysex that's too short for START
+  const uint8_t short_sysex[] = {0xC0, 0x07, 0xF0, 0x7D, 0xF7};
+  midi_parser_.Parse(short_sysex, sizeof(short_sysex));
+  ASSERT_EQ(6U, handler.log_.size());
+  EXPECT_EQ("PC 7", handler.log_[4]);
+  EXPECT_EQ(0U, event_queue.readable());
+}
+
+TEST_F(MidiTest, EventQueueBackpressure)
+{
+  midi::MidiEventQueue event_queue;
+  midi_parser_.Init({&midi_handler_, nullptr, nullptr, &event_queue});
+
+  // Program changes with running status are one byte per event, and the note offs must not be lost
+  std::vector<uint8_t> data = {0xC0};
+  for (int i = 0; i < 100; ++i) data.push_back(static_cast<uint8_t>(i));
+  data.push_back(0x90);
+  for (int i = 0; i < 100; ++i) {
+    data.push_back(static_cast<uint8_t>(i));
+    data.push_back(0);
+  }
+
+  size_t pos = 0;
+  int blocks = 0;
+  while (pos < data.size()) {
+    auto len = std::min(data.size() - pos, midi_parser_.max_parse_len());
+    ASSERT_GT(len, 0U);
+    midi_parser_.Parse(data.data() + pos, len);
+    pos += len;
+    ASSERT_LE(event_queue.readable(), midi::kMidiEventQueueSize);
+    midi::DispatchEvents(event_queue, midi_handler_);
+    ++blocks;
+  }
+  EXPECT_GT(blocks, 1);
+  ASSERT_EQ(100U, midi_handler_.notes_.size());
+  for (int i = 0; i < 100; ++i) EXPECT_EQ(i, midi_handler_.notes_[i].note);
+}
+
+TEST_F(MidiTest, CoalesceEvents)
+{
+  using midi::MidiEvent;
+  const MidiEvent input[] = {
+      {0xE0, {0x00, 0x00}},  // bend, dropped
+      {0x90, {0x3C, 0x7F}},
+      {0xB0, {0x01, 0x10}},  // mod wheel, dropped
+      {0xB0, {0x63, 0x01}},  // NRPN MSB
+      {0xB0, {0x62, 0x02}},  // NRPN LSB
+      {0xB0, {0x06, 0x03}},  // data entry
+      {0xB1, {0x01, 0x20}},  // other channel
+      {0xE0, {0x00, 0x40}},
+      {0xB0, {0x01, 0x30}},
+      {0xB0, {0x63, 0x04}},
+      {0xB0, {0x62, 0x05}},
+      {0xB0, {0x06, 0x06}},
+      {0x80, {0x3C, 0x00}},
+  };
+  MidiEvent events[std::size(input)];
+  std::copy(std::begin(input), std::end(input), events);
+  auto num_events = midi::CoalesceEvents(events, std::size(events));
+  ASSERT_EQ(11U, num_events);
+
+  const size_t expected[] = {1, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+  for (size_t i = 0; i < num_events; ++i) {
+    EXPECT_EQ(input[expected[i]].status, events[i].status) << i;
+    EXPECT_EQ(input[expected[i]].data[0], events[i].data[0]) << i;
+    EXPECT_EQ(input[expected[i]].data[1], events[i].data[1]) << i;
+  }
+
+  for (size_t i = 0; i < num_events; ++i) midi::DispatchEvent(events[i], midi_handler_);
+  EXPECT_EQ(1, midi_handler_.num_pitch_bends_);
+  ASSERT_EQ(2, midi_handler_.notes_.size());
+  ASSERT_EQ(8, midi_handler_.controls_.size());
+  EXPECT_EQ(0x06, midi_handler_.controls_[2].control);
+  EXPECT_EQ(0x03, midi_handler_.controls_[2].value);
+  EXPECT_EQ(1, midi_handler_.controls_[3].channel);
+  EXPECT_EQ(0x30, midi_handler_.controls_[4].value);
+}
+
 }  // namespace pfm2sid::test
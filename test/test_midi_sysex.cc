@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <string>
 #include <vector>
 
 #include "fmt/core.h"
@@ -61,4 +63,73 @@ TEST_F(MidiSysexTest, Abort)
   EXPECT_TRUE(midi_handler_.data_.empty());
 }
 
+// Records all callbacks so the byte-wise and bulk parsing can be compared. The sysex DATA chunks
+// may differ, so they are collected until the end of the transfer.
+class MidiHandlerRecorder : public midi::MidiHandler, public midi::MidiHandlerRT {
+public:
+  MidiHandlerRecorder() : midi::MidiHandler(1) {}
+
+  void MidiNoteOff(midi::Channel channel, midi::Note note, midi::Velocity velocity) final
+  {
+    log_.push_back(fmt::format("off {} {} {}", channel, note, velocity));
+  }
+  void MidiNoteOn(midi::Channel channel, midi::Note note, midi::Velocity velocity) final
+  {
+    log_.push_back(fmt::format("on {} {} {}", channel, note, velocity));
+  }
+  void MidiClock() final { log_.push_back("clock"); }
+
+  bool MidiSysex(const uint8_t* data, unsigned len, midi::SYSEX_STATUS status) final
+  {
+    if (midi::SYSEX_STATUS::START == status) {
+      log_.push_back(fmt::format("sysex start {:02X}{:02X}{:02X}", data[0], data[1], data[2]));
+      sysex_.clear();
+      return data[0] == 0x2D;
+    }
+    sysex_.insert(sysex_.end(), data, data + len);
+    if (midi::SYSEX_STATUS::DATA != status) {
+      auto entry = fmt::format("sysex {} {}:", to_string(status), sysex_.size());
+      for (auto b : sysex_) entry += fmt::format(" {:02X}", b);
+      log_.push_back(entry);
+    }
+    return true;
+  }
+
+  std::vector<std::string> log_;
+  std::vector<uint8_t> sysex_;
+};
+
+TEST(MidiSysexBulkTest, MatchesPerByte)
+{
+  std::vector<uint8_t> stream = {0x90, 0x3C, 0x7F, 0x3D, 0x7F};
+  stream.push_back(0xF0);
+  for (int i = 0; i < 600; ++i) {
+    stream.push_back(i & 0x7f);
+    if (i == 1) stream[stream.size() - 1] = 0x2D;
+    if (i % 97 == 50) stream.push_back(0xF8);  // realtime doesn't interrupt sysex
+  }
+  stream.push_back(0xF7);
+  for (uint8_t b : {0x11, 0x22, 0x33}) stream.push_back(b);  // orphaned
+  for (uint8_t b : {0xF0, 0x7E, 0x01, 0x02, 0x03, 0x04, 0xF7}) stream.push_back(b);  // rejected
+  for (uint8_t b : {0x80, 0x3C, 0x00, 0xF0, 0x2D, 0x01, 0x02, 0x90, 0x40, 0x40})
+    stream.push_back(b);  // aborted by status
+
+  MidiHandlerRecorder expected;
+  {
+    midi::MidiParser midi_parser;
+    midi_parser.Init({&expected, nullptr, &expected});
+    for (auto b : stream) midi_parser.Parse(b);
+  }
+  ASSERT_GT(expected.log_.size(), 8U);
+
+  for (size_t chunk_size : {1, 2, 3, 5, 16, 255, 4096}) {
+    MidiHandlerRecorder actual;
+    midi::MidiParser midi_parser;
+    midi_parser.Init({&actual, nullptr, &actual});
+    for (size_t pos = 0; pos < stream.size(); pos += chunk_size)
+      midi_parser.Parse(stream.data() + pos, std::min(chunk_size, stream.size() - pos));
+    EXPECT_EQ(expected.log_, actual.log_) << chunk_size;
+  }
+}
+
 }  // namespace pfm2sid::test
@@ -0,0 +1,129 @@
+#include <cstring>
+#include <initializer_list>
+
+#include "gtest/gtest.h"
+#include "pfm2sid_test.h"
+#include "sidbits/mos6502.h"
+
+namespace pfm2sid::test {
+
+// Flat 64K, no I/O
+struct FlatBus {
+  uint8_t memory[0x10000] = {};
+
+  uint8_t Read(uint16_t address, uint32_t) { return memory[address]; }
+  void Write(uint16_t address, uint8_t value, uint32_t) { memory[address] = value; }
+  bool IsReturnTrap(uint16_t) const { return false; }
+};
+
+using CPU = sidbits::MOS6502<FlatBus>;
+
+class MOS6502Test : public ::testing::Test {
+protected:
+  static constexpr uint16_t kOrigin = 0x1000;
+
+  FlatBus bus_;
+  CPU cpu_{bus_};
+
+  void Load(uint16_t address, std::initializer_list<uint8_t> code)
+  {
+    std::copy(code.begin(), code.end(), bus_.memory + address);
+  }
+
+  // Returns the cycles taken
+  uint32_t Call(std::initializer_list<uint8_t> code, uint8_t a = 0)
+  {
+    Load(kOrigin, code);
+    const auto start = cpu_.cycles();
+    cpu_.Call(kOrigin, a);
+    EXPECT_EQ(CPU::STATE::RETURNED, cpu_.Run(start + 100000));
+    return cpu_.cycles() - start;
+  }
+};
+
+TEST_F(MOS6502Test, Binary)
+{
+  // LDA #$50, CLC, ADC #$50, RTS
+  EXPECT_EQ(2U + 2U + 2U + 6U, Call({0xa9, 0x50, 0x18, 0x69, 0x50, 0x60}));
+  EXPECT_EQ(0xa0, cpu_.registers().a);
+  EXPECT_TRUE(cpu_.registers().p & CPU::FLAG_V);
+  EXPECT_TRUE(cpu_.registers().p & CPU::FLAG_N);
+  EXPECT_FALSE(cpu_.registers().p & CPU::FLAG_C);
+
+  // SEC, LDA #$10, SBC #$20, RTS
+  Call({0x38, 0xa9, 0x10, 0xe9, 0x20, 0x60});
+  EXPECT_EQ(0xf0, cpu_.registers().a);
+  EXPECT_FALSE(cpu_.registers().p & CPU::FLAG_C);
+}
+
+TEST_F(MOS6502Test, Decimal)
+{
+  // SED, CLC, LDA #$19, ADC #$28, STA $00, SEC, LDA #$42, SBC #$13, STA $01, CLD, RTS
+  Call({0xf8, 0x18, 0xa9, 0x19, 0x69, 0x28, 0x85, 0x00, 0x38, 0xa9, 0x42, 0xe9, 0x13, 0x85, 0x01,
+        0xd8, 0x60});
+  EXPECT_EQ(0x47, bus_.memory[0]);
+  EXPECT_EQ(0x29, bus_.memory[1]);
+
+  // SED, CLC, LDA #$99, ADC #$01, CLD, RTS
+  Call({0xf8, 0x18, 0xa9, 0x99, 0x69, 0x01, 0xd8, 0x60});
+  EXPECT_EQ(0x00, cpu_.registers().a);
+  EXPECT_TRUE(cpu_.registers().p & CPU::FLAG_C);
+}
+
+TEST_F(MOS6502Test, Cycles)
+{
+  // LDX #$01, LDA $20FF,X, RTS: crosses a page
+  EXPECT_EQ(2U + 5U + 6U, Call({0xa2, 0x01, 0xbd, 0xff, 0x20, 0x60}));
+  // LDX #$01, LDA $2000,X, RTS
+  EXPECT_EQ(2U + 4U + 6U, Call({0xa2, 0x01, 0xbd, 0x00, 0x20, 0x60}));
+  // LDX #$01, STA $2000,X, RTS: stores always take the extra cycle
+  EXPECT_EQ(2U + 5U + 6U, Call({0xa2, 0x01, 0x9d, 0x00, 0x20, 0x60}));
+
+  // LDX #$03, DEX, BNE -3, RTS: taken branches take one more
+  EXPECT_EQ(2U + 3 * 2U + 2 * 3U + 2U + 6U, Call({0xa2, 0x03, 0xca, 0xd0, 0xfd, 0x60}));
+}
+
+TEST_F(MOS6502Test, Subroutines)
+{
+  Load(0x2000, {0xa9, 0x42, 0x48, 0x68, 0x60});  // LDA #$42, PHA, PLA, RTS
+  // JSR $2000, TAX, RTS
+  EXPECT_EQ(6U + 2U + 3U + 4U + 6U + 2U + 6U, Call({0x20, 0x00, 0x20, 0xaa, 0x60}));
+  EXPECT_EQ(0x42, cpu_.registers().x);
+  EXPECT_EQ(0xff, cpu_.registers().sp);
+
+  // Interrupt handler: INC $00, RTI
+  Load(0x3000, {0xe6, 0x00, 0x40});
+  bus_.memory[0] = 0;
+  cpu_.Interrupt(0x3000);
+  EXPECT_EQ(CPU::STATE::RETURNED, cpu_.Run(cpu_.cycles() + 1000));
+  EXPECT_EQ(1, bus_.memory[0]);
+}
+
+TEST_F(MOS6502Test, Undocumented)
+{
+  bus_.memory[0x20] = 0x81;
+  // LAX $20, SAX $21 (A & X), DCP $20, RTS
+  Call({0xa7, 0x20, 0x87, 0x21, 0xc7, 0x20, 0x60});
+  EXPECT_EQ(0x81, cpu_.registers().a);
+  EXPECT_EQ(0x81, cpu_.registers().x);
+  EXPECT_EQ(0x81, bus_.memory[0x21]);
+  EXPECT_EQ(0x80, bus_.memory[0x20]);
+  EXPECT_TRUE(cpu_.registers().p & CPU::FLAG_C);  // 0x81 >= 0x80
+
+  // JAM
+  Load(kOrigin, {0x02});
+  cpu_.Call(kOrigin);
+  EXPECT_EQ(CPU::STATE::JAMMED, cpu_.Run(cpu_.cycles() + 1000));
+}
+
+TEST_F(MOS6502Test, Deadline)
+{
+  // JMP *
+  Load(kOrigin, {0x4c, 0x00, 0x10});
+  cpu_.Call(kOrigin);
+  EXPECT_EQ(CPU::STATE::RUNNING, cpu_.Run(cpu_.cycles() + 100));
+  EXPECT_LE(100U, cpu_.cycles());
+  EXPECT_GT(100U + 3U, cpu_.cycles());
+}
+
+}  // namespace pfm2sid::test
@@ -1,7 +1,9 @@
 #include "fmt/core.h"
 #include "gtest/gtest.h"
+#include "synth/parameter_listener.h"
 #include "synth/parameter_structs.h"
 #include "synth/parameters.h"
+#include "synth/patch.h"
 
 namespace pfm2sid::test {
 
@@ -10,6 +12,8 @@ TEST(ParametersTest, basics)
   fmt::println("global_parameter_count={}", synth::kNumGlobalParameters);
   fmt::println("voice_parameter_count={}", synth::kNumVoiceParameters);
   fmt::println("lfo_parameter_count={}", synth::kNumLfoParameters);
+  fmt::println("sizeof(Parameters)={}", sizeof(synth::Parameters));
+  fmt::println("sizeof(Patch)={}", sizeof(synth::Patch));
 }
 
 static void Print(const synth::ParameterDesc *desc)
@@ -32,38 +36,108 @@ TEST(ParametersTest, ParameterRef)
   EXPECT_EQ(GLOBAL::FILTER_MODE, global_ref.global_param);
 }
 
-TEST(ParametersTest, global_parameter_array)
+template <typename parameter_enum>
+static void CheckDescs(bool (synth::ParameterRef::*is_scope)() const)
 {
-  using synth::GLOBAL;
-  auto arr = synth::detail::build_parameter_array<GLOBAL>();
-
-  for (auto &value : arr) {
-    ASSERT_NE(value.desc(), nullptr);
-    EXPECT_TRUE(value.desc()->parameter.is_global()) << value.desc()->name;
-    Print(value.desc());
+  for (size_t i = 0; i < util::enum_count<parameter_enum>(); ++i) {
+    auto desc = synth::ParameterDesc::Find(static_cast<parameter_enum>(i));
+    ASSERT_NE(desc, nullptr);
+    EXPECT_EQ(desc, &synth::detail::parameter_descs<parameter_enum>()[i]);
+    EXPECT_TRUE((desc->parameter.*is_scope)()) << desc->name;
+    EXPECT_EQ(desc, synth::ParameterDesc::Find(desc->parameter)) << desc->name;  // order
+    EXPECT_GE(desc->default_value, desc->min_value) << desc->name;
+    EXPECT_LE(desc->default_value, desc->max_value) << desc->name;
+    Print(desc);
   }
 }
 
-TEST(ParametersTest, voice_parameter_array)
+TEST(ParametersTest, global_parameter_descs)
+{
+  CheckDescs<synth::GLOBAL>(&synth::ParameterRef::is_global);
+}
+
+TEST(ParametersTest, voice_parameter_descs)
+{
+  CheckDescs<synth::VOICE>(&synth::ParameterRef::is_voice);
+}
+
+TEST(ParametersTest, lfo_parameter_descs)
 {
+  CheckDescs<synth::LFO>(&synth::ParameterRef::is_lfo);
+}
+
+TEST(ParametersTest, system_parameter_descs)
+{
+  CheckDescs<synth::SYSTEM>(&synth::ParameterRef::is_system);
+}
+
+TEST(ParametersTest, Storage)
+{
+  using synth::GLOBAL;
   using synth::VOICE;
-  auto arr = synth::detail::build_parameter_array<VOICE>();
-  for (auto &value : arr) {
-    ASSERT_NE(value.desc(), nullptr);
-    EXPECT_TRUE(value.desc()->parameter.is_voice());
-    Print(value.desc());
-  }
+
+  static_assert(&synth::parameter_desc<GLOBAL::VOLUME>() ==
+                &synth::detail::global_parameter_descs[util::enum_to_i(GLOBAL::VOLUME)]);
+
+  synth::Patch patch;
+  EXPECT_EQ(15, patch.parameters.get<GLOBAL::VOLUME>().value());
+  EXPECT_EQ(2048, patch.parameters.get<VOICE::OSC_PWM>(sidbits::VOICE2).value());
+
+  // Snapshot and compare
+  auto snapshot = patch;
+  EXPECT_TRUE(snapshot.parameters == patch.parameters);
+
+  auto pwm = patch.parameters.mutable_value(VOICE::OSC_PWM, sidbits::VOICE2);
+  ASSERT_TRUE(pwm);
+  EXPECT_TRUE(pwm.change_value(-48));
+  EXPECT_EQ(2000, patch.parameters.get<VOICE::OSC_PWM>(sidbits::VOICE2).value());
+  EXPECT_EQ(2048, snapshot.parameters.get<VOICE::OSC_PWM>(sidbits::VOICE2).value());
+  EXPECT_TRUE(snapshot.parameters != patch.parameters);
+
+  // Values are clamped
+  pwm.set(5000);
+  EXPECT_EQ(4095, pwm.value());
+  EXPECT_FALSE(pwm.change_value(1));
+
+  // Wrong scope
+  EXPECT_FALSE(patch.parameters.mutable_value(VOICE::OSC_PWM));
+  EXPECT_FALSE(patch.parameters.mutable_value(GLOBAL::VOLUME, sidbits::VOICE1));
+
+  patch.parameters.Reset();
+  EXPECT_TRUE(snapshot.parameters == patch.parameters);
 }
 
-TEST(ParametersTest, lfo_parameter_array)
+TEST(ParametersTest, ChangeSet)
 {
-  using synth::LFO;
-  auto arr = synth::detail::build_parameter_array<LFO>();
-  for (auto &value : arr) {
-    ASSERT_NE(value.desc(), nullptr);
-    EXPECT_TRUE(value.desc()->parameter.is_lfo());
-    Print(value.desc());
-  }
+  using synth::GLOBAL;
+  using synth::SYSTEM;
+
+  synth::ChangeSet changes;
+  EXPECT_FALSE(changes.any());
+  changes.set(GLOBAL::CHIP_MODEL);
+  EXPECT_TRUE(changes.test(GLOBAL::CHIP_MODEL));
+  EXPECT_FALSE(changes.test(GLOBAL::VOICE_MODE));
+  EXPECT_FALSE(changes.test(SYSTEM::SID_CLOCK));
+
+  synth::ChangeSet other;
+  other.set(SYSTEM::SID_CLOCK);
+  other.set(GLOBAL::VOICE_MODE);
+  other.scale = true;
+  changes |= other;
+  EXPECT_TRUE(changes.test(SYSTEM::SID_CLOCK));
+  EXPECT_TRUE(changes.scale);
+
+  int num_global = 0, num_system = 0;
+  changes.for_each_global([&](GLOBAL) { ++num_global; });
+  changes.for_each_system([&](SYSTEM parameter) {
+    EXPECT_EQ(SYSTEM::SID_CLOCK, parameter);
+    ++num_system;
+  });
+  EXPECT_EQ(2, num_global);
+  EXPECT_EQ(1, num_system);
+
+  changes.clear();
+  EXPECT_FALSE(changes.any());
 }
 
 }  // namespace pfm2sid::test
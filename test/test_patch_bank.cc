@@ -0,0 +1,197 @@
+#include <array>
+#include <cstdio>
+#include <string>
+
+#include "fmt/core.h"
+#include "gtest/gtest.h"
+#include "host_flash_storage.h"
+#include "synth/patch_bank.h"
+
+namespace pfm2sid::test {
+
+using synth::GLOBAL;
+using synth::Patch;
+using synth::PatchBank;
+
+namespace {
+
+// Large enough for all slots, small enough to fill up quickly
+constexpr size_t kNumSectors = 3;
+constexpr size_t kSectorSize = 64 * 1024;
+
+Patch MakePatch(int number)
+{
+  Patch patch;
+  patch.set_number(number);
+  patch.parameters.mutable_value(GLOBAL::FILTER_FREQ).set(number % 1024);
+  patch.scale.reference_freq = 400.f + static_cast<float>(number % 64);
+  return patch;
+}
+
+size_t NextSlot(uint32_t &random)
+{
+  random = random * 1664525U + 1013904223U;
+  return (random >> 8) % PatchBank::kNumSlots;
+}
+
+}  // namespace
+
+TEST(PatchBankTest, Empty)
+{
+  HostFlashStorage storage{kNumSectors, kSectorSize};
+  PatchBank bank;
+  ASSERT_TRUE(bank.Init(&storage));
+  for (size_t slot = 0; slot < PatchBank::kNumSlots; ++slot) EXPECT_EQ(nullptr, bank.Find(slot));
+
+  Patch patch;
+  EXPECT_FALSE(bank.Load(0, patch));
+  EXPECT_FALSE(bank.Save(PatchBank::kNumSlots, patch));
+  EXPECT_EQ(nullptr, bank.Find(PatchBank::kNumSlots));
+
+  // Too small to hold all slots
+  HostFlashStorage small{kNumSectors, 16 * 1024};
+  EXPECT_FALSE(bank.Init(&small));
+  HostFlashStorage single{1, kSectorSize};
+  EXPECT_FALSE(bank.Init(&single));
+}
+
+TEST(PatchBankTest, SaveLoad)
+{
+  const std::string path = ::testing::TempDir() + "pfm2sid_patch_bank.bin";
+  std::remove(path.c_str());
+  {
+    HostFlashStorage storage{kNumSectors, kSectorSize, path};
+    PatchBank bank;
+    ASSERT_TRUE(bank.Init(&storage));
+
+    EXPECT_TRUE(bank.Save(5, MakePatch(5)));
+    EXPECT_TRUE(bank.Save(6, MakePatch(6)));
+    EXPECT_TRUE(bank.Save(5, MakePatch(55)));
+
+    // The patch is read directly from flash
+    auto patch = bank.Find(5);
+    ASSERT_NE(nullptr, patch);
+    auto bytes = reinterpret_cast<const uint8_t *>(patch);
+    EXPECT_TRUE(bytes >= storage.data().data() &&
+                bytes + sizeof(Patch) <= storage.data().data() + storage.data().size());
+    EXPECT_EQ(55, patch->number());
+  }
+
+  HostFlashStorage storage{kNumSectors, kSectorSize, path};
+  PatchBank bank;
+  ASSERT_TRUE(bank.Init(&storage));
+  EXPECT_EQ(3U, bank.stats().records);
+  EXPECT_EQ(0U, bank.stats().invalid);
+
+  Patch patch;
+  ASSERT_TRUE(bank.Load(5, patch));
+  EXPECT_EQ(55, patch.number());
+  EXPECT_EQ(55, patch.parameters.get<GLOBAL::FILTER_FREQ>().value());
+  EXPECT_EQ(MakePatch(55).scale, patch.scale);
+  ASSERT_TRUE(bank.Load(6, patch));
+  EXPECT_EQ(6, patch.number());
+  EXPECT_EQ(nullptr, bank.Find(7));
+  std::remove(path.c_str());
+}
+
+TEST(PatchBankTest, WearLevelling)
+{
+  HostFlashStorage storage{kNumSectors, kSectorSize};
+  PatchBank bank;
+  ASSERT_TRUE(bank.Init(&storage));
+
+  std::array<int, PatchBank::kNumSlots> expected;
+  expected.fill(-1);
+  uint32_t random = 1;
+  for (int i = 0; i < 5000; ++i) {
+    auto slot = NextSlot(random);
+    ASSERT_TRUE(bank.Save(slot, MakePatch(i))) << i;
+    expected[slot] = i;
+  }
+
+  PatchBank reloaded;
+  ASSERT_TRUE(reloaded.Init(&storage));
+  for (size_t slot = 0; slot < PatchBank::kNumSlots; ++slot) {
+    auto patch = reloaded.Find(slot);
+    if (expected[slot] < 0) {
+      EXPECT_EQ(nullptr, patch);
+    } else {
+      ASSERT_NE(nullptr, patch);
+      EXPECT_EQ(expected[slot], patch->number());
+    }
+  }
+
+  uint32_t min_erases = ~0U, max_erases = 0;
+  for (size_t s = 0; s < kNumSectors; ++s) {
+    fmt::println("sector {} erases={} ({})", s, storage.erases(s), bank.erase_count(s));
+    EXPECT_EQ(storage.erases(s), bank.erase_count(s));
+    min_erases = std::min(min_erases, storage.erases(s));
+    max_erases = std::max(max_erases, storage.erases(s));
+  }
+  EXPECT_GT(min_erases, 0U);
+  EXPECT_LE(max_erases - min_erases, 1U);
+}
+
+// Cut the power at (many) different points of a sequence of saves that wraps around the sectors a
+// few times. After rebooting each slot has to contain either the previous or the new patch, and
+// saving has to work again.
+TEST(PatchBankTest, PowerLoss)
+{
+  static constexpr int kNumSaves = 600;
+  static constexpr int kEmpty = -1000;
+
+  HostFlashStorage storage{kNumSectors, kSectorSize};
+  {
+    PatchBank bank;
+    ASSERT_TRUE(bank.Init(&storage));
+    for (size_t slot = 0; slot < PatchBank::kNumSlots; slot += 3) {
+      ASSERT_TRUE(bank.Save(slot, MakePatch(-1 - static_cast<int>(slot))));
+    }
+  }
+  const auto initial = storage.data();
+
+  int num_cuts = 0;
+  for (uint64_t budget = 0;; budget += 997) {
+    storage.set_data(initial);
+    storage.PowerOn();
+
+    PatchBank bank;
+    ASSERT_TRUE(bank.Init(&storage));
+    std::array<int, PatchBank::kNumSlots> expected;
+    for (size_t slot = 0; slot < PatchBank::kNumSlots; ++slot) {
+      auto patch = bank.Find(slot);
+      expected[slot] = patch ? patch->number() : kEmpty;
+    }
+
+    storage.set_budget(budget);
+    uint32_t random = 1;
+    size_t slot = 0;
+    int i = 0;
+    for (; i < kNumSaves; ++i) {
+      slot = NextSlot(random);
+      if (!bank.Save(slot, MakePatch(i))) break;
+      expected[slot] = i;
+    }
+    if (kNumSaves == i) break;
+    ++num_cuts;
+
+    storage.PowerOn();
+    ASSERT_TRUE(bank.Init(&storage)) << budget;
+    for (size_t s = 0; s < PatchBank::kNumSlots; ++s) {
+      auto patch = bank.Find(s);
+      auto number = patch ? patch->number() : kEmpty;
+      if (s == slot && number == i) continue;
+      ASSERT_EQ(expected[s], number) << "budget=" << budget << " slot=" << s;
+    }
+
+    ASSERT_TRUE(bank.Save(slot, MakePatch(kNumSaves))) << budget;
+    PatchBank reloaded;
+    ASSERT_TRUE(reloaded.Init(&storage));
+    ASSERT_NE(nullptr, reloaded.Find(slot));
+    EXPECT_EQ(kNumSaves, reloaded.Find(slot)->number());
+  }
+  fmt::println("{} power cuts", num_cuts);
+  EXPECT_GT(num_cuts, 300);
+}
+
+}  // namespace pfm2sid::test
@@ -0,0 +1,127 @@
+#include <vector>
+
+#include "fmt/core.h"
+#include "gtest/gtest.h"
+#include "synth/patch_switcher.h"
+
+namespace pfm2sid::test {
+
+using synth::GLOBAL;
+
+class PatchListener : public synth::ParameterListener {
+public:
+  void ParametersChanged(const synth::ChangeSet &changes) final
+  {
+    fmt::println("ParametersChanged {} scale={}", changes.global_parameters.to_string(),
+                 changes.scale);
+    changes_.push_back(changes);
+  }
+
+  std::vector<synth::ChangeSet> changes_;
+};
+
+class PatchSwitcherTest : public ::testing::Test {
+public:
+  void SetUp() final
+  {
+    patch_switcher_.Init(&patch_, &change_notifier_);
+    change_notifier_.register_listener(&listener_);
+  }
+
+protected:
+  synth::Patch patch_;
+  synth::ChangeNotifier change_notifier_;
+  synth::PatchSwitcher patch_switcher_;
+  PatchListener listener_;
+
+  // As in RenderSampleBlock
+  bool Apply()
+  {
+    auto applied = patch_switcher_.Apply();
+    change_notifier_.Dispatch();
+    return applied;
+  }
+};
+
+TEST_F(PatchSwitcherTest, Apply)
+{
+  EXPECT_FALSE(patch_switcher_.pending());
+  EXPECT_FALSE(Apply());
+  EXPECT_TRUE(listener_.changes_.empty());
+
+  auto &shadow = patch_switcher_.shadow();
+  shadow.set_number(7);
+  shadow.parameters.mutable_value(GLOBAL::FILTER_FREQ).set(1000);
+  shadow.parameters.mutable_value(GLOBAL::FILTER_RES).set(8);
+  EXPECT_EQ(0, patch_.number());
+
+  patch_switcher_.Commit();
+  EXPECT_TRUE(patch_switcher_.pending());
+  EXPECT_EQ(0, patch_.number());  // not until Apply
+
+  EXPECT_TRUE(Apply());
+  EXPECT_FALSE(patch_switcher_.pending());
+  EXPECT_EQ(7, patch_.number());
+  EXPECT_EQ(1000, patch_.parameters.get<GLOBAL::FILTER_FREQ>().value());
+  EXPECT_EQ(0, patch_switcher_.shadow().number());
+
+  ASSERT_EQ(1U, listener_.changes_.size());
+  auto &changes = listener_.changes_.front();
+  EXPECT_FALSE(changes.scale);
+  EXPECT_EQ(2U, changes.global_parameters.count());
+  EXPECT_TRUE(changes.global_parameters.test(util::enum_to_i(GLOBAL::FILTER_FREQ)));
+  EXPECT_TRUE(changes.global_parameters.test(util::enum_to_i(GLOBAL::FILTER_RES)));
+
+  EXPECT_FALSE(Apply());
+  EXPECT_EQ(1U, listener_.changes_.size());
+}
+
+TEST_F(PatchSwitcherTest, EditTarget)
+{
+  EXPECT_EQ(&patch_, &patch_switcher_.edit_target());
+
+  // An edit before the program change is replaced by the new patch...
+  patch_switcher_.edit_target().parameters.mutable_value(GLOBAL::FILTER_RES).set(4);
+  auto &shadow = patch_switcher_.shadow();
+  shadow.set_number(3);
+  shadow.parameters.mutable_value(GLOBAL::FILTER_FREQ).set(1000);
+  patch_switcher_.Commit();
+
+  // ...and one after it survives the swap
+  EXPECT_EQ(&shadow, &patch_switcher_.edit_target());
+  patch_switcher_.edit_target().parameters.mutable_value(GLOBAL::FILTER_FREQ).set(500);
+  EXPECT_TRUE(Apply());
+  EXPECT_EQ(&patch_, &patch_switcher_.edit_target());
+  EXPECT_EQ(3, patch_.number());
+  EXPECT_EQ(500, patch_.parameters.get<GLOBAL::FILTER_FREQ>().value());
+  EXPECT_EQ(0, patch_.parameters.get<GLOBAL::FILTER_RES>().value());
+
+  ASSERT_EQ(1U, listener_.changes_.size());
+  EXPECT_TRUE(listener_.changes_.front().global_parameters.test(
+      util::enum_to_i(GLOBAL::FILTER_FREQ)));
+}
+
+TEST_F(PatchSwitcherTest, Scale)
+{
+  auto &shadow = patch_switcher_.shadow();
+  shadow.scale.reference_freq = 432.f;
+  patch_switcher_.Commit();
+  EXPECT_TRUE(Apply());
+
+  ASSERT_EQ(1U, listener_.changes_.size());
+  EXPECT_TRUE(listener_.changes_.front().scale);
+  EXPECT_TRUE(listener_.changes_.front().global_parameters.none());
+  EXPECT_EQ(432.f, patch_.scale.reference_freq);
+}
+
+TEST_F(PatchSwitcherTest, Unchanged)
+{
+  // Only the number differs, so there is nothing for the listeners to do
+  patch_switcher_.shadow().set_number(1);
+  patch_switcher_.Commit();
+  EXPECT_TRUE(Apply());
+  EXPECT_EQ(1, patch_.number());
+  EXPECT_TRUE(listener_.changes_.empty());
+}
+
+}  // namespace pfm2sid::test
@@ -0,0 +1,157 @@
+#include <cstring>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "pfm2sid_test.h"
+#include "sidbits/psid_player.h"
+
+namespace pfm2sid::test {
+
+using sidbits::PSIDPlayer;
+
+static constexpr float kSampleRate = 44100.f;
+static constexpr size_t kBlockSize = 32;
+
+static void PushU16(std::vector<uint8_t> &data, size_t offset, uint16_t value)
+{
+  data[offset] = static_cast<uint8_t>(value >> 8);
+  data[offset + 1] = static_cast<uint8_t>(value);
+}
+
+// PSID v2 at $1000 with the load address in the data
+static std::vector<uint8_t> MakePSID(uint16_t init, uint16_t play, std::vector<uint8_t> code,
+                                     uint32_t speed = 0)
+{
+  std::vector<uint8_t> data(0x7c);
+  memcpy(data.data(), "PSID", 4);
+  PushU16(data, 0x04, 2);
+  PushU16(data, 0x06, 0x7c);
+  PushU16(data, 0x0a, init);
+  PushU16(data, 0x0c, play);
+  PushU16(data, 0x0e, 2);
+  PushU16(data, 0x10, 1);
+  PushU16(data, 0x12, static_cast<uint16_t>(speed >> 16));
+  PushU16(data, 0x14, static_cast<uint16_t>(speed));
+  strcpy(reinterpret_cast<char *>(data.data() + 0x16), "Test");
+  data.push_back(0x00);
+  data.push_back(0x10);
+  data.insert(data.end(), code.begin(), code.end());
+  return data;
+}
+
+// init: STA $20, LDA #$0F, STA $D418, RTS
+// play: INC $20, LDA $20, STA $D400, RTS
+static const std::vector<uint8_t> kCode = {0x85, 0x20, 0xa9, 0x0f, 0x8d, 0x18, 0xd4, 0x60,
+                                           0xe6, 0x20, 0xa5, 0x20, 0x8d, 0x00, 0xd4, 0x60};
+
+TEST(PSIDPlayerTest, Header)
+{
+  const auto data = MakePSID(0x1000, 0x1008, kCode);
+  PSIDPlayer player;
+  EXPECT_FALSE(player.Load(data.data(), 0x40));
+  ASSERT_TRUE(player.Load(data.data(), data.size()));
+
+  auto &tune = player.tune();
+  EXPECT_EQ(0x1000, tune.load_address);
+  EXPECT_EQ(0x1008, tune.play_address);
+  EXPECT_EQ(2, tune.songs);
+  EXPECT_STREQ("Test", tune.name);
+  EXPECT_EQ(kCode.size(), tune.data_size);
+  EXPECT_EQ(sidbits::SID_CLOCK::PAL, tune.clock());
+}
+
+TEST(PSIDPlayerTest, Play)
+{
+  const auto data = MakePSID(0x1000, 0x1008, kCode);
+  PSIDPlayer player;
+  ASSERT_TRUE(player.Load(data.data(), data.size()));
+  ASSERT_TRUE(player.StartSong(2, kSampleRate));
+  EXPECT_EQ(2U, player.song());
+  EXPECT_EQ(PSIDPlayer::kPALFrameCycles, player.frame_cycles());
+
+  // init runs right away
+  player.Render(kBlockSize);
+  ASSERT_EQ(1U, player.block_writes().size());
+  EXPECT_EQ(24, player.block_writes().begin()->reg);
+  EXPECT_EQ(0x0f, player.block_writes().begin()->value);
+  EXPECT_EQ(0, player.register_map().peek(24));
+
+  // play is called once per frame, with A = song - 1 from init
+  const auto samples_per_frame =
+      PSIDPlayer::kPALFrameCycles * kSampleRate / sidbits::clock_freq(sidbits::SID_CLOCK::PAL);
+  uint32_t block_start = kBlockSize;
+  uint8_t expected = 1;
+  while (player.stats().frames < 10) {
+    player.Render(kBlockSize);
+    EXPECT_EQ(0x0f, player.register_map().peek(24));
+    for (auto &w : player.block_writes()) {
+      EXPECT_EQ(0, w.reg);
+      EXPECT_EQ(++expected, w.value);
+      const auto expected_sample = samples_per_frame * static_cast<float>(expected - 1);
+      EXPECT_NEAR(expected_sample, static_cast<float>(block_start + w.offset), 1.5f);
+    }
+    block_start += kBlockSize;
+  }
+  EXPECT_EQ(11, expected);
+  EXPECT_EQ(0U, player.stats().overruns);
+}
+
+TEST(PSIDPlayerTest, Overrun)
+{
+  // play: JMP $1008
+  auto code = kCode;
+  code[8] = 0x4c;
+  code[9] = 0x08;
+  code[10] = 0x10;
+  const auto data = MakePSID(0x1000, 0x1008, code);
+  PSIDPlayer player;
+  ASSERT_TRUE(player.Load(data.data(), data.size()));
+  ASSERT_TRUE(player.StartSong(0, kSampleRate));
+  while (player.stats().frames < 5) player.Render(kBlockSize);
+  EXPECT_EQ(4U, player.stats().overruns);
+
+  // JAM
+  code[8] = 0x02;
+  const auto jam = MakePSID(0x1000, 0x1008, code);
+  ASSERT_TRUE(player.Load(jam.data(), jam.size()));
+  ASSERT_TRUE(player.StartSong(0, kSampleRate));
+  while (player.stats().frames < 5) player.Render(kBlockSize);
+  player.Render(kBlockSize);
+  EXPECT_EQ(5U, player.stats().jams);
+  EXPECT_EQ(0U, player.stats().overruns);
+}
+
+TEST(PSIDPlayerTest, CIATiming)
+{
+  // init: LDA #$00, STA $DC04, LDA #$20, STA $DC05, RTS
+  // play: RTS
+  const std::vector<uint8_t> code = {0xa9, 0x00, 0x8d, 0x04, 0xdc, 0xa9, 0x20, 0x8d, 0x05, 0xdc,
+                                     0x60, 0x60};
+  const auto data = MakePSID(0x1000, 0x100b, code, 0x01);
+  PSIDPlayer player;
+  ASSERT_TRUE(player.Load(data.data(), data.size()));
+  ASSERT_TRUE(player.StartSong(1, kSampleRate));
+  EXPECT_EQ(sidbits::C64Bus::kDefaultCIATimer + 1U, player.frame_cycles());
+  while (player.stats().frames < 2) player.Render(kBlockSize);
+  EXPECT_EQ(0x2001U, player.frame_cycles());
+
+  // Song 2 uses the VBI
+  ASSERT_TRUE(player.StartSong(2, kSampleRate));
+  while (player.stats().frames < 2) player.Render(kBlockSize);
+  EXPECT_EQ(PSIDPlayer::kPALFrameCycles, player.frame_cycles());
+}
+
+TEST(PSIDPlayerTest, Memory)
+{
+  const auto data = MakePSID(0x1000, 0x1008, kCode);
+  PSIDPlayer player;
+  ASSERT_TRUE(player.Load(data.data(), data.size()));
+  ASSERT_TRUE(player.StartSong(1, kSampleRate));
+  while (player.stats().frames < 2) player.Render(kBlockSize);
+
+  // Zero page, stack and the partial tune page
+  EXPECT_EQ(3U, player.bus().stats().ram_pages);
+  EXPECT_EQ(0U, player.bus().stats().dropped_writes);
+}
+
+}  // namespace pfm2sid::test
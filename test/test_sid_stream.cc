@@ -0,0 +1,140 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "pfm2sid_test.h"
+#include "sidbits/sid_stream.h"
+
+namespace pfm2sid::test {
+
+using sidbits::SIDStream;
+
+static void PushU32(std::vector<uint8_t> &stream, uint32_t value)
+{
+  for (int i = 0; i < 4; ++i) stream.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+// Keyframe offsets are relative to the records
+static std::vector<uint8_t> MakeStream(uint32_t num_frames, std::initializer_list<uint8_t> records,
+                                       uint8_t keyframe_interval = 0,
+                                       std::initializer_list<uint32_t> keyframes = {})
+{
+  std::vector<uint8_t> stream = {'S', 'I', 'D', 'Z', SIDStream::kVersion, 25, keyframe_interval, 0};
+  PushU32(stream, num_frames);
+  PushU32(stream, static_cast<uint32_t>(keyframes.size()));
+  const auto data_start = SIDStream::kHeaderSize + 4 * keyframes.size();
+  for (auto offset : keyframes) PushU32(stream, static_cast<uint32_t>(data_start + offset));
+  stream.insert(stream.end(), records);
+  return stream;
+}
+
+TEST(SIDStreamTest, Raw)
+{
+  std::vector<uint8_t> data(2 * sidbits::SID_REGISTER_COUNT);
+  for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<uint8_t>(i);
+
+  SIDStream stream;
+  stream.Init({data.data(), data.data() + data.size()});
+  EXPECT_FALSE(stream.compressed());
+  EXPECT_EQ(2U, stream.num_frames());
+
+  stream.Step();
+  EXPECT_EQ(24, stream.register_map().peek(24));
+  stream.Step();
+  EXPECT_EQ(25, stream.register_map().peek(0));
+  stream.Step();  // loop
+  EXPECT_EQ(0, stream.register_map().peek(0));
+}
+
+TEST(SIDStreamTest, Compressed)
+{
+  // clang-format off
+  const auto data = MakeStream(9, {
+      0x05, 0x03, 0x11, 0x22, 0x40, 0x33,  // frame 0: reg 0, 1, 20
+      0x82,                                // frame 1-3: unchanged
+      0x08, 0x08, 0x44,                    // frame 4: reg 24
+      0xC1, 0x0A, 0x00,                    // frame 5-8: replay frame 0-3
+  });
+  // clang-format on
+
+  SIDStream stream;
+  stream.Init({data.data(), data.data() + data.size()});
+  EXPECT_TRUE(stream.compressed());
+  EXPECT_EQ(9U, stream.num_frames());
+
+  std::vector<std::array<uint8_t, 4>> frames;
+  for (int i = 0; i < 9; ++i) {
+    stream.Step();
+    const auto &r = stream.register_map();
+    frames.push_back({r.peek(0), r.peek(1), r.peek(20), r.peek(24)});
+  }
+  const std::array<uint8_t, 4> a = {0x11, 0x22, 0x33, 0x00};
+  const std::array<uint8_t, 4> b = {0x11, 0x22, 0x33, 0x44};
+  EXPECT_EQ(a, frames[0]);
+  EXPECT_EQ(a, frames[3]);
+  EXPECT_EQ(b, frames[4]);
+  EXPECT_EQ(b, frames[5]);  // the replayed frame 0 only writes the same values again
+  EXPECT_EQ(b, frames[8]);
+  EXPECT_EQ(9U, stream.frame());
+
+  // The replay returns to the record after it, i.e. the end of the stream, so it loops
+  EXPECT_TRUE(stream.Step());
+  EXPECT_EQ(0x00, stream.register_map().peek(24));
+  EXPECT_EQ(0x11, stream.register_map().peek(0));
+  EXPECT_EQ(1U, stream.frame());
+}
+
+TEST(SIDStreamTest, Seek)
+{
+  // clang-format off
+  std::initializer_list<uint8_t> keyframe = {
+      0x10, 1, 0, 0, 0, 0x41, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x0f};
+  // clang-format on
+  std::vector<uint8_t> records;
+  records.insert(records.end(), keyframe);            // frame 0
+  records.insert(records.end(), {0x01, 0x01, 0x02});  // frame 1
+  records.insert(records.end(), {0x81});              // frame 2, 3
+  records.insert(records.end(), keyframe);            // frame 4
+  records[records.size() - 25] = 5;
+  records.insert(records.end(), {0xC0, 30, 0x00});  // frame 5 replays frame 1
+  records.insert(records.end(), {0x80});            // frame 6
+
+  auto data = MakeStream(7, {}, 4, {0, 30});
+  data.insert(data.end(), records.begin(), records.end());
+
+  SIDStream stream;
+  stream.Init({data.data(), data.data() + data.size()});
+  ASSERT_TRUE(stream.compressed());
+  EXPECT_EQ(4U, stream.keyframe_interval());
+
+  const uint8_t expected[7] = {1, 2, 2, 2, 5, 2, 2};
+  for (uint32_t frame : {3, 0, 6, 4, 5, 1, 2}) {
+    stream.Seek(frame);
+    EXPECT_EQ(frame + 1, stream.frame());
+    EXPECT_EQ(expected[frame], stream.register_map().peek(0)) << frame;
+    EXPECT_EQ(0x41, stream.register_map().peek(4)) << frame;
+  }
+
+  // Loop frames 2-4
+  stream.set_loop(2, 5);
+  stream.Seek(2);
+  std::vector<uint8_t> values;
+  for (int i = 0; i < 6; ++i) {
+    stream.Step();
+    values.push_back(stream.register_map().peek(0));
+  }
+  EXPECT_EQ((std::vector<uint8_t>{2, 5, 2, 2, 5, 2}), values);
+}
+
+TEST(SIDStreamTest, Invalid)
+{
+  // Replay before the start, and truncated data
+  for (auto data : {MakeStream(1, {0xC0, 0x10, 0x00}), MakeStream(1, {0x01, 0x7f, 0x01})}) {
+    SIDStream stream;
+    stream.Init({data.data(), data.data() + data.size()});
+    ASSERT_TRUE(stream.compressed());
+    for (int i = 0; i < 4; ++i) stream.Step();
+    EXPECT_EQ(0, stream.register_map().peek(2));
+  }
+}
+
+}  // namespace pfm2sid::test
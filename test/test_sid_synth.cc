@@ -0,0 +1,104 @@
+#include <memory>
+
+#include "gtest/gtest.h"
+#include "synth/patch.h"
+#include "synth/sid_synth.h"
+
+namespace pfm2sid::test {
+
+using synth::SIDSynth;
+using synth::VOICE_MODE;
+
+class SIDSynthTest : public ::testing::Test {
+public:
+  void SetUp() final
+  {
+    patch_.parameters.Reset();
+    sid_synth_ = std::make_unique<SIDSynth>();
+    sid_synth_->Init(&patch_.parameters);
+    sid_synth_->Update();  // Flush the reset state
+  }
+
+  bool gate(unsigned chip, unsigned voice) const
+  {
+    using sidbits::RegisterMap;
+    auto control = sid_synth_->register_map(chip).peek(RegisterMap::voice_register(
+        static_cast<sidbits::VOICE_INDEX>(voice), RegisterMap::VOICE_CONTROL));
+    return control & RegisterMap::VOICE_CONTROL_GATE;
+  }
+
+protected:
+  synth::Patch patch_;
+  std::unique_ptr<SIDSynth> sid_synth_;
+};
+
+static_assert(synth::kNumSIDs >= 2, "tests are built with PFM2SID_NUM_SIDS=2");
+
+TEST_F(SIDSynthTest, ActiveChips)
+{
+  sid_synth_->SetVoiceMode(VOICE_MODE::POLY);
+  sid_synth_->Update();
+  EXPECT_EQ(0U, sid_synth_->active_chips());
+
+  sid_synth_->NoteOn(0, 60, 100);
+  sid_synth_->Update();
+  EXPECT_EQ(1U, sid_synth_->active_chips());
+  for (midi::Note note = 61; note < 64; ++note) sid_synth_->NoteOn(0, note, 100);
+  sid_synth_->Update();
+  EXPECT_EQ(3U, sid_synth_->active_chips());
+}
+
+TEST_F(SIDSynthTest, ChipLimitPoly)
+{
+  sid_synth_->SetVoiceMode(VOICE_MODE::POLY);
+  for (midi::Note note = 60; note < 66; ++note) sid_synth_->NoteOn(0, note, 100);
+  sid_synth_->Update();
+  EXPECT_EQ(3U, sid_synth_->active_chips());
+  for (unsigned v = 0; v < SIDSynth::kVoiceCount; ++v) EXPECT_TRUE(sid_synth_->voice_active(v));
+
+  // The voices on the second chip are cut off, without a release
+  sid_synth_->set_chip_limit(1);
+  sid_synth_->Update();
+  for (unsigned v = 0; v < 3; ++v) EXPECT_FALSE(gate(1, v));
+  sid_synth_->Update();
+  EXPECT_EQ(1U, sid_synth_->active_chips());
+  for (unsigned v = 3; v < SIDSynth::kVoiceCount; ++v) EXPECT_FALSE(sid_synth_->voice_active(v));
+
+  // New notes steal on the first chip, and note offs for the cut voices are ignored
+  for (midi::Note note = 70; note < 74; ++note) sid_synth_->NoteOn(0, note, 100);
+  for (midi::Note note = 60; note < 66; ++note) sid_synth_->NoteOff(0, note, 0);
+  sid_synth_->Update();
+  EXPECT_EQ(1U, sid_synth_->active_chips());
+  for (unsigned v = 0; v < 3; ++v) EXPECT_TRUE(gate(0, v));
+
+  // Back to both chips
+  sid_synth_->set_chip_limit(2);
+  sid_synth_->NoteOn(0, 80, 100);
+  sid_synth_->Update();
+  EXPECT_EQ(3U, sid_synth_->active_chips());
+}
+
+TEST_F(SIDSynthTest, ChipLimitUnison)
+{
+  sid_synth_->SetVoiceMode(VOICE_MODE::UNISON);
+  sid_synth_->set_chip_limit(1);
+  sid_synth_->NoteOn(0, 60, 100);
+  sid_synth_->Update();
+  EXPECT_EQ(1U, sid_synth_->active_chips());
+  for (unsigned v = 0; v < 3; ++v) EXPECT_TRUE(sid_synth_->voice_active(v));
+  for (unsigned v = 3; v < SIDSynth::kVoiceCount; ++v) EXPECT_FALSE(sid_synth_->voice_active(v));
+
+  sid_synth_->set_chip_limit(2);
+  sid_synth_->NoteOn(0, 62, 100);
+  sid_synth_->Update();
+  EXPECT_EQ(3U, sid_synth_->active_chips());
+  for (unsigned v = 3; v < SIDSynth::kVoiceCount; ++v) EXPECT_TRUE(gate(1, v - 3));
+
+  sid_synth_->set_chip_limit(1);
+  sid_synth_->Update();
+  sid_synth_->Update();
+  EXPECT_EQ(1U, sid_synth_->active_chips());
+  for (unsigned v = 0; v < 3; ++v) EXPECT_FALSE(gate(1, v));
+}
+
+}  // namespace pfm2sid::test
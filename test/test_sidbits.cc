@@ -1,6 +1,11 @@
+#include <algorithm>
+#include <vector>
+
 #include "fmt/core.h"
 #include "gtest/gtest.h"
 #include "midi/midi_types.h"
+#include "sidbits/frame_scheduler.h"
+#include "sidbits/register_writes.h"
 #include "sidbits/sidbits.h"
 
 namespace pfm2sid::test {
@@ -78,4 +83,152 @@ TEST(sidbitsTest, midi_to_filter_freq)
   }
 }
 
+TEST(sidbitsTest, RegisterRamps)
+{
+  using namespace sidbits;
+  RegisterRamps register_ramps;
+  RegisterWriteList<64> writes;
+
+  EXPECT_TRUE(register_ramps.empty());
+  register_ramps.set(RAMP_TARGET::VOICE2_PWM, 0x800, 0x800);
+  EXPECT_TRUE(register_ramps.empty());
+
+  register_ramps.Interpolate(4, 32, writes);
+  EXPECT_TRUE(writes.empty());
+
+  register_ramps.set(RegisterRamps::freq_target(VOICE2), 0x10f0, 0x1100);
+  EXPECT_FALSE(register_ramps.empty());
+  register_ramps.Interpolate(1, 32, writes);
+  EXPECT_TRUE(writes.empty());
+
+  register_ramps.Interpolate(4, 32, writes);
+  for (auto &w : writes) fmt::println("{:2} {:02x}={:02x}", w.offset, w.reg, w.value);
+
+  // The chip starts the block with the end value 0x1100, so the first step writes both bytes of
+  // 0x10f0; then 0x10f4, 0x10f8, 0x10fc.
+  ASSERT_EQ(5U, writes.size());
+  const uint8_t freq_lo = RegisterMap::voice_register(VOICE2, RegisterMap::VOICE_FREQ_LO);
+  auto w = writes.begin();
+  EXPECT_EQ(0, w->offset);
+  EXPECT_EQ(freq_lo, w->reg);
+  EXPECT_EQ(0xf0, w->value);
+  ++w;
+  EXPECT_EQ(0, w->offset);
+  EXPECT_EQ(freq_lo + 1, w->reg);
+  EXPECT_EQ(0x10, w->value);
+  ++w;
+  EXPECT_EQ(8, w->offset);
+  EXPECT_EQ(0xf4, w->value);
+  ++w;
+  EXPECT_EQ(16, w->offset);
+  EXPECT_EQ(0xf8, w->value);
+  ++w;
+  EXPECT_EQ(24, w->offset);
+  EXPECT_EQ(freq_lo, w->reg);
+  EXPECT_EQ(0xfc, w->value);
+
+  register_ramps.clear();
+  EXPECT_TRUE(register_ramps.empty());
+
+  // Offsets are ordered
+  writes.clear();
+  register_ramps.set(RAMP_TARGET::FILTER_FREQ, 0, 0x7ff);
+  register_ramps.set(RAMP_TARGET::VOICE3_PWM, 0xfff, 0);
+  register_ramps.Interpolate(8, 32, writes);
+  EXPECT_TRUE(std::is_sorted(writes.begin(), writes.end(),
+                             [](auto &a, auto &b) { return a.offset < b.offset; }));
+  EXPECT_EQ(28, (writes.end() - 1)->offset);
+}
+
+// Replay the writes like SIDInstance::Render does, i.e. on top of the end values, and check the
+// register state at every sample of the block
+TEST(sidbitsTest, RegisterRampsReplay)
+{
+  using namespace sidbits;
+  static constexpr unsigned kBlockSize = 32;
+
+  struct Ramp {
+    uint16_t start;
+    uint16_t end;
+  };
+  static constexpr Ramp kFreqRamps[] = {{0x10f0, 0x1100}, {0x1100, 0x10f0}, {0x00ff, 0xff00},
+                                        {0x1234, 0x1235}};
+  // All 11 bits of the cutoff change, including the three in the low register
+  static constexpr Ramp kFilterRamps[] = {{0, 0x7ff}, {0x7ff, 0x400}, {0x0f8, 0x108},
+                                          {0x100, 0x110}, {0x207, 0x1f8}};
+
+  for (unsigned num_steps : {2U, 4U, 8U, 16U}) {
+    for (auto &freq_ramp : kFreqRamps) {
+      for (auto &filter_ramp : kFilterRamps) {
+        RegisterRamps register_ramps;
+        register_ramps.set(RegisterRamps::freq_target(VOICE1), freq_ramp.start, freq_ramp.end);
+        register_ramps.set(RAMP_TARGET::FILTER_FREQ, filter_ramp.start, filter_ramp.end);
+        RegisterWriteList<RegisterRamps::kNumTargets * 2 * 16> writes;
+        register_ramps.Interpolate(num_steps, kBlockSize, writes);
+
+        RegisterMap register_map;
+        register_map.voice_set_freq(VOICE1, freq_ramp.end);
+        register_map.filter_set_freq(filter_ramp.end);
+
+        auto expected = [&](const Ramp &ramp, unsigned offset) {
+          auto step = static_cast<int32_t>(offset * num_steps / kBlockSize);
+          return static_cast<uint16_t>(ramp.start + (ramp.end - ramp.start) * step /
+                                                        static_cast<int32_t>(num_steps));
+        };
+
+        auto write = writes.begin();
+        for (unsigned offset = 0; offset < kBlockSize; ++offset) {
+          for (; write != writes.end() && write->offset <= offset; ++write)
+            register_map.poke(write->reg, write->value);
+          ASSERT_EQ(expected(freq_ramp, offset), register_map.voice_get_freq(VOICE1))
+              << num_steps << " " << offset;
+          ASSERT_EQ(expected(filter_ramp, offset), register_map.filter_get_freq())
+              << num_steps << " " << offset;
+        }
+        EXPECT_EQ(writes.end(), write);
+      }
+    }
+  }
+}
+
+TEST(sidbitsTest, FrameScheduler)
+{
+  static constexpr uint32_t kBlockSize = 32;
+  using sidbits::FrameScheduler;
+
+  auto frame_positions = [](FrameScheduler &scheduler, uint32_t num_blocks) {
+    std::vector<uint32_t> positions;
+    for (uint32_t block = 0; block < num_blocks; ++block)
+      scheduler.Advance(kBlockSize, [&](uint16_t offset) {
+        EXPECT_LT(offset, kBlockSize);
+        positions.push_back(block * kBlockSize + offset);
+      });
+    return positions;
+  };
+
+  FrameScheduler scheduler;
+  scheduler.Init(44100, sidbits::SID_CLOCK::PAL, 1);
+  EXPECT_EQ(50U, scheduler.frame_rate());
+  auto positions = frame_positions(scheduler, 44100 / kBlockSize);
+  ASSERT_EQ(50U, positions.size());
+  for (uint32_t i = 0; i < positions.size(); ++i) EXPECT_EQ(i * 882, positions[i]);
+
+  scheduler.Init(44100, sidbits::SID_CLOCK::NTSC, 1);
+  scheduler.Reset();
+  positions = frame_positions(scheduler, 44100 / kBlockSize);
+  ASSERT_EQ(60U, positions.size());
+  for (uint32_t i = 0; i < positions.size(); ++i) EXPECT_EQ(i * 735, positions[i]);
+
+  // 110.25 samples per frame
+  scheduler.Init(44100, sidbits::SID_CLOCK::PAL, 8);
+  scheduler.Reset();
+  EXPECT_EQ(400U, scheduler.frame_rate());
+  positions = frame_positions(scheduler, 4 * 441 / kBlockSize + 1);
+  ASSERT_EQ(17U, positions.size());
+  for (uint32_t i = 0; i < positions.size(); ++i) EXPECT_EQ(i * 441 / 4, positions[i]);
+
+  scheduler.Init(44100, sidbits::SID_CLOCK::PAL, 16);
+  EXPECT_EQ(FrameScheduler::kMaxSpeed, scheduler.speed());
+}
+
 }  // namespace pfm2sid::test
@@ -0,0 +1,48 @@
+#include "gtest/gtest.h"
+#include "misc/spsc_queue.h"
+
+namespace pfm2sid::test {
+
+TEST(SpscQueueTest, Basics)
+{
+  util::SpscQueue<uint8_t, 8> queue;
+  EXPECT_EQ(0U, queue.readable());
+  EXPECT_EQ(8U, queue.writeable());
+  EXPECT_EQ(0U, queue.ReadableSpan().size);
+
+  for (uint8_t i = 0; i < 8; ++i) EXPECT_TRUE(queue.Write(i));
+  EXPECT_FALSE(queue.Write(8));
+  EXPECT_EQ(8U, queue.readable());
+  EXPECT_EQ(0U, queue.writeable());
+
+  EXPECT_EQ(0, queue.Read());
+  EXPECT_EQ(1, queue.Read());
+  EXPECT_EQ(6U, queue.readable());
+}
+
+TEST(SpscQueueTest, Spans)
+{
+  util::SpscQueue<uint8_t, 8> queue;
+  for (uint8_t i = 0; i < 6; ++i) queue.Write(i);
+  queue.Consume(5);
+  for (uint8_t i = 6; i < 12; ++i) queue.Write(i);
+  EXPECT_EQ(7U, queue.readable());
+
+  // Wraps, so two spans
+  auto span = queue.ReadableSpan();
+  ASSERT_EQ(3U, span.size);
+  EXPECT_EQ(5, span.data[0]);
+  EXPECT_EQ(7, span.data[2]);
+  queue.Consume(span.size);
+
+  span = queue.ReadableSpan();
+  ASSERT_EQ(4U, span.size);
+  EXPECT_EQ(8, span.data[0]);
+  EXPECT_EQ(11, span.data[3]);
+  queue.Consume(span.size);
+
+  EXPECT_EQ(0U, queue.ReadableSpan().size);
+  EXPECT_EQ(8U, queue.writeable());
+}
+
+}  // namespace pfm2sid::test
@@ -0,0 +1,405 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "fmt/core.h"
+#include "gtest/gtest.h"
+#include "host_flash_storage.h"
+#include "midi/midi_parser.h"
+#include "midi/sysex_transfer.h"
+#include "misc/crc32.h"
+#include "misc/flash_file.h"
+#include "synth/patch_receiver.h"
+
+namespace pfm2sid::test {
+
+using midi::SysexTransfer;
+using COMMAND = SysexTransfer::COMMAND;
+using STATUS = SysexTransfer::STATUS;
+using TYPE = SysexTransfer::TYPE;
+
+namespace {
+
+// Host side encoding, see resources/sysex_transfer.py
+using Message = std::vector<uint8_t>;
+
+Message BeginMessage(TYPE type, uint8_t slot, uint8_t version, size_t size)
+{
+  return {0xF0,
+          SysexTransfer::kSysexId,
+          static_cast<uint8_t>(COMMAND::BEGIN),
+          static_cast<uint8_t>(type),
+          slot,
+          version,
+          static_cast<uint8_t>(size >> 14 & 0x7f),
+          static_cast<uint8_t>(size >> 7 & 0x7f),
+          static_cast<uint8_t>(size & 0x7f),
+          0xF7};
+}
+
+Message DataMessage(uint8_t seq, const uint8_t *data, size_t len)
+{
+  Message message = {0xF0, SysexTransfer::kSysexId, static_cast<uint8_t>(COMMAND::DATA), seq};
+  unsigned sum = seq;
+  for (size_t i = 0; i < len; i += 7) {
+    const auto n = std::min<size_t>(7, len - i);
+    uint8_t msbs = 0;
+    for (size_t j = 0; j < n; ++j) msbs |= static_cast<uint8_t>((data[i + j] >> 7) << j);
+    message.push_back(msbs);
+    sum += msbs;
+    for (size_t j = 0; j < n; ++j) {
+      message.push_back(data[i + j] & 0x7f);
+      sum += data[i + j] & 0x7f;
+    }
+  }
+  message.push_back(sum & 0x7f);
+  message.push_back(0xF7);
+  return message;
+}
+
+Message EndMessage(uint32_t crc)
+{
+  Message message = {0xF0, SysexTransfer::kSysexId, static_cast<uint8_t>(COMMAND::END)};
+  for (int shift = 28; shift >= 0; shift -= 7) message.push_back((crc >> shift) & 0x7f);
+  message.push_back(0xF7);
+  return message;
+}
+
+std::vector<Message> Chunks(const std::vector<uint8_t> &data)
+{
+  std::vector<Message> chunks;
+  for (size_t offset = 0; offset < data.size(); offset += SysexTransfer::kChunkSize) {
+    const auto len = std::min(SysexTransfer::kChunkSize, data.size() - offset);
+    chunks.push_back(
+        DataMessage(static_cast<uint8_t>(chunks.size() & 0x7f), data.data() + offset, len));
+  }
+  return chunks;
+}
+
+std::vector<uint8_t> RandomData(size_t size, uint32_t seed = 0x5eed)
+{
+  std::vector<uint8_t> data(size);
+  for (auto &d : data) {
+    seed = seed * 1664525U + 1013904223U;
+    d = static_cast<uint8_t>(seed >> 24);
+  }
+  return data;
+}
+
+uint32_t Crc(const std::vector<uint8_t> &data)
+{
+  return util::Crc32(data.data(), data.size());
+}
+
+class MemorySink : public SysexTransfer::Sink {
+public:
+  bool Begin(TYPE /*type*/, uint8_t slot, uint8_t /*version*/, size_t size) final
+  {
+    slot_ = slot;
+    data_.clear();
+    data_.reserve(size);
+    return true;
+  }
+
+  bool Write(size_t offset, const uint8_t *data, size_t len) final
+  {
+    EXPECT_EQ(data_.size(), offset);
+    data_.insert(data_.end(), data, data + len);
+    ++writes_;
+    return true;
+  }
+
+  bool End(bool ok) final
+  {
+    ok_ = ok;
+    return ok;
+  }
+
+  std::vector<uint8_t> data_;
+  uint8_t slot_ = 0;
+  unsigned writes_ = 0;
+  bool ok_ = false;
+};
+
+// Writes the data to a FlashFile, like the SID upload
+class FileSink : public SysexTransfer::Sink {
+public:
+  explicit FileSink(util::FlashFile *file) : file_(file) {}
+
+  bool Begin(TYPE, uint8_t, uint8_t, size_t size) final { return file_->Begin(size); }
+  bool Write(size_t, const uint8_t *data, size_t len) final { return file_->Write(data, len); }
+  bool End(bool ok) final { return ok && file_->Commit(); }
+
+private:
+  util::FlashFile *file_;
+};
+
+// Forwards sysex to the transfer like the MidiHandler, and collects the replies
+class TransferHandler : public midi::MidiHandler {
+public:
+  explicit TransferHandler(SysexTransfer *transfer)
+      : midi::MidiHandler(midi::ALL_CHANNELS), transfer_(transfer)
+  {}
+
+  bool MidiSysex(const uint8_t *data, unsigned len, midi::SYSEX_STATUS status) final
+  {
+    switch (status) {
+      case midi::SYSEX_STATUS::START:
+        if (!SysexTransfer::is_transfer_sysex(data)) return false;
+        transfer_->BeginSysex();
+        return true;
+      case midi::SYSEX_STATUS::DATA: transfer_->FeedSysex(data, len); return true;
+      case midi::SYSEX_STATUS::EOX:
+        transfer_->FeedSysex(data, len);
+        if (auto reply = transfer_->EndSysex()) replies_.push_back(*reply);
+        return true;
+      case midi::SYSEX_STATUS::ABORT: transfer_->AbortSysex(); break;
+      default: break;
+    }
+    return false;
+  }
+
+  std::vector<SysexTransfer::Reply> replies_;
+
+private:
+  SysexTransfer *transfer_;
+};
+
+}  // namespace
+
+class SysexTransferTest : public ::testing::Test {
+protected:
+  void SetUp() final
+  {
+    transfer_.set_sink(TYPE::SID, &sink_);
+    midi_parser_.Init({&handler_, nullptr, nullptr});
+  }
+
+  // Send a message and return the reply
+  SysexTransfer::Reply Send(const Message &message)
+  {
+    const auto num_replies = handler_.replies_.size();
+    // Like the serial input, in small pieces
+    for (size_t i = 0; i < message.size(); i += 3)
+      midi_parser_.Parse(message.data() + i, std::min<size_t>(3, message.size() - i));
+    EXPECT_EQ(num_replies + 1, handler_.replies_.size());
+    return handler_.replies_.back();
+  }
+
+  MemorySink sink_;
+  SysexTransfer transfer_;
+  TransferHandler handler_{&transfer_};
+  midi::MidiParser midi_parser_;
+};
+
+#define EXPECT_REPLY(expected_command, expected_seq, expected_status, reply) \
+  do {                                                                     \
+    auto r = (reply);                                                      \
+    EXPECT_EQ(expected_command, r.command);                                \
+    EXPECT_EQ(expected_seq, r.seq);                                        \
+    EXPECT_EQ(expected_status, r.status);                                  \
+  } while (0)
+
+TEST_F(SysexTransferTest, Transfer)
+{
+  const auto data = RandomData(SysexTransfer::kChunkSize * 200 + 17);
+  EXPECT_REPLY(COMMAND::BEGIN, 0, STATUS::OK, Send(BeginMessage(TYPE::SID, 3, 0, data.size())));
+  EXPECT_TRUE(transfer_.active());
+  EXPECT_EQ(data.size(), transfer_.size());
+
+  size_t wire_bytes = 0;
+  const auto chunks = Chunks(data);
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    EXPECT_REPLY(COMMAND::DATA, i & 0x7f, STATUS::OK, Send(chunks[i]));
+    wire_bytes += chunks[i].size();
+  }
+  EXPECT_EQ(data.size(), transfer_.received());
+  EXPECT_REPLY(COMMAND::END, chunks.size() & 0x7f, STATUS::OK, Send(EndMessage(Crc(data))));
+  EXPECT_FALSE(transfer_.active());
+
+  EXPECT_TRUE(sink_.ok_);
+  EXPECT_EQ(3, sink_.slot_);
+  EXPECT_EQ(data, sink_.data_);
+  EXPECT_EQ(chunks.size(), sink_.writes_);
+
+  // 3125 bytes/s at 31250 baud
+  const auto efficiency = static_cast<double>(data.size()) / static_cast<double>(wire_bytes);
+  fmt::println("{} bytes in {} bytes, {:.1f}% = {:.0f} bytes/s", data.size(), wire_bytes,
+               efficiency * 100.0, efficiency * 3125.0);
+  EXPECT_GT(efficiency, 0.85);
+
+  const auto reply = SysexTransfer::Reply{COMMAND::DATA, 5, STATUS::CHECKSUM}.sysex();
+  const std::array<uint8_t, 7> expected = {0xF0, 0x7D, 0x13, 0x11, 0x05, 0x01, 0xF7};
+  EXPECT_EQ(expected, reply);
+}
+
+TEST_F(SysexTransferTest, Resend)
+{
+  const auto data = RandomData(SysexTransfer::kChunkSize * 4);
+  const auto chunks = Chunks(data);
+  EXPECT_REPLY(COMMAND::BEGIN, 0, STATUS::OK, Send(BeginMessage(TYPE::SID, 0, 0, data.size())));
+  EXPECT_REPLY(COMMAND::DATA, 0, STATUS::OK, Send(chunks[0]));
+
+  // A damaged byte, and the rest of the window
+  auto corrupt = chunks[1];
+  corrupt[100] ^= 0x01;
+  EXPECT_REPLY(COMMAND::DATA, 1, STATUS::CHECKSUM, Send(corrupt));
+  EXPECT_REPLY(COMMAND::DATA, 1, STATUS::SEQUENCE, Send(chunks[2]));
+
+  // A dropped byte
+  auto truncated = chunks[1];
+  truncated.erase(truncated.begin() + 50);
+  EXPECT_REPLY(COMMAND::DATA, 1, STATUS::CHECKSUM, Send(truncated));
+
+  // Resend from 1, with a duplicate of 0
+  EXPECT_REPLY(COMMAND::DATA, 0, STATUS::OK, Send(chunks[0]));
+  for (size_t i = 1; i < chunks.size(); ++i)
+    EXPECT_REPLY(COMMAND::DATA, i, STATUS::OK, Send(chunks[i]));
+  EXPECT_REPLY(COMMAND::DATA, 2, STATUS::OK, Send(chunks[2]));
+
+  EXPECT_REPLY(COMMAND::END, 4, STATUS::OK, Send(EndMessage(Crc(data))));
+  EXPECT_EQ(data, sink_.data_);
+  EXPECT_EQ(chunks.size(), sink_.writes_);
+}
+
+TEST_F(SysexTransferTest, Errors)
+{
+  const auto data = RandomData(1000);
+  const auto chunks = Chunks(data);
+
+  // No transfer
+  EXPECT_REPLY(COMMAND::DATA, 0, STATUS::INVALID, Send(chunks[0]));
+  EXPECT_REPLY(COMMAND::END, 0, STATUS::INVALID, Send(EndMessage(Crc(data))));
+
+  // No sink
+  EXPECT_REPLY(COMMAND::BEGIN, 0, STATUS::UNSUPPORTED,
+               Send(BeginMessage(TYPE::WAVETABLE, 0, 0, data.size())));
+  EXPECT_REPLY(COMMAND::BEGIN, 0, STATUS::INVALID, Send(BeginMessage(TYPE::LAST, 0, 0, 1)));
+  EXPECT_REPLY(COMMAND::BEGIN, 0, STATUS::INVALID, Send(BeginMessage(TYPE::SID, 0, 0, 0)));
+
+  // Incomplete
+  EXPECT_REPLY(COMMAND::BEGIN, 0, STATUS::OK, Send(BeginMessage(TYPE::SID, 0, 0, data.size())));
+  EXPECT_REPLY(COMMAND::DATA, 0, STATUS::OK, Send(chunks[0]));
+  EXPECT_REPLY(COMMAND::END, 1, STATUS::CRC, Send(EndMessage(Crc(data))));
+  EXPECT_FALSE(sink_.ok_);
+  EXPECT_FALSE(transfer_.active());
+
+  // Wrong CRC
+  EXPECT_REPLY(COMMAND::BEGIN, 0, STATUS::OK, Send(BeginMessage(TYPE::SID, 0, 0, data.size())));
+  for (auto &chunk : chunks) Send(chunk);
+  EXPECT_REPLY(COMMAND::END, 4, STATUS::CRC, Send(EndMessage(Crc(data) ^ 1)));
+  EXPECT_FALSE(sink_.ok_);
+
+  // Chunk is the wrong size
+  EXPECT_REPLY(COMMAND::BEGIN, 0, STATUS::OK, Send(BeginMessage(TYPE::SID, 0, 0, data.size())));
+  EXPECT_REPLY(COMMAND::DATA, 0, STATUS::INVALID, Send(DataMessage(0, data.data(), 100)));
+  EXPECT_FALSE(transfer_.active());
+
+  // Interrupted message
+  EXPECT_REPLY(COMMAND::BEGIN, 0, STATUS::OK, Send(BeginMessage(TYPE::SID, 0, 0, data.size())));
+  auto interrupted = chunks[0];
+  interrupted.resize(100);
+  midi_parser_.Parse(interrupted.data(), interrupted.size());
+  EXPECT_REPLY(COMMAND::BEGIN, 0, STATUS::OK, Send(BeginMessage(TYPE::SID, 0, 0, data.size())));
+  EXPECT_REPLY(COMMAND::DATA, 0, STATUS::OK, Send(chunks[0]));
+}
+
+TEST_F(SysexTransferTest, Bank)
+{
+  HostFlashStorage storage{3, 64 * 1024};
+  synth::PatchBank bank;
+  ASSERT_TRUE(bank.Init(&storage));
+  synth::PatchReceiver receiver;
+  receiver.Init(&bank);
+  transfer_.set_sink(TYPE::PATCH, &receiver);
+  transfer_.set_sink(TYPE::BANK, &receiver);
+
+  static constexpr size_t kNumPatches = 5;
+  static constexpr uint8_t kSlot = 120;
+  std::vector<uint8_t> data;
+  for (size_t i = 0; i < kNumPatches; ++i) {
+    synth::Patch patch;
+    patch.parameters.mutable_value(synth::GLOBAL::FILTER_FREQ).set(static_cast<int>(1000 + i));
+    if (i == 2) patch.scale.reference_freq = -1.f;
+    auto p = reinterpret_cast<uint8_t *>(&patch);
+    if (i == 1) {
+      // Values and names out of range, as far as it's possible to find them
+      const int16_t freq = 1001;
+      auto v = std::search(p, p + sizeof(patch), reinterpret_cast<const uint8_t *>(&freq),
+                           reinterpret_cast<const uint8_t *>(&freq) + sizeof(freq));
+      ASSERT_NE(p + sizeof(patch), v);
+      const int16_t invalid = 32767;
+      memcpy(v, &invalid, sizeof(invalid));
+      auto name = std::search(p, p + sizeof(patch), patch.name(), patch.name() + 7);
+      ASSERT_NE(p + sizeof(patch), name);
+      memset(name, 'x', 20);
+    }
+    data.insert(data.end(), p, p + sizeof(patch));
+  }
+
+  EXPECT_REPLY(COMMAND::BEGIN, 0, STATUS::INVALID,
+               Send(BeginMessage(TYPE::PATCH, kSlot, synth::PatchBank::kPatchVersion,
+                                 data.size())));
+  EXPECT_REPLY(COMMAND::BEGIN, 0, STATUS::INVALID,
+               Send(BeginMessage(TYPE::BANK, kSlot, 0, data.size())));
+  EXPECT_REPLY(COMMAND::BEGIN, 0, STATUS::INVALID,
+               Send(BeginMessage(TYPE::BANK, kSlot + 4, synth::PatchBank::kPatchVersion,
+                                 data.size())));
+  EXPECT_REPLY(COMMAND::BEGIN, 0, STATUS::INVALID,
+               Send(BeginMessage(TYPE::BANK, kSlot, synth::PatchBank::kPatchVersion,
+                                 data.size() - 1)));
+
+  EXPECT_REPLY(
+      COMMAND::BEGIN, 0, STATUS::OK,
+      Send(BeginMessage(TYPE::BANK, kSlot, synth::PatchBank::kPatchVersion, data.size())));
+  for (auto &chunk : Chunks(data)) EXPECT_EQ(STATUS::OK, Send(chunk).status);
+  EXPECT_EQ(STATUS::OK, Send(EndMessage(Crc(data))).status);
+
+  for (size_t i = 0; i < kNumPatches; ++i) {
+    auto patch = bank.Find(kSlot + i);
+    ASSERT_NE(nullptr, patch);
+    EXPECT_EQ(static_cast<int>(kSlot + i), patch->number());
+    auto value = patch->parameters.get<synth::GLOBAL::FILTER_FREQ>().value();
+    EXPECT_EQ(i == 1 ? 1024 : static_cast<int>(1000 + i), value);
+    EXPECT_GT(20, strlen(patch->name()));
+    EXPECT_GT(patch->scale.reference_freq, 0.f);
+  }
+}
+
+TEST_F(SysexTransferTest, FlashFile)
+{
+  HostFlashStorage storage{2, 16 * 1024};
+  util::FlashFile file;
+  file.Init(&storage);
+  EXPECT_FALSE(file.valid());
+  EXPECT_EQ(0, file.size());
+
+  FileSink file_sink{&file};
+  transfer_.set_sink(TYPE::SID, &file_sink);
+
+  const auto data = RandomData(20000);
+  EXPECT_REPLY(COMMAND::BEGIN, 0, STATUS::INVALID,
+               Send(BeginMessage(TYPE::SID, 0, 0, file.capacity() + 1)));
+  EXPECT_REPLY(COMMAND::BEGIN, 0, STATUS::OK, Send(BeginMessage(TYPE::SID, 0, 0, data.size())));
+  for (auto &chunk : Chunks(data)) EXPECT_EQ(STATUS::OK, Send(chunk).status);
+  EXPECT_REPLY(COMMAND::END, 79, STATUS::OK, Send(EndMessage(Crc(data))));
+
+  ASSERT_TRUE(file.valid());
+  ASSERT_EQ(data.size(), file.size());
+  EXPECT_EQ(0, memcmp(data.data(), file.data(), data.size()));
+
+  util::FlashFile reloaded;
+  reloaded.Init(&storage);
+  EXPECT_TRUE(reloaded.valid());
+  EXPECT_EQ(data.size(), reloaded.size());
+
+  // Power loss during the next upload leaves no valid file
+  storage.set_budget(2 * 16 * 1024 + 100);
+  EXPECT_REPLY(COMMAND::BEGIN, 0, STATUS::OK, Send(BeginMessage(TYPE::SID, 0, 0, data.size())));
+  EXPECT_REPLY(COMMAND::DATA, 0, STATUS::WRITE, Send(Chunks(data)[0]));
+  storage.PowerOn();
+  reloaded.Init(&storage);
+  EXPECT_FALSE(reloaded.valid());
+}
+
+}  // namespace pfm2sid::test
@@ -0,0 +1,145 @@
+#include <cmath>
+
+#include "fmt/core.h"
+#include "gtest/gtest.h"
+#include "sidbits/sidbits.h"
+#include "synth/tuning.h"
+
+namespace pfm2sid::test {
+
+using synth::Scale;
+using synth::TuningTable;
+
+static util::s816 note_fp(int32_t note, int32_t fraction = 0)
+{
+  return util::s816::from(note, fraction);
+}
+
+TEST(TuningTest, EqualTemperament)
+{
+  Scale scale;
+  EXPECT_TRUE(scale.valid());
+  EXPECT_EQ(12, scale.num_degrees);
+  EXPECT_FLOAT_EQ(440.f, scale.note_freq(81));
+  EXPECT_FLOAT_EQ(880.f, scale.note_freq(93));
+  EXPECT_NEAR(261.63f, scale.note_freq(72), 0.01f);
+  EXPECT_NEAR(16.35f, scale.note_freq(midi::C0), 0.01f);
+
+  static TuningTable tuning_table;
+  tuning_table.Init(scale, sidbits::SID_CLOCK::PAL);
+
+  // Should match the existing table where it doesn't overflow
+  for (int32_t note = midi::C0; note < 95; ++note) {
+    auto expected = sidbits::midi_to_osc_freq(note);
+    auto f = tuning_table.osc_freq(note_fp(note));
+    EXPECT_NEAR(expected, f, 1) << note;
+  }
+
+  // Fractional notes are monotonic
+  uint16_t last = 0;
+  for (int32_t n = 0; n < (128 << 16); n += 1 << 10) {
+    auto f = tuning_table.osc_freq(util::s816::from_raw(n));
+    EXPECT_LE(last, f) << n;
+    last = f;
+  }
+
+  // Clamped at both ends
+  EXPECT_EQ(0xffff, tuning_table.osc_freq(note_fp(127)));
+  EXPECT_EQ(tuning_table.osc_freq(note_fp(0)), tuning_table.osc_freq(note_fp(-12)));
+
+  // Halfway between semitones is ~50 cents
+  auto a = static_cast<float>(tuning_table.osc_freq(note_fp(60)));
+  auto b = static_cast<float>(tuning_table.osc_freq(note_fp(60, 0x8000)));
+  EXPECT_NEAR(50.f, 1200.f * log2f(b / a), 2.f);
+}
+
+TEST(TuningTest, Clock)
+{
+  static TuningTable pal, ntsc;
+  Scale scale;
+  pal.Init(scale, sidbits::SID_CLOCK::PAL);
+  ntsc.Init(scale, sidbits::SID_CLOCK::NTSC);
+  EXPECT_EQ(sidbits::SID_CLOCK::NTSC, ntsc.sid_clock());
+
+  // The same frequency needs a lower value with a faster clock
+  for (int32_t note = 24; note < 90; ++note) {
+    auto p = pal.osc_freq(note_fp(note));
+    auto n = ntsc.osc_freq(note_fp(note));
+    EXPECT_LT(n, p);
+    EXPECT_NEAR(static_cast<float>(p) * sidbits::CLOCK_FREQ_PAL / sidbits::CLOCK_FREQ_NTSC,
+                static_cast<float>(n), 1.f);
+  }
+}
+
+TEST(TuningTest, Scale)
+{
+  // Bohlen-Pierce style: 13 equal steps of a tritave
+  Scale scale;
+  scale.num_degrees = 13;
+  for (unsigned i = 0; i < 13; ++i)
+    scale.set_degree_cents(i, 1901.955f * static_cast<float>(i + 1) / 13.f);
+  scale.root_note = 60;
+  scale.reference_note = 60;
+  scale.reference_freq = 200.f;
+
+  EXPECT_FLOAT_EQ(0.f, scale.note_cents(60));
+  // Degrees are stored in 1/10 cents
+  EXPECT_FLOAT_EQ(1902.f, scale.note_cents(73));
+  EXPECT_FLOAT_EQ(-1902.f, scale.note_cents(47));
+  EXPECT_NEAR(600.f, scale.note_freq(73), 0.05f);
+  EXPECT_NEAR(200.f / 3.f, scale.note_freq(47), 0.01f);
+
+  static TuningTable tuning_table;
+  tuning_table.Init(scale, sidbits::SID_CLOCK::PAL);
+  auto ratio = static_cast<float>(tuning_table.osc_freq(note_fp(73))) /
+               static_cast<float>(tuning_table.osc_freq(note_fp(60)));
+  EXPECT_NEAR(3.f, ratio, 0.001f);
+}
+
+TEST(TuningTest, Sysex)
+{
+  // Just intonation major scale, root C4, A4 = 432Hz
+  const uint32_t cents[] = {20391, 38631, 49804, 70196, 88436, 108827, 120000};
+  uint8_t sysex[8 + 7 * 3] = {synth::PFM2SID_SYSEX_ID, synth::SYSEX_SCALE, 60, 69};
+  auto put_u21 = [](uint8_t *dst, uint32_t value) {
+    dst[0] = (value >> 14) & 0x7f;
+    dst[1] = (value >> 7) & 0x7f;
+    dst[2] = value & 0x7f;
+  };
+  put_u21(sysex + 4, 432000);
+  sysex[7] = 7;
+  for (unsigned i = 0; i < 7; ++i) put_u21(sysex + 8 + i * 3, cents[i]);
+
+  Scale scale;
+  EXPECT_FALSE(synth::ParseScaleSysex(sysex, sizeof(sysex) - 1, scale));
+  EXPECT_EQ(12, scale.num_degrees);
+
+  ASSERT_TRUE(synth::ParseScaleSysex(sysex, sizeof(sysex), scale));
+  EXPECT_EQ(7, scale.num_degrees);
+  EXPECT_EQ(60, scale.root_note);
+  EXPECT_EQ(69, scale.reference_note);
+  EXPECT_FLOAT_EQ(432.f, scale.reference_freq);
+  EXPECT_FLOAT_EQ(1200.f, scale.period());
+  EXPECT_FLOAT_EQ(432.f, scale.note_freq(69));
+  // Notes are mapped to scale degrees, so 7 keys per octave
+  EXPECT_NEAR(2.f * scale.note_freq(60), scale.note_freq(67), 0.01f);
+  EXPECT_NEAR(1.5f, scale.note_freq(64) / scale.note_freq(60), 0.001f);
+  fmt::println("C4={} G4={}", scale.note_freq(60), scale.note_freq(64));
+
+  EXPECT_FLOAT_EQ(203.9f, scale.degree_cents(0));
+
+  // Zero period is invalid
+  sysex[7] = 1;
+  put_u21(sysex + 8, 0);
+  EXPECT_FALSE(synth::ParseScaleSysex(sysex, 11, scale));
+  EXPECT_EQ(7, scale.num_degrees);
+
+  // So are degrees that can't be stored
+  put_u21(sysex + 8, 655360);
+  EXPECT_FALSE(synth::ParseScaleSysex(sysex, 11, scale));
+  put_u21(sysex + 8, 655350);
+  ASSERT_TRUE(synth::ParseScaleSysex(sysex, 11, scale));
+  EXPECT_FLOAT_EQ(Scale::kMaxDegreeCents, scale.period());
+}
+
+}  // namespace pfm2sid::test
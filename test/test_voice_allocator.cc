@@ -1,5 +1,9 @@
+#include <algorithm>
+#include <vector>
+
 #include "fmt/core.h"
 #include "gtest/gtest.h"
+#include "linear_voice_allocator.h"
 #include "synth/voice_allocator.h"
 
 namespace pfm2sid::test {
@@ -84,4 +88,196 @@ TEST(VoiceAllocatorTest, Poly)
   Dump(voice_allocator.lru());
 }
 
+TEST(VoiceAllocatorTest, ChipPoly)
+{
+  synth::ChipVoiceAllocator<2, 3, synth::STEAL_STRATEGY::LRU> voice_allocator;
+
+  // Same group fills the first chip before using the next one
+  for (midi::Note note = 60; note < 63; ++note) {
+    auto v = voice_allocator.NoteOn(note, 100, 0);
+    ASSERT_TRUE(v);
+    EXPECT_EQ(0U, voice_allocator.chip(v.value()));
+  }
+  EXPECT_EQ(3U, voice_allocator.chip_active_voices(0));
+  EXPECT_FALSE(voice_allocator.chip_active(1));
+
+  auto v = voice_allocator.NoteOn(63, 100, 0);
+  ASSERT_TRUE(v);
+  EXPECT_EQ(1U, voice_allocator.chip(v.value()));
+
+  // Retrigger uses the same voice
+  auto r = voice_allocator.NoteOn(63, 50, 0);
+  ASSERT_TRUE(r);
+  EXPECT_EQ(v.value(), r.value());
+  EXPECT_EQ(50, voice_allocator.voices()[r.value()].velocity);
+  EXPECT_EQ(4U, voice_allocator.lru().size());
+
+  // Releasing all voices on a chip frees it for another group
+  EXPECT_TRUE(voice_allocator.NoteOff(63));
+  EXPECT_FALSE(voice_allocator.chip_active(1));
+  v = voice_allocator.NoteOn(90, 100, 1);
+  ASSERT_TRUE(v);
+  EXPECT_EQ(1U, voice_allocator.chip(v.value()));
+  EXPECT_EQ(1, voice_allocator.chip_group(1));
+  DumpVoices(voice_allocator.voices());
+  Dump(voice_allocator.lru());
+}
+
+TEST(VoiceAllocatorTest, ChipPolyGroups)
+{
+  synth::ChipVoiceAllocator<3, 3, synth::STEAL_STRATEGY::LRU> voice_allocator;
+
+  // Interleaved groups end up on separate chips
+  for (midi::Note note = 0; note < 6; ++note) {
+    auto group = static_cast<synth::FilterGroup>(note & 1);
+    auto v = voice_allocator.NoteOn(note + 60, 100, group);
+    ASSERT_TRUE(v);
+    EXPECT_EQ(group, voice_allocator.chip_group(voice_allocator.chip(v.value())));
+  }
+  EXPECT_EQ(3U, voice_allocator.chip_active_voices(0));
+  EXPECT_EQ(3U, voice_allocator.chip_active_voices(1));
+  EXPECT_FALSE(voice_allocator.chip_active(2));
+
+  // Group 0 overflows to the idle chip
+  auto v = voice_allocator.NoteOn(70, 100, 0);
+  ASSERT_TRUE(v);
+  EXPECT_EQ(2U, voice_allocator.chip(v.value()));
+
+  // Fill up the last chip with another group, then all voices are in use
+  EXPECT_TRUE(voice_allocator.NoteOn(71, 100, 2));
+  EXPECT_TRUE(voice_allocator.NoteOn(72, 100, 2));
+  EXPECT_EQ(9U, voice_allocator.lru().size());
+
+  // Stealing prefers the oldest voice in the same group (note 61 on chip 1)
+  v = voice_allocator.NoteOn(73, 100, 1);
+  ASSERT_TRUE(v);
+  EXPECT_EQ(1U, voice_allocator.chip(v.value()));
+  EXPECT_FALSE(voice_allocator.Find(61));
+  EXPECT_EQ(v.value(), voice_allocator.lru().back());
+
+  // ...and the oldest voice overall if there is no match
+  v = voice_allocator.NoteOn(74, 100, 5);
+  ASSERT_TRUE(v);
+  EXPECT_FALSE(voice_allocator.Find(60));
+  EXPECT_EQ(0U, voice_allocator.chip(v.value()));
+
+  voice_allocator.Clear();
+  for (size_t chip = 0; chip < 3; ++chip) EXPECT_FALSE(voice_allocator.chip_active(chip));
+  EXPECT_EQ(0U, voice_allocator.lru().size());
+}
+
+TEST(VoiceAllocatorTest, PolyAllocate)
+{
+  synth::VoiceAllocator<3, synth::STEAL_STRATEGY::LRU> voice_allocator;
+  EXPECT_FALSE(voice_allocator.Find(63));
+
+  EXPECT_EQ(0U, voice_allocator.NoteOn(63, 127).value());
+  EXPECT_EQ(1U, voice_allocator.NoteOn(64, 123).value());
+  EXPECT_EQ(2U, voice_allocator.NoteOn(65, 123).value());
+  EXPECT_EQ(3U, voice_allocator.lru().size());
+  EXPECT_EQ(1U, voice_allocator.Find(64).value());
+
+  // Freed voice isn't re-used immediately if there are others (round robin)
+  EXPECT_EQ(1U, voice_allocator.NoteOff(64).value());
+  EXPECT_FALSE(voice_allocator.NoteOff(64));
+  EXPECT_EQ(midi::INVALID_NOTE, voice_allocator.voices()[1].note);
+  EXPECT_EQ(1U, voice_allocator.NoteOn(66, 100).value());
+
+  // Retrigger
+  EXPECT_EQ(0U, voice_allocator.NoteOn(63, 10).value());
+  EXPECT_EQ(10, voice_allocator.voices()[0].velocity);
+  EXPECT_EQ(0U, voice_allocator.lru().back());
+
+  // Steal least recently used, 65
+  EXPECT_EQ(2U, voice_allocator.NoteOn(67, 100).value());
+  EXPECT_FALSE(voice_allocator.Find(65));
+  EXPECT_FALSE(voice_allocator.NoteOff(65));
+  EXPECT_EQ(3U, voice_allocator.lru().size());
+
+  voice_allocator.Clear();
+  EXPECT_EQ(0U, voice_allocator.lru().size());
+  EXPECT_FALSE(voice_allocator.Find(63));
+}
+
+// Stealing from the per-group lists has to pick the same voice as a scan of the full LRU would
+TEST(VoiceAllocatorTest, ChipPolySteal)
+{
+  synth::ChipVoiceAllocator<4, 3, synth::STEAL_STRATEGY::LRU> voice_allocator;
+
+  uint32_t random = 1;
+  for (int i = 0; i < 10000; ++i) {
+    random = random * 1664525U + 1013904223U;
+    auto note = static_cast<midi::Note>((random >> 8) % 32 + 48);
+    auto group = static_cast<synth::FilterGroup>((random >> 16) % 4);
+    if ((random >> 24) % 4) {
+      std::optional<synth::VoiceIndex> expected;
+      if (!voice_allocator.Find(note) && voice_allocator.lru().size() == 12) {
+        expected = voice_allocator.lru().front();
+        for (auto v : voice_allocator.lru()) {
+          if (voice_allocator.chip_group(voice_allocator.chip(v)) == group) {
+            expected = v;
+            break;
+          }
+        }
+      }
+      auto v = voice_allocator.NoteOn(note, 100, group);
+      ASSERT_TRUE(v);
+      if (expected) {
+        ASSERT_EQ(expected.value(), v.value());
+      }
+    } else {
+      (void)voice_allocator.NoteOff(note);
+    }
+  }
+}
+
+TEST(VoiceAllocatorTest, ChipPolyLimit)
+{
+  synth::ChipVoiceAllocator<2, 3, synth::STEAL_STRATEGY::LRU> voice_allocator;
+  for (midi::Note note = 60; note < 66; ++note) ASSERT_TRUE(voice_allocator.NoteOn(note, 100, 0));
+  EXPECT_EQ(3U, voice_allocator.chip_active_voices(1));
+
+  // Voices on the other chip are released
+  std::vector<synth::VoiceIndex> released;
+  voice_allocator.set_chip_limit(1, [&](synth::VoiceIndex v) { released.push_back(v); });
+  EXPECT_EQ((std::vector<synth::VoiceIndex>{3, 4, 5}), released);
+  EXPECT_FALSE(voice_allocator.chip_active(1));
+  EXPECT_EQ(3U, voice_allocator.lru().size());
+  for (midi::Note note = 63; note < 66; ++note) EXPECT_FALSE(voice_allocator.Find(note));
+
+  // ...and new notes only steal on the first one
+  for (midi::Note note = 70; note < 76; ++note) {
+    auto v = voice_allocator.NoteOn(note, 100, static_cast<synth::FilterGroup>(note & 1));
+    ASSERT_TRUE(v);
+    EXPECT_EQ(0U, voice_allocator.chip(v.value()));
+  }
+  EXPECT_FALSE(voice_allocator.chip_active(1));
+
+  voice_allocator.set_chip_limit(2, [&](synth::VoiceIndex) { FAIL(); });
+  auto v = voice_allocator.NoteOn(80, 100, 0);
+  ASSERT_TRUE(v);
+  EXPECT_EQ(1U, voice_allocator.chip(v.value()));
+}
+
+// Same allocation order as the original linear implementation
+TEST(VoiceAllocatorTest, MatchesLinear)
+{
+  LinearVoiceAllocator<12, synth::STEAL_STRATEGY::LRU> reference;
+  synth::VoiceAllocator<12, synth::STEAL_STRATEGY::LRU> voice_allocator;
+
+  uint32_t random = 1;
+  for (int i = 0; i < 10000; ++i) {
+    random = random * 1664525U + 1013904223U;
+    auto note = static_cast<midi::Note>((random >> 8) % 32 + 48);
+    if ((random >> 24) & 1) {
+      ASSERT_EQ(reference.NoteOn(note, 100), voice_allocator.NoteOn(note, 100));
+    } else {
+      ASSERT_EQ(reference.NoteOff(note), voice_allocator.NoteOff(note));
+    }
+    ASSERT_EQ(reference.lru().size(), voice_allocator.lru().size());
+    ASSERT_TRUE(std::equal(reference.lru().begin(), reference.lru().end(),
+                           voice_allocator.lru().begin()));
+  }
+}
+
 }  // namespace pfm2sid::test
@@ -4,15 +4,16 @@
 #include "synth/wavetable.h"
 
 template <>
-class fmt::formatter<pfm2sid::synth::WaveTable::Entry> {
+class fmt::formatter<pfm2sid::synth::WaveTable::Step> {
 public:
   constexpr auto parse(format_parse_context& ctx) { return ctx.begin(); }
   template <typename Context>
-  constexpr auto format(pfm2sid::synth::WaveTable::Entry& entry, Context& ctx) const
+  constexpr auto format(const pfm2sid::synth::WaveTable::Step& step, Context& ctx) const
   {
-    char buf[5] = {0};
-    return format_to(ctx.out(), "[ {:4} {:+2} {} ]", pfm2sid::synth::action_to_string(entry, buf),
-                     entry.transpose, static_cast<uint8_t>(entry.waveform));
+    char buf[8] = {0};
+    return format_to(ctx.out(), "[ {:7} {:2} {:+3} {:02x} {:02x} {:+4} ]",
+                     pfm2sid::synth::action_to_string(step, buf), step.duration, step.transpose,
+                     step.wave_gate, step.pwm, step.filter);
   }
 };
 
@@ -20,41 +21,127 @@ namespace pfm2sid::test {
 
 using synth::WaveTable;
 using synth::WaveTableScanner;
+using Step = WaveTable::Step;
+
+static constexpr Step test_steps[] = {
+    Step::Play(1).Transpose(12).Wave(sidbits::OSC_WAVE::SAW),
+    Step::Play(2).Transpose(-12).Gate(true),
+    Step::Play(4).Pwm(0x80),
+    Step::Loop(),
+};
 
 TEST(WaveTableTest, Basics)
 {
-  WaveTable wt;
+  static_assert(sizeof(Step) == 6);
 
-  int i = 0;
-  for (auto s : wt) {
-    if (i++ < 8) fmt::println("{:2x} {}", i, s);
+  constexpr WaveTable wt{test_steps};
+  EXPECT_EQ(4U, wt.size());
 
-    EXPECT_TRUE(WaveTable::END == s.action);
-    EXPECT_EQ(0, s.transpose);
-    EXPECT_EQ(sidbits::OSC_WAVE::SILENCE, s.waveform);
-  }
+  for (auto& s : wt) fmt::println("{}", s);
+
+  constexpr auto step = Step::Play(3).Transpose(-5).Wave(sidbits::OSC_WAVE::PULSE).Gate(true);
+  static_assert(WaveTable::PLAY == step.action());
+  static_assert(step.is_enabled<WaveTable::TRANSPOSE>());
+  static_assert(step.is_enabled<WaveTable::WAVEFORM>());
+  static_assert(step.is_enabled<WaveTable::GATE>());
+  static_assert(!step.is_enabled<WaveTable::PWM>());
+  static_assert(!step.is_enabled<WaveTable::FILTER>());
+  static_assert(sidbits::OSC_WAVE::PULSE == step.waveform());
+  static_assert(step.gate());
+  static_assert(-5 == step.transpose);
+  static_assert(3 == step.ticks());
+  static_assert(WaveTable::END == step.End().action());
+  static_assert(step.End().is_enabled<WaveTable::GATE>());
+
+  // Out of range
+  EXPECT_EQ(WaveTable::END, wt.at(4).action());
+  EXPECT_EQ(WaveTable::END, WaveTable{}.at(0).action());
+
+  for (auto& t : synth::wavetables) EXPECT_GT(t.size(), 0U);
 }
 
 TEST(WaveTableTest, Scanner)
 {
-  WaveTable wt;
+  constexpr WaveTable wt{test_steps};
   WaveTableScanner wts;
-
-  auto& data = wt.mutable_data();
-  data[0] = {60, sidbits::OSC_WAVE::SAW};
-  data[1] = {61, sidbits::OSC_WAVE::SAW};
-  data[2] = {WaveTable::LOOP};
+  WaveTableScanner::Events events;
 
   EXPECT_FALSE(wts.active());
 
-  wts.SetSource(&wt);
+  // 8 samples per tick, so steps at 0, 8, 24, then loop at 56
   wts.set_rate(WaveTableScanner::kRateMax);
+  wts.SetSource(&wt);
   EXPECT_TRUE(wts.active());
 
+  auto state = wts.Advance(32, events);
+  EXPECT_EQ(12, state.transpose);
+  EXPECT_EQ(sidbits::OSC_WAVE::SAW, state.waveform());
+  EXPECT_FALSE(state.is_enabled<WaveTable::GATE>());
+  ASSERT_EQ(2U, events.size());
+
+  auto e = events.begin();
+  EXPECT_EQ(8, e->offset);
+  EXPECT_EQ(Step::track_mask<WaveTable::TRANSPOSE>() | Step::track_mask<WaveTable::GATE>(),
+            e->tracks);
+  EXPECT_EQ(-12, e->state.transpose);
+  EXPECT_TRUE(e->state.gate());
+  EXPECT_EQ(sidbits::OSC_WAVE::SAW, e->state.waveform());  // Tracks hold values
+  ++e;
+  EXPECT_EQ(24, e->offset);
+  EXPECT_EQ(Step::track_mask<WaveTable::PWM>(), e->tracks);
+  EXPECT_EQ(0x800, e->state.pwm12());
+  EXPECT_EQ(-12, e->state.transpose);
+  EXPECT_TRUE(events.any<WaveTable::PWM>());
+  EXPECT_FALSE(events.any<WaveTable::WAVEFORM>());
+
+  state = wts.Advance(32, events);
+  EXPECT_EQ(0x80, state.pwm);
+  ASSERT_EQ(1U, events.size());
+  EXPECT_EQ(56 - 32, events.begin()->offset);
+  EXPECT_EQ(12, events.begin()->state.transpose);
+
+  // Slower rate, 16 samples per tick
+  wts.set_rate(WaveTableScanner::kRateMax - 1);
+  wts.SetSource(&wt);
+  wts.Advance(32, events);
+  ASSERT_EQ(1U, events.size());
+  EXPECT_EQ(16, events.begin()->offset);
+  wts.Advance(32, events);
+  ASSERT_EQ(1U, events.size());
+  EXPECT_EQ(16, events.begin()->offset);
+  EXPECT_EQ(Step::track_mask<WaveTable::PWM>(), events.begin()->tracks);
+
+  // Steps starting exactly at the end of the block are part of the next block's start state
+  wts.set_rate(WaveTableScanner::kRateMax - 3);
+  wts.SetSource(&wt);
+  wts.Advance(32, events);
+  EXPECT_TRUE(events.empty());
+  state = wts.Advance(32, events);
+  EXPECT_TRUE(events.empty());
+  EXPECT_EQ(-12, state.transpose);
+}
+
+TEST(WaveTableTest, ScannerEnd)
+{
+  static constexpr Step steps[] = {
+      Step::Play(1).Transpose(1),
+      Step::Play(1).Transpose(2).End(),
+      Step::Play(1).Transpose(3),
+  };
+  constexpr WaveTable wt{steps};
+  WaveTableScanner wts;
+  WaveTableScanner::Events events;
+
+  wts.set_rate(WaveTableScanner::kRateMax);
+  wts.SetSource(&wt);
+  wts.Advance(32, events);
+  ASSERT_EQ(1U, events.size());
+  EXPECT_EQ(2, events.begin()->state.transpose);
+
   for (int i = 0; i < 4; ++i) {
-    auto step = wts.Update();
-    fmt::println("{:2x} {}", i, step);
-    EXPECT_EQ(WaveTable::PLAY, step.action);
+    auto state = wts.Advance(32, events);
+    EXPECT_TRUE(events.empty());
+    EXPECT_EQ(2, state.transpose);
   }
 }
 }  // namespace pfm2sid::test